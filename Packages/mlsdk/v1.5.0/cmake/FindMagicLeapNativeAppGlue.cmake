@@ -14,11 +14,21 @@ none for device
 for ZI / Host building:
 MLSDK = path to the top level installation directory of the
                     MagicLeap SDK.
+ML_ZI_OPEN_LOOPER = (linux only) link the glue against the open epoll
+                    based ALooper in zi_android_sdk/looper instead of the
+                    ZI runtime's android and log libraries.
+ML_ZI_LOOPER_BENCHMARKS = (linux only) also build the zi_looper_benchmark
+                    executable.
+ML_ZI_APP_SCHEDULER_WORKERS = when set, start the android_app task scheduler
+                    with that many workers before android_main() is
+                    invoked (0 derives the count from the CPU cores).
+                    Left empty the app starts it itself.
 
 Outputs:
 --------
 
 native_app_glue
+zi_looper (when ML_ZI_OPEN_LOOPER is enabled)
 
 #]=======================================================================]
 
@@ -41,11 +51,44 @@ if(ML_TARGET STREQUAL ml2)
 
 else()
 
-    add_library(native_app_glue STATIC "${MLSDK}/zi_android_sdk/native_app_glue/android_native_app_glue.cpp")
+    option(ML_ZI_OPEN_LOOPER "Use the open epoll based ALooper on Linux hosts" OFF)
+    option(ML_ZI_LOOPER_BENCHMARKS "Build the open ALooper microbenchmarks" OFF)
+    set(ML_ZI_APP_SCHEDULER_WORKERS "" CACHE STRING "Workers of the android_app task scheduler started before android_main(), empty to not start it")
+
+    add_library(native_app_glue STATIC
+        "${MLSDK}/zi_android_sdk/native_app_glue/android_native_app_glue.cpp"
+        "${MLSDK}/zi_android_sdk/native_app_glue/android_app_saved_state.cpp"
+        "${MLSDK}/zi_android_sdk/native_app_glue/android_app_scheduler.cpp"
+        "${MLSDK}/zi_android_sdk/native_app_glue/android_app_trace.cpp")
     target_include_directories(native_app_glue PUBLIC "${MLSDK}/zi_android_sdk/include" "${MLSDK}/zi_android_sdk/native_app_glue" )
     set_property(TARGET native_app_glue PROPERTY POSITION_INDEPENDENT_CODE TRUE)
     target_link_directories(native_app_glue PUBLIC "${MLSDK}/lib/${ML_TARGET}")
-    target_link_libraries(native_app_glue android log)
+
+    find_package(Threads REQUIRED)
+    target_link_libraries(native_app_glue Threads::Threads)
+
+    if(ML_TARGET STREQUAL linux AND ML_ZI_OPEN_LOOPER)
+
+        add_library(zi_looper STATIC
+            "${MLSDK}/zi_android_sdk/looper/looper_epoll.cpp"
+            "${MLSDK}/zi_android_sdk/looper/looper_event_reader_writer_eventfd.cpp"
+            "${MLSDK}/zi_android_sdk/looper/android_log_stderr.cpp")
+        target_include_directories(zi_looper PUBLIC "${MLSDK}/zi_android_sdk/include")
+        set_property(TARGET zi_looper PROPERTY POSITION_INDEPENDENT_CODE TRUE)
+        target_compile_features(zi_looper PRIVATE cxx_std_11)
+        target_link_libraries(zi_looper PUBLIC Threads::Threads)
+
+        target_link_libraries(native_app_glue zi_looper)
+
+        if(ML_ZI_LOOPER_BENCHMARKS)
+            add_executable(zi_looper_benchmark "${MLSDK}/zi_android_sdk/looper/looper_benchmark.cpp")
+            target_link_libraries(zi_looper_benchmark zi_looper)
+            target_compile_features(zi_looper_benchmark PRIVATE cxx_std_11)
+        endif()
+
+    else()
+        target_link_libraries(native_app_glue android log)
+    endif()
 
     if(ML_TARGET STREQUAL osx)
     target_link_options(native_app_glue PUBLIC -u _OnAppLaunchZIv2)
@@ -58,6 +101,13 @@ else()
 
     if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU" OR CMAKE_CXX_COMPILER_ID STREQUAL "Clang")
         target_compile_options(native_app_glue PRIVATE -Werror -Wall -Wextra -Wno-unused-function -Wno-deprecated-declarations)
+        if(TARGET zi_looper)
+            target_compile_options(zi_looper PRIVATE -Werror -Wall -Wextra)
+        endif()
+    endif()
+
+    if(NOT ML_ZI_APP_SCHEDULER_WORKERS STREQUAL "")
+        target_compile_definitions(native_app_glue PRIVATE ANDROID_APP_SCHEDULER_WORKERS=${ML_ZI_APP_SCHEDULER_WORKERS})
     endif()
 
     target_compile_features(native_app_glue PRIVATE cxx_std_11)
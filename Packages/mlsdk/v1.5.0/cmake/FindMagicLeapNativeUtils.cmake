@@ -0,0 +1,139 @@
+# Copyright 2024 (c) Magic Leap Inc.
+
+#[=======================================================================[.rst:
+FindMagicLeapNativeUtils
+-------
+
+Sets up the native utilities library: CPU-side helpers built on top of the
+Magic Leap C API (perception snapshots, depth and world cameras).
+
+Inputs:
+-------
+
+MLSDK = path to the top level installation directory of the
+                    MagicLeap SDK.
+
+Options:
+--------
+
+ML_NATIVE_UTILS_AVX2 = build the SIMD kernels for AVX2/FMA on x86-64
+                    (default ON; ML2 and development hosts support it).
+
+ML_NATIVE_UTILS_DEPTH_CAMERA_REPLAY = also build depth_camera_replay, a
+                    shared library implementing the depth camera C API by
+                    replaying recordings, for hosts without a headset
+                    (default OFF). Link it instead of ML::perception.
+
+ML_NATIVE_UTILS_TESTS = also build the native_utils tests and register them
+                    with CTest (default OFF). They compile the sources
+                    they cover against the C API headers only, so they
+                    run on hosts without a headset.
+
+Outputs:
+--------
+
+native_utils
+depth_camera_replay (when ML_NATIVE_UTILS_DEPTH_CAMERA_REPLAY is ON)
+*_test (when ML_NATIVE_UTILS_TESTS is ON)
+
+#]=======================================================================]
+
+find_package(MagicLeap REQUIRED)
+find_package(Threads REQUIRED)
+
+if (FindMagicLeapNativeUtils_FOUND)
+  return()
+endif()
+
+set(NATIVE_UTILS_DIR "${MLSDK}/native_utils")
+
+add_library(native_utils STATIC
+    "${NATIVE_UTILS_DIR}/clock_mapper.cpp"
+    "${NATIVE_UTILS_DIR}/depth_codec.cpp"
+    "${NATIVE_UTILS_DIR}/depth_frame_ring.cpp"
+    "${NATIVE_UTILS_DIR}/depth_mask.cpp"
+    "${NATIVE_UTILS_DIR}/depth_normals.cpp"
+    "${NATIVE_UTILS_DIR}/depth_pyramid.cpp"
+    "${NATIVE_UTILS_DIR}/depth_recording.cpp"
+    "${NATIVE_UTILS_DIR}/depth_rgb_registration.cpp"
+    "${NATIVE_UTILS_DIR}/depth_stream_merger.cpp"
+    "${NATIVE_UTILS_DIR}/depth_unprojector.cpp"
+    "${NATIVE_UTILS_DIR}/predicted_pose_service.cpp"
+    "${NATIVE_UTILS_DIR}/shared_snapshot.cpp"
+    "${NATIVE_UTILS_DIR}/snapshot_transform_resolver.cpp"
+    "${NATIVE_UTILS_DIR}/temporal_depth_filter.cpp"
+    "${NATIVE_UTILS_DIR}/transform_graph.cpp"
+    "${NATIVE_UTILS_DIR}/tsdf_volume.cpp"
+    "${NATIVE_UTILS_DIR}/worker_pool.cpp"
+    "${NATIVE_UTILS_DIR}/world_camera_features.cpp"
+    "${NATIVE_UTILS_DIR}/world_camera_grabber.cpp"
+    "${NATIVE_UTILS_DIR}/world_camera_stereo.cpp"
+)
+target_include_directories(native_utils PUBLIC "${NATIVE_UTILS_DIR}")
+set_property(TARGET native_utils PROPERTY POSITION_INDEPENDENT_CODE TRUE)
+target_link_libraries(native_utils PUBLIC ML::perception Threads::Threads)
+target_compile_features(native_utils PUBLIC cxx_std_17)
+
+if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU" OR CMAKE_CXX_COMPILER_ID STREQUAL "Clang")
+    target_compile_options(native_utils PRIVATE -Werror -Wall -Wextra -Wno-deprecated-declarations)
+endif()
+
+if(CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64|amd64")
+    option(ML_NATIVE_UTILS_AVX2 "Build native_utils SIMD kernels for AVX2/FMA" ON)
+    if(ML_NATIVE_UTILS_AVX2)
+        if(MSVC)
+            target_compile_options(native_utils PRIVATE /arch:AVX2)
+        else()
+            target_compile_options(native_utils PRIVATE -mavx2 -mfma)
+        endif()
+    endif()
+endif()
+
+option(ML_NATIVE_UTILS_DEPTH_CAMERA_REPLAY "Build the depth camera replay library" OFF)
+if(ML_NATIVE_UTILS_DEPTH_CAMERA_REPLAY)
+    add_library(depth_camera_replay SHARED
+        "${NATIVE_UTILS_DIR}/depth_camera_replay.cpp"
+        "${NATIVE_UTILS_DIR}/depth_codec.cpp"
+        "${NATIVE_UTILS_DIR}/depth_frame_ring.cpp"
+        "${NATIVE_UTILS_DIR}/depth_recording.cpp"
+    )
+    target_include_directories(depth_camera_replay PUBLIC "${NATIVE_UTILS_DIR}")
+    # Stands in for perception.magicleap, so only the headers are used.
+    target_link_libraries(depth_camera_replay PUBLIC base.magicleap Threads::Threads)
+    target_compile_definitions(depth_camera_replay PRIVATE ML_EXPORT)
+    target_compile_features(depth_camera_replay PUBLIC cxx_std_17)
+    if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU" OR CMAKE_CXX_COMPILER_ID STREQUAL "Clang")
+        target_compile_options(depth_camera_replay PRIVATE -Werror -Wall -Wextra -Wno-deprecated-declarations)
+    endif()
+endif()
+
+option(ML_NATIVE_UTILS_TESTS "Build the native_utils tests" OFF)
+if(ML_NATIVE_UTILS_TESTS)
+    enable_testing()
+    function(native_utils_add_test name)
+        add_executable(${name} "${NATIVE_UTILS_DIR}/tests/${name}.cpp" ${ARGN})
+        target_include_directories(${name} PRIVATE "${NATIVE_UTILS_DIR}")
+        target_link_libraries(${name} PRIVATE base.magicleap Threads::Threads)
+        target_compile_features(${name} PRIVATE cxx_std_17)
+        # Same warnings and instruction set as native_utils.
+        target_compile_options(${name} PRIVATE $<TARGET_PROPERTY:native_utils,COMPILE_OPTIONS>)
+        add_test(NAME ${name} COMMAND ${name})
+        # A deadlock fails the test instead of hanging the run.
+        set_tests_properties(${name} PROPERTIES TIMEOUT 60)
+    endfunction()
+
+    native_utils_add_test(depth_frame_ring_test "${NATIVE_UTILS_DIR}/depth_frame_ring.cpp")
+    native_utils_add_test(depth_recording_test
+        "${NATIVE_UTILS_DIR}/depth_codec.cpp"
+        "${NATIVE_UTILS_DIR}/depth_frame_ring.cpp"
+        "${NATIVE_UTILS_DIR}/depth_recording.cpp"
+    )
+    native_utils_add_test(world_camera_stereo_test
+        "${NATIVE_UTILS_DIR}/worker_pool.cpp"
+        "${NATIVE_UTILS_DIR}/world_camera_stereo.cpp"
+    )
+endif()
+
+unset(NATIVE_UTILS_DIR)
+
+set(FindMagicLeapNativeUtils_FOUND TRUE)
@@ -0,0 +1,205 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "clock_mapper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+
+namespace {
+
+// Drift assumed until two fits can be compared (100 ppm).
+constexpr double kInitialDrift = 1e-4;
+// Lower bound on the drift, so the bound still grows with distance (1 ppb).
+constexpr double kMinDrift = 1e-9;
+
+struct timespec ToTimespec(int64_t ns) {
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+  ts.tv_nsec = static_cast<long>(ns % 1000000000);
+  return ts;
+}
+
+int64_t FromTimespec(const struct timespec &ts) {
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+}  // namespace
+
+ClockMapper::ClockMapper(size_t window) : window_size_(std::max<size_t>(window, 2)) {
+  window_.reserve(window_size_);
+}
+
+ClockMapper::~ClockMapper() {
+  Stop();
+}
+
+int64_t ClockMapper::SystemNow() {
+#if defined(_WIN32)
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return FromTimespec(now);
+#endif
+}
+
+MLResult ClockMapper::ToMLTimeSlow(int64_t system_ns, MLTime *out_ml_time, int64_t *out_error_ns) const {
+  const struct timespec ts = ToTimespec(system_ns);
+  const MLResult result = MLTimeConvertSystemTimeToMLTime(&ts, out_ml_time);
+  if (out_error_ns != nullptr) {
+    *out_error_ns = 0;
+  }
+  return result;
+}
+
+MLResult ClockMapper::ToSystemTimeSlow(MLTime ml_time, int64_t *out_system_ns, int64_t *out_error_ns) const {
+  struct timespec ts = {};
+  const MLResult result = MLTimeConvertMLTimeToSystemTime(ml_time, &ts);
+  *out_system_ns = FromTimespec(ts);
+  if (out_error_ns != nullptr) {
+    *out_error_ns = 0;
+  }
+  return result;
+}
+
+MLResult ClockMapper::Calibrate() {
+  std::lock_guard<std::mutex> lock(calibrate_mutex_);
+  Sample sample;
+  sample.system_ns = SystemNow();
+  const struct timespec system_ts = ToTimespec(sample.system_ns);
+  MLResult result = MLTimeConvertSystemTimeToMLTime(&system_ts, &sample.ml_time);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  struct timespec back = {};
+  result = MLTimeConvertMLTimeToSystemTime(sample.ml_time, &back);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  sample.round_trip_ns = std::abs(FromTimespec(back) - sample.system_ns);
+
+  if (window_.size() < window_size_) {
+    window_.push_back(sample);
+  } else {
+    window_[next_] = sample;
+  }
+  next_ = (next_ + 1) % window_size_;
+  samples_.fetch_add(1, std::memory_order_relaxed);
+
+  // Least squares over the window, relative to the newest sample so the
+  // doubles keep nanosecond precision.
+  Model model;
+  model.system_ns = sample.system_ns;
+  model.ml_time = sample.ml_time;
+  model.slope = 1.0;
+  model.drift = kInitialDrift;
+  int64_t round_trip = 0;
+  double mean_x = 0.0, mean_y = 0.0;
+  for (const Sample &s : window_) {
+    mean_x += static_cast<double>(s.system_ns - sample.system_ns);
+    mean_y += static_cast<double>(s.ml_time - sample.ml_time);
+    round_trip = std::max(round_trip, s.round_trip_ns);
+  }
+  mean_x /= static_cast<double>(window_.size());
+  mean_y /= static_cast<double>(window_.size());
+  double intercept = 0.0;
+  if (window_.size() >= 2) {
+    double sxx = 0.0, sxy = 0.0;
+    for (const Sample &s : window_) {
+      const double dx = static_cast<double>(s.system_ns - sample.system_ns) - mean_x;
+      const double dy = static_cast<double>(s.ml_time - sample.ml_time) - mean_y;
+      sxx += dx * dx;
+      sxy += dx * dy;
+    }
+    if (sxx > 0.0) {
+      model.slope = sxy / sxx;
+      intercept = mean_y - model.slope * mean_x;
+      if (previous_slope_ != 0.0) {
+        // Decaying maximum of the slope change between successive fits.
+        max_drift_ = std::max(std::fabs(model.slope - previous_slope_), max_drift_ * 0.5);
+        model.drift = std::max(max_drift_, kMinDrift);
+      }
+      previous_slope_ = model.slope;
+    }
+  }
+  double residual = 0.0, sum_squares = 0.0, sxx = 0.0;
+  for (const Sample &s : window_) {
+    const double x = static_cast<double>(s.system_ns - sample.system_ns);
+    const double y = static_cast<double>(s.ml_time - sample.ml_time);
+    const double r = std::fabs(y - (intercept + model.slope * x));
+    residual = std::max(residual, r);
+    sum_squares += r * r;
+    sxx += (x - mean_x) * (x - mean_x);
+  }
+  if (window_.size() > 2 && sxx > 0.0) {
+    // Three standard errors of the fitted slope cover jitter in the samples.
+    const double slope_error = std::sqrt(sum_squares / static_cast<double>(window_.size() - 2) / sxx);
+    model.drift = std::max(model.drift, 3.0 * slope_error);
+  }
+  model.ml_time += static_cast<int64_t>(std::llround(intercept));
+  model.error_ns = static_cast<int64_t>(std::ceil(residual)) + round_trip;
+  Store(model);
+  return MLResult_Ok;
+}
+
+void ClockMapper::Store(const Model &model) {
+  const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  system_ns_.store(model.system_ns, std::memory_order_relaxed);
+  ml_time_.store(model.ml_time, std::memory_order_relaxed);
+  slope_.store(model.slope, std::memory_order_relaxed);
+  error_ns_.store(model.error_ns, std::memory_order_relaxed);
+  drift_.store(model.drift, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+MLResult ClockMapper::Start(int64_t period_ns) {
+  if (period_ns <= 0) {
+    return MLResult_InvalidParam;
+  }
+  std::lock_guard<std::mutex> lock(thread_mutex_);
+  if (thread_.joinable()) {
+    return MLResult_UnspecifiedFailure;
+  }
+  stop_ = false;
+  thread_ = std::thread(&ClockMapper::Run, this, period_ns);
+  return MLResult_Ok;
+}
+
+void ClockMapper::Stop() {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock(thread_mutex_);
+    stop_ = true;
+    thread.swap(thread_);
+  }
+  wake_.notify_all();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void ClockMapper::Run(int64_t period_ns) {
+  std::unique_lock<std::mutex> lock(thread_mutex_);
+  while (!stop_) {
+    lock.unlock();
+    Calibrate();
+    lock.lock();
+    wake_.wait_for(lock, std::chrono::nanoseconds(period_ns), [this] { return stop_; });
+  }
+}
@@ -0,0 +1,194 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_time.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*!
+  \brief Converts between MLTime and system (CLOCK_MONOTONIC) time with
+         inline arithmetic.
+
+  Calibrate() converts the current system time with
+  MLTimeConvertSystemTimeToMLTime(), converts the result back with
+  MLTimeConvertMLTimeToSystemTime(), and refits a linear model over the last
+  few samples; between calibrations every conversion is a multiply-add.
+  Each conversion reports an error bound made of the fit residual, the
+  round-trip disagreement of the C API, and the slope drift observed between
+  successive fits times the distance from the newest sample. Call
+  Calibrate() periodically, or let Start() do it on a background thread.
+
+  Conversions are lock-free and may run on any thread. Before the first
+  calibration they fall back to the C API.
+*/
+class ClockMapper {
+public:
+  /*! \param[in] window Number of calibration samples the model is fitted to (at least 2). */
+  explicit ClockMapper(size_t window = 16);
+
+  /*! Stops the calibration thread if it is running. */
+  ~ClockMapper();
+
+  ClockMapper(const ClockMapper &) = delete;
+  ClockMapper &operator=(const ClockMapper &) = delete;
+
+  /*!
+    \brief Takes one calibration sample and refits the model.
+
+    \retval MLResult_Ok The model was updated.
+    \return Otherwise the failure returned by the C API.
+  */
+  MLResult Calibrate();
+
+  /*!
+    \brief Calibrates every `period_ns` on a background thread.
+
+    \retval MLResult_Ok The thread was started.
+    \retval MLResult_InvalidParam period_ns is not positive.
+    \retval MLResult_UnspecifiedFailure Calibration is already running.
+  */
+  MLResult Start(int64_t period_ns = 1000000000);
+
+  /*! Stops the thread started by Start(). */
+  void Stop();
+
+  /*!
+    \brief Converts a system time in nanoseconds to MLTime.
+
+    \param[in] system_ns CLOCK_MONOTONIC time in nanoseconds.
+    \param[out] out_ml_time Converted time.
+    \param[out] out_error_ns Optional bound on the conversion error.
+
+    \retval MLResult_Ok The time was converted.
+    \return Otherwise the failure of the C API fallback used before calibration.
+  */
+  MLResult ToMLTime(int64_t system_ns, MLTime *out_ml_time, int64_t *out_error_ns = nullptr) const {
+    Model model;
+    if (!Load(&model)) {
+      return ToMLTimeSlow(system_ns, out_ml_time, out_error_ns);
+    }
+    const int64_t offset = system_ns - model.system_ns;
+    *out_ml_time = model.ml_time + static_cast<int64_t>(static_cast<double>(offset) * model.slope);
+    if (out_error_ns != nullptr) {
+      *out_error_ns = ErrorBound(model, offset);
+    }
+    return MLResult_Ok;
+  }
+
+  /*! Converts MLTime to system time in nanoseconds; see ToMLTime(). */
+  MLResult ToSystemTime(MLTime ml_time, int64_t *out_system_ns, int64_t *out_error_ns = nullptr) const {
+    Model model;
+    if (!Load(&model)) {
+      return ToSystemTimeSlow(ml_time, out_system_ns, out_error_ns);
+    }
+    const int64_t offset = static_cast<int64_t>(static_cast<double>(ml_time - model.ml_time) / model.slope);
+    *out_system_ns = model.system_ns + offset;
+    if (out_error_ns != nullptr) {
+      *out_error_ns = ErrorBound(model, offset);
+    }
+    return MLResult_Ok;
+  }
+
+  /*! Current CLOCK_MONOTONIC time in nanoseconds. */
+  static int64_t SystemNow();
+
+  /*! Number of calibration samples taken. */
+  uint64_t samples() const { return samples_.load(std::memory_order_relaxed); }
+
+private:
+  // ml_time = ml_time_ref + slope * (system_ns - system_ns_ref)
+  struct Model {
+    int64_t system_ns;
+    int64_t ml_time;
+    double slope;
+    // Residual and round-trip error of the fit, in ns.
+    int64_t error_ns;
+    // Slope drift bound in ns per ns.
+    double drift;
+  };
+
+  static int64_t ErrorBound(const Model &model, int64_t offset) {
+    const double distance = static_cast<double>(offset < 0 ? -offset : offset);
+    // One extra ns for rounding to integer nanoseconds.
+    return model.error_ns + static_cast<int64_t>(distance * model.drift) + 1;
+  }
+
+  bool Load(Model *model) const {
+    for (;;) {
+      const uint32_t sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence == 0) {
+        return false;
+      }
+      if (sequence & 1) {
+        continue;
+      }
+      model->system_ns = system_ns_.load(std::memory_order_relaxed);
+      model->ml_time = ml_time_.load(std::memory_order_relaxed);
+      model->slope = slope_.load(std::memory_order_relaxed);
+      model->error_ns = error_ns_.load(std::memory_order_relaxed);
+      model->drift = drift_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == sequence) {
+        return true;
+      }
+    }
+  }
+
+  MLResult ToMLTimeSlow(int64_t system_ns, MLTime *out_ml_time, int64_t *out_error_ns) const;
+  MLResult ToSystemTimeSlow(MLTime ml_time, int64_t *out_system_ns, int64_t *out_error_ns) const;
+  void Store(const Model &model);
+  void Run(int64_t period_ns);
+
+  struct Sample {
+    int64_t system_ns;
+    int64_t ml_time;
+    int64_t round_trip_ns;
+  };
+
+  // Seqlock over the model: 0 before calibration, odd while it is rewritten.
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<int64_t> system_ns_{0};
+  std::atomic<int64_t> ml_time_{0};
+  std::atomic<double> slope_{1.0};
+  std::atomic<int64_t> error_ns_{0};
+  std::atomic<double> drift_{0.0};
+  std::atomic<uint64_t> samples_{0};
+
+  std::mutex calibrate_mutex_;
+  std::vector<Sample> window_;
+  size_t window_size_;
+  size_t next_ = 0;
+  double previous_slope_ = 0.0;
+  double max_drift_ = 0.0;
+
+  std::mutex thread_mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+/*! \} */
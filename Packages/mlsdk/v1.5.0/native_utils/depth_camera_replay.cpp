@@ -0,0 +1,373 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_camera_replay.h"
+
+#include "depth_recording.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Frame rates of MLDepthCameraFrameRate, in enum order.
+constexpr float kFrameRates[] = {1.0f, 5.0f, 25.0f, 30.0f, 50.0f, 60.0f};
+
+struct Delivery {
+  DepthRecordingFrame frame;
+  MLDepthCameraFrame out;
+};
+
+class Replay {
+public:
+  MLResult Configure(const DepthCameraReplaySettings &settings);
+  MLResult Connect(const MLDepthCameraSettings &camera, MLHandle *out_handle);
+  MLResult UpdateSettings(MLHandle handle, const MLDepthCameraSettings &camera);
+  MLResult GetCapabilities(MLHandle handle, uint32_t streams, MLDepthCameraCapabilityList *out_caps);
+  MLResult GetLatest(MLHandle handle, uint64_t timeout_ms, MLDepthCameraData *out_data);
+  MLResult Release(MLHandle handle, MLDepthCameraData *data);
+  MLResult Disconnect(MLHandle handle);
+
+private:
+  bool Enabled(size_t index) const;
+  Clock::time_point Due(size_t index, int64_t pass) const;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool configured_ = false;
+  DepthCameraReplaySettings settings_ = {};
+  std::string path_;
+
+  DepthRecordingReader reader_;
+  MLHandle handle_ = ML_INVALID_HANDLE;
+  MLHandle next_handle_ = 1;
+  MLDepthCameraSettings camera_ = {};
+
+  // Playback position.
+  Clock::time_point start_;
+  size_t next_ = 0;
+  int64_t pass_ = 0;
+  MLTime pass_length_ = 0;
+  int64_t pass_frames_ = 0;
+
+  std::vector<std::unique_ptr<Delivery>> free_;
+  std::unordered_map<const MLDepthCameraFrame *, std::unique_ptr<Delivery>> delivered_;
+};
+
+Replay &Instance() {
+  static Replay replay;
+  return replay;
+}
+
+MLDepthCameraStream StreamOf(MLDepthCameraFrameType type) {
+  return type == MLDepthCameraFrameType_LongRange ? MLDepthCameraStream_LongRange : MLDepthCameraStream_ShortRange;
+}
+
+// Frame period configured for the stream of `type`, in ns.
+MLTime FramePeriod(const MLDepthCameraSettings &camera, MLDepthCameraFrameType type) {
+  const int rate = camera.stream_configs[type == MLDepthCameraFrameType_LongRange ? 0 : 1].frame_rate;
+  const int rates = static_cast<int>(sizeof(kFrameRates) / sizeof(kFrameRates[0]));
+  return static_cast<MLTime>(1e9f / kFrameRates[rate >= 0 && rate < rates ? rate : 0]);
+}
+
+bool EnvironmentFlag(const char *name) {
+  const char *value = getenv(name);
+  return value != nullptr && atoi(value) != 0;
+}
+
+MLResult Replay::Configure(const DepthCameraReplaySettings &settings) {
+  if (settings.path == nullptr || !(settings.speed >= 0.0f)) {
+    return MLResult_InvalidParam;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  settings_ = settings;
+  path_ = settings.path;
+  settings_.path = path_.c_str();
+  configured_ = true;
+  return MLResult_Ok;
+}
+
+MLResult Replay::Connect(const MLDepthCameraSettings &camera, MLHandle *out_handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle_ != ML_INVALID_HANDLE) {
+    return MLResult_InvalidParam;
+  }
+  if (!configured_) {
+    const char *path = getenv("ML_DEPTH_CAMERA_REPLAY_FILE");
+    if (path == nullptr) {
+      return MLResult_UnspecifiedFailure;
+    }
+    DepthCameraReplaySettingsInit(&settings_);
+    path_ = path;
+    settings_.path = path_.c_str();
+    if (const char *speed = getenv("ML_DEPTH_CAMERA_REPLAY_SPEED")) {
+      settings_.speed = std::max(static_cast<float>(atof(speed)), 0.0f);
+    }
+    settings_.skip_late_frames = EnvironmentFlag("ML_DEPTH_CAMERA_REPLAY_SKIP_LATE");
+    settings_.loop = EnvironmentFlag("ML_DEPTH_CAMERA_REPLAY_LOOP");
+  }
+  if (reader_.Open(settings_.path) != MLResult_Ok || reader_.frame_count() == 0) {
+    reader_.Close();
+    return MLResult_UnspecifiedFailure;
+  }
+  const size_t count = reader_.frame_count();
+  const MLTime first = reader_.entry(0).timestamp, last = reader_.entry(count - 1).timestamp;
+  // A pass lasts one average frame interval longer than the recording, so loops keep the cadence. A recording
+  // without an interval, e.g. a single frame, repeats at the configured frame rate.
+  const MLTime span = last - first;
+  pass_length_ =
+      span > 0 ? span + span / static_cast<MLTime>(count - 1) : FramePeriod(camera, reader_.entry(0).frame_type);
+  pass_frames_ = reader_.entry(count - 1).frame_number - reader_.entry(0).frame_number + 1;
+  camera_ = camera;
+  start_ = Clock::now();
+  next_ = 0;
+  pass_ = 0;
+  handle_ = next_handle_++;
+  *out_handle = handle_;
+  return MLResult_Ok;
+}
+
+MLResult Replay::UpdateSettings(MLHandle handle, const MLDepthCameraSettings &camera) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle != handle_ || handle_ == ML_INVALID_HANDLE) {
+    return MLResult_InvalidParam;
+  }
+  camera_ = camera;
+  return MLResult_Ok;
+}
+
+bool Replay::Enabled(size_t index) const {
+  return (camera_.streams & StreamOf(reader_.entry(index).frame_type)) != 0;
+}
+
+Clock::time_point Replay::Due(size_t index, int64_t pass) const {
+  if (settings_.speed == 0.0f) {
+    return start_;
+  }
+  const double elapsed_ns =
+      static_cast<double>(reader_.entry(index).timestamp - reader_.entry(0).timestamp + pass * pass_length_);
+  return start_ + std::chrono::nanoseconds(static_cast<int64_t>(elapsed_ns / settings_.speed));
+}
+
+MLResult Replay::GetCapabilities(MLHandle handle, uint32_t streams, MLDepthCameraCapabilityList *out_caps) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle != handle_ || handle_ == ML_INVALID_HANDLE) {
+    return MLResult_InvalidParam;
+  }
+  // One capability per recorded stream, at the recorded frame rate.
+  std::vector<MLDepthCameraStreamCapability> found;
+  for (int type = 0; type < MLDepthCameraFrameType_Count; type++) {
+    const MLDepthCameraStream stream = StreamOf(static_cast<MLDepthCameraFrameType>(type));
+    if (streams != 0 && (streams & stream) == 0) {
+      continue;
+    }
+    size_t frames = 0;
+    MLTime first = 0, last = 0;
+    for (size_t i = 0; i < reader_.frame_count(); i++) {
+      if (reader_.entry(i).frame_type == type) {
+        last = reader_.entry(i).timestamp;
+        first = frames++ == 0 ? last : first;
+      }
+    }
+    if (frames == 0) {
+      continue;
+    }
+    const float rate = frames > 1 && last > first ? 1e9f * (frames - 1) / static_cast<float>(last - first) : 1.0f;
+    int nearest = 0;
+    for (int i = 1; i < static_cast<int>(sizeof(kFrameRates) / sizeof(kFrameRates[0])); i++) {
+      if (std::fabs(kFrameRates[i] - rate) < std::fabs(kFrameRates[nearest] - rate)) {
+        nearest = i;
+      }
+    }
+    MLDepthCameraStreamCapability capability;
+    capability.stream = stream;
+    // Exposure limits of the device, see MLDepthCameraSettings.
+    capability.min_exposure = stream == MLDepthCameraStream_LongRange ? 250 : 50;
+    capability.max_exposure = stream == MLDepthCameraStream_LongRange ? 2000 : 375;
+    capability.frame_rate = static_cast<MLDepthCameraFrameRate>(nearest);
+    found.push_back(capability);
+  }
+  out_caps->size = static_cast<uint8_t>(found.size());
+  out_caps->capabilities = found.empty() ? nullptr : new MLDepthCameraCapability[found.size()];
+  for (size_t i = 0; i < found.size(); i++) {
+    out_caps->capabilities[i].size = 1;
+    out_caps->capabilities[i].stream_capabilities = new MLDepthCameraStreamCapability[1]{found[i]};
+  }
+  return MLResult_Ok;
+}
+
+MLResult Replay::GetLatest(MLHandle handle, uint64_t timeout_ms, MLDepthCameraData *out_data) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (handle != handle_ || handle_ == ML_INVALID_HANDLE) {
+    return MLResult_InvalidParam;
+  }
+  const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  const size_t count = reader_.frame_count();
+  size_t next = next_;
+  int64_t pass = pass_;
+  // Finds the next frame of a connected stream at or after `next`, wrapping when looping.
+  auto advance = [&](size_t *index, int64_t *index_pass) {
+    for (size_t scanned = 0; scanned <= count; scanned++) {
+      if (*index == count) {
+        if (!settings_.loop) {
+          return false;
+        }
+        *index = 0;
+        ++*index_pass;
+      }
+      if (Enabled(*index)) {
+        return true;
+      }
+      ++*index;
+    }
+    return false;
+  };
+  bool found = advance(&next, &pass);
+  if (found && settings_.skip_late_frames && settings_.speed > 0.0f) {
+    const Clock::time_point now = Clock::now();
+    size_t later = next + 1;
+    int64_t later_pass = pass;
+    while (advance(&later, &later_pass) && Due(later, later_pass) <= now) {
+      next = later++;
+      pass = later_pass;
+    }
+  }
+  if (!found || Due(next, pass) > deadline) {
+    wake_.wait_until(lock, deadline, [&] { return handle_ != handle; });
+    return handle_ == handle ? MLResult_Timeout : MLResult_InvalidParam;
+  }
+  // Claim the frame before waiting for it to be due, so concurrent callers get the following frames.
+  next_ = next + 1;
+  pass_ = pass;
+  if (wake_.wait_until(lock, Due(next, pass), [&] { return handle_ != handle; })) {
+    return MLResult_InvalidParam;
+  }
+
+  std::unique_ptr<Delivery> delivery;
+  if (free_.empty()) {
+    delivery.reset(new Delivery());
+  } else {
+    delivery = std::move(free_.back());
+    free_.pop_back();
+  }
+  if (reader_.ReadFrame(next, &delivery->frame) != MLResult_Ok) {
+    free_.push_back(std::move(delivery));
+    return MLResult_UnspecifiedFailure;
+  }
+  MLDepthCameraFrame &frame = delivery->out;
+  frame = delivery->frame.frame();
+  frame.frame_timestamp += pass * pass_length_;
+  frame.frame_number += pass * pass_frames_;
+  // MLDepthCameraFlags share the bit order of DepthRecordingImage.
+  const uint32_t flags = camera_.stream_configs[frame.frame_type == MLDepthCameraFrameType_LongRange ? 0 : 1].flags;
+  if ((flags & MLDepthCameraFlags_DepthImage) == 0) frame.depth_image = nullptr;
+  if ((flags & MLDepthCameraFlags_Confidence) == 0) frame.confidence = nullptr;
+  if ((flags & MLDepthCameraFlags_DepthFlags) == 0) frame.flags = nullptr;
+  if ((flags & MLDepthCameraFlags_AmbientRawDepthImage) == 0) frame.ambient_raw_depth_image = nullptr;
+  if ((flags & MLDepthCameraFlags_RawDepthImage) == 0) frame.raw_depth_image = nullptr;
+
+  out_data->frame_count = 1;
+  out_data->frames = &frame;
+  delivered_[&frame] = std::move(delivery);
+  return MLResult_Ok;
+}
+
+MLResult Replay::Release(MLHandle handle, MLDepthCameraData *data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle != handle_ || handle_ == ML_INVALID_HANDLE) {
+    return MLResult_InvalidParam;
+  }
+  const auto it = delivered_.find(data->frames);
+  if (it == delivered_.end()) {
+    return MLResult_InvalidParam;
+  }
+  free_.push_back(std::move(it->second));
+  delivered_.erase(it);
+  data->frames = nullptr;
+  data->frame_count = 0;
+  return MLResult_Ok;
+}
+
+MLResult Replay::Disconnect(MLHandle handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle != handle_ || handle_ == ML_INVALID_HANDLE) {
+    return MLResult_InvalidParam;
+  }
+  handle_ = ML_INVALID_HANDLE;
+  reader_.Close();
+  delivered_.clear();
+  free_.clear();
+  wake_.notify_all();
+  return MLResult_Ok;
+}
+
+}  // namespace
+
+MLResult DepthCameraReplayConfigure(const DepthCameraReplaySettings *settings) {
+  return settings != nullptr ? Instance().Configure(*settings) : MLResult_InvalidParam;
+}
+
+MLResult MLDepthCameraConnect(const MLDepthCameraSettings *settings, MLHandle *out_handle) {
+  if (settings == nullptr || out_handle == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  return Instance().Connect(*settings, out_handle);
+}
+
+MLResult MLDepthCameraUpdateSettings(MLHandle handle, const MLDepthCameraSettings *settings) {
+  return settings != nullptr ? Instance().UpdateSettings(handle, *settings) : MLResult_InvalidParam;
+}
+
+MLResult MLDepthCameraGetCapabilities(MLHandle handle, const MLDepthCameraCapabilityFilter *filter,
+                                      MLDepthCameraCapabilityList *out_caps) {
+  if (filter == nullptr || out_caps == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  return Instance().GetCapabilities(handle, filter->streams, out_caps);
+}
+
+MLResult MLDepthCameraReleaseCapabilities(MLHandle, MLDepthCameraCapabilityList *out_caps) {
+  if (out_caps == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  for (uint8_t i = 0; i < out_caps->size; i++) {
+    delete[] out_caps->capabilities[i].stream_capabilities;
+  }
+  delete[] out_caps->capabilities;
+  out_caps->capabilities = nullptr;
+  out_caps->size = 0;
+  return MLResult_Ok;
+}
+
+MLResult MLDepthCameraGetLatestDepthData(MLHandle handle, uint64_t timeout_ms, MLDepthCameraData *out_data) {
+  return out_data != nullptr ? Instance().GetLatest(handle, timeout_ms, out_data) : MLResult_InvalidParam;
+}
+
+MLResult MLDepthCameraReleaseDepthData(MLHandle handle, MLDepthCameraData *depth_camera_data) {
+  return depth_camera_data != nullptr ? Instance().Release(handle, depth_camera_data) : MLResult_InvalidParam;
+}
+
+MLResult MLDepthCameraDisconnect(MLHandle handle) {
+  return Instance().Disconnect(handle);
+}
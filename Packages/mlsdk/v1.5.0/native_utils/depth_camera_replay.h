@@ -0,0 +1,88 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+
+ML_EXTERN_C_BEGIN
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*!
+  \brief Playback of the depth_camera_replay library.
+
+  depth_camera_replay is a stand-in for the depth camera part of
+  perception.magicleap on hosts without a headset. It implements
+  MLDepthCameraConnect(), MLDepthCameraUpdateSettings(),
+  MLDepthCameraGetCapabilities(), MLDepthCameraReleaseCapabilities(),
+  MLDepthCameraGetLatestDepthData(), MLDepthCameraReleaseDepthData() and
+  MLDepthCameraDisconnect() on top of a recording written by DepthRecorder,
+  which is memory mapped.
+
+  Each MLDepthCameraGetLatestDepthData() call returns the next recorded
+  frame of a connected stream, with the images the stream's flags select,
+  once its recorded time has come. A frame that is not due within
+  timeout_ms is not returned and the call returns MLResult_Timeout after
+  timeout_ms, as on the device. Several frames may be held at once; each
+  must be released once.
+
+  Unless skip_late_frames is set, every frame is delivered in order however
+  slowly the caller polls, so runs are repeatable. Looped playback offsets
+  the timestamps and frame numbers of each pass so they keep increasing.
+*/
+typedef struct DepthCameraReplaySettings {
+  /*! Recording to replay; copied by DepthCameraReplayConfigure(). */
+  const char *path;
+  /*!
+    \brief Playback rate relative to the recording, e.g. 4 for four times
+           real time. 0 returns each frame as soon as it is requested.
+  */
+  float speed;
+  /*! Skip frames whose time has passed, as a device would, instead of queueing them. */
+  bool skip_late_frames;
+  /*! Restart from the first frame at the end instead of timing out. */
+  bool loop;
+} DepthCameraReplaySettings;
+
+/*! \brief Initializes DepthCameraReplaySettings for real time playback of every frame. */
+ML_STATIC_INLINE void DepthCameraReplaySettingsInit(DepthCameraReplaySettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->path = NULL;
+    inout_settings->speed = 1.0f;
+    inout_settings->skip_late_frames = false;
+    inout_settings->loop = false;
+  }
+}
+
+/*!
+  \brief Selects the recording and playback for the next MLDepthCameraConnect().
+
+  Without this call MLDepthCameraConnect() reads the settings from the
+  environment: ML_DEPTH_CAMERA_REPLAY_FILE, ML_DEPTH_CAMERA_REPLAY_SPEED,
+  ML_DEPTH_CAMERA_REPLAY_SKIP_LATE and ML_DEPTH_CAMERA_REPLAY_LOOP (0 or 1).
+
+  \param[in] settings Playback settings, see DepthCameraReplaySettingsInit().
+
+  \retval MLResult_Ok The settings will be used by the next connection.
+  \retval MLResult_InvalidParam settings or its path is null, or speed is negative.
+*/
+ML_API MLResult ML_CALL DepthCameraReplayConfigure(const DepthCameraReplaySettings *settings);
+
+/*! \} */
+
+ML_EXTERN_C_END
@@ -0,0 +1,385 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_codec.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace native_utils {
+
+namespace {
+
+enum PlaneMode : uint8_t { kPlaneRaw = 0, kPlaneConstant = 1, kPlaneRans = 2 };
+enum Predictor : uint8_t { kPredictSpatial = 0, kPredictTemporal = 1 };
+
+constexpr uint32_t kProbabilityBits = 12;
+constexpr uint32_t kProbabilityScale = 1u << kProbabilityBits;
+constexpr uint32_t kRansLow = 1u << 23;
+// Every kSampleRowStep-th row is used to pick the predictor.
+constexpr uint32_t kSampleRowStep = 8;
+
+inline uint32_t ZigZag(uint32_t difference) {
+  return (difference << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(difference) >> 31);
+}
+
+inline uint32_t UnZigZag(uint32_t value) {
+  return (value >> 1) ^ (0u - (value & 1));
+}
+
+inline uint32_t Residual(uint32_t value, uint32_t prediction, DepthImageResidual residual) {
+  return residual == DepthImageResidual::Xor ? value ^ prediction : ZigZag(value - prediction);
+}
+
+inline uint32_t Reconstruct(uint32_t residual_value, uint32_t prediction, DepthImageResidual residual) {
+  return residual == DepthImageResidual::Xor ? residual_value ^ prediction : prediction + UnZigZag(residual_value);
+}
+
+inline int BitLength(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return value == 0 ? 0 : 32 - __builtin_clz(value);
+#else
+  int bits = 0;
+  while (value != 0) {
+    bits++;
+    value >>= 1;
+  }
+  return bits;
+#endif
+}
+
+inline uint32_t LeftPrediction(const uint32_t *image, uint32_t width, uint32_t u, uint32_t v) {
+  if (u > 0) {
+    return image[v * width + u - 1];
+  }
+  return v > 0 ? image[(v - 1) * width] : 0;
+}
+
+void PutU32(std::vector<uint8_t> *out, uint32_t value) {
+  uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value >> 16),
+                      static_cast<uint8_t>(value >> 24)};
+  out->insert(out->end(), bytes, bytes + 4);
+}
+
+void PutVarint(std::vector<uint8_t> *out, uint32_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+bool GetU32(const uint8_t **data, const uint8_t *end, uint32_t *value) {
+  if (end - *data < 4) {
+    return false;
+  }
+  const uint8_t *p = *data;
+  *value = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+  *data += 4;
+  return true;
+}
+
+bool GetVarint(const uint8_t **data, const uint8_t *end, uint32_t *value) {
+  uint32_t result = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*data >= end) {
+      return false;
+    }
+    const uint8_t byte = *(*data)++;
+    result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Encoder constants of one symbol; the division by the frequency is done
+// with a fixed-point reciprocal.
+struct EncodeSymbol {
+  uint32_t x_max;
+  uint32_t reciprocal;
+  uint32_t bias;
+  uint32_t complement;
+  uint32_t shift;
+
+  void Init(uint32_t start, uint32_t freq) {
+    x_max = freq == 0 ? 0 : ((kRansLow >> kProbabilityBits) << 8) * freq;
+    complement = kProbabilityScale - freq;
+    if (freq < 2) {
+      // x / 1 == x: a reciprocal of 2^32 - 1 with the bias below yields it.
+      reciprocal = ~0u;
+      shift = 0;
+      bias = start + kProbabilityScale - 1;
+    } else {
+      uint32_t bits = 0;
+      while (freq > (1u << bits)) {
+        bits++;
+      }
+      reciprocal = static_cast<uint32_t>(((1ull << (bits + 31)) + freq - 1) / freq);
+      shift = bits - 1;
+      bias = start;
+    }
+  }
+};
+
+// Scales symbol counts to frequencies summing to kProbabilityScale, keeping
+// every present symbol at least 1.
+void NormalizeFrequencies(const uint32_t *counts, size_t total, uint32_t *freq) {
+  int64_t sum = 0;
+  for (int s = 0; s < 256; s++) {
+    freq[s] = 0;
+    if (counts[s] != 0) {
+      freq[s] = static_cast<uint32_t>(static_cast<uint64_t>(counts[s]) * kProbabilityScale / total);
+      if (freq[s] == 0) {
+        freq[s] = 1;
+      }
+      sum += freq[s];
+    }
+  }
+  int largest = 0;
+  for (int s = 1; s < 256; s++) {
+    if (freq[s] > freq[largest]) largest = s;
+  }
+  if (sum < kProbabilityScale) {
+    freq[largest] += static_cast<uint32_t>(kProbabilityScale - sum);
+    return;
+  }
+  while (sum > kProbabilityScale) {
+    for (int s = 1; s < 256; s++) {
+      if (freq[s] > freq[largest]) largest = s;
+    }
+    freq[largest]--;
+    sum--;
+  }
+}
+
+void EncodePlane(const uint8_t *plane, size_t count, std::vector<uint8_t> *out) {
+  uint32_t counts[256] = {};
+  for (size_t i = 0; i < count; i++) {
+    counts[plane[i]]++;
+  }
+  if (count == 0 || counts[plane[0]] == count) {
+    out->push_back(kPlaneConstant);
+    out->push_back(count == 0 ? 0 : plane[0]);
+    return;
+  }
+  // Planes of sensor noise are close to 8 bits per symbol; storing them raw
+  // is as small and much faster than entropy coding them.
+  double entropy_bits = 0.0;
+  for (int s = 0; s < 256; s++) {
+    if (counts[s] != 0) {
+      entropy_bits -= counts[s] * std::log2(static_cast<double>(counts[s]) / static_cast<double>(count));
+    }
+  }
+  if (entropy_bits > 0.95 * 8.0 * static_cast<double>(count)) {
+    out->push_back(kPlaneRaw);
+    out->insert(out->end(), plane, plane + count);
+    return;
+  }
+  uint32_t freq[256];
+  NormalizeFrequencies(counts, count, freq);
+  EncodeSymbol symbols[256];
+  uint32_t start = 0;
+  for (int s = 0; s < 256; s++) {
+    symbols[s].Init(start, freq[s]);
+    start += freq[s];
+  }
+
+  // rANS emits bytes backwards; two interleaved states take even and odd symbols.
+  static thread_local std::vector<uint8_t> buffer;
+  buffer.resize(count + count / 2 + 64);
+  uint8_t *const end = buffer.data() + buffer.size();
+  uint8_t *p = end;
+  uint32_t state[2] = {kRansLow, kRansLow};
+  for (size_t i = count; i-- > 0;) {
+    uint32_t &x = state[i & 1];
+    const EncodeSymbol &symbol = symbols[plane[i]];
+    while (x >= symbol.x_max) {
+      *--p = static_cast<uint8_t>(x);
+      x >>= 8;
+    }
+    const uint32_t q = static_cast<uint32_t>((static_cast<uint64_t>(x) * symbol.reciprocal) >> 32) >> symbol.shift;
+    x += symbol.bias + q * symbol.complement;
+    if (p - buffer.data() < 8) {
+      break;
+    }
+  }
+  const size_t table_bytes = 256 * 2;
+  const size_t encoded = static_cast<size_t>(end - p) + 8;
+  if (p - buffer.data() < 8 || encoded + table_bytes >= count) {
+    out->push_back(kPlaneRaw);
+    out->insert(out->end(), plane, plane + count);
+    return;
+  }
+  for (int k = 1; k >= 0; k--) {
+    p -= 4;
+    p[0] = static_cast<uint8_t>(state[k]);
+    p[1] = static_cast<uint8_t>(state[k] >> 8);
+    p[2] = static_cast<uint8_t>(state[k] >> 16);
+    p[3] = static_cast<uint8_t>(state[k] >> 24);
+  }
+  out->push_back(kPlaneRans);
+  for (int s = 0; s < 256; s++) {
+    PutVarint(out, freq[s]);
+  }
+  PutU32(out, static_cast<uint32_t>(end - p));
+  out->insert(out->end(), p, end);
+}
+
+bool DecodePlane(const uint8_t **data, const uint8_t *end, size_t count, uint8_t *plane) {
+  if (*data >= end) {
+    return false;
+  }
+  const uint8_t mode = *(*data)++;
+  if (mode == kPlaneConstant) {
+    if (*data >= end) {
+      return false;
+    }
+    memset(plane, *(*data)++, count);
+    return true;
+  }
+  if (mode == kPlaneRaw) {
+    if (static_cast<size_t>(end - *data) < count) {
+      return false;
+    }
+    memcpy(plane, *data, count);
+    *data += count;
+    return true;
+  }
+  if (mode != kPlaneRans) {
+    return false;
+  }
+  uint32_t freq[256], start[256];
+  uint8_t symbol[kProbabilityScale];
+  uint32_t total = 0;
+  for (int s = 0; s < 256; s++) {
+    if (!GetVarint(data, end, &freq[s]) || freq[s] > kProbabilityScale - total) {
+      return false;
+    }
+    start[s] = total;
+    memset(symbol + total, s, freq[s]);
+    total += freq[s];
+  }
+  uint32_t size;
+  if (total != kProbabilityScale || !GetU32(data, end, &size) || static_cast<size_t>(end - *data) < size || size < 8) {
+    return false;
+  }
+  const uint8_t *p = *data;
+  const uint8_t *const stop = p + size;
+  *data = stop;
+  uint32_t state[2];
+  GetU32(&p, stop, &state[0]);
+  GetU32(&p, stop, &state[1]);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t &x = state[i & 1];
+    const uint32_t slot = x & (kProbabilityScale - 1);
+    const uint8_t s = symbol[slot];
+    plane[i] = s;
+    x = freq[s] * (x >> kProbabilityBits) + slot - start[s];
+    while (x < kRansLow) {
+      if (p >= stop) {
+        return false;
+      }
+      x = (x << 8) | *p++;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void EncodeDepthImage(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t stride,
+                      const uint32_t *previous, DepthImageResidual residual, std::vector<uint8_t> *out) {
+  const size_t count = static_cast<size_t>(width) * height;
+  static thread_local std::vector<uint32_t> image;
+  static thread_local std::vector<uint8_t> planes;
+  image.resize(count);
+  planes.resize(count * 4);
+  for (uint32_t v = 0; v < height; v++) {
+    memcpy(&image[static_cast<size_t>(v) * width], pixels + static_cast<size_t>(v) * stride, width * sizeof(uint32_t));
+  }
+
+  Predictor predictor = kPredictSpatial;
+  if (previous != nullptr) {
+    uint64_t spatial_bits = 0, temporal_bits = 0;
+    for (uint32_t v = 0; v < height; v += kSampleRowStep) {
+      for (uint32_t u = 0; u < width; u++) {
+        const uint32_t value = image[static_cast<size_t>(v) * width + u];
+        spatial_bits += BitLength(Residual(value, LeftPrediction(image.data(), width, u, v), residual));
+        temporal_bits += BitLength(Residual(value, previous[static_cast<size_t>(v) * width + u], residual));
+      }
+    }
+    if (temporal_bits < spatial_bits) {
+      predictor = kPredictTemporal;
+    }
+  }
+
+  uint8_t *const plane[4] = {&planes[0], &planes[count], &planes[count * 2], &planes[count * 3]};
+  for (uint32_t v = 0; v < height; v++) {
+    const size_t row = static_cast<size_t>(v) * width;
+    for (uint32_t u = 0; u < width; u++) {
+      const size_t i = row + u;
+      uint32_t prediction;
+      if (predictor == kPredictTemporal) {
+        prediction = previous[i];
+      } else {
+        prediction = u > 0 ? image[i - 1] : LeftPrediction(image.data(), width, 0, v);
+      }
+      const uint32_t r = Residual(image[i], prediction, residual);
+      plane[0][i] = static_cast<uint8_t>(r);
+      plane[1][i] = static_cast<uint8_t>(r >> 8);
+      plane[2][i] = static_cast<uint8_t>(r >> 16);
+      plane[3][i] = static_cast<uint8_t>(r >> 24);
+    }
+  }
+  out->push_back(predictor);
+  for (int b = 0; b < 4; b++) {
+    EncodePlane(plane[b], count, out);
+  }
+}
+
+bool DecodeDepthImage(const uint8_t **data, const uint8_t *end, uint32_t width, uint32_t height,
+                      bool has_previous, DepthImageResidual residual, uint32_t *image) {
+  const size_t count = static_cast<size_t>(width) * height;
+  if (*data >= end) {
+    return false;
+  }
+  const uint8_t predictor = *(*data)++;
+  if (predictor > kPredictTemporal || (predictor == kPredictTemporal && !has_previous)) {
+    return false;
+  }
+  static thread_local std::vector<uint8_t> planes;
+  planes.resize(count * 4);
+  for (int b = 0; b < 4; b++) {
+    if (!DecodePlane(data, end, count, &planes[count * b])) {
+      return false;
+    }
+  }
+  const uint8_t *const plane[4] = {&planes[0], &planes[count], &planes[count * 2], &planes[count * 3]};
+  size_t i = 0;
+  for (uint32_t v = 0; v < height; v++) {
+    for (uint32_t u = 0; u < width; u++, i++) {
+      const uint32_t r = plane[0][i] | (plane[1][i] << 8) | (plane[2][i] << 16) |
+                         (static_cast<uint32_t>(plane[3][i]) << 24);
+      // Temporal prediction reads the previous value in place; spatial
+      // prediction reads neighbours already decoded.
+      const uint32_t prediction = predictor == kPredictTemporal ? image[i] : LeftPrediction(image, width, u, v);
+      image[i] = Reconstruct(r, prediction, residual);
+    }
+  }
+  return true;
+}
+
+}  // namespace native_utils
@@ -0,0 +1,66 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+/*
+  Lossless codec for 32-bit depth camera images used by the depth recording
+  format.
+
+  Each pixel is predicted from the same pixel of the previous image of the
+  stream (temporal) or from its left neighbour (spatial), whichever a sample
+  of rows says is cheaper. Float images store the zigzagged integer
+  difference of the bit patterns and flag images the XOR, so decoding is
+  exact. The residuals are split into four byte planes, and each plane is
+  stored raw, as a constant, or entropy coded with an order-0 interleaved
+  rANS coder.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace native_utils {
+
+enum class DepthImageResidual : uint8_t {
+  // Integer difference of float bit patterns.
+  Difference = 0,
+  // XOR, for bit fields.
+  Xor = 1,
+};
+
+/*!
+  \brief Appends the encoding of a width x height image of 32-bit values.
+
+  \param[in] pixels Row-major values, `stride` bytes apart per row.
+  \param[in] previous Previous decoded image of the stream (tightly packed),
+             or null for a key image.
+*/
+void EncodeDepthImage(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t stride,
+                      const uint32_t *previous, DepthImageResidual residual, std::vector<uint8_t> *out);
+
+/*!
+  \brief Decodes an image written by EncodeDepthImage().
+
+  \param[in,out] data Cursor into the encoded bytes; advanced past the image.
+  \param[in] end End of the encoded bytes.
+  \param[in,out] image Tightly packed width * height values; holds the
+                 previous image on input when the image was encoded with one.
+  \param[in] has_previous Whether `image` holds the previous image.
+
+  \return false when the data is truncated or corrupt.
+*/
+bool DecodeDepthImage(const uint8_t **data, const uint8_t *end, uint32_t width, uint32_t height,
+                      bool has_previous, DepthImageResidual residual, uint32_t *image);
+
+}  // namespace native_utils
@@ -0,0 +1,206 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_frame_ring.h"
+
+#include <chrono>
+#include <utility>
+
+struct DepthFrameView::Slot {
+  std::atomic<uint32_t> references{0};
+  DepthFrameRing *ring = nullptr;
+  // Holds SDK data not yet released; guarded by the ring's mutex.
+  bool acquired = false;
+  uint64_t sequence = 0;
+  MLDepthCameraData data;
+};
+
+DepthFrameView::DepthFrameView(const DepthFrameView &other) : slot_(other.slot_) {
+  if (slot_ != nullptr) {
+    slot_->references.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+DepthFrameView::DepthFrameView(DepthFrameView &&other) noexcept : slot_(other.slot_) {
+  other.slot_ = nullptr;
+}
+
+DepthFrameView &DepthFrameView::operator=(DepthFrameView other) noexcept {
+  std::swap(slot_, other.slot_);
+  return *this;
+}
+
+DepthFrameView::~DepthFrameView() {
+  reset();
+}
+
+const MLDepthCameraData *DepthFrameView::get() const {
+  return slot_ != nullptr ? &slot_->data : nullptr;
+}
+
+const MLDepthCameraFrame *DepthFrameView::Frame(MLDepthCameraFrameType type) const {
+  if (slot_ == nullptr) {
+    return nullptr;
+  }
+  for (uint8_t i = 0; i < slot_->data.frame_count; i++) {
+    if (slot_->data.frames[i].frame_type == type) {
+      return &slot_->data.frames[i];
+    }
+  }
+  return nullptr;
+}
+
+uint64_t DepthFrameView::sequence() const {
+  return slot_ != nullptr ? slot_->sequence : 0;
+}
+
+void DepthFrameView::reset() {
+  Slot *slot = slot_;
+  slot_ = nullptr;
+  if (slot == nullptr) {
+    return;
+  }
+  uint32_t references = slot->references.load(std::memory_order_relaxed);
+  while (references > 1) {
+    if (slot->references.compare_exchange_weak(references, references - 1, std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+  // The last reference is dropped under the ring's lock, so a ring being
+  // destroyed cannot observe the free slot before this call is done with it.
+  slot->ring->OnSlotFree(slot);
+}
+
+DepthFrameRing::DepthFrameRing(MLHandle camera, size_t capacity)
+    : camera_(camera), capacity_(capacity > 0 ? capacity : 1), slots_(new DepthFrameView::Slot[capacity_]) {
+  for (size_t i = 0; i < capacity_; i++) {
+    slots_[i].ring = this;
+  }
+}
+
+DepthFrameRing::~DepthFrameRing() {
+  DepthFrameView latest;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest = std::move(latest_);
+  }
+  latest.reset();
+  std::unique_lock<std::mutex> lock(mutex_);
+  slot_free_.wait(lock, [this] {
+    ReleaseUnusedLocked();
+    for (size_t i = 0; i < capacity_; i++) {
+      if (slots_[i].acquired) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void DepthFrameRing::OnSlotFree(DepthFrameView::Slot *slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  slot->references.fetch_sub(1, std::memory_order_acq_rel);
+  slot_free_.notify_all();
+}
+
+void DepthFrameRing::ReleaseUnusedLocked() {
+  for (size_t i = 0; i < capacity_; i++) {
+    DepthFrameView::Slot &slot = slots_[i];
+    if (slot.acquired && slot.references.load(std::memory_order_acquire) == 0) {
+      MLDepthCameraReleaseDepthData(camera_, &slot.data);
+      slot.acquired = false;
+      stats_.released++;
+    }
+  }
+}
+
+void DepthFrameRing::ReleaseUnused() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseUnusedLocked();
+}
+
+MLResult DepthFrameRing::Poll(uint64_t timeout_ms, DepthFrameView *out_view) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  DepthFrameView::Slot *slot = nullptr;
+  auto find_free = [&] {
+    ReleaseUnusedLocked();
+    for (size_t i = 0; i < capacity_ && slot == nullptr; i++) {
+      if (!slots_[i].acquired) {
+        slot = &slots_[i];
+      }
+    }
+    return slot != nullptr;
+  };
+  if (!find_free()) {
+    stats_.waits++;
+    if (!slot_free_.wait_for(lock, std::chrono::milliseconds(timeout_ms), find_free)) {
+      stats_.stalls++;
+      return MLResult_Timeout;
+    }
+  }
+  // Reserve the slot while the camera fills it without the lock held.
+  slot->acquired = true;
+  lock.unlock();
+
+  MLDepthCameraDataInit(&slot->data);
+  const MLResult result = MLDepthCameraGetLatestDepthData(camera_, timeout_ms, &slot->data);
+
+  lock.lock();
+  if (result != MLResult_Ok) {
+    slot->acquired = false;
+    return result;
+  }
+  stats_.acquired++;
+  uint32_t used = 0;
+  for (size_t i = 0; i < capacity_; i++) {
+    used += slots_[i].acquired ? 1 : 0;
+  }
+  if (used > stats_.max_in_use) {
+    stats_.max_in_use = used;
+  }
+  slot->sequence = ++sequence_;
+  slot->references.store(1, std::memory_order_relaxed);
+  DepthFrameView previous = std::move(latest_);
+  latest_ = DepthFrameView(slot);
+  DepthFrameView view;
+  if (out_view != nullptr) {
+    view = latest_;
+  }
+  lock.unlock();
+  // Dropping the ring's reference to the previous data, or the view
+  // *out_view held, may free its slot, which takes the lock again.
+  if (out_view != nullptr) {
+    *out_view = std::move(view);
+  }
+  previous.reset();
+  return MLResult_Ok;
+}
+
+DepthFrameView DepthFrameRing::Latest() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latest_;
+}
+
+size_t DepthFrameRing::in_use() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t used = 0;
+  for (size_t i = 0; i < capacity_; i++) {
+    used += slots_[i].acquired ? 1 : 0;
+  }
+  return used;
+}
+
+DepthFrameRingStats DepthFrameRing::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
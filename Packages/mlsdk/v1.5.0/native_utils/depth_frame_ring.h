@@ -0,0 +1,156 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Counters of a DepthFrameRing. */
+typedef struct DepthFrameRingStats {
+  /*! MLDepthCameraData objects obtained from the camera. */
+  uint64_t acquired;
+  /*! MLDepthCameraData objects handed back with MLDepthCameraReleaseDepthData(). */
+  uint64_t released;
+  /*! Poll() calls that had to wait for a consumer to free a slot. */
+  uint64_t waits;
+  /*! Poll() calls that timed out because every slot stayed in use. */
+  uint64_t stalls;
+  /*! Largest number of slots in use at the same time. */
+  uint32_t max_in_use;
+} DepthFrameRingStats;
+
+class DepthFrameRing;
+
+/*!
+  \brief Reference-counted view of one MLDepthCameraData owned by a DepthFrameRing.
+
+  The SDK buffers behind the view stay valid until the last copy is dropped.
+  Views may be copied and dropped on any thread.
+*/
+class DepthFrameView {
+public:
+  DepthFrameView() = default;
+  DepthFrameView(const DepthFrameView &other);
+  DepthFrameView(DepthFrameView &&other) noexcept;
+  DepthFrameView &operator=(DepthFrameView other) noexcept;
+  ~DepthFrameView();
+
+  /*! The camera data, or null for an empty view. */
+  const MLDepthCameraData *get() const;
+
+  /*! The frame captured by `type`'s stream, or null when the data has none. */
+  const MLDepthCameraFrame *Frame(MLDepthCameraFrameType type) const;
+
+  /*! Poll() sequence number of the data, starting at 1. */
+  uint64_t sequence() const;
+
+  explicit operator bool() const { return slot_ != nullptr; }
+
+  /*! Drops this view's reference. */
+  void reset();
+
+private:
+  friend class DepthFrameRing;
+  struct Slot;
+
+  explicit DepthFrameView(Slot *slot) : slot_(slot) {}
+
+  Slot *slot_ = nullptr;
+};
+
+/*!
+  \brief Fixed ring of depth camera data shared between consumers without copies.
+
+  Poll() fetches the latest data with MLDepthCameraGetLatestDepthData() into
+  a free slot and publishes it; consumers hold DepthFrameView references
+  instead of copying the buffers. A slot is handed back with
+  MLDepthCameraReleaseDepthData() once the ring has moved on and the last
+  view is dropped. Because the depth camera API is not thread safe, these
+  releases are deferred to the polling thread (the next Poll() or
+  ReleaseUnused()).
+
+  When every slot is still held by consumers, Poll() waits up to its
+  timeout for one to be dropped and otherwise returns MLResult_Timeout,
+  so slow consumers throttle the producer instead of growing memory.
+
+  Poll() and ReleaseUnused() must be called from one thread; Latest() and
+  views may be used from any thread. Destroying the ring waits for every
+  view to be dropped.
+*/
+class DepthFrameRing {
+public:
+  /*!
+    \param[in] camera Handle from MLDepthCameraConnect(); must outlive the ring.
+    \param[in] capacity Number of MLDepthCameraData objects that may be held at once.
+  */
+  DepthFrameRing(MLHandle camera, size_t capacity = 4);
+  ~DepthFrameRing();
+
+  DepthFrameRing(const DepthFrameRing &) = delete;
+  DepthFrameRing &operator=(const DepthFrameRing &) = delete;
+
+  /*!
+    \brief Fetches the next camera data into the ring.
+
+    \param[in] timeout_ms Longest time to wait, first for a free slot and
+               then for new data.
+    \param[out] out_view Optional view of the new data.
+
+    \retval MLResult_Ok New data was published.
+    \retval MLResult_Timeout No slot was freed, or no new data arrived, in time.
+    \return Otherwise the failure returned by MLDepthCameraGetLatestDepthData().
+  */
+  MLResult Poll(uint64_t timeout_ms, DepthFrameView *out_view = nullptr);
+
+  /*! View of the most recently published data, or an empty view. */
+  DepthFrameView Latest() const;
+
+  /*! Releases the slots no view refers to any more. */
+  void ReleaseUnused();
+
+  /*! Number of slots currently holding camera data. */
+  size_t in_use() const;
+
+  DepthFrameRingStats stats() const;
+
+private:
+  friend class DepthFrameView;
+
+  void ReleaseUnusedLocked();
+  void OnSlotFree(DepthFrameView::Slot *slot);
+
+  MLHandle camera_;
+  size_t capacity_;
+  std::unique_ptr<DepthFrameView::Slot[]> slots_;
+  mutable std::mutex mutex_;
+  std::condition_variable slot_free_;
+  DepthFrameView latest_;
+  uint64_t sequence_ = 0;
+  DepthFrameRingStats stats_ = {};
+};
+
+/*! \} */
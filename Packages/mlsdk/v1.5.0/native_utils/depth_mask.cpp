@@ -0,0 +1,118 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_mask.h"
+
+#include "simd_float8.h"
+
+#include <cstring>
+
+using native_utils::Float8;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+
+bool Matches(const MLDepthCameraFrameBuffer &buffer, const MLDepthCameraDepthImage &depth, uint32_t unit) {
+  return buffer.data != nullptr && buffer.bytes_per_unit == unit && buffer.width == depth.width &&
+         buffer.height == depth.height && buffer.stride >= buffer.width * unit;
+}
+
+const uint8_t *Row(const MLDepthCameraFrameBuffer &buffer, uint32_t v) {
+  return static_cast<const uint8_t *>(buffer.data) + static_cast<size_t>(v) * buffer.stride;
+}
+
+}  // namespace
+
+MLResult MaskDepth(const MLDepthCameraDepthImage &depth, const MLDepthCameraConfidenceBuffer *confidence,
+                   const MLDepthCameraDepthFlagsBuffer *flags, const DepthMaskSettings &settings, float *out_depth,
+                   uint32_t *out_indices, size_t *out_count) {
+  if (!Matches(depth, depth, sizeof(float)) || (confidence != nullptr && !Matches(*confidence, depth, sizeof(float))) ||
+      (flags != nullptr && !Matches(*flags, depth, sizeof(uint32_t)))) {
+    return MLResult_InvalidParam;
+  }
+  const Float8 min_depth(settings.min_depth), max_depth(settings.max_depth);
+  const Float8 min_confidence(settings.min_confidence);
+  const Float8 invalid(settings.invalid_depth);
+  uint32_t reject_bits[kLanes];
+  for (uint32_t &bits : reject_bits) bits = settings.reject_flags;
+  const Float8 reject = Float8::LoadBits(reject_bits);
+
+  const uint32_t width = depth.width;
+  const uint32_t full = width - width % kLanes;
+  alignas(32) float tail_depth[kLanes], tail_confidence[kLanes], tail_out[kLanes];
+  alignas(32) uint32_t tail_flags[kLanes];
+  size_t count = 0;
+
+  for (uint32_t v = 0; v < depth.height; v++) {
+    const float *depth_row = reinterpret_cast<const float *>(Row(depth, v));
+    const float *confidence_row = confidence ? reinterpret_cast<const float *>(Row(*confidence, v)) : nullptr;
+    const uint32_t *flags_row = flags ? reinterpret_cast<const uint32_t *>(Row(*flags, v)) : nullptr;
+    const uint32_t base = v * width;
+    for (uint32_t u = 0; u < width; u += kLanes) {
+      const bool partial = u >= full;
+      const uint32_t n = partial ? width - u : kLanes;
+      Float8 d, c, f;
+      if (!partial) {
+        d = Float8::Load(depth_row + u);
+        c = confidence_row ? Float8::Load(confidence_row + u) : min_confidence;
+        f = flags_row ? Float8::LoadBits(flags_row + u) : Float8(0.0f);
+      } else {
+        // NaN depth keeps the lanes past the end of the row out of the mask.
+        for (float &lane : tail_depth) lane = std::numeric_limits<float>::quiet_NaN();
+        memset(tail_flags, 0, sizeof(tail_flags));
+        memcpy(tail_depth, depth_row + u, n * sizeof(float));
+        if (confidence_row) memcpy(tail_confidence, confidence_row + u, n * sizeof(float));
+        if (flags_row) memcpy(tail_flags, flags_row + u, n * sizeof(uint32_t));
+        d = Float8::Load(tail_depth);
+        c = confidence_row ? Float8::Load(tail_confidence) : min_confidence;
+        f = Float8::LoadBits(tail_flags);
+      }
+      const Float8 keep = (d > min_depth) & (d < max_depth) & (c >= min_confidence) & TestZero(f, reject);
+      if (out_depth != nullptr) {
+        const Float8 masked = Select(keep, d, invalid);
+        if (!partial) {
+          masked.Store(out_depth + base + u);
+        } else {
+          masked.Store(tail_out);
+          memcpy(out_depth + base + u, tail_out, n * sizeof(float));
+        }
+      }
+      const int mask = keep.MoveMask();
+      if (out_indices != nullptr) {
+        // Branch-free compaction: every lane writes, kept lanes advance.
+        // Writes stay in bounds because count <= base + u + lane.
+        for (uint32_t lane = 0; lane < n; lane++) {
+          out_indices[count] = base + u + lane;
+          count += static_cast<size_t>((mask >> lane) & 1);
+        }
+      } else {
+        for (uint32_t lane = 0; lane < n; lane++) {
+          count += static_cast<size_t>((mask >> lane) & 1);
+        }
+      }
+    }
+  }
+  if (out_count != nullptr) {
+    *out_count = count;
+  }
+  return MLResult_Ok;
+}
+
+MLResult MaskDepth(const MLDepthCameraFrame &frame, const DepthMaskSettings &settings, float *out_depth,
+                   uint32_t *out_indices, size_t *out_count) {
+  if (frame.depth_image == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  return MaskDepth(*frame.depth_image, frame.confidence, frame.flags, settings, out_depth, out_indices, out_count);
+}
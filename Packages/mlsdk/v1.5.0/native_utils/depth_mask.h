@@ -0,0 +1,83 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Which depth pixels MaskDepth() keeps. */
+typedef struct DepthMaskSettings {
+  /*! Pixels with a confidence below this are dropped (confidence is not normalized). */
+  float min_confidence;
+  /*! Pixels with any of these #MLDepthCameraDepthFlags bits set are dropped. */
+  uint32_t reject_flags;
+  /*! Pixels whose depth is not within (min_depth, max_depth) are dropped. */
+  float min_depth;
+  float max_depth;
+  /*! Value written to the masked image for dropped pixels, e.g. 0 or NaN. */
+  float invalid_depth;
+} DepthMaskSettings;
+
+/*!
+  \brief Initializes DepthMaskSettings to drop only pixels flagged invalid
+         and non-positive depths.
+*/
+inline void DepthMaskSettingsInit(DepthMaskSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->min_confidence = -std::numeric_limits<float>::infinity();
+    inout_settings->reject_flags = MLDepthCameraDepthFlags_Invalid;
+    inout_settings->min_depth = 0.0f;
+    inout_settings->max_depth = std::numeric_limits<float>::infinity();
+    inout_settings->invalid_depth = 0.0f;
+  }
+}
+
+/*!
+  \brief Masks a depth image by confidence, flags and range in one pass.
+
+  Reads the depth, confidence and flags rows together, eight pixels at a
+  time, and writes the masked image and/or the row-major indices of the
+  kept pixels (v * width + u) without a branch per pixel. Every buffer's
+  stride is honoured; the outputs are tightly packed.
+
+  \param[in] depth Float depth image.
+  \param[in] confidence Optional float confidence buffer of the same size.
+  \param[in] flags Optional uint32_t flags buffer of the same size.
+  \param[in] settings Mask settings, see DepthMaskSettingsInit().
+  \param[out] out_depth Optional masked image of width * height floats.
+  \param[out] out_indices Optional list with room for width * height indices.
+  \param[out] out_count Optional number of pixels kept.
+
+  \retval MLResult_Ok The outputs were written.
+  \retval MLResult_InvalidParam A buffer has the wrong unit size, a
+          different size than the depth image, or a null data pointer.
+*/
+MLResult MaskDepth(const MLDepthCameraDepthImage &depth, const MLDepthCameraConfidenceBuffer *confidence,
+                   const MLDepthCameraDepthFlagsBuffer *flags, const DepthMaskSettings &settings, float *out_depth,
+                   uint32_t *out_indices, size_t *out_count);
+
+/*! Masks the depth image of `frame` with its own confidence and flags buffers. */
+MLResult MaskDepth(const MLDepthCameraFrame &frame, const DepthMaskSettings &settings, float *out_depth,
+                   uint32_t *out_indices, size_t *out_count);
+
+/*! \} */
@@ -0,0 +1,264 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_normals.h"
+
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using native_utils::Float8;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+// Integral image channels: count, x, y, z, xx, xy, xz, yy, yz and zz.
+constexpr int kChannels = 10;
+// Per-pixel inputs of the eigen solve.
+constexpr int kMoments = 10;
+constexpr int kNewtonIterations = 6;
+
+}  // namespace
+
+DepthNormalEstimator::DepthNormalEstimator(const DepthNormalSettings &settings)
+    : settings_(settings), unprojector_(1, settings.opengl_axes) {
+  settings_.mask.invalid_depth = std::numeric_limits<float>::quiet_NaN();
+}
+
+MLResult DepthNormalEstimator::Estimate(const MLDepthCameraFrame &frame, const MLPointBatch &out_normals,
+                                        float *out_curvature, uint8_t *out_valid) {
+  if (frame.depth_image == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const MLDepthCameraDepthImage &depth = *frame.depth_image;
+  masked_.resize(static_cast<size_t>(depth.width) * depth.height);
+  const MLResult result = MaskDepth(frame, settings_.mask, masked_.data(), nullptr, nullptr);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  MLDepthCameraDepthImage image = depth;
+  image.stride = depth.width * sizeof(float);
+  image.size = image.stride * depth.height;
+  image.data = masked_.data();
+  return Estimate(image, frame.intrinsics, out_normals, out_curvature, out_valid);
+}
+
+MLResult DepthNormalEstimator::Estimate(const MLDepthCameraDepthImage &depth, const MLDepthCameraIntrinsics &intrinsics,
+                                        const MLPointBatch &out_normals, float *out_curvature, uint8_t *out_valid) {
+  if (out_normals.x == nullptr || out_normals.y == nullptr || out_normals.z == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  width_ = depth.width;
+  height_ = depth.height;
+  const size_t count = static_cast<size_t>(width_) * height_;
+  x_.resize(count);
+  y_.resize(count);
+  z_.resize(count);
+  const MLPointBatch points = {x_.data(), y_.data(), z_.data()};
+  const MLResult result =
+      unprojector_.Unproject(depth, intrinsics, nullptr, points, settings_.mask.min_depth, settings_.mask.max_depth);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+
+  const uint32_t radius = settings_.window_radius;
+  const size_t row_size = (static_cast<size_t>(width_) + 1) * kChannels;
+  integral_.resize(row_size * (radius * 2 + 2));
+  columns_.resize(row_size);
+  window_.resize(static_cast<size_t>(width_) * kChannels);
+  moments_.resize((static_cast<size_t>(width_) + kLanes - 1) / kLanes * kLanes * kMoments);
+  std::fill(integral_.begin(), integral_.begin() + row_size, 0.0);
+  integral_rows_ = 1;
+  for (uint32_t v = 0; v < height_; v++) {
+    const uint32_t bottom = std::min(v + radius + 1, height_);
+    while (integral_rows_ <= bottom) {
+      Accumulate(integral_rows_++);
+    }
+    Solve(v, out_normals, out_curvature, out_valid);
+  }
+  return MLResult_Ok;
+}
+
+void DepthNormalEstimator::Accumulate(uint32_t row) {
+  // Integral row `row` sums image rows 0 to row - 1: the previous integral
+  // row plus the running sums along image row - 1.
+  const uint32_t ring = settings_.window_radius * 2 + 2;
+  const size_t stride = static_cast<size_t>(width_) + 1;
+  const double *previous = &integral_[((row - 1) % ring) * stride * kChannels];
+  double *current = &integral_[(row % ring) * stride * kChannels];
+  const size_t base = static_cast<size_t>(row - 1) * width_;
+  double sums[kChannels] = {};
+  for (int c = 0; c < kChannels; c++) {
+    current[c * stride] = 0.0;
+  }
+  for (uint32_t u = 0; u < width_; u++) {
+    // Unproject() writes NaN points for invalid depths; add zeros for those.
+    const bool valid = x_[base + u] == x_[base + u];
+    const double x = valid ? x_[base + u] : 0.0, y = valid ? y_[base + u] : 0.0, z = valid ? z_[base + u] : 0.0;
+    const double values[kChannels] = {valid ? 1.0 : 0.0, x, y, z, x * x, x * y, x * z, y * y, y * z, z * z};
+    for (int c = 0; c < kChannels; c++) {
+      sums[c] += values[c];
+      current[c * stride + u + 1] = previous[c * stride + u + 1] + sums[c];
+    }
+  }
+}
+
+void DepthNormalEstimator::Solve(uint32_t row, const MLPointBatch &out_normals, float *out_curvature,
+                                 uint8_t *out_valid) {
+  const uint32_t radius = settings_.window_radius;
+  const uint32_t ring = radius * 2 + 2;
+  const size_t stride = static_cast<size_t>(width_) + 1;
+  const uint32_t top = row > radius ? row - radius : 0;
+  const uint32_t bottom = std::min(row + radius + 1, height_);
+  const double *upper = &integral_[(top % ring) * stride * kChannels];
+  const double *lower = &integral_[(bottom % ring) * stride * kChannels];
+  const size_t base = static_cast<size_t>(row) * width_;
+
+  // Column sums of the window rows, then window sums per channel. The
+  // loops run over contiguous doubles so the compiler vectorizes them.
+  for (size_t i = 0; i < stride * kChannels; i++) {
+    columns_[i] = lower[i] - upper[i];
+  }
+  const uint32_t first = std::min(radius, width_);
+  const uint32_t last = width_ > radius ? std::max(width_ - radius - 1, first) : first;
+  for (int c = 0; c < kChannels; c++) {
+    const double *column = &columns_[c * stride];
+    double *sum = &window_[c * static_cast<size_t>(width_)];
+    for (uint32_t u = first; u < last; u++) {
+      sum[u] = column[u + radius + 1] - column[u - radius];
+    }
+    // Windows clipped by the image border.
+    for (uint32_t u = 0; u < first; u++) {
+      sum[u] = column[std::min(u + radius + 1, width_)] - column[0];
+    }
+    for (uint32_t u = last; u < width_; u++) {
+      sum[u] = column[width_] - column[u > radius ? u - radius : 0];
+    }
+  }
+
+  // Covariance about the window mean in double, divided by its trace and
+  // stored as float for the eigen solve: xx, xy, xz, yy, yz, zz, the center
+  // point, and whether the center is valid with enough points around it.
+  // Unscaled, the determinant of a flat window underflows to denormals.
+  const size_t padded = moments_.size() / kMoments;
+  float *moments[kMoments];
+  for (int k = 0; k < kMoments; k++) {
+    moments[k] = &moments_[k * padded];
+  }
+  const double rows = bottom - top;
+  const double *sums[kChannels];
+  for (int c = 0; c < kChannels; c++) {
+    sums[c] = &window_[c * static_cast<size_t>(width_)];
+  }
+  for (uint32_t u = 0; u < width_; u++) {
+    const double area = rows * (std::min(u + radius + 1, width_) - (u > radius ? u - radius : 0));
+    const double points = sums[0][u];
+    const bool enough = points >= 3.0 && points >= settings_.min_valid_fraction * area && x_[base + u] == x_[base + u];
+    const double inv = enough ? 1.0 / points : 0.0;
+    const double mx = sums[1][u] * inv, my = sums[2][u] * inv, mz = sums[3][u] * inv;
+    const double xx = sums[4][u] * inv - mx * mx, yy = sums[7][u] * inv - my * my, zz = sums[9][u] * inv - mz * mz;
+    const double trace = xx + yy + zz;
+    const double scale = trace > 0.0 ? 1.0 / trace : 0.0;
+    moments[0][u] = static_cast<float>(xx * scale);
+    moments[1][u] = static_cast<float>((sums[5][u] * inv - mx * my) * scale);
+    moments[2][u] = static_cast<float>((sums[6][u] * inv - mx * mz) * scale);
+    moments[3][u] = static_cast<float>(yy * scale);
+    moments[4][u] = static_cast<float>((sums[8][u] * inv - my * mz) * scale);
+    moments[5][u] = static_cast<float>(zz * scale);
+    moments[9][u] = enough ? 1.0f : 0.0f;
+  }
+  for (size_t u = width_; u < padded; u++) {
+    for (int k = 0; k < kMoments; k++) {
+      moments[k][u] = 0.0f;
+    }
+  }
+  memcpy(moments[6], &x_[base], width_ * sizeof(float));
+  memcpy(moments[7], &y_[base], width_ * sizeof(float));
+  memcpy(moments[8], &z_[base], width_ * sizeof(float));
+
+  const Float8 zero(0.0f), one(1.0f), two(2.0f), three(3.0f), tiny(1e-30f);
+  const Float8 nan(std::numeric_limits<float>::quiet_NaN());
+  alignas(32) float results[4][kLanes];
+  for (uint32_t u = 0; u < width_; u += kLanes) {
+    const uint32_t n = std::min<uint32_t>(kLanes, width_ - u);
+    const Float8 xx = Float8::Load(moments[0] + u), xy = Float8::Load(moments[1] + u);
+    const Float8 xz = Float8::Load(moments[2] + u), yy = Float8::Load(moments[3] + u);
+    const Float8 yz = Float8::Load(moments[4] + u), zz = Float8::Load(moments[5] + u);
+    const Float8 px = Float8::Load(moments[6] + u), py = Float8::Load(moments[7] + u);
+    const Float8 pz = Float8::Load(moments[8] + u);
+
+    // Characteristic polynomial l^3 - a l^2 + b l - c. Newton's method from
+    // 0 climbs monotonically to the smallest root, as the polynomial is
+    // concave below it; for surfaces that root is well separated and few
+    // iterations suffice.
+    const Float8 a = xx + yy + zz;
+    const Float8 b = MulAdd(xx, yy, MulAdd(xx, zz, yy * zz)) - MulAdd(xy, xy, MulAdd(xz, xz, yz * yz));
+    const Float8 c = xx * MulAdd(yy, zz, -(yz * yz)) - xy * MulAdd(xy, zz, -(yz * xz)) +
+                     xz * MulAdd(xy, yz, -(yy * xz));
+    Float8 lambda = zero;
+    for (int k = 0; k < kNewtonIterations; k++) {
+      const Float8 f = MulAdd(MulAdd(lambda - a, lambda, b), lambda, -c);
+      const Float8 slope = MulAdd(MulAdd(three, lambda, -(two * a)), lambda, b);
+      lambda = lambda - f / Max(slope, tiny);
+    }
+
+    // The eigenvector is orthogonal to the rows of the covariance minus
+    // lambda; take the longest cross product of two rows.
+    const Float8 r00 = xx - lambda, r11 = yy - lambda, r22 = zz - lambda;
+    Float8 nx = xy * yz - xz * r11, ny = xz * xy - r00 * yz, nz = r00 * r11 - xy * xy;
+    Float8 length = MulAdd(nx, nx, MulAdd(ny, ny, nz * nz));
+    {
+      const Float8 cx = xy * r22 - xz * yz, cy = xz * xz - r00 * r22, cz = r00 * yz - xy * xz;
+      const Float8 candidate = MulAdd(cx, cx, MulAdd(cy, cy, cz * cz));
+      const Float8 longer = candidate > length;
+      nx = Select(longer, cx, nx);
+      ny = Select(longer, cy, ny);
+      nz = Select(longer, cz, nz);
+      length = Max(candidate, length);
+    }
+    {
+      const Float8 cx = r11 * r22 - yz * yz, cy = yz * xz - xy * r22, cz = xy * yz - r11 * xz;
+      const Float8 candidate = MulAdd(cx, cx, MulAdd(cy, cy, cz * cz));
+      const Float8 longer = candidate > length;
+      nx = Select(longer, cx, nx);
+      ny = Select(longer, cy, ny);
+      nz = Select(longer, cz, nz);
+      length = Max(candidate, length);
+    }
+    // Orient towards the camera at the origin.
+    const Float8 facing = MulAdd(nx, px, MulAdd(ny, py, nz * pz));
+    const Float8 scale = Select(facing > zero, -one, one) / Sqrt(length);
+    const Float8 valid = (Float8::Load(moments[9] + u) > zero) & (length > tiny) & (a > zero);
+    Select(valid, nx * scale, nan).Store(results[0]);
+    Select(valid, ny * scale, nan).Store(results[1]);
+    Select(valid, nz * scale, nan).Store(results[2]);
+    Select(valid, Max(lambda, zero) / a, nan).Store(results[3]);
+    const int bits = valid.MoveMask();
+
+    const size_t i = base + u;
+    memcpy(out_normals.x + i, results[0], n * sizeof(float));
+    memcpy(out_normals.y + i, results[1], n * sizeof(float));
+    memcpy(out_normals.z + i, results[2], n * sizeof(float));
+    if (out_curvature != nullptr) {
+      memcpy(out_curvature + i, results[3], n * sizeof(float));
+    }
+    if (out_valid != nullptr) {
+      for (uint32_t lane = 0; lane < n; lane++) {
+        out_valid[i + lane] = static_cast<uint8_t>((bits >> lane) & 1);
+      }
+    }
+  }
+}
@@ -0,0 +1,120 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+
+#include "depth_mask.h"
+#include "depth_unprojector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Parameters of a DepthNormalEstimator. */
+typedef struct DepthNormalSettings {
+  /*! Pixels of each frame to use. */
+  DepthMaskSettings mask;
+  /*! Half size of the square window, e.g. 3 for 7 x 7 pixels. */
+  uint32_t window_radius;
+  /*! Fraction of the window that must hold valid depth for a normal. */
+  float min_valid_fraction;
+  /*! Whether points are in OpenGL camera axes, see DepthUnprojector. */
+  bool opengl_axes;
+} DepthNormalSettings;
+
+/*! \brief Initializes DepthNormalSettings for 7 x 7 windows at least half valid. */
+inline void DepthNormalSettingsInit(DepthNormalSettings *inout_settings) {
+  if (inout_settings) {
+    DepthMaskSettingsInit(&inout_settings->mask);
+    inout_settings->window_radius = 3;
+    inout_settings->min_valid_fraction = 0.5f;
+    inout_settings->opengl_axes = false;
+  }
+}
+
+/*!
+  \brief Estimates camera-space surface normals and curvature per depth pixel.
+
+  Each pixel's normal is the smallest eigenvector of the covariance of the
+  points in the window around it, oriented towards the camera, and its
+  curvature is the surface variation lambda_min / (lambda_0 + lambda_1 +
+  lambda_2): 0 on planes, up to 1/3 for isotropic scatter. Windows crossing
+  depth edges therefore show up as high curvature.
+
+  The window sums of the points and their products come from integral
+  images, so the cost per pixel does not depend on window_radius. They are
+  accumulated in double precision over a ring of window_radius * 2 + 2 rows
+  rather than the whole image. The eigen solve, Newton iterations on the
+  characteristic polynomial followed by a cross product, runs eight pixels
+  at a time.
+
+  Not thread safe; use one estimator per thread.
+*/
+class DepthNormalEstimator {
+public:
+  explicit DepthNormalEstimator(const DepthNormalSettings &settings);
+
+  /*!
+    \brief Estimates normals for a float depth image.
+
+    Depths outside the mask's min_depth to max_depth range are ignored; the
+    confidence and flags criteria need the frame overload.
+
+    \param[in] depth Float depth image.
+    \param[in] intrinsics Intrinsics matching the image.
+    \param[out] out_normals Unit normals, NaN where invalid.
+    \param[out] out_curvature Optional curvature per pixel, NaN where invalid.
+    \param[out] out_valid Optional mask per pixel, 1 where a normal was estimated.
+
+    \retval MLResult_Ok The outputs were written.
+    \retval MLResult_InvalidParam The image is not float, its size does not
+            match the intrinsics, or a normal array is null.
+  */
+  MLResult Estimate(const MLDepthCameraDepthImage &depth, const MLDepthCameraIntrinsics &intrinsics,
+                    const MLPointBatch &out_normals, float *out_curvature, uint8_t *out_valid);
+
+  /*! Estimates normals for the depth image of `frame`, masked with its confidence and flags. */
+  MLResult Estimate(const MLDepthCameraFrame &frame, const MLPointBatch &out_normals, float *out_curvature,
+                    uint8_t *out_valid);
+
+private:
+  void Accumulate(uint32_t row);
+  void Solve(uint32_t row, const MLPointBatch &out_normals, float *out_curvature, uint8_t *out_valid);
+
+  DepthNormalSettings settings_;
+  DepthUnprojector unprojector_;
+  std::vector<float> masked_;
+  std::vector<float> x_, y_, z_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+
+  // Integral image rows of count, x, y, z, xx, xy, xz, yy, yz and zz, one
+  // channel after the other; row k lives at slot k % ring size.
+  std::vector<double> integral_;
+  uint32_t integral_rows_ = 0;
+
+  // Per-row scratch: window column sums, window sums and moments.
+  std::vector<double> columns_;
+  std::vector<double> window_;
+  std::vector<float> moments_;
+};
+
+/*! \} */
@@ -0,0 +1,111 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+/*
+  Internal helpers for the native_utils kernels that project camera-space
+  points back into an image: the rotation matrix of a pose, the inverse of
+  the Brown-Conrady model for a single pixel, and the forward projection,
+  eight points at a time.
+*/
+
+#pragma once
+
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include "depth_unprojector.h"
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace native_utils {
+
+// Row-major rotation matrix of a unit quaternion.
+inline void RotationMatrix(const MLQuaternionf &q, float (&m)[3][3]) {
+  const float x = q.x, y = q.y, z = q.z, w = q.w;
+  const float r[3][3] = {{1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w)},
+                         {2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w)},
+                         {2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y)}};
+  memcpy(m, r, sizeof(m));
+}
+
+// Largest squared undistorted radius at the corners of a width x height ray table.
+inline float FieldOfViewRadius2(const MLPointBatch &rays, uint32_t width, uint32_t height) {
+  const size_t count = static_cast<size_t>(width) * height;
+  float max_r2 = 0.0f;
+  for (size_t corner : {size_t(0), size_t(width - 1), count - width, count - 1}) {
+    const float x = rays.x[corner] / rays.z[corner], y = rays.y[corner] / rays.z[corner];
+    max_r2 = std::max(max_r2, x * x + y * y);
+  }
+  return max_r2;
+}
+
+// Projects camera-space points in the pinhole convention through the
+// distortion model of `intrinsics`.
+// Inverts the Brown-Conrady model by fixed-point iteration: (xd, yd) is a
+// distorted normalized image point, (*x, *y) the undistorted one.
+inline void Undistort(const MLDepthCameraIntrinsics &intrinsics, double xd, double yd, double *x, double *y) {
+  constexpr int kIterations = 20;
+  const double k1 = intrinsics.distortion[0], k2 = intrinsics.distortion[1];
+  const double p1 = intrinsics.distortion[2], p2 = intrinsics.distortion[3];
+  const double k3 = intrinsics.distortion[4];
+  double xu = xd, yu = yd;
+  for (int i = 0; i < kIterations; i++) {
+    const double r2 = xu * xu + yu * yu;
+    const double radial = 1.0 + r2 * (k1 + r2 * (k2 + r2 * k3));
+    const double dx = 2.0 * p1 * xu * yu + p2 * (r2 + 2.0 * xu * xu);
+    const double dy = p1 * (r2 + 2.0 * yu * yu) + 2.0 * p2 * xu * yu;
+    xu = (xd - dx) / radial;
+    yu = (yd - dy) / radial;
+  }
+  *x = xu;
+  *y = yu;
+}
+
+class DistortedProjection {
+public:
+  // Points are only projected within the field of view `max_r2`, plus a
+  // margin, which keeps the distortion polynomial away from where it folds
+  // back. `offset` is added to the principal point before flooring: 0.5
+  // gives the pixel that contains the point.
+  DistortedProjection(const MLDepthCameraIntrinsics &intrinsics, float max_r2, float offset)
+      : fx_(static_cast<float>(intrinsics.focal_length.x)), fy_(static_cast<float>(intrinsics.focal_length.y)),
+        cx_(static_cast<float>(intrinsics.principal_point.x + offset)),
+        cy_(static_cast<float>(intrinsics.principal_point.y + offset)),
+        k1_(static_cast<float>(intrinsics.distortion[0])), k2_(static_cast<float>(intrinsics.distortion[1])),
+        p1_(static_cast<float>(intrinsics.distortion[2])), p2_(static_cast<float>(intrinsics.distortion[3])),
+        k3_(static_cast<float>(intrinsics.distortion[4])), limit_(max_r2 * 1.1f) {}
+
+  // Stores the floored pixel coordinates of (x, y, z) and returns the mask
+  // of the lanes in front of the camera and within the field of view.
+  Float8 Project(Float8 x, Float8 y, Float8 z, Float8 *u, Float8 *v) const {
+    const Float8 one(1.0f), two(2.0f);
+    const Float8 inv_z = one / z;
+    const Float8 xn = x * inv_z, yn = y * inv_z;
+    const Float8 r2 = MulAdd(xn, xn, yn * yn);
+    const Float8 radial = MulAdd(r2, MulAdd(r2, MulAdd(r2, k3_, k2_), k1_), one);
+    const Float8 xy2 = two * xn * yn;
+    const Float8 xd = MulAdd(xn, radial, MulAdd(p1_, xy2, p2_ * MulAdd(two * xn, xn, r2)));
+    const Float8 yd = MulAdd(yn, radial, MulAdd(p2_, xy2, p1_ * MulAdd(two * yn, yn, r2)));
+    *u = Floor(MulAdd(fx_, xd, cx_));
+    *v = Floor(MulAdd(fy_, yd, cy_));
+    return (z > Float8(0.0f)) & (r2 < limit_);
+  }
+
+private:
+  Float8 fx_, fy_, cx_, cy_, k1_, k2_, p1_, p2_, k3_, limit_;
+};
+
+}  // namespace native_utils
@@ -0,0 +1,168 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_pyramid.h"
+
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using native_utils::Float8;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+constexpr float kMillimeters = 0.001f;
+
+Float8 Valid(Float8 depth) {
+  return (depth > Float8(0.0f)) & (depth < Float8(std::numeric_limits<float>::infinity()));
+}
+
+// Combines the 2 x 2 blocks (a0, a1) over (b0, b1) of eight output pixels.
+Float8 Combine(Float8 a0, Float8 a1, Float8 b0, Float8 b1, const DepthPyramidSettings &settings) {
+  const Float8 infinity(std::numeric_limits<float>::infinity()), one(1.0f), zero(0.0f);
+  const Float8 valid[4] = {Valid(a0), Valid(a1), Valid(b0), Valid(b1)};
+  const Float8 x[4] = {Select(valid[0], a0, infinity), Select(valid[1], a1, infinity),
+                       Select(valid[2], b0, infinity), Select(valid[3], b1, infinity)};
+  // Two smallest values; invalid pixels sort last.
+  const Float8 low0 = Min(x[0], x[1]), high0 = Max(x[0], x[1]);
+  const Float8 low1 = Min(x[2], x[3]), high1 = Max(x[2], x[3]);
+  const Float8 first = Min(low0, low1);
+  const Float8 second = Min(Max(low0, low1), Min(high0, high1));
+  const Float8 count = Select(valid[0], one, zero) + Select(valid[1], one, zero) + Select(valid[2], one, zero) +
+                       Select(valid[3], one, zero);
+  const Float8 median = Select(count >= Float8(3.0f), second, first);
+  Float8 result = median;
+  if (settings.filter == DepthPyramidFilter_Bilateral) {
+    const Float8 inv_sigma = one / (median * Float8(settings.range_sigma));
+    Float8 sum = zero, weights = zero;
+    for (int i = 0; i < 4; i++) {
+      const Float8 t = (x[i] - median) * inv_sigma;
+      const Float8 weight = Select(valid[i], one / MulAdd(t, t, one), zero);
+      sum = MulAdd(weight, Select(valid[i], x[i], zero), sum);
+      weights = weights + weight;
+    }
+    result = sum / weights;
+  }
+  return Select(first < infinity, result, Float8(settings.invalid_depth));
+}
+
+}  // namespace
+
+DepthPyramid::DepthPyramid(const DepthPyramidSettings &settings) : settings_(settings) {
+  settings_.max_levels = std::max<uint32_t>(settings_.max_levels, 1);
+  levels_.resize(settings_.max_levels);
+}
+
+MLResult DepthPyramid::Build(const MLDepthCameraFrame &frame) {
+  if (frame.depth_image == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  return Build(*frame.depth_image, frame.intrinsics);
+}
+
+MLResult DepthPyramid::Build(const MLDepthCameraDepthImage &depth, const MLDepthCameraIntrinsics &intrinsics) {
+  if (depth.data == nullptr || (depth.bytes_per_unit != sizeof(float) && depth.bytes_per_unit != sizeof(uint16_t)) ||
+      depth.stride < depth.width * depth.bytes_per_unit || depth.width != intrinsics.width ||
+      depth.height != intrinsics.height || depth.width == 0 || depth.height == 0) {
+    return MLResult_InvalidParam;
+  }
+  const uint32_t width = depth.width, height = depth.height;
+  Level &base = levels_[0];
+  base.pixels.resize(static_cast<size_t>(width) * height);
+  const Float8 invalid(settings_.invalid_depth);
+  for (uint32_t v = 0; v < height; v++) {
+    const uint8_t *row = static_cast<const uint8_t *>(depth.data) + static_cast<size_t>(v) * depth.stride;
+    float *out = &base.pixels[static_cast<size_t>(v) * width];
+    uint32_t u = 0;
+    if (depth.bytes_per_unit == sizeof(float)) {
+      const float *in = reinterpret_cast<const float *>(row);
+      for (; u + kLanes <= width; u += kLanes) {
+        const Float8 x = Float8::Load(in + u);
+        Select(Valid(x), x, invalid).Store(out + u);
+      }
+      for (; u < width; u++) {
+        out[u] = in[u] > 0.0f && in[u] < std::numeric_limits<float>::infinity() ? in[u] : settings_.invalid_depth;
+      }
+    } else {
+      const uint16_t *in = reinterpret_cast<const uint16_t *>(row);
+      for (; u + kLanes <= width; u += kLanes) {
+        const Float8 x = Float8::LoadU16(in + u) * Float8(kMillimeters);
+        Select(Valid(x), x, invalid).Store(out + u);
+      }
+      for (; u < width; u++) {
+        out[u] = in[u] != 0 ? in[u] * kMillimeters : settings_.invalid_depth;
+      }
+    }
+  }
+  base.intrinsics = intrinsics;
+  base.image.width = width;
+  base.image.height = height;
+  base.image.stride = width * sizeof(float);
+  base.image.bytes_per_unit = sizeof(float);
+  base.image.size = base.image.stride * height;
+  base.image.data = base.pixels.data();
+
+  level_count_ = 1;
+  while (level_count_ < settings_.max_levels && levels_[level_count_ - 1].image.width >= 2 &&
+         levels_[level_count_ - 1].image.height >= 2) {
+    Downsample(levels_[level_count_ - 1], &levels_[level_count_]);
+    level_count_++;
+  }
+  return MLResult_Ok;
+}
+
+void DepthPyramid::Downsample(const Level &source, Level *out) const {
+  const uint32_t in_width = source.image.width;
+  const uint32_t width = in_width / 2, height = source.image.height / 2;
+  out->pixels.resize(static_cast<size_t>(width) * height);
+  for (uint32_t v = 0; v < height; v++) {
+    const float *r0 = &source.pixels[static_cast<size_t>(2 * v) * in_width];
+    const float *r1 = r0 + in_width;
+    float *row = &out->pixels[static_cast<size_t>(v) * width];
+    uint32_t u = 0;
+    Float8 a0, a1, b0, b1;
+    for (; u + kLanes <= width; u += kLanes) {
+      Float8::LoadDeinterleaved(r0 + 2 * u, &a0, &a1);
+      Float8::LoadDeinterleaved(r1 + 2 * u, &b0, &b1);
+      Combine(a0, a1, b0, b1, settings_).Store(row + u);
+    }
+    if (u < width) {
+      // Pad the tail to a whole vector.
+      alignas(32) float t0[2 * kLanes] = {}, t1[2 * kLanes] = {}, result[kLanes];
+      memcpy(t0, r0 + 2 * u, 2 * (width - u) * sizeof(float));
+      memcpy(t1, r1 + 2 * u, 2 * (width - u) * sizeof(float));
+      Float8::LoadDeinterleaved(t0, &a0, &a1);
+      Float8::LoadDeinterleaved(t1, &b0, &b1);
+      Combine(a0, a1, b0, b1, settings_).Store(result);
+      memcpy(row + u, result, (width - u) * sizeof(float));
+    }
+  }
+
+  // Output pixel u covers input pixels 2u and 2u + 1, centered on 2u + 0.5.
+  out->intrinsics = source.intrinsics;
+  out->intrinsics.width = width;
+  out->intrinsics.height = height;
+  out->intrinsics.focal_length.x *= 0.5f;
+  out->intrinsics.focal_length.y *= 0.5f;
+  out->intrinsics.principal_point.x = (source.intrinsics.principal_point.x - 0.5f) * 0.5f;
+  out->intrinsics.principal_point.y = (source.intrinsics.principal_point.y - 0.5f) * 0.5f;
+  out->image.width = width;
+  out->image.height = height;
+  out->image.stride = width * sizeof(float);
+  out->image.bytes_per_unit = sizeof(float);
+  out->image.size = out->image.stride * height;
+  out->image.data = out->pixels.data();
+}
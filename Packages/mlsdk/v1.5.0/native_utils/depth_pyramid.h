@@ -0,0 +1,116 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief How DepthPyramid combines each 2 x 2 block of valid depths. */
+typedef enum DepthPyramidFilter {
+  /*!
+    \brief Lower median: the nearer of two, the second nearest of three or
+           four. Always an observed depth, so edges stay sharp.
+  */
+  DepthPyramidFilter_Median = 0,
+  /*!
+    \brief Average weighted by closeness to the lower median, falling off as
+           1 / (1 + (delta / (range_sigma * median))^2). Smoother on surfaces,
+           still no blending across depth edges.
+  */
+  DepthPyramidFilter_Bilateral = 1,
+  DepthPyramidFilter_Ensure32Bits = 0x7FFFFFFF
+} DepthPyramidFilter;
+
+/*! \brief Parameters of a DepthPyramid. */
+typedef struct DepthPyramidSettings {
+  /*! Number of levels including the full resolution one. */
+  uint32_t max_levels;
+  DepthPyramidFilter filter;
+  /*! Bilateral range sigma relative to depth, e.g. 0.03 for 3 cm at 1 m. */
+  float range_sigma;
+  /*! Value written for pixels without a valid depth, e.g. 0 or NaN. */
+  float invalid_depth;
+} DepthPyramidSettings;
+
+/*! \brief Initializes DepthPyramidSettings for four median-filtered levels. */
+inline void DepthPyramidSettingsInit(DepthPyramidSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->max_levels = 4;
+    inout_settings->filter = DepthPyramidFilter_Median;
+    inout_settings->range_sigma = 0.03f;
+    inout_settings->invalid_depth = 0.0f;
+  }
+}
+
+/*!
+  \brief Halves a depth image level by level for coarse-to-fine processing.
+
+  Level 0 is the input converted to tightly packed float meters; depth
+  images with bytes_per_unit 2 are read as uint16_t millimeters. Each
+  further level combines 2 x 2 blocks of the previous one, eight outputs
+  at a time, ignoring zero, negative, infinite and NaN depths. Odd last
+  rows and columns are dropped.
+
+  Every level is exposed as an MLDepthCameraDepthImage with matching
+  intrinsics (focal length halved and principal point moved to the new
+  pixel centers), so levels can be passed straight to DepthUnprojector and
+  the other helpers.
+*/
+class DepthPyramid {
+public:
+  explicit DepthPyramid(const DepthPyramidSettings &settings);
+
+  /*!
+    \brief Rebuilds every level from `depth`.
+
+    \retval MLResult_Ok The levels were built.
+    \retval MLResult_InvalidParam The image is not float or uint16_t, its
+            stride is too small, or its size does not match the intrinsics.
+  */
+  MLResult Build(const MLDepthCameraDepthImage &depth, const MLDepthCameraIntrinsics &intrinsics);
+
+  /*! Builds from the depth image and intrinsics of `frame`. */
+  MLResult Build(const MLDepthCameraFrame &frame);
+
+  /*! Levels built by the last Build(); fewer than max_levels for small images. */
+  uint32_t level_count() const { return level_count_; }
+
+  /*! Level `index`; its data stays valid until the next Build(). */
+  const MLDepthCameraDepthImage &level(uint32_t index) const { return levels_[index].image; }
+  const MLDepthCameraIntrinsics &intrinsics(uint32_t index) const { return levels_[index].intrinsics; }
+
+private:
+  struct Level {
+    std::vector<float> pixels;
+    MLDepthCameraDepthImage image;
+    MLDepthCameraIntrinsics intrinsics;
+  };
+
+  void Downsample(const Level &source, Level *out) const;
+
+  DepthPyramidSettings settings_;
+  std::vector<Level> levels_;
+  uint32_t level_count_ = 0;
+};
+
+/*! \} */
@@ -0,0 +1,605 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_recording.h"
+
+#include "depth_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using native_utils::DecodeDepthImage;
+using native_utils::DepthImageResidual;
+using native_utils::EncodeDepthImage;
+
+namespace {
+
+constexpr char kHeaderMagic[4] = {'M', 'L', 'D', 'R'};
+constexpr char kChunkMagic[4] = {'M', 'L', 'D', 'C'};
+constexpr char kIndexMagic[4] = {'M', 'L', 'D', 'I'};
+constexpr char kEndMagic[4] = {'M', 'L', 'D', 'E'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kChunkHeaderSize = 32;
+constexpr size_t kIndexEntrySize = 32;
+constexpr size_t kTrailerSize = 12;
+constexpr size_t kStreamCount = 2;
+// Largest image side recorded or accepted on read; far above the depth
+// camera's 544x480, and it bounds the allocation for a corrupt header.
+constexpr uint32_t kMaxImageSide = 4096;
+
+// Put() and Get() copy values in host byte order; the format is little-endian.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "depth recordings are little-endian and this host is not"
+#endif
+
+template <typename T>
+void Put(std::vector<uint8_t> *out, T value) {
+  uint8_t bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));
+  out->insert(out->end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool Get(const uint8_t **data, const uint8_t *end, T *value) {
+  if (static_cast<size_t>(end - *data) < sizeof(T)) {
+    return false;
+  }
+  memcpy(value, *data, sizeof(T));
+  *data += sizeof(T);
+  return true;
+}
+
+MLDepthCameraFrameBuffer *&FrameImage(MLDepthCameraFrame &frame, int kind) {
+  switch (kind) {
+    case 0: return frame.depth_image;
+    case 1: return frame.confidence;
+    case 2: return frame.flags;
+    case 3: return frame.ambient_raw_depth_image;
+    default: return frame.raw_depth_image;
+  }
+}
+
+DepthImageResidual ResidualOf(int kind) {
+  return (1 << kind) == DepthRecordingImage_Flags ? DepthImageResidual::Xor : DepthImageResidual::Difference;
+}
+
+size_t StreamOf(MLDepthCameraFrameType type) {
+  return type == MLDepthCameraFrameType_LongRange ? 0 : 1;
+}
+
+bool Recordable(const MLDepthCameraFrameBuffer *buffer) {
+  return buffer != nullptr && buffer->data != nullptr && buffer->bytes_per_unit == sizeof(uint32_t) &&
+         buffer->width <= kMaxImageSide && buffer->height <= kMaxImageSide &&
+         buffer->stride >= buffer->width * sizeof(uint32_t);
+}
+
+}  // namespace
+
+// Previous image of one stream and kind, the temporal prediction source.
+struct DepthRecorder::StreamState {
+  std::vector<uint32_t> pixels;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool valid = false;
+};
+
+struct DepthRecordingReader::StreamState {
+  std::vector<uint32_t> pixels;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool valid = false;
+};
+
+struct DepthRecorder::Job {
+  DepthFrameView view;
+  // Copy of a frame appended without a view.
+  MLDepthCameraFrame frame;
+  MLDepthCameraFrameBuffer buffers[DepthRecordingImage_Count];
+  std::vector<uint8_t> storage[DepthRecordingImage_Count];
+};
+
+DepthRecorder::DepthRecorder() = default;
+
+DepthRecorder::~DepthRecorder() {
+  Close();
+}
+
+MLResult DepthRecorder::Open(const char *path, const DepthRecorderSettings &settings) {
+  if (path == nullptr || file_ != nullptr) {
+    return MLResult_InvalidParam;
+  }
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr) {
+    return MLResult_UnspecifiedFailure;
+  }
+  {
+    // Append() may already be called from other threads.
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ = file;
+    settings_ = settings;
+    settings_.chunk_frames = std::max<uint32_t>(settings_.chunk_frames, 1);
+    settings_.max_pending = std::max<uint32_t>(settings_.max_pending, 1);
+    closing_ = false;
+    stats_ = DepthRecorderStats();
+  }
+  failed_ = false;
+  chunk_.clear();
+  chunk_count_ = 0;
+  index_.clear();
+  index_count_ = 0;
+  streams_.reset(new StreamState[kStreamCount * DepthRecordingImage_Count]);
+
+  std::vector<uint8_t> header(kHeaderMagic, kHeaderMagic + 4);
+  Put<uint32_t>(&header, kFormatVersion);
+  Put<uint32_t>(&header, settings_.chunk_frames);
+  Put<uint32_t>(&header, 0);
+  failed_ = fwrite(header.data(), 1, header.size(), file_) != header.size();
+  offset_ = header.size();
+  thread_ = std::thread(&DepthRecorder::Run, this);
+  return MLResult_Ok;
+}
+
+MLResult DepthRecorder::Enqueue(std::unique_ptr<Job> job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_ == nullptr || closing_) {
+    return MLResult_InvalidParam;
+  }
+  if (queue_.size() >= settings_.max_pending) {
+    stats_.dropped += job->view ? job->view.get()->frame_count : 1;
+    return MLResult_Timeout;
+  }
+  queue_.push_back(std::move(job));
+  wake_.notify_one();
+  return MLResult_Ok;
+}
+
+MLResult DepthRecorder::Append(const DepthFrameView &view) {
+  if (!view) {
+    return MLResult_InvalidParam;
+  }
+  std::unique_ptr<Job> job(new Job());
+  job->view = view;
+  return Enqueue(std::move(job));
+}
+
+MLResult DepthRecorder::Append(const MLDepthCameraFrame &frame) {
+  uint32_t images;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    images = settings_.images;
+  }
+  std::unique_ptr<Job> job(new Job());
+  job->frame = frame;
+  for (int kind = 0; kind < DepthRecordingImage_Count; kind++) {
+    MLDepthCameraFrameBuffer *&image = FrameImage(job->frame, kind);
+    if (!Recordable(image) || (images & (1u << kind)) == 0) {
+      image = nullptr;
+      continue;
+    }
+    const size_t row_bytes = image->width * sizeof(uint32_t);
+    std::vector<uint8_t> &storage = job->storage[kind];
+    storage.resize(row_bytes * image->height);
+    for (uint32_t v = 0; v < image->height; v++) {
+      memcpy(&storage[v * row_bytes], static_cast<const uint8_t *>(image->data) + static_cast<size_t>(v) * image->stride,
+             row_bytes);
+    }
+    MLDepthCameraFrameBuffer &copy = job->buffers[kind];
+    copy = *image;
+    copy.stride = static_cast<uint32_t>(row_bytes);
+    copy.size = static_cast<uint32_t>(storage.size());
+    copy.data = storage.data();
+    image = &copy;
+  }
+  return Enqueue(std::move(job));
+}
+
+void DepthRecorder::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    std::unique_ptr<Job> job = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    if (job->view) {
+      const MLDepthCameraData *data = job->view.get();
+      for (uint8_t i = 0; i < data->frame_count; i++) {
+        EncodeFrame(data->frames[i]);
+      }
+    } else {
+      EncodeFrame(job->frame);
+    }
+    // Drops the view, handing the SDK buffers back to the ring.
+    job.reset();
+    lock.lock();
+  }
+}
+
+void DepthRecorder::EncodeFrame(const MLDepthCameraFrame &frame) {
+  if (chunk_count_ == 0) {
+    chunk_first_ = frame.frame_timestamp;
+    for (size_t i = 0; i < kStreamCount * DepthRecordingImage_Count; i++) {
+      streams_[i].valid = false;
+    }
+  }
+  chunk_last_ = frame.frame_timestamp;
+
+  const size_t record_start = chunk_.size();
+  Put<uint32_t>(&chunk_, 0);
+  Put<int64_t>(&chunk_, frame.frame_number);
+  Put<int64_t>(&chunk_, frame.frame_timestamp);
+  Put<uint32_t>(&chunk_, static_cast<uint32_t>(frame.frame_type));
+  for (float value : frame.camera_pose.rotation.values) Put<float>(&chunk_, value);
+  Put<float>(&chunk_, frame.camera_pose.position.x);
+  Put<float>(&chunk_, frame.camera_pose.position.y);
+  Put<float>(&chunk_, frame.camera_pose.position.z);
+  const MLDepthCameraIntrinsics &intrinsics = frame.intrinsics;
+  Put<uint32_t>(&chunk_, intrinsics.width);
+  Put<uint32_t>(&chunk_, intrinsics.height);
+  Put<float>(&chunk_, intrinsics.focal_length.x);
+  Put<float>(&chunk_, intrinsics.focal_length.y);
+  Put<float>(&chunk_, intrinsics.principal_point.x);
+  Put<float>(&chunk_, intrinsics.principal_point.y);
+  Put<float>(&chunk_, intrinsics.fov);
+  for (double value : intrinsics.distortion) Put<double>(&chunk_, value);
+
+  MLDepthCameraFrame &mutable_frame = const_cast<MLDepthCameraFrame &>(frame);
+  uint32_t mask = 0;
+  for (int kind = 0; kind < DepthRecordingImage_Count; kind++) {
+    if (Recordable(FrameImage(mutable_frame, kind)) && (settings_.images & (1u << kind)) != 0) {
+      mask |= 1u << kind;
+    }
+  }
+  Put<uint32_t>(&chunk_, mask);
+
+  uint64_t raw_bytes = 0;
+  const size_t images_start = chunk_.size();
+  for (int kind = 0; kind < DepthRecordingImage_Count; kind++) {
+    if ((mask & (1u << kind)) == 0) {
+      continue;
+    }
+    const MLDepthCameraFrameBuffer &image = *FrameImage(mutable_frame, kind);
+    StreamState &state = streams_[StreamOf(frame.frame_type) * DepthRecordingImage_Count + kind];
+    const bool temporal = state.valid && state.width == image.width && state.height == image.height;
+    Put<uint32_t>(&chunk_, image.width);
+    Put<uint32_t>(&chunk_, image.height);
+    const uint8_t *pixels = static_cast<const uint8_t *>(image.data);
+    EncodeDepthImage(pixels, image.width, image.height, image.stride, temporal ? state.pixels.data() : nullptr,
+                     ResidualOf(kind), &chunk_);
+    state.pixels.resize(static_cast<size_t>(image.width) * image.height);
+    for (uint32_t v = 0; v < image.height; v++) {
+      memcpy(&state.pixels[static_cast<size_t>(v) * image.width], pixels + static_cast<size_t>(v) * image.stride,
+             image.width * sizeof(uint32_t));
+    }
+    state.width = image.width;
+    state.height = image.height;
+    state.valid = true;
+    raw_bytes += static_cast<uint64_t>(image.width) * image.height * sizeof(uint32_t);
+  }
+  const uint32_t record_size = static_cast<uint32_t>(chunk_.size() - record_start - sizeof(uint32_t));
+  memcpy(&chunk_[record_start], &record_size, sizeof(record_size));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.frames++;
+    stats_.raw_bytes += raw_bytes;
+    stats_.coded_bytes += chunk_.size() - images_start;
+  }
+  if (++chunk_count_ >= settings_.chunk_frames) {
+    FlushChunk();
+  }
+}
+
+void DepthRecorder::FlushChunk() {
+  if (chunk_count_ == 0) {
+    return;
+  }
+  std::vector<uint8_t> header(kChunkMagic, kChunkMagic + 4);
+  Put<uint32_t>(&header, chunk_count_);
+  Put<uint64_t>(&header, chunk_.size());
+  Put<int64_t>(&header, chunk_first_);
+  Put<int64_t>(&header, chunk_last_);
+  if (!failed_) {
+    failed_ = fwrite(header.data(), 1, header.size(), file_) != header.size() ||
+              fwrite(chunk_.data(), 1, chunk_.size(), file_) != chunk_.size();
+  }
+  Put<uint64_t>(&index_, offset_);
+  Put<uint32_t>(&index_, chunk_count_);
+  Put<uint32_t>(&index_, 0);
+  Put<int64_t>(&index_, chunk_first_);
+  Put<int64_t>(&index_, chunk_last_);
+  index_count_++;
+  offset_ += header.size() + chunk_.size();
+  chunk_.clear();
+  chunk_count_ = 0;
+}
+
+MLResult DepthRecorder::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ == nullptr) {
+      return MLResult_Ok;
+    }
+    closing_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  FlushChunk();
+  std::vector<uint8_t> tail(kIndexMagic, kIndexMagic + 4);
+  Put<uint32_t>(&tail, index_count_);
+  tail.insert(tail.end(), index_.begin(), index_.end());
+  Put<uint64_t>(&tail, offset_);
+  tail.insert(tail.end(), kEndMagic, kEndMagic + 4);
+  if (!failed_) {
+    failed_ = fwrite(tail.data(), 1, tail.size(), file_) != tail.size();
+  }
+  failed_ = fclose(file_) != 0 || failed_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_ = nullptr;
+  return failed_ ? MLResult_UnspecifiedFailure : MLResult_Ok;
+}
+
+DepthRecorderStats DepthRecorder::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+DepthRecordingFrame::DepthRecordingFrame() {
+  memset(&frame_, 0, sizeof(frame_));
+  memset(buffers_, 0, sizeof(buffers_));
+}
+
+DepthRecordingReader::DepthRecordingReader() = default;
+
+DepthRecordingReader::~DepthRecordingReader() {
+  Close();
+}
+
+MLResult DepthRecordingReader::Open(const char *path) {
+  Close();
+  if (path == nullptr) {
+    return MLResult_InvalidParam;
+  }
+#if defined(_WIN32)
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) {
+    return MLResult_UnspecifiedFailure;
+  }
+  fseek(file, 0, SEEK_END);
+  file_data_.resize(static_cast<size_t>(ftell(file)));
+  fseek(file, 0, SEEK_SET);
+  const bool read = fread(file_data_.data(), 1, file_data_.size(), file) == file_data_.size();
+  fclose(file);
+  if (!read) {
+    return MLResult_UnspecifiedFailure;
+  }
+  data_ = file_data_.data();
+  size_ = file_data_.size();
+#else
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return MLResult_UnspecifiedFailure;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return st.st_size == 0 ? MLResult_InvalidParam : MLResult_UnspecifiedFailure;
+  }
+  void *mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return MLResult_UnspecifiedFailure;
+  }
+  data_ = static_cast<const uint8_t *>(mapping);
+  size_ = static_cast<size_t>(st.st_size);
+#endif
+  uint32_t version = 0;
+  const uint8_t *p = data_ + 4;
+  if (size_ < kHeaderSize || memcmp(data_, kHeaderMagic, 4) != 0 || !Get(&p, data_ + size_, &version) ||
+      version != kFormatVersion || !Index()) {
+    Close();
+    return MLResult_InvalidParam;
+  }
+  streams_.reset(new StreamState[kStreamCount * DepthRecordingImage_Count]);
+  decoded_ = SIZE_MAX;
+  return MLResult_Ok;
+}
+
+void DepthRecordingReader::Close() {
+#if defined(_WIN32)
+  file_data_.clear();
+#else
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  entries_.clear();
+  offsets_.clear();
+  chunk_first_frame_.clear();
+  decoded_ = SIZE_MAX;
+}
+
+bool DepthRecordingReader::Index() {
+  const uint8_t *const end = data_ + size_;
+  std::vector<uint64_t> chunks;
+  // Use the index when the recording was closed properly.
+  if (size_ >= kHeaderSize + kTrailerSize && memcmp(end - 4, kEndMagic, 4) == 0) {
+    const uint8_t *p = end - kTrailerSize;
+    uint64_t index_offset = 0;
+    uint32_t count = 0;
+    Get(&p, end, &index_offset);
+    if (index_offset + 8 <= size_ - kTrailerSize && memcmp(data_ + index_offset, kIndexMagic, 4) == 0) {
+      p = data_ + index_offset + 4;
+      Get(&p, end, &count);
+      if (static_cast<uint64_t>(count) * kIndexEntrySize == size_ - kTrailerSize - index_offset - 8) {
+        for (uint32_t i = 0; i < count; i++) {
+          uint64_t offset = 0;
+          Get(&p, end, &offset);
+          p += kIndexEntrySize - sizeof(offset);
+          chunks.push_back(offset);
+        }
+      }
+    }
+  }
+  // Otherwise walk the complete chunks.
+  if (chunks.empty()) {
+    size_t offset = kHeaderSize;
+    while (size_ - offset >= kChunkHeaderSize && memcmp(data_ + offset, kChunkMagic, 4) == 0) {
+      const uint8_t *p = data_ + offset + 8;
+      uint64_t payload = 0;
+      Get(&p, end, &payload);
+      if (payload > size_ - offset - kChunkHeaderSize) {
+        break;
+      }
+      chunks.push_back(offset);
+      offset += kChunkHeaderSize + payload;
+    }
+  }
+
+  for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+    const uint64_t offset = chunks[chunk];
+    if (offset > size_ || size_ - offset < kChunkHeaderSize || memcmp(data_ + offset, kChunkMagic, 4) != 0) {
+      return false;
+    }
+    const uint8_t *p = data_ + offset + 4;
+    uint32_t frames = 0;
+    uint64_t payload = 0;
+    Get(&p, end, &frames);
+    Get(&p, end, &payload);
+    p = data_ + offset + kChunkHeaderSize;
+    if (payload > static_cast<uint64_t>(end - p)) {
+      return false;
+    }
+    const uint8_t *const chunk_end = p + payload;
+    chunk_first_frame_.push_back(entries_.size());
+    for (uint32_t i = 0; i < frames; i++) {
+      uint32_t record_size = 0;
+      DepthRecordingEntry entry;
+      uint32_t type = 0;
+      if (!Get(&p, chunk_end, &record_size) || record_size > static_cast<size_t>(chunk_end - p)) {
+        return false;
+      }
+      const uint8_t *record = p;
+      if (!Get(&record, chunk_end, &entry.frame_number) || !Get(&record, chunk_end, &entry.timestamp) ||
+          !Get(&record, chunk_end, &type)) {
+        return false;
+      }
+      entry.frame_type = static_cast<MLDepthCameraFrameType>(type);
+      entry.chunk = static_cast<uint32_t>(chunk);
+      entries_.push_back(entry);
+      offsets_.push_back(static_cast<size_t>(p - data_));
+      p += record_size;
+    }
+  }
+  return true;
+}
+
+size_t DepthRecordingReader::Seek(MLTime timestamp) const {
+  const auto it = std::lower_bound(entries_.begin(), entries_.end(), timestamp,
+                                   [](const DepthRecordingEntry &e, MLTime t) { return e.timestamp < t; });
+  return static_cast<size_t>(it - entries_.begin());
+}
+
+MLResult DepthRecordingReader::ReadFrame(size_t index, DepthRecordingFrame *out) {
+  if (out == nullptr || index >= entries_.size()) {
+    return MLResult_InvalidParam;
+  }
+  const size_t first = chunk_first_frame_[entries_[index].chunk];
+  size_t start = first;
+  if (decoded_ != SIZE_MAX && decoded_ >= first && decoded_ < index) {
+    start = decoded_ + 1;
+  } else {
+    for (size_t i = 0; i < kStreamCount * DepthRecordingImage_Count; i++) {
+      streams_[i].valid = false;
+    }
+  }
+  for (size_t i = start; i <= index; i++) {
+    if (!Decode(i, i == index ? out : nullptr)) {
+      decoded_ = SIZE_MAX;
+      return MLResult_UnspecifiedFailure;
+    }
+  }
+  decoded_ = index;
+  return MLResult_Ok;
+}
+
+bool DepthRecordingReader::Decode(size_t index, DepthRecordingFrame *out) {
+  const uint8_t *p = data_ + offsets_[index];
+  uint32_t record_size;
+  memcpy(&record_size, p - sizeof(record_size), sizeof(record_size));
+  const uint8_t *const end = p + record_size;
+
+  MLDepthCameraFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  uint32_t type = 0, mask = 0;
+  bool ok = Get(&p, end, &frame.frame_number) && Get(&p, end, &frame.frame_timestamp) && Get(&p, end, &type);
+  for (float &value : frame.camera_pose.rotation.values) ok = ok && Get(&p, end, &value);
+  ok = ok && Get(&p, end, &frame.camera_pose.position.x) && Get(&p, end, &frame.camera_pose.position.y) &&
+       Get(&p, end, &frame.camera_pose.position.z);
+  MLDepthCameraIntrinsics &intrinsics = frame.intrinsics;
+  ok = ok && Get(&p, end, &intrinsics.width) && Get(&p, end, &intrinsics.height) &&
+       Get(&p, end, &intrinsics.focal_length.x) && Get(&p, end, &intrinsics.focal_length.y) &&
+       Get(&p, end, &intrinsics.principal_point.x) && Get(&p, end, &intrinsics.principal_point.y) &&
+       Get(&p, end, &intrinsics.fov);
+  for (double &value : intrinsics.distortion) ok = ok && Get(&p, end, &value);
+  ok = ok && Get(&p, end, &mask);
+  if (!ok) {
+    return false;
+  }
+  frame.frame_type = static_cast<MLDepthCameraFrameType>(type);
+
+  for (int kind = 0; kind < DepthRecordingImage_Count; kind++) {
+    if ((mask & (1u << kind)) == 0) {
+      continue;
+    }
+    uint32_t width = 0, height = 0;
+    if (!Get(&p, end, &width) || !Get(&p, end, &height) || width > kMaxImageSide || height > kMaxImageSide) {
+      return false;
+    }
+    StreamState &state = streams_[StreamOf(frame.frame_type) * DepthRecordingImage_Count + kind];
+    const bool temporal = state.valid && state.width == width && state.height == height;
+    state.pixels.resize(static_cast<size_t>(width) * height);
+    state.width = width;
+    state.height = height;
+    state.valid = DecodeDepthImage(&p, end, width, height, temporal, ResidualOf(kind), state.pixels.data());
+    if (!state.valid) {
+      return false;
+    }
+    if (out != nullptr) {
+      out->pixels_[kind] = state.pixels;
+      MLDepthCameraFrameBuffer &buffer = out->buffers_[kind];
+      buffer.width = width;
+      buffer.height = height;
+      buffer.stride = width * sizeof(uint32_t);
+      buffer.bytes_per_unit = sizeof(uint32_t);
+      buffer.size = buffer.stride * height;
+      buffer.data = out->pixels_[kind].data();
+      FrameImage(frame, kind) = &buffer;
+    }
+  }
+  if (out != nullptr) {
+    out->frame_ = frame;
+  }
+  return true;
+}
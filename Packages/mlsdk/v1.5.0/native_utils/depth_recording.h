@@ -0,0 +1,271 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "depth_frame_ring.h"
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*!
+  \brief Depth recording file format.
+
+  A recording is a file header, a sequence of chunks, and an index:
+
+  - header: "MLDR", format version, frames per chunk;
+  - chunk: "MLDC", frame count, payload size, first and last timestamp,
+    then one record per frame: frame number, timestamp, type, camera pose,
+    intrinsics and the losslessly coded images (see depth_codec.h);
+  - index: "MLDI", one entry (offset, frame count, timestamps) per chunk,
+    followed by the index offset and "MLDE".
+
+  Images are predicted from the previous image of the same stream within a
+  chunk, so every chunk decodes on its own and is a seek point. A recording
+  cut short, e.g. by a crash, has no index; readers rebuild it by scanning
+  the complete chunks. Values are stored in host byte order, which is
+  little-endian on every supported target; big-endian hosts are rejected at
+  build time rather than writing recordings other hosts cannot read.
+*/
+
+/*! \brief Images a recording can hold, as bits of DepthRecorderSettings::images. */
+typedef enum DepthRecordingImage {
+  DepthRecordingImage_Depth = 1 << 0,
+  DepthRecordingImage_Confidence = 1 << 1,
+  DepthRecordingImage_Flags = 1 << 2,
+  DepthRecordingImage_AmbientRaw = 1 << 3,
+  DepthRecordingImage_Raw = 1 << 4,
+  DepthRecordingImage_All = 0x1f,
+  DepthRecordingImage_Count = 5
+} DepthRecordingImage;
+
+/*! \brief Settings of a DepthRecorder. */
+typedef struct DepthRecorderSettings {
+  /*! Frames per chunk, i.e. distance between seek points. */
+  uint32_t chunk_frames;
+  /*! Frames that may wait for the writer thread before Append() drops frames. */
+  uint32_t max_pending;
+  /*! #DepthRecordingImage bits of the images to record when present. */
+  uint32_t images;
+} DepthRecorderSettings;
+
+/*! \brief Initializes DepthRecorderSettings with default values. */
+inline void DepthRecorderSettingsInit(DepthRecorderSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->chunk_frames = 30;
+    inout_settings->max_pending = 8;
+    inout_settings->images = DepthRecordingImage_All;
+  }
+}
+
+/*! \brief Counters of a DepthRecorder. */
+typedef struct DepthRecorderStats {
+  /*! Frames written to the file. */
+  uint64_t frames;
+  /*! Frames dropped because the writer thread fell behind. */
+  uint64_t dropped;
+  /*! Image bytes before and after coding. */
+  uint64_t raw_bytes;
+  uint64_t coded_bytes;
+} DepthRecorderStats;
+
+/*!
+  \brief Appends depth camera frames to a recording from a background thread.
+
+  Append() only queues the frame; coding and file I/O happen on the
+  recorder's thread. Frames appended as DepthFrameView are coded straight
+  from the SDK buffers, which the view keeps alive until then; frames
+  appended as MLDepthCameraFrame are copied first. Images wider or taller
+  than 4096 pixels are not recorded.
+
+  Append() may be called from any thread.
+*/
+class DepthRecorder {
+public:
+  DepthRecorder();
+  /*! Closes the recording if it is open. */
+  ~DepthRecorder();
+
+  DepthRecorder(const DepthRecorder &) = delete;
+  DepthRecorder &operator=(const DepthRecorder &) = delete;
+
+  /*!
+    \brief Creates the file at `path` and starts the writer thread.
+
+    \retval MLResult_Ok The recording was started.
+    \retval MLResult_InvalidParam path is null or a recording is already open.
+    \retval MLResult_UnspecifiedFailure The file could not be created.
+  */
+  MLResult Open(const char *path, const DepthRecorderSettings &settings);
+
+  /*!
+    \brief Queues every frame of a view.
+
+    \retval MLResult_Ok The frames were queued.
+    \retval MLResult_InvalidParam The recorder is not open or the view is empty.
+    \retval MLResult_Timeout The queue is full; the frames were dropped.
+  */
+  MLResult Append(const DepthFrameView &view);
+
+  /*! Copies and queues one frame; see Append(const DepthFrameView &). */
+  MLResult Append(const MLDepthCameraFrame &frame);
+
+  /*!
+    \brief Writes the queued frames and the index, then closes the file.
+
+    \retval MLResult_Ok The recording is complete.
+    \retval MLResult_UnspecifiedFailure Writing to the file failed.
+  */
+  MLResult Close();
+
+  DepthRecorderStats stats() const;
+
+private:
+  struct Job;
+  struct StreamState;
+
+  MLResult Enqueue(std::unique_ptr<Job> job);
+  void Run();
+  void EncodeFrame(const MLDepthCameraFrame &frame);
+  void FlushChunk();
+
+  DepthRecorderSettings settings_ = {};
+  FILE *file_ = nullptr;
+  bool failed_ = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::unique_ptr<Job>> queue_;
+  bool closing_ = false;
+  std::thread thread_;
+  DepthRecorderStats stats_ = {};
+
+  // Writer thread state.
+  std::vector<uint8_t> chunk_;
+  uint32_t chunk_count_ = 0;
+  MLTime chunk_first_ = 0;
+  MLTime chunk_last_ = 0;
+  std::vector<uint8_t> index_;
+  uint32_t index_count_ = 0;
+  uint64_t offset_ = 0;
+  std::unique_ptr<StreamState[]> streams_;
+};
+
+/*!
+  \brief A frame decoded from a recording.
+
+  frame() points into buffers owned by this object; it stays valid until
+  the object is reused or destroyed.
+*/
+class DepthRecordingFrame {
+public:
+  DepthRecordingFrame();
+  DepthRecordingFrame(const DepthRecordingFrame &) = delete;
+  DepthRecordingFrame &operator=(const DepthRecordingFrame &) = delete;
+
+  const MLDepthCameraFrame &frame() const { return frame_; }
+
+private:
+  friend class DepthRecordingReader;
+
+  MLDepthCameraFrame frame_;
+  MLDepthCameraFrameBuffer buffers_[DepthRecordingImage_Count];
+  std::vector<uint32_t> pixels_[DepthRecordingImage_Count];
+};
+
+/*! \brief Per-frame metadata available without decoding. */
+typedef struct DepthRecordingEntry {
+  int64_t frame_number;
+  MLTime timestamp;
+  MLDepthCameraFrameType frame_type;
+  /*! Chunk holding the frame. */
+  uint32_t chunk;
+} DepthRecordingEntry;
+
+/*!
+  \brief Reads a recording through a memory mapping.
+
+  Sequential reads decode each frame once; random access decodes from the
+  start of the frame's chunk. Not thread safe.
+*/
+class DepthRecordingReader {
+public:
+  DepthRecordingReader();
+  ~DepthRecordingReader();
+
+  DepthRecordingReader(const DepthRecordingReader &) = delete;
+  DepthRecordingReader &operator=(const DepthRecordingReader &) = delete;
+
+  /*!
+    \brief Maps the recording at `path` and indexes its frames.
+
+    \retval MLResult_Ok The recording can be read.
+    \retval MLResult_InvalidParam The file is not a depth recording.
+    \retval MLResult_UnspecifiedFailure The file could not be opened.
+  */
+  MLResult Open(const char *path);
+
+  void Close();
+
+  size_t frame_count() const { return entries_.size(); }
+  const DepthRecordingEntry &entry(size_t index) const { return entries_[index]; }
+
+  /*!
+    \brief Index of the first frame at or after `timestamp`, or
+           frame_count() when there is none. Assumes frames were appended in
+           timestamp order.
+  */
+  size_t Seek(MLTime timestamp) const;
+
+  /*!
+    \brief Decodes frame `index` into `out`.
+
+    \retval MLResult_Ok out holds the frame.
+    \retval MLResult_InvalidParam index is out of range or out is null.
+    \retval MLResult_UnspecifiedFailure The recording is corrupt.
+  */
+  MLResult ReadFrame(size_t index, DepthRecordingFrame *out);
+
+private:
+  struct StreamState;
+
+  bool Index();
+  bool Decode(size_t index, DepthRecordingFrame *out);
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  std::vector<uint8_t> file_data_;
+#endif
+  std::vector<DepthRecordingEntry> entries_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> chunk_first_frame_;
+  std::unique_ptr<StreamState[]> streams_;
+  size_t decoded_ = SIZE_MAX;
+};
+
+/*! \} */
@@ -0,0 +1,242 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_rgb_registration.h"
+
+#include "ml_cv_camera.h"
+
+#include "depth_projection.h"
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using native_utils::DistortedProjection;
+using native_utils::Float8;
+using native_utils::RotationMatrix;
+using native_utils::Undistort;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+constexpr uint32_t kMaxSplatSize = 8;
+
+}  // namespace
+
+DepthRgbRegistration::DepthRgbRegistration(const DepthRgbRegistrationSettings &settings)
+    : settings_(settings), unprojector_(2, settings.opengl_axes) {
+  clouds_.resize(std::max<uint32_t>(settings.history, 1));
+  Reset();
+}
+
+void DepthRgbRegistration::Reset() {
+  for (Cloud &cloud : clouds_) {
+    cloud.x.clear();
+    cloud.y.clear();
+    cloud.z.clear();
+    cloud.timestamp = 0;
+  }
+  next_cloud_ = 0;
+}
+
+MLResult DepthRgbRegistration::AddDepth(const MLDepthCameraData &data) {
+  if (data.frame_count > 0 && data.frames == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  for (uint8_t i = 0; i < data.frame_count; i++) {
+    const MLResult result = AddDepth(data.frames[i]);
+    if (result != MLResult_Ok) {
+      return result;
+    }
+  }
+  return MLResult_Ok;
+}
+
+MLResult DepthRgbRegistration::AddDepth(const MLDepthCameraFrame &frame) {
+  if (frame.depth_image == nullptr || frame.depth_image->width != frame.intrinsics.width ||
+      frame.depth_image->height != frame.intrinsics.height) {
+    return MLResult_InvalidParam;
+  }
+  const size_t count = static_cast<size_t>(frame.intrinsics.width) * frame.intrinsics.height;
+  DepthMaskSettings mask = settings_.mask;
+  mask.invalid_depth = std::numeric_limits<float>::quiet_NaN();
+  masked_.resize(count);
+  MLResult result = MaskDepth(frame, mask, masked_.data(), nullptr, nullptr);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  MLDepthCameraDepthImage masked = *frame.depth_image;
+  masked.stride = masked.width * sizeof(float);
+  masked.size = static_cast<uint32_t>(count * sizeof(float));
+  masked.data = masked_.data();
+
+  Cloud &cloud = clouds_[next_cloud_];
+  cloud.x.resize(count + kLanes);
+  cloud.y.resize(count + kLanes);
+  cloud.z.resize(count + kLanes);
+  const MLPointBatch points = {cloud.x.data(), cloud.y.data(), cloud.z.data()};
+  result = unprojector_.Unproject(masked, frame.intrinsics, &frame.camera_pose, points);
+  if (result != MLResult_Ok) {
+    cloud.x.clear();
+    return result;
+  }
+
+  // Keep the valid points, then pad to whole vectors with points that never project.
+  size_t kept = 0;
+  for (size_t i = 0; i < count; i++) {
+    cloud.x[kept] = cloud.x[i];
+    cloud.y[kept] = cloud.y[i];
+    cloud.z[kept] = cloud.z[i];
+    kept += cloud.x[i] == cloud.x[i];
+  }
+  const size_t padded = (kept + kLanes - 1) / kLanes * kLanes;
+  std::fill(cloud.x.begin() + kept, cloud.x.begin() + padded, std::numeric_limits<float>::quiet_NaN());
+  cloud.x.resize(padded);
+  cloud.y.resize(padded);
+  cloud.z.resize(padded);
+  cloud.timestamp = frame.frame_timestamp;
+  cloud.focal_length = static_cast<float>(frame.intrinsics.focal_length.x);
+  next_cloud_ = (next_cloud_ + 1) % clouds_.size();
+  return MLResult_Ok;
+}
+
+MLResult DepthRgbRegistration::Register(const MLCameraResultExtras &extras, MLHandle cv_camera, MLHandle head) {
+  if (extras.intrinsics == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  MLTransform color_pose;
+  const MLResult result =
+      MLCVCameraGetFramePose(cv_camera, head, MLCVCameraID_ColorCamera, extras.vcam_timestamp, &color_pose);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  return Register(*extras.intrinsics, extras.vcam_timestamp, color_pose);
+}
+
+MLResult DepthRgbRegistration::Register(const MLCameraIntrinsicCalibrationParameters &color_intrinsics,
+                                        MLTime color_timestamp, const MLTransform &color_pose) {
+  // Intrinsics of the registered image: the color intrinsics scaled about
+  // the pixel corner, with the same distortion.
+  const float scale = settings_.scale;
+  MLDepthCameraIntrinsics intrinsics = {};
+  intrinsics.width = static_cast<uint32_t>(std::lround(color_intrinsics.width * scale));
+  intrinsics.height = static_cast<uint32_t>(std::lround(color_intrinsics.height * scale));
+  intrinsics.focal_length.x = color_intrinsics.focal_length.x * scale;
+  intrinsics.focal_length.y = color_intrinsics.focal_length.y * scale;
+  intrinsics.principal_point.x = (color_intrinsics.principal_point.x + 0.5f) * scale - 0.5f;
+  intrinsics.principal_point.y = (color_intrinsics.principal_point.y + 0.5f) * scale - 0.5f;
+  intrinsics.fov = color_intrinsics.fov;
+  memcpy(intrinsics.distortion, color_intrinsics.distortion, sizeof(intrinsics.distortion));
+  if (!(scale > 0.0f) || intrinsics.width == 0 || intrinsics.height == 0) {
+    return MLResult_InvalidParam;
+  }
+
+  const Cloud *cloud = nullptr;
+  MLTime best = settings_.max_time_offset_ns;
+  for (const Cloud &candidate : clouds_) {
+    const MLTime offset = candidate.timestamp - color_timestamp;
+    if (!candidate.x.empty() && std::max(offset, -offset) <= best) {
+      cloud = &candidate;
+      best = std::max(offset, -offset);
+    }
+  }
+  if (cloud == nullptr) {
+    return MLResult_InvalidTimestamp;
+  }
+
+  const uint32_t width = intrinsics.width, height = intrinsics.height;
+  const size_t count = static_cast<size_t>(width) * height;
+  pixels_.assign(count, std::numeric_limits<float>::infinity());
+
+  // The field of view comes from undistorting the corners alone: a ray
+  // table at color resolution would cost more than the registration.
+  float max_r2 = 0.0f;
+  for (uint32_t v : {0u, height - 1}) {
+    for (uint32_t u : {0u, width - 1}) {
+      double x, y;
+      Undistort(intrinsics, (u - intrinsics.principal_point.x) / intrinsics.focal_length.x,
+                (v - intrinsics.principal_point.y) / intrinsics.focal_length.y, &x, &y);
+      max_r2 = std::max(max_r2, static_cast<float>(x * x + y * y));
+    }
+  }
+
+  float rotation[3][3];
+  RotationMatrix(color_pose.rotation, rotation);
+  const float sign = settings_.color_opengl_axes ? -1.0f : 1.0f;
+  Float8 r[3][3];
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      // Transposed, with the pinhole axes folded in.
+      r[col][row] = Float8(rotation[row][col] * (col == 0 ? 1.0f : sign));
+    }
+  }
+  const Float8 tx(color_pose.position.x), ty(color_pose.position.y), tz(color_pose.position.z);
+  uint32_t splat_size = settings_.splat_size;
+  if (splat_size == 0) {
+    // The spacing of neighbouring depth points on the registered image, plus
+    // one pixel for the parallax between the cameras.
+    splat_size = static_cast<uint32_t>(std::ceil(intrinsics.focal_length.x / cloud->focal_length)) + 1;
+    splat_size = std::min(std::max(splat_size, 1u), kMaxSplatSize);
+  }
+  const int splat = static_cast<int>(splat_size);
+  // Projects to the top-left pixel of the splat.
+  const DistortedProjection projection(intrinsics, max_r2, 1.0f - 0.5f * splat);
+  const Float8 min_u(static_cast<float>(1 - splat)), min_v(static_cast<float>(1 - splat));
+  const Float8 max_u(static_cast<float>(width - 1)), max_v(static_cast<float>(height - 1));
+  alignas(32) float us[kLanes], vs[kLanes], ds[kLanes];
+
+  for (size_t i = 0; i < cloud->x.size(); i += kLanes) {
+    const Float8 dx = Float8::Load(&cloud->x[i]) - tx, dy = Float8::Load(&cloud->y[i]) - ty;
+    const Float8 dz = Float8::Load(&cloud->z[i]) - tz;
+    const Float8 x = MulAdd(dx, r[0][0], MulAdd(dy, r[0][1], dz * r[0][2]));
+    const Float8 y = MulAdd(dx, r[1][0], MulAdd(dy, r[1][1], dz * r[1][2]));
+    const Float8 z = MulAdd(dx, r[2][0], MulAdd(dy, r[2][1], dz * r[2][2]));
+    Float8 u, v;
+    const Float8 visible = projection.Project(x, y, z, &u, &v);
+    const int inside = (visible & (u >= min_u) & (u <= max_u) & (v >= min_v) & (v <= max_v)).MoveMask();
+    if (inside == 0) {
+      continue;
+    }
+    u.Store(us);
+    v.Store(vs);
+    Sqrt(MulAdd(x, x, MulAdd(y, y, z * z))).Store(ds);
+    for (int lane = 0; lane < kLanes; lane++) {
+      if (((inside >> lane) & 1) == 0) {
+        continue;
+      }
+      const int u0 = static_cast<int>(us[lane]), v0 = static_cast<int>(vs[lane]);
+      for (int sv = std::max(v0, 0); sv < std::min(v0 + splat, static_cast<int>(height)); sv++) {
+        float *row = &pixels_[static_cast<size_t>(sv) * width];
+        for (int su = std::max(u0, 0); su < std::min(u0 + splat, static_cast<int>(width)); su++) {
+          row[su] = std::min(row[su], ds[lane]);
+        }
+      }
+    }
+  }
+
+  const float invalid = settings_.mask.invalid_depth;
+  for (float &depth : pixels_) {
+    depth = depth < std::numeric_limits<float>::infinity() ? depth : invalid;
+  }
+  intrinsics_ = intrinsics;
+  image_.width = width;
+  image_.height = height;
+  image_.stride = width * sizeof(float);
+  image_.bytes_per_unit = sizeof(float);
+  image_.size = image_.stride * height;
+  image_.data = pixels_.data();
+  depth_timestamp_ = cloud->timestamp;
+  return MLResult_Ok;
+}
@@ -0,0 +1,166 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_camera_v2.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include "depth_mask.h"
+#include "depth_unprojector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Parameters of a DepthRgbRegistration. */
+typedef struct DepthRgbRegistrationSettings {
+  /*! Depth pixels to register; invalid_depth is written where no depth lands. */
+  DepthMaskSettings mask;
+  /*! Size of the registered image relative to the color image, e.g. 0.5 for half size. */
+  float scale;
+  /*!
+    \brief Each depth point covers splat_size x splat_size registered pixels;
+           0 derives it from the ratio of the focal lengths.
+  */
+  uint32_t splat_size;
+  /*! Number of recent depth frames kept for matching color timestamps. */
+  uint32_t history;
+  /*! Depth frames further than this from the color timestamp are not used. */
+  MLTime max_time_offset_ns;
+  /*! Whether depth camera poses follow the OpenGL camera convention, see DepthUnprojector. */
+  bool opengl_axes;
+  /*! Whether color camera poses follow the OpenGL camera convention. */
+  bool color_opengl_axes;
+} DepthRgbRegistrationSettings;
+
+/*!
+  \brief Initializes DepthRgbRegistrationSettings for full-size registered
+         images from depth frames up to 100 ms away, enough to always match
+         the 5 fps long-range stream.
+*/
+inline void DepthRgbRegistrationSettingsInit(DepthRgbRegistrationSettings *inout_settings) {
+  if (inout_settings) {
+    DepthMaskSettingsInit(&inout_settings->mask);
+    inout_settings->scale = 1.0f;
+    inout_settings->splat_size = 0;
+    inout_settings->history = 4;
+    inout_settings->max_time_offset_ns = 100000000;
+    inout_settings->opengl_axes = false;
+    inout_settings->color_opengl_axes = false;
+  }
+}
+
+/*!
+  \brief Registers depth frames to the image plane of the main (color) camera.
+
+  AddDepth() turns each depth frame into a world-space point cloud with its
+  camera pose, once per frame, and keeps the last `history` clouds. For a
+  color frame, Register() picks the cloud whose timestamp is nearest to the
+  frame's vcam_timestamp and projects it into the color camera's pose and
+  intrinsics, eight points at a time with a z-buffer. The result is a depth
+  image aligned pixel for pixel with the MLCameraOutput frame (scaled by
+  `scale`), holding the radial distance from the color camera.
+
+  The color pose at vcam_timestamp comes from MLCVCameraGetFramePose(), which
+  looks it up in the head tracking history; depth frames carry their own
+  pose. As both meet in world space, head motion between the two
+  timestamps is compensated, assuming a static scene.
+
+  The registered image is exposed as an MLDepthCameraDepthImage with
+  matching MLDepthCameraIntrinsics, so it can be passed straight to
+  DepthUnprojector and the other helpers.
+
+  Not thread safe. MLCameraResultExtras::intrinsics is only valid inside the
+  capture callback, so call Register() from there or copy the intrinsics.
+*/
+class DepthRgbRegistration {
+public:
+  explicit DepthRgbRegistration(const DepthRgbRegistrationSettings &settings);
+
+  /*!
+    \brief Keeps `frame` for registration, replacing the oldest kept frame.
+
+    \retval MLResult_Ok The frame was added.
+    \retval MLResult_InvalidParam The frame's buffers are invalid.
+  */
+  MLResult AddDepth(const MLDepthCameraFrame &frame);
+
+  /*! Adds every frame of `data`; see AddDepth(const MLDepthCameraFrame &). */
+  MLResult AddDepth(const MLDepthCameraData &data);
+
+  /*!
+    \brief Registers the depth frame nearest to `color_timestamp`.
+
+    \param[in] color_intrinsics Intrinsics of the color frame.
+    \param[in] color_timestamp MLCameraResultExtras::vcam_timestamp of the color frame.
+    \param[in] color_pose Transform from the color camera to the world.
+
+    \retval MLResult_Ok image() holds the registered depth.
+    \retval MLResult_InvalidParam The intrinsics or scale give an empty image.
+    \retval MLResult_InvalidTimestamp No depth frame is within max_time_offset_ns.
+  */
+  MLResult Register(const MLCameraIntrinsicCalibrationParameters &color_intrinsics, MLTime color_timestamp,
+                    const MLTransform &color_pose);
+
+  /*!
+    \brief Registers a frame delivered to an ml_camera_v2.h capture callback,
+           looking up the color pose with MLCVCameraGetFramePose().
+
+    \param[in] extras Extras of the capture callback, with intrinsics.
+    \param[in] cv_camera Handle from MLCVCameraTrackingCreate().
+    \param[in] head Handle from MLHeadTrackingCreate().
+
+    \retval MLResult_InvalidParam extras has no intrinsics.
+    \return Otherwise the failure of MLCVCameraGetFramePose(), or see the
+            overload above.
+  */
+  MLResult Register(const MLCameraResultExtras &extras, MLHandle cv_camera, MLHandle head);
+
+  /*! Forgets every kept depth frame. */
+  void Reset();
+
+  /*! Depth registered by the last successful Register(); valid until the next one. */
+  const MLDepthCameraDepthImage &image() const { return image_; }
+  const MLDepthCameraIntrinsics &intrinsics() const { return intrinsics_; }
+  /*! Timestamp of the depth frame used by the last successful Register(). */
+  MLTime depth_timestamp() const { return depth_timestamp_; }
+
+private:
+  // Valid points of one depth frame in world space, padded to whole vectors with NaN.
+  struct Cloud {
+    std::vector<float> x, y, z;
+    MLTime timestamp;
+    float focal_length;
+  };
+
+  DepthRgbRegistrationSettings settings_;
+  DepthUnprojector unprojector_;
+  std::vector<float> masked_;
+  std::vector<Cloud> clouds_;
+  size_t next_cloud_ = 0;
+
+  std::vector<float> pixels_;
+  MLDepthCameraDepthImage image_ = {};
+  MLDepthCameraIntrinsics intrinsics_ = {};
+  MLTime depth_timestamp_ = 0;
+};
+
+/*! \} */
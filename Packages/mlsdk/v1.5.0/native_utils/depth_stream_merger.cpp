@@ -0,0 +1,191 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_stream_merger.h"
+
+#include "depth_projection.h"
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using native_utils::DistortedProjection;
+using native_utils::Float8;
+using native_utils::FieldOfViewRadius2;
+using native_utils::RotationMatrix;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+
+bool MatchesIntrinsics(const MLDepthCameraFrame &frame) {
+  return frame.depth_image != nullptr && frame.depth_image->width == frame.intrinsics.width &&
+         frame.depth_image->height == frame.intrinsics.height;
+}
+
+}  // namespace
+
+DepthStreamMerger::DepthStreamMerger(const DepthStreamMergerSettings &settings)
+    : settings_(settings), unprojector_(2, settings.opengl_axes) {
+  settings_.long_range.invalid_depth = std::numeric_limits<float>::quiet_NaN();
+  settings_.splat_size = std::max<uint32_t>(settings_.splat_size, 1);
+}
+
+void DepthStreamMerger::Reset() {
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  long_range_timestamp_ = 0;
+}
+
+MLResult DepthStreamMerger::SetLongRange(const MLDepthCameraFrame &frame) {
+  if (frame.frame_type != MLDepthCameraFrameType_LongRange || !MatchesIntrinsics(frame)) {
+    return MLResult_InvalidParam;
+  }
+  const size_t count = static_cast<size_t>(frame.intrinsics.width) * frame.intrinsics.height;
+  masked_.resize(count);
+  MLResult result = MaskDepth(frame, settings_.long_range, masked_.data(), nullptr, nullptr);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  MLDepthCameraDepthImage masked = *frame.depth_image;
+  masked.stride = masked.width * sizeof(float);
+  masked.size = static_cast<uint32_t>(count * sizeof(float));
+  masked.data = masked_.data();
+  x_.resize(count + kLanes);
+  y_.resize(count + kLanes);
+  z_.resize(count + kLanes);
+  const MLPointBatch points = {x_.data(), y_.data(), z_.data()};
+  result = unprojector_.Unproject(masked, frame.intrinsics, &frame.camera_pose, points);
+  if (result != MLResult_Ok) {
+    Reset();
+    return result;
+  }
+
+  // Keep the valid points, then pad to whole vectors with points that never project.
+  size_t kept = 0;
+  for (size_t i = 0; i < count; i++) {
+    x_[kept] = x_[i];
+    y_[kept] = y_[i];
+    z_[kept] = z_[i];
+    kept += x_[i] == x_[i];
+  }
+  const size_t padded = (kept + kLanes - 1) / kLanes * kLanes;
+  std::fill(x_.begin() + kept, x_.begin() + padded, std::numeric_limits<float>::quiet_NaN());
+  x_.resize(padded);
+  y_.resize(padded);
+  z_.resize(padded);
+  long_range_timestamp_ = frame.frame_timestamp;
+  return MLResult_Ok;
+}
+
+MLResult DepthStreamMerger::Merge(const MLDepthCameraData &data, float *out_depth, uint8_t *out_source) {
+  if (data.frame_count > 0 && data.frames == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const MLDepthCameraFrame *short_range = nullptr;
+  for (uint8_t i = 0; i < data.frame_count; i++) {
+    if (data.frames[i].frame_type == MLDepthCameraFrameType_ShortRange) {
+      short_range = &data.frames[i];
+      continue;
+    }
+    const MLResult result = SetLongRange(data.frames[i]);
+    if (result != MLResult_Ok) {
+      return result;
+    }
+  }
+  return short_range != nullptr ? Merge(*short_range, out_depth, out_source) : MLResult_Pending;
+}
+
+MLResult DepthStreamMerger::Merge(const MLDepthCameraFrame &frame, float *out_depth, uint8_t *out_source) {
+  if (frame.frame_type != MLDepthCameraFrameType_ShortRange || !MatchesIntrinsics(frame) || out_depth == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const MLDepthCameraIntrinsics &intrinsics = frame.intrinsics;
+  const uint32_t width = intrinsics.width, height = intrinsics.height;
+  const size_t count = static_cast<size_t>(width) * height;
+  DepthMaskSettings mask = settings_.short_range;
+  mask.invalid_depth = std::numeric_limits<float>::quiet_NaN();
+  masked_.resize(count);
+  const MLResult result = MaskDepth(frame, mask, masked_.data(), nullptr, nullptr);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+
+  const MLTime age = frame.frame_timestamp - long_range_timestamp_;
+  const bool warp = !x_.empty() && std::max(age, -age) <= settings_.max_long_range_age_ns;
+  warped_.assign(count, std::numeric_limits<float>::infinity());
+  if (warp) {
+    float rotation[3][3];
+    RotationMatrix(frame.camera_pose.rotation, rotation);
+    const float sign = settings_.opengl_axes ? -1.0f : 1.0f;
+    Float8 r[3][3];
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 3; col++) {
+        // Transposed, with the pinhole axes folded in.
+        r[col][row] = Float8(rotation[row][col] * (col == 0 ? 1.0f : sign));
+      }
+    }
+    const Float8 tx(frame.camera_pose.position.x), ty(frame.camera_pose.position.y);
+    const Float8 tz(frame.camera_pose.position.z);
+    const int splat = static_cast<int>(settings_.splat_size);
+    // Projects to the top-left pixel of the splat.
+    const DistortedProjection projection(intrinsics, FieldOfViewRadius2(unprojector_.Rays(intrinsics), width, height),
+                                         1.0f - 0.5f * splat);
+    const Float8 min_u(static_cast<float>(1 - splat)), min_v(static_cast<float>(1 - splat));
+    const Float8 max_u(static_cast<float>(width - 1)), max_v(static_cast<float>(height - 1));
+    alignas(32) float us[kLanes], vs[kLanes], ds[kLanes];
+
+    for (size_t i = 0; i < x_.size(); i += kLanes) {
+      const Float8 dx = Float8::Load(&x_[i]) - tx, dy = Float8::Load(&y_[i]) - ty, dz = Float8::Load(&z_[i]) - tz;
+      const Float8 x = MulAdd(dx, r[0][0], MulAdd(dy, r[0][1], dz * r[0][2]));
+      const Float8 y = MulAdd(dx, r[1][0], MulAdd(dy, r[1][1], dz * r[1][2]));
+      const Float8 z = MulAdd(dx, r[2][0], MulAdd(dy, r[2][1], dz * r[2][2]));
+      Float8 u, v;
+      const Float8 visible = projection.Project(x, y, z, &u, &v);
+      const int inside = (visible & (u >= min_u) & (u <= max_u) & (v >= min_v) & (v <= max_v)).MoveMask();
+      if (inside == 0) {
+        continue;
+      }
+      u.Store(us);
+      v.Store(vs);
+      Sqrt(MulAdd(x, x, MulAdd(y, y, z * z))).Store(ds);
+      for (int lane = 0; lane < kLanes; lane++) {
+        if (((inside >> lane) & 1) == 0) {
+          continue;
+        }
+        const int u0 = static_cast<int>(us[lane]), v0 = static_cast<int>(vs[lane]);
+        for (int sv = std::max(v0, 0); sv < std::min(v0 + splat, static_cast<int>(height)); sv++) {
+          float *row = &warped_[static_cast<size_t>(sv) * width];
+          for (int su = std::max(u0, 0); su < std::min(u0 + splat, static_cast<int>(width)); su++) {
+            row[su] = std::min(row[su], ds[lane]);
+          }
+        }
+      }
+    }
+  }
+
+  const float invalid = settings_.short_range.invalid_depth;
+  for (size_t i = 0; i < count; i++) {
+    const float near = masked_[i], far = warped_[i];
+    const bool has_near = near == near, has_far = far < std::numeric_limits<float>::infinity();
+    out_depth[i] = has_near ? near : has_far ? far : invalid;
+    if (out_source != nullptr) {
+      out_source[i] = static_cast<uint8_t>(has_near ? DepthSource_ShortRange
+                                                    : has_far ? DepthSource_LongRange : DepthSource_None);
+    }
+  }
+  return MLResult_Ok;
+}
@@ -0,0 +1,142 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include "depth_mask.h"
+#include "depth_unprojector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Stream a merged depth pixel came from. */
+typedef enum DepthSource {
+  /*! Neither stream observed the pixel; its depth is the short-range invalid_depth. */
+  DepthSource_None = 0,
+  DepthSource_ShortRange = 1,
+  /*! Warped from the latest long-range frame. */
+  DepthSource_LongRange = 2,
+  DepthSource_Ensure8Bits = 0x7F
+} DepthSource;
+
+/*! \brief Parameters of a DepthStreamMerger. */
+typedef struct DepthStreamMergerSettings {
+  /*! Short-range pixels to keep; invalid_depth is written where neither stream has depth. */
+  DepthMaskSettings short_range;
+  /*! Long-range pixels to warp; invalid_depth is ignored. */
+  DepthMaskSettings long_range;
+  /*! Long-range frames older than this, relative to the short-range frame, are not used. */
+  MLTime max_long_range_age_ns;
+  /*! Each warped point covers splat_size x splat_size pixels, closing cracks between points. */
+  uint32_t splat_size;
+  /*! Whether camera poses follow the OpenGL camera convention, see DepthUnprojector. */
+  bool opengl_axes;
+} DepthStreamMergerSettings;
+
+/*!
+  \brief Initializes DepthStreamMergerSettings to use long-range frames up
+         to 400 ms old with 2 x 2 splats.
+*/
+inline void DepthStreamMergerSettingsInit(DepthStreamMergerSettings *inout_settings) {
+  if (inout_settings) {
+    DepthMaskSettingsInit(&inout_settings->short_range);
+    DepthMaskSettingsInit(&inout_settings->long_range);
+    inout_settings->max_long_range_age_ns = 400000000;
+    inout_settings->splat_size = 2;
+    inout_settings->opengl_axes = false;
+  }
+}
+
+/*!
+  \brief Fills the gaps of each short-range frame with the latest long-range
+         frame, seen from the short-range camera.
+
+  The short-range stream runs at up to 60 fps but only reaches about a
+  meter; the long-range stream reaches further at 5 fps. The merger keeps
+  the latest long-range frame as a world-space point cloud, built once per
+  long-range frame. Every short-range frame then projects that cloud into
+  its own pose and intrinsics, eight points at a time with a z-buffer, and
+  uses the warped depth wherever its own pixel was masked out. Each output
+  pixel is tagged with the stream it came from.
+
+  Warping assumes the scene is static between the two frames.
+
+  Not thread safe.
+*/
+class DepthStreamMerger {
+public:
+  explicit DepthStreamMerger(const DepthStreamMergerSettings &settings);
+
+  /*!
+    \brief Replaces the long-range frame used for merging.
+
+    \retval MLResult_Ok The frame will be used by the next Merge() calls.
+    \retval MLResult_InvalidParam The frame is not a long-range frame or
+            its buffers are invalid.
+  */
+  MLResult SetLongRange(const MLDepthCameraFrame &frame);
+
+  /*!
+    \brief Merges a short-range frame with the latest long-range frame.
+
+    \param[in] frame Short-range frame.
+    \param[out] out_depth Merged radial depth, width * height floats
+                matching the short-range depth image.
+    \param[out] out_source Optional #DepthSource per pixel, width * height bytes.
+
+    \retval MLResult_Ok The outputs were written.
+    \retval MLResult_InvalidParam The frame is not a short-range frame,
+            its buffers are invalid, or out_depth is null.
+  */
+  MLResult Merge(const MLDepthCameraFrame &frame, float *out_depth, uint8_t *out_source);
+
+  /*!
+    \brief Feeds every long-range frame of `data` and merges its short-range
+           frame, if any.
+
+    \retval MLResult_Ok A short-range frame was merged.
+    \retval MLResult_Pending `data` holds no short-range frame; the outputs
+            were not written.
+    \retval MLResult_InvalidParam See SetLongRange() and Merge().
+  */
+  MLResult Merge(const MLDepthCameraData &data, float *out_depth, uint8_t *out_source);
+
+  /*! Forgets the long-range frame. */
+  void Reset();
+
+  /*! Timestamp of the long-range frame in use, or 0 when there is none. */
+  MLTime long_range_timestamp() const { return long_range_timestamp_; }
+
+private:
+  DepthStreamMergerSettings settings_;
+  DepthUnprojector unprojector_;
+
+  // Valid long-range points in world space, padded to whole vectors with NaN.
+  std::vector<float> x_, y_, z_;
+  MLTime long_range_timestamp_ = 0;
+
+  std::vector<float> masked_;
+  std::vector<float> warped_;
+};
+
+/*! \} */
@@ -0,0 +1,181 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_unprojector.h"
+
+#include "depth_projection.h"
+#include "simd_float8.h"
+
+#include <cmath>
+#include <cstring>
+
+using native_utils::Float8;
+using native_utils::Undistort;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+
+bool SameIntrinsics(const MLDepthCameraIntrinsics &a, const MLDepthCameraIntrinsics &b) {
+  if (a.width != b.width || a.height != b.height || a.focal_length.x != b.focal_length.x ||
+      a.focal_length.y != b.focal_length.y || a.principal_point.x != b.principal_point.x ||
+      a.principal_point.y != b.principal_point.y) {
+    return false;
+  }
+  return memcmp(a.distortion, b.distortion, sizeof(a.distortion)) == 0;
+}
+
+}  // namespace
+
+DepthUnprojector::DepthUnprojector(size_t max_cached_rays, bool opengl_axes)
+    : max_tables_(max_cached_rays > 0 ? max_cached_rays : 1), opengl_axes_(opengl_axes) {}
+
+DepthUnprojector::RayTable &DepthUnprojector::Table(const MLDepthCameraIntrinsics &intrinsics) {
+  clock_++;
+  for (RayTable &table : tables_) {
+    if (SameIntrinsics(table.intrinsics, intrinsics)) {
+      table.last_used = clock_;
+      return table;
+    }
+  }
+  RayTable *table;
+  if (tables_.size() < max_tables_) {
+    tables_.emplace_back();
+    table = &tables_.back();
+  } else {
+    table = &tables_[0];
+    for (RayTable &candidate : tables_) {
+      if (candidate.last_used < table->last_used) {
+        table = &candidate;
+      }
+    }
+  }
+  table->intrinsics = intrinsics;
+  table->last_used = clock_;
+  const size_t count = static_cast<size_t>(intrinsics.width) * intrinsics.height;
+  table->x.resize(count);
+  table->y.resize(count);
+  table->z.resize(count);
+  const double fx = intrinsics.focal_length.x, fy = intrinsics.focal_length.y;
+  const double cx = intrinsics.principal_point.x, cy = intrinsics.principal_point.y;
+  const double sign = opengl_axes_ ? -1.0 : 1.0;
+  size_t i = 0;
+  for (uint32_t v = 0; v < intrinsics.height; v++) {
+    for (uint32_t u = 0; u < intrinsics.width; u++, i++) {
+      double x, y;
+      Undistort(intrinsics, (u - cx) / fx, (v - cy) / fy, &x, &y);
+      const double inv_norm = 1.0 / std::sqrt(x * x + y * y + 1.0);
+      table->x[i] = static_cast<float>(x * inv_norm);
+      table->y[i] = static_cast<float>(sign * y * inv_norm);
+      table->z[i] = static_cast<float>(sign * inv_norm);
+    }
+  }
+  return *table;
+}
+
+MLPointBatch DepthUnprojector::Rays(const MLDepthCameraIntrinsics &intrinsics) {
+  RayTable &table = Table(intrinsics);
+  MLPointBatch rays = {table.x.data(), table.y.data(), table.z.data()};
+  return rays;
+}
+
+MLResult DepthUnprojector::Unproject(const MLDepthCameraFrame &frame, const MLPointBatch &out, float min_depth,
+                                     float max_depth) {
+  if (frame.depth_image == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  return Unproject(*frame.depth_image, frame.intrinsics, &frame.camera_pose, out, min_depth, max_depth);
+}
+
+MLResult DepthUnprojector::Unproject(const MLDepthCameraDepthImage &depth, const MLDepthCameraIntrinsics &intrinsics,
+                                     const MLTransform *camera_pose, const MLPointBatch &out, float min_depth,
+                                     float max_depth) {
+  if (depth.data == nullptr || depth.bytes_per_unit != sizeof(float) || depth.width != intrinsics.width ||
+      depth.height != intrinsics.height || depth.stride < depth.width * sizeof(float) || out.x == nullptr ||
+      out.y == nullptr || out.z == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const RayTable &table = Table(intrinsics);
+
+  // Rotation matrix and translation of the camera pose.
+  float m[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  float t[3] = {0, 0, 0};
+  if (camera_pose != nullptr) {
+    const float x = camera_pose->rotation.x, y = camera_pose->rotation.y;
+    const float z = camera_pose->rotation.z, w = camera_pose->rotation.w;
+    const float r[3][3] = {{1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w)},
+                           {2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w)},
+                           {2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y)}};
+    memcpy(m, r, sizeof(m));
+    t[0] = camera_pose->position.x;
+    t[1] = camera_pose->position.y;
+    t[2] = camera_pose->position.z;
+  }
+  const Float8 m00(m[0][0]), m01(m[0][1]), m02(m[0][2]);
+  const Float8 m10(m[1][0]), m11(m[1][1]), m12(m[1][2]);
+  const Float8 m20(m[2][0]), m21(m[2][1]), m22(m[2][2]);
+  const Float8 tx(t[0]), ty(t[1]), tz(t[2]);
+  const Float8 lo(min_depth), hi(max_depth);
+  const Float8 nan(std::numeric_limits<float>::quiet_NaN());
+
+  const uint32_t width = depth.width;
+  const uint32_t full = width - width % kLanes;
+  alignas(32) float tail[4][kLanes];
+  for (uint32_t v = 0; v < depth.height; v++) {
+    const float *row = reinterpret_cast<const float *>(static_cast<const uint8_t *>(depth.data) +
+                                                       static_cast<size_t>(v) * depth.stride);
+    const size_t base = static_cast<size_t>(v) * width;
+    for (uint32_t u = 0; u < width; u += kLanes) {
+      const size_t i = base + u;
+      const bool partial = u >= full;
+      Float8 d, rx, ry, rz;
+      if (!partial) {
+        d = Float8::Load(row + u);
+        rx = Float8::Load(&table.x[i]);
+        ry = Float8::Load(&table.y[i]);
+        rz = Float8::Load(&table.z[i]);
+      } else {
+        const uint32_t n = width - u;
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail[0], row + u, n * sizeof(float));
+        memcpy(tail[1], &table.x[i], n * sizeof(float));
+        memcpy(tail[2], &table.y[i], n * sizeof(float));
+        memcpy(tail[3], &table.z[i], n * sizeof(float));
+        d = Float8::Load(tail[0]);
+        rx = Float8::Load(tail[1]);
+        ry = Float8::Load(tail[2]);
+        rz = Float8::Load(tail[3]);
+      }
+      // NaN depths fail both comparisons.
+      const Float8 valid = (d > lo) & (d < hi);
+      const Float8 px = d * rx, py = d * ry, pz = d * rz;
+      const Float8 wx = Select(valid, MulAdd(m00, px, MulAdd(m01, py, MulAdd(m02, pz, tx))), nan);
+      const Float8 wy = Select(valid, MulAdd(m10, px, MulAdd(m11, py, MulAdd(m12, pz, ty))), nan);
+      const Float8 wz = Select(valid, MulAdd(m20, px, MulAdd(m21, py, MulAdd(m22, pz, tz))), nan);
+      if (!partial) {
+        wx.Store(out.x + i);
+        wy.Store(out.y + i);
+        wz.Store(out.z + i);
+      } else {
+        const uint32_t n = width - u;
+        wx.Store(tail[1]);
+        wy.Store(tail[2]);
+        wz.Store(tail[3]);
+        memcpy(out.x + i, tail[1], n * sizeof(float));
+        memcpy(out.y + i, tail[2], n * sizeof(float));
+        memcpy(out.z + i, tail[3], n * sizeof(float));
+      }
+    }
+  }
+  return MLResult_Ok;
+}
@@ -0,0 +1,110 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*!
+  \brief Destination arrays for a point cloud in structure-of-arrays layout.
+
+  Each array must hold one entry per depth pixel, in row-major order.
+*/
+typedef struct MLPointBatch {
+  float *x;
+  float *y;
+  float *z;
+} MLPointBatch;
+
+/*!
+  \brief Turns depth images into point clouds.
+
+  Depth images hold the radial distance along each pixel's ray, so every
+  point is the depth times the pixel's unit ray. The rays are undistorted
+  once per set of intrinsics (focal length, principal point and the k1, k2,
+  p1, p2, k3 coefficients) and cached, and frames are then unprojected and
+  moved into world space eight pixels at a time.
+
+  Rays use the pinhole convention: x right, y down, z forward. Set
+  `opengl_axes` to get (x, -y, -z) for poses that follow the OpenGL camera
+  convention instead.
+
+  Not thread safe; use one instance per thread.
+*/
+class DepthUnprojector {
+public:
+  /*!
+    \param[in] max_cached_rays Number of intrinsics whose rays are kept,
+               e.g. one per depth stream.
+    \param[in] opengl_axes See the class description.
+  */
+  explicit DepthUnprojector(size_t max_cached_rays = 4, bool opengl_axes = false);
+
+  /*!
+    \brief Unprojects `depth` into `out`.
+
+    Pixels whose depth is not within (min_depth, max_depth) are written as NaN.
+
+    \param[in] depth Float depth image matching the intrinsics' size.
+    \param[in] intrinsics Intrinsics of the frame.
+    \param[in] camera_pose Camera pose in world; null to keep camera-space points.
+    \param[out] out Destination arrays of width * height entries.
+
+    \retval MLResult_Ok The point cloud was written.
+    \retval MLResult_InvalidParam The image is not float, its size does not
+            match the intrinsics, or a pointer is null.
+  */
+  MLResult Unproject(const MLDepthCameraDepthImage &depth, const MLDepthCameraIntrinsics &intrinsics,
+                     const MLTransform *camera_pose, const MLPointBatch &out, float min_depth = 0.0f,
+                     float max_depth = std::numeric_limits<float>::infinity());
+
+  /*! Unprojects the depth image of `frame` into world space with its camera pose. */
+  MLResult Unproject(const MLDepthCameraFrame &frame, const MLPointBatch &out, float min_depth = 0.0f,
+                     float max_depth = std::numeric_limits<float>::infinity());
+
+  /*!
+    \brief Returns the unit rays for `intrinsics`, building them on first use.
+
+    The returned arrays hold width * height entries and stay valid until
+    more than max_cached_rays other intrinsics have been used.
+  */
+  MLPointBatch Rays(const MLDepthCameraIntrinsics &intrinsics);
+
+private:
+  struct RayTable {
+    MLDepthCameraIntrinsics intrinsics;
+    std::vector<float> x, y, z;
+    uint64_t last_used;
+  };
+
+  RayTable &Table(const MLDepthCameraIntrinsics &intrinsics);
+
+  std::vector<RayTable> tables_;
+  size_t max_tables_;
+  bool opengl_axes_;
+  uint64_t clock_ = 0;
+};
+
+/*! \} */
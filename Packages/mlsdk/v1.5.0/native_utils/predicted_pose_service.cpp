@@ -0,0 +1,395 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "predicted_pose_service.h"
+
+#include "ml_perception.h"
+#include "ml_snapshot.h"
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using native_utils::Float8;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+constexpr float kNsToSeconds = 1e-9f;
+// How often the sampling thread recalibrates its clock mapping.
+constexpr int64_t kClockCalibrationPeriodNs = 1000000000;
+
+// Inputs of one block of queries: the pose interpolated between samples 0
+// and 1 at u, then extrapolated by dt seconds with the derivatives.
+// Interpolated lanes have dt = 0; extrapolated lanes have u = 0.
+struct QueryLanes {
+  float p0[3][kLanes], q0[4][kLanes];
+  float p1[3][kLanes], q1[4][kLanes];
+  float u[kLanes];
+  float v[3][kLanes], a[3][kLanes];
+  float w[3][kLanes], alpha[3][kLanes];
+  float dt[kLanes];
+};
+
+struct PoseLanes {
+  float p[3][kLanes], q[4][kLanes];
+};
+
+void EvaluateLanes(const QueryLanes &in, PoseLanes *out) {
+  const Float8 zero(0.0f), one(1.0f);
+  const Float8 u = Float8::Load(in.u);
+  const Float8 dt = Float8::Load(in.dt);
+
+  // Slerp along the shortest arc; sin(theta) and theta both stay within the
+  // polynomial ranges because the flipped dot product is non-negative.
+  Float8 q0[4], q1[4];
+  for (int c = 0; c < 4; c++) {
+    q0[c] = Float8::Load(in.q0[c]);
+    q1[c] = Float8::Load(in.q1[c]);
+  }
+  Float8 d = q0[0] * q1[0];
+  for (int c = 1; c < 4; c++) d = MulAdd(q0[c], q1[c], d);
+  const Float8 flip = d < zero;
+  for (int c = 0; c < 4; c++) q1[c] = Select(flip, -q1[c], q1[c]);
+  d = Min(Abs(d), one);
+  const Float8 theta = native_utils::AcosPositive(d);
+  const Float8 sin_theta = Sqrt(Max(one - d * d, zero));
+  const Float8 nearly_equal = sin_theta < Float8(1e-4f);
+  const Float8 inv_sin = one / Select(nearly_equal, one, sin_theta);
+  const Float8 w0 = Select(nearly_equal, one - u, native_utils::SinSmall((one - u) * theta) * inv_sin);
+  const Float8 w1 = Select(nearly_equal, u, native_utils::SinSmall(u * theta) * inv_sin);
+  Float8 q[4];
+  Float8 norm = zero;
+  for (int c = 0; c < 4; c++) {
+    q[c] = MulAdd(w0, q0[c], w1 * q1[c]);
+    norm = MulAdd(q[c], q[c], norm);
+  }
+  const Float8 inv_norm = one / Sqrt(Max(norm, Float8(1e-20f)));
+  for (int c = 0; c < 4; c++) q[c] = q[c] * inv_norm;
+
+  // Rotate by the world-frame rotation vector (w + alpha dt / 2) dt.
+  Float8 r[3];
+  Float8 angle2 = zero;
+  for (int c = 0; c < 3; c++) {
+    const Float8 w = MulAdd(Float8(0.5f) * dt, Float8::Load(in.alpha[c]), Float8::Load(in.w[c]));
+    r[c] = w * dt;
+    angle2 = MulAdd(r[c], r[c], angle2);
+  }
+  const Float8 angle = Min(Sqrt(angle2), Float8(3.14159265f));
+  const Float8 half = Float8(0.5f) * angle;
+  const Float8 tiny = angle < Float8(1e-6f);
+  const Float8 scale = Select(tiny, Float8(0.5f), native_utils::SinSmall(half) / Select(tiny, one, angle));
+  const Float8 dw = native_utils::CosSmall(half);
+  const Float8 dx = r[0] * scale, dy = r[1] * scale, dz = r[2] * scale;
+  Float8 o[4];
+  o[3] = dw * q[3] - dx * q[0] - dy * q[1] - dz * q[2];
+  o[0] = dw * q[0] + dx * q[3] + dy * q[2] - dz * q[1];
+  o[1] = dw * q[1] - dx * q[2] + dy * q[3] + dz * q[0];
+  o[2] = dw * q[2] + dx * q[1] - dy * q[0] + dz * q[3];
+  for (int c = 0; c < 4; c++) o[c].Store(out->q[c]);
+
+  const Float8 half_dt2 = Float8(0.5f) * dt * dt;
+  for (int c = 0; c < 3; c++) {
+    const Float8 p0 = Float8::Load(in.p0[c]);
+    Float8 p = MulAdd(u, Float8::Load(in.p1[c]) - p0, p0);
+    p = MulAdd(Float8::Load(in.v[c]), dt, p);
+    p = MulAdd(Float8::Load(in.a[c]), half_dt2, p);
+    p.Store(out->p[c]);
+  }
+}
+
+// Angular velocity (world frame) that rotates q0 into q1 over dt seconds.
+void AngularVelocity(const float *q0, const float *q1, float dt, float *out) {
+  // dq = q1 * conj(q0)
+  const float x = -q1[3] * q0[0] + q1[0] * q0[3] - q1[1] * q0[2] + q1[2] * q0[1];
+  const float y = -q1[3] * q0[1] + q1[0] * q0[2] + q1[1] * q0[3] - q1[2] * q0[0];
+  const float z = -q1[3] * q0[2] - q1[0] * q0[1] + q1[1] * q0[0] + q1[2] * q0[3];
+  float w = q1[3] * q0[3] + q1[0] * q0[0] + q1[1] * q0[1] + q1[2] * q0[2];
+  float sign = 1.0f;
+  if (w < 0.0f) {
+    sign = -1.0f;
+    w = -w;
+  }
+  const float s = std::sqrt(x * x + y * y + z * z);
+  const float angle = 2.0f * std::atan2(s, w);
+  const float k = s > 1e-9f ? sign * angle / (s * dt) : 2.0f * sign / dt;
+  out[0] = x * k;
+  out[1] = y * k;
+  out[2] = z * k;
+}
+
+}  // namespace
+
+PredictedPoseService::PredictedPoseService(const MLCoordinateFrameUID *frames, size_t frame_count, size_t history)
+    : frames_(frames, frames + frame_count),
+      capacity_(std::max<size_t>(history, 2) + 1),
+      slots_(new Slot[capacity_]),
+      poses_(capacity_ * frame_count),
+      scratch_(frame_count) {}
+
+PredictedPoseService::~PredictedPoseService() {
+  Stop();
+}
+
+MLResult PredictedPoseService::Sample(MLTime timestamp) {
+  std::lock_guard<std::mutex> lock(producer_mutex_);
+  const uint64_t written = written_.load(std::memory_order_relaxed);
+  const FramePose *previous = nullptr;
+  float previous_dt = 0.0f;
+  if (written > 0) {
+    const uint64_t previous_index = (written - 1) % capacity_;
+    const MLTime previous_timestamp = slots_[previous_index].timestamp.load(std::memory_order_relaxed);
+    if (timestamp <= previous_timestamp) {
+      return MLResult_InvalidTimestamp;
+    }
+    previous = &poses_[previous_index * frames_.size()];
+    previous_dt = static_cast<float>(timestamp - previous_timestamp) * kNsToSeconds;
+  }
+
+  MLSnapshot *snapshot = nullptr;
+  const MLResult result = MLPerceptionGetPredictedSnapshot(timestamp, &snapshot);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  for (size_t i = 0; i < frames_.size(); i++) {
+    MLTransform transform = {};
+    MLTransformDerivatives derivatives;
+    MLTransformDerivativesInit(&derivatives);
+    const MLResult frame_result = MLSnapshotGetTransformWithDerivatives(snapshot, &frames_[i], &transform, &derivatives);
+    FramePose &pose = scratch_[i];
+    memset(&pose, 0, sizeof(pose));
+    pose.rotation[3] = 1.0f;
+    if (frame_result != MLResult_Ok && frame_result != MLSnapshotResult_DerivativesNotCalculated) {
+      continue;
+    }
+    pose.found = 1;
+    memcpy(pose.position, &transform.position, sizeof(pose.position));
+    memcpy(pose.rotation, &transform.rotation, sizeof(pose.rotation));
+    if (frame_result == MLResult_Ok) {
+      memcpy(pose.linear_velocity, &derivatives.linear_velocity_m_s, sizeof(pose.linear_velocity));
+      memcpy(pose.linear_acceleration, &derivatives.linear_acceleration_m_s2, sizeof(pose.linear_acceleration));
+      memcpy(pose.angular_velocity, &derivatives.angular_velocity_r_s, sizeof(pose.angular_velocity));
+      memcpy(pose.angular_acceleration, &derivatives.angular_acceleration_r_s2, sizeof(pose.angular_acceleration));
+    } else if (previous != nullptr && previous[i].found) {
+      for (int c = 0; c < 3; c++) {
+        pose.linear_velocity[c] = (pose.position[c] - previous[i].position[c]) / previous_dt;
+      }
+      AngularVelocity(previous[i].rotation, pose.rotation, previous_dt, pose.angular_velocity);
+    }
+  }
+  MLPerceptionReleaseSnapshot(snapshot);
+
+  const uint64_t index = written % capacity_;
+  Slot &slot = slots_[index];
+  const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::copy(scratch_.begin(), scratch_.end(), poses_.begin() + index * frames_.size());
+  slot.sample.store(written, std::memory_order_relaxed);
+  slot.timestamp.store(timestamp, std::memory_order_relaxed);
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  written_.store(written + 1, std::memory_order_release);
+  return MLResult_Ok;
+}
+
+MLResult PredictedPoseService::Start(MLTime period_ns, MLTime lead_ns) {
+  if (period_ns <= 0) {
+    return MLResult_InvalidParam;
+  }
+  std::lock_guard<std::mutex> lock(thread_mutex_);
+  if (thread_.joinable()) {
+    return MLResult_UnspecifiedFailure;
+  }
+  stop_ = false;
+  thread_ = std::thread(&PredictedPoseService::Run, this, period_ns, lead_ns);
+  return MLResult_Ok;
+}
+
+void PredictedPoseService::Stop() {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock(thread_mutex_);
+    stop_ = true;
+    thread.swap(thread_);
+  }
+  wake_.notify_all();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void PredictedPoseService::Run(MLTime period_ns, MLTime lead_ns) {
+  auto next = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(thread_mutex_);
+  int64_t next_calibration = 0;
+  while (!stop_) {
+    lock.unlock();
+    const int64_t system_now = ClockMapper::SystemNow();
+    if (system_now >= next_calibration) {
+      clock_.Calibrate();
+      next_calibration = system_now + kClockCalibrationPeriodNs;
+    }
+    MLTime now = 0;
+    if (clock_.ToMLTime(system_now, &now) == MLResult_Ok) {
+      Sample(now + lead_ns);
+    }
+    next += std::chrono::nanoseconds(period_ns);
+    lock.lock();
+    wake_.wait_until(lock, next, [this] { return stop_; });
+  }
+}
+
+bool PredictedPoseService::ReadSlot(uint64_t index, size_t frame_index, MLTime *timestamp, FramePose *pose) const {
+  const Slot &slot = slots_[index % capacity_];
+  for (;;) {
+    const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    const uint64_t sample = slot.sample.load(std::memory_order_relaxed);
+    *timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    memcpy(pose, &poses_[(index % capacity_) * frames_.size() + frame_index], sizeof(*pose));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      return sample == index;
+    }
+  }
+}
+
+MLTime PredictedPoseService::newest_timestamp() const {
+  const uint64_t written = written_.load(std::memory_order_acquire);
+  return written == 0 ? 0 : slots_[(written - 1) % capacity_].timestamp.load(std::memory_order_relaxed);
+}
+
+MLResult PredictedPoseService::Query(size_t frame_index, MLTime timestamp, MLTransform *out) const {
+  if (out == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const MLTransformBatch batch = {&out->position.x, &out->position.y, &out->position.z, &out->rotation.x,
+                                  &out->rotation.y, &out->rotation.z, &out->rotation.w, nullptr};
+  return QueryBatch(frame_index, &timestamp, 1, batch);
+}
+
+MLResult PredictedPoseService::QueryBatch(size_t frame_index, const MLTime *timestamps, size_t count,
+                                          const MLTransformBatch &batch) const {
+  if (frame_index >= frames_.size() || (timestamps == nullptr && count > 0)) {
+    return MLResult_InvalidParam;
+  }
+  const MLTime max_extrapolation = max_extrapolation_ns_.load(std::memory_order_relaxed);
+  MLResult overall = MLResult_Ok;
+  QueryLanes lanes;
+  PoseLanes poses;
+  bool found[kLanes];
+
+  for (size_t base = 0; base < count; base += kLanes) {
+    const size_t block = std::min<size_t>(kLanes, count - base);
+    memset(&lanes, 0, sizeof(lanes));
+    for (size_t lane = 0; lane < static_cast<size_t>(kLanes); lane++) {
+      lanes.q0[3][lane] = lanes.q1[3][lane] = 1.0f;
+      found[lane] = false;
+    }
+
+    for (size_t lane = 0; lane < block; lane++) {
+      const MLTime t = timestamps[base + lane];
+      FramePose first, second;
+      MLTime first_time = 0, second_time = 0;
+      bool interpolate = false;
+      bool ok = false;
+      // Retries only when the producer laps this reader mid-query.
+      for (;;) {
+        const uint64_t written = written_.load(std::memory_order_acquire);
+        if (written == 0) {
+          break;
+        }
+        const uint64_t newest = written - 1;
+        // One slot is kept out of the window as a margin for the producer.
+        const uint64_t oldest = written > capacity_ - 1 ? written - (capacity_ - 1) : 0;
+        if (!ReadSlot(newest, frame_index, &first_time, &first)) {
+          continue;
+        }
+        if (t >= first_time) {
+          ok = first.found != 0;
+          break;
+        }
+        uint64_t lo = oldest, hi = newest;
+        if (t < slots_[lo % capacity_].timestamp.load(std::memory_order_relaxed)) {
+          break;
+        }
+        // Largest lo with timestamp(lo) <= t < timestamp(hi).
+        while (hi - lo > 1) {
+          const uint64_t mid = lo + (hi - lo) / 2;
+          if (slots_[mid % capacity_].timestamp.load(std::memory_order_relaxed) <= t) {
+            lo = mid;
+          } else {
+            hi = mid;
+          }
+        }
+        if (!ReadSlot(lo, frame_index, &first_time, &first) || !ReadSlot(hi, frame_index, &second_time, &second)) {
+          continue;
+        }
+        interpolate = true;
+        ok = first.found && second.found && first_time <= t && t < second_time;
+        break;
+      }
+      if (!ok) {
+        continue;
+      }
+      found[lane] = true;
+      for (int c = 0; c < 3; c++) {
+        lanes.p0[c][lane] = first.position[c];
+        lanes.p1[c][lane] = first.position[c];
+      }
+      for (int c = 0; c < 4; c++) {
+        lanes.q0[c][lane] = first.rotation[c];
+        lanes.q1[c][lane] = first.rotation[c];
+      }
+      if (interpolate) {
+        for (int c = 0; c < 3; c++) lanes.p1[c][lane] = second.position[c];
+        for (int c = 0; c < 4; c++) lanes.q1[c][lane] = second.rotation[c];
+        lanes.u[lane] = static_cast<float>(t - first_time) / static_cast<float>(second_time - first_time);
+      } else {
+        for (int c = 0; c < 3; c++) {
+          lanes.v[c][lane] = first.linear_velocity[c];
+          lanes.a[c][lane] = first.linear_acceleration[c];
+          lanes.w[c][lane] = first.angular_velocity[c];
+          lanes.alpha[c][lane] = first.angular_acceleration[c];
+        }
+        lanes.dt[lane] = static_cast<float>(std::min(t - first_time, max_extrapolation)) * kNsToSeconds;
+      }
+    }
+
+    EvaluateLanes(lanes, &poses);
+
+    float *const position[3] = {batch.position_x, batch.position_y, batch.position_z};
+    float *const rotation[4] = {batch.rotation_x, batch.rotation_y, batch.rotation_z, batch.rotation_w};
+    for (size_t lane = 0; lane < block; lane++) {
+      const size_t i = base + lane;
+      for (int c = 0; c < 3; c++) {
+        if (position[c] != nullptr) position[c][i] = found[lane] ? poses.p[c][lane] : 0.0f;
+      }
+      for (int c = 0; c < 4; c++) {
+        if (rotation[c] != nullptr) rotation[c][i] = found[lane] ? poses.q[c][lane] : (c == 3 ? 1.0f : 0.0f);
+      }
+      if (batch.results != nullptr) {
+        batch.results[i] = found[lane] ? MLResult_Ok : MLResult_PoseNotFound;
+      }
+      if (!found[lane]) {
+        overall = MLResult_PoseNotFound;
+      }
+    }
+  }
+  return overall;
+}
@@ -0,0 +1,170 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_coordinate_frame_uid.h"
+#include "ml_time.h"
+#include "ml_types.h"
+#include "clock_mapper.h"
+#include "snapshot_transform_resolver.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*!
+  \brief Pose history sampled from predicted snapshots, queryable at any time.
+
+  A single producer calls MLPerceptionGetPredictedSnapshot() and
+  MLSnapshotGetTransformWithDerivatives() for a fixed set of coordinate
+  frames, either on its own thread at a fixed rate (Start()) or explicitly
+  (Sample()), and appends the poses and derivatives to a history ring.
+  Render, audio and physics then query poses at their own timestamps without
+  touching the C API:
+
+  - timestamps inside the history are interpolated between the two
+    bracketing samples (slerp for rotation, lerp for position);
+  - timestamps past the newest sample are extrapolated from its velocity and
+    acceleration, up to max_extrapolation();
+  - timestamps older than the history report MLResult_PoseNotFound.
+
+  Queries are lock-free and may run on any number of threads concurrently
+  with the producer; a query that races with the slot being overwritten
+  simply retries.
+*/
+class PredictedPoseService {
+public:
+  /*!
+    \param[in] frames Coordinate frames to track; query them by index.
+    \param[in] frame_count Number of entries in frames.
+    \param[in] history Number of samples kept per frame (at least 2).
+  */
+  PredictedPoseService(const MLCoordinateFrameUID *frames, size_t frame_count, size_t history = 64);
+
+  /*! Stops the sampling thread if it is running. */
+  ~PredictedPoseService();
+
+  PredictedPoseService(const PredictedPoseService &) = delete;
+  PredictedPoseService &operator=(const PredictedPoseService &) = delete;
+
+  /*!
+    \brief Acquires a predicted snapshot for `timestamp` and appends one sample.
+
+    Timestamps must increase from one sample to the next.
+
+    \retval MLResult_Ok The sample was recorded.
+    \retval MLResult_InvalidTimestamp timestamp is not newer than the last sample.
+    \return Otherwise the failure returned by MLPerceptionGetPredictedSnapshot().
+  */
+  MLResult Sample(MLTime timestamp);
+
+  /*!
+    \brief Starts sampling on a background thread.
+
+    Every `period_ns` the thread samples the pose predicted for `lead_ns`
+    after the current time; a lead close to the display latency keeps render
+    queries on the interpolation path.
+
+    \retval MLResult_Ok The thread was started.
+    \retval MLResult_InvalidParam period_ns is not positive.
+    \retval MLResult_UnspecifiedFailure Sampling is already running.
+  */
+  MLResult Start(MLTime period_ns = 4000000, MLTime lead_ns = 0);
+
+  /*! Stops the sampling thread started by Start(). */
+  void Stop();
+
+  /*!
+    \brief Returns the pose of frame `frame_index` at `timestamp`.
+
+    \retval MLResult_Ok The pose was interpolated or extrapolated.
+    \retval MLResult_InvalidParam frame_index is out of range or out is null.
+    \retval MLResult_PoseNotFound No sample covers timestamp, or the frame was
+            not tracked in the samples around it; out is set to identity.
+  */
+  MLResult Query(size_t frame_index, MLTime timestamp, MLTransform *out) const;
+
+  /*!
+    \brief Returns the poses of frame `frame_index` at `count` timestamps.
+
+    Per-timestamp results are written to batch.results when provided.
+
+    \retval MLResult_Ok Every pose was found.
+    \retval MLResult_InvalidParam frame_index is out of range or timestamps is null.
+    \retval MLResult_PoseNotFound At least one timestamp could not be answered.
+  */
+  MLResult QueryBatch(size_t frame_index, const MLTime *timestamps, size_t count, const MLTransformBatch &batch) const;
+
+  /*! Timestamp of the newest sample, or 0 before the first sample. */
+  MLTime newest_timestamp() const;
+
+  /*! Limit on how far past the newest sample poses are extrapolated (default 100 ms). */
+  MLTime max_extrapolation() const { return max_extrapolation_ns_.load(std::memory_order_relaxed); }
+  void set_max_extrapolation(MLTime ns) { max_extrapolation_ns_.store(ns, std::memory_order_relaxed); }
+
+private:
+  // One frame in one sample. Derivatives come from the snapshot when it
+  // has them and from finite differences with the previous sample otherwise.
+  struct FramePose {
+    float position[3];
+    float rotation[4];
+    float linear_velocity[3];
+    float linear_acceleration[3];
+    float angular_velocity[3];
+    float angular_acceleration[3];
+    uint32_t found;
+  };
+
+  struct Slot {
+    // Even when stable, odd while the producer rewrites the slot.
+    std::atomic<uint32_t> sequence{0};
+    // Index of the sample held by the slot, so readers notice being lapped.
+    std::atomic<uint64_t> sample{UINT64_MAX};
+    std::atomic<MLTime> timestamp{0};
+  };
+
+  bool ReadSlot(uint64_t index, size_t frame_index, MLTime *timestamp, FramePose *pose) const;
+  void Run(MLTime period_ns, MLTime lead_ns);
+
+  std::vector<MLCoordinateFrameUID> frames_;
+  size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  // capacity_ x frames_.size() poses, slot-major.
+  std::vector<FramePose> poses_;
+  // Number of samples ever written.
+  std::atomic<uint64_t> written_{0};
+  std::atomic<MLTime> max_extrapolation_ns_{100000000};
+
+  std::mutex producer_mutex_;
+  std::vector<FramePose> scratch_;
+  std::mutex thread_mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::thread thread_;
+  // Maps the sampling thread's clock to MLTime; calibrated by Run().
+  ClockMapper clock_;
+};
+
+/*! \} */
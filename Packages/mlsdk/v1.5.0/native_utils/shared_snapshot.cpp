@@ -0,0 +1,168 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "shared_snapshot.h"
+
+#include "ml_perception.h"
+
+#include <chrono>
+#include <utility>
+
+namespace {
+
+void StoreMax(std::atomic<uint64_t> &target, uint64_t value) {
+  uint64_t current = target.load(std::memory_order_relaxed);
+  while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+struct SharedSnapshotSource::Counters {
+  std::atomic<uint64_t> acquired{0};
+  std::atomic<uint64_t> shared{0};
+  std::atomic<uint64_t> released{0};
+  std::atomic<uint64_t> live{0};
+  std::atomic<uint64_t> max_live{0};
+  std::atomic<uint64_t> total_live_ns{0};
+  std::atomic<uint64_t> max_live_ns{0};
+  std::atomic<uint64_t> last_live_ns{0};
+};
+
+struct SharedSnapshot::Block {
+  std::atomic<uint32_t> references{1};
+  MLSnapshot *snapshot = nullptr;
+  uint64_t frame = 0;
+  MLTime timestamp = 0;
+  std::chrono::steady_clock::time_point acquired_at;
+  std::shared_ptr<SharedSnapshotSource::Counters> counters;
+};
+
+SharedSnapshot::SharedSnapshot(const SharedSnapshot &other) : block_(other.block_) {
+  if (block_ != nullptr) {
+    block_->references.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+SharedSnapshot::SharedSnapshot(SharedSnapshot &&other) noexcept : block_(other.block_) {
+  other.block_ = nullptr;
+}
+
+SharedSnapshot &SharedSnapshot::operator=(SharedSnapshot other) noexcept {
+  std::swap(block_, other.block_);
+  return *this;
+}
+
+SharedSnapshot::~SharedSnapshot() {
+  reset();
+}
+
+const MLSnapshot *SharedSnapshot::get() const {
+  return block_ != nullptr ? block_->snapshot : nullptr;
+}
+
+uint64_t SharedSnapshot::frame() const {
+  return block_ != nullptr ? block_->frame : 0;
+}
+
+MLTime SharedSnapshot::timestamp() const {
+  return block_ != nullptr ? block_->timestamp : 0;
+}
+
+void SharedSnapshot::reset() {
+  Block *block = block_;
+  block_ = nullptr;
+  if (block == nullptr || block->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  MLPerceptionReleaseSnapshot(block->snapshot);
+  const uint64_t live_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - block->acquired_at).count());
+  SharedSnapshotSource::Counters &counters = *block->counters;
+  counters.released.fetch_add(1, std::memory_order_relaxed);
+  counters.live.fetch_sub(1, std::memory_order_relaxed);
+  counters.total_live_ns.fetch_add(live_ns, std::memory_order_relaxed);
+  counters.last_live_ns.store(live_ns, std::memory_order_relaxed);
+  StoreMax(counters.max_live_ns, live_ns);
+  delete block;
+}
+
+SharedSnapshotSource::SharedSnapshotSource() : counters_(std::make_shared<Counters>()) {}
+
+SharedSnapshotSource::~SharedSnapshotSource() = default;
+
+MLResult SharedSnapshotSource::Acquire(uint64_t frame, SharedSnapshot *out_snapshot, MLTime timestamp) {
+  if (out_snapshot == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  // Snapshots dropped here, the previous frame's and the one *out_snapshot
+  // held, are released after the lock if this was their last reference.
+  SharedSnapshot previous;
+  SharedSnapshot released;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (current_) {
+    if (frame == current_.frame()) {
+      counters_->shared.fetch_add(1, std::memory_order_relaxed);
+      released = std::exchange(*out_snapshot, current_);
+      return MLResult_Ok;
+    }
+    if (frame < current_.frame()) {
+      return MLResult_InvalidTimestamp;
+    }
+  }
+
+  MLSnapshot *snapshot = nullptr;
+  const MLResult result =
+      timestamp != 0 ? MLPerceptionGetPredictedSnapshot(timestamp, &snapshot) : MLPerceptionGetSnapshot(&snapshot);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  SharedSnapshot::Block *block = new SharedSnapshot::Block();
+  block->snapshot = snapshot;
+  block->frame = frame;
+  block->timestamp = timestamp;
+  block->acquired_at = std::chrono::steady_clock::now();
+  block->counters = counters_;
+  counters_->acquired.fetch_add(1, std::memory_order_relaxed);
+  StoreMax(counters_->max_live, counters_->live.fetch_add(1, std::memory_order_relaxed) + 1);
+
+  previous = std::move(current_);
+  current_ = SharedSnapshot(block);
+  released = std::exchange(*out_snapshot, current_);
+  return MLResult_Ok;
+}
+
+SharedSnapshot SharedSnapshotSource::Current() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return current_;
+}
+
+void SharedSnapshotSource::Reset() {
+  SharedSnapshot previous;
+  std::lock_guard<std::mutex> lock(mutex_);
+  previous = std::move(current_);
+}
+
+SharedSnapshotStats SharedSnapshotSource::stats() const {
+  const Counters &counters = *counters_;
+  SharedSnapshotStats stats;
+  stats.acquired = counters.acquired.load(std::memory_order_relaxed);
+  stats.shared = counters.shared.load(std::memory_order_relaxed);
+  stats.released = counters.released.load(std::memory_order_relaxed);
+  stats.live = static_cast<uint32_t>(counters.live.load(std::memory_order_relaxed));
+  stats.max_live = static_cast<uint32_t>(counters.max_live.load(std::memory_order_relaxed));
+  stats.total_live_ns = counters.total_live_ns.load(std::memory_order_relaxed);
+  stats.max_live_ns = counters.max_live_ns.load(std::memory_order_relaxed);
+  stats.last_live_ns = counters.last_live_ns.load(std::memory_order_relaxed);
+  return stats;
+}
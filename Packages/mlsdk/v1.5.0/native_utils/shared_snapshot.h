@@ -0,0 +1,151 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_snapshot.h"
+#include "ml_time.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Lifetime statistics of the snapshots handed out by a SharedSnapshotSource. */
+typedef struct SharedSnapshotStats {
+  /*! Snapshots acquired from the C API. */
+  uint64_t acquired;
+  /*! Handles served from an already acquired snapshot instead of a new C API call. */
+  uint64_t shared;
+  /*! Snapshots released back to the C API. */
+  uint64_t released;
+  /*! Snapshots acquired but not yet released. */
+  uint32_t live;
+  /*! Largest number of snapshots live at the same time. */
+  uint32_t max_live;
+  /*! Sum, maximum and latest live time, from acquisition to release, in nanoseconds. */
+  uint64_t total_live_ns;
+  uint64_t max_live_ns;
+  uint64_t last_live_ns;
+} SharedSnapshotStats;
+
+/*!
+  \brief Reference-counted handle to an #MLSnapshot.
+
+  Copies share the same snapshot; the snapshot is released with
+  MLPerceptionReleaseSnapshot() when the last handle is destroyed, on
+  whichever thread that happens. Handles may be copied and destroyed from
+  any thread; the snapshot itself is read-only.
+*/
+class SharedSnapshot {
+public:
+  SharedSnapshot() = default;
+  SharedSnapshot(const SharedSnapshot &other);
+  SharedSnapshot(SharedSnapshot &&other) noexcept;
+  SharedSnapshot &operator=(SharedSnapshot other) noexcept;
+  ~SharedSnapshot();
+
+  /*! The snapshot, or null for an empty handle. */
+  const MLSnapshot *get() const;
+
+  /*! Frame the snapshot was acquired for. */
+  uint64_t frame() const;
+
+  /*! Prediction timestamp passed to MLPerceptionGetPredictedSnapshot(), or 0. */
+  MLTime timestamp() const;
+
+  explicit operator bool() const { return block_ != nullptr; }
+
+  /*! Drops this handle's reference. */
+  void reset();
+
+private:
+  friend class SharedSnapshotSource;
+  struct Block;
+
+  explicit SharedSnapshot(Block *block) : block_(block) {}
+
+  Block *block_ = nullptr;
+};
+
+/*!
+  \brief Hands out one shared snapshot per frame to every thread.
+
+  The first Acquire() for a frame calls the C API; every other Acquire()
+  for the same frame, from any thread, returns a handle to the same
+  snapshot, so all subsystems see one consistent pose view. The source
+  drops its own reference when a newer frame is acquired, so a snapshot is
+  released as soon as the last subsystem working on its frame is done.
+
+  \code
+    // Render thread
+    SharedSnapshot snapshot;
+    source.Acquire(frame_index, &snapshot, predicted_display_time);
+    // Audio, physics... for the same frame share it
+    source.Acquire(frame_index, &snapshot);
+  \endcode
+*/
+class SharedSnapshotSource {
+public:
+  SharedSnapshotSource();
+  ~SharedSnapshotSource();
+
+  SharedSnapshotSource(const SharedSnapshotSource &) = delete;
+  SharedSnapshotSource &operator=(const SharedSnapshotSource &) = delete;
+
+  /*!
+    \brief Returns the snapshot of `frame`, acquiring it on first use.
+
+    \param[in] frame Monotonically increasing frame index.
+    \param[out] out_snapshot Receives the shared handle.
+    \param[in] timestamp When non-zero, the first acquisition for the frame
+               uses MLPerceptionGetPredictedSnapshot() for this time;
+               otherwise MLPerceptionGetSnapshot().
+
+    \retval MLResult_Ok out_snapshot holds the frame's snapshot.
+    \retval MLResult_InvalidParam out_snapshot is null.
+    \retval MLResult_InvalidTimestamp frame is older than the current frame,
+            whose snapshot has already replaced it.
+    \return Otherwise the failure returned by the C API.
+  */
+  MLResult Acquire(uint64_t frame, SharedSnapshot *out_snapshot, MLTime timestamp = 0);
+
+  /*! Handle to the most recently acquired snapshot, or an empty handle. */
+  SharedSnapshot Current() const;
+
+  /*!
+    \brief Drops the source's reference to the current snapshot, e.g. when
+           the app pauses; it is released once other handles are gone.
+  */
+  void Reset();
+
+  /*! Statistics since construction. */
+  SharedSnapshotStats stats() const;
+
+private:
+  friend class SharedSnapshot;
+  struct Counters;
+
+  mutable std::mutex mutex_;
+  SharedSnapshot current_;
+  // Shared with the handles so releases can be counted after the source is gone.
+  std::shared_ptr<Counters> counters_;
+};
+
+/*! \} */
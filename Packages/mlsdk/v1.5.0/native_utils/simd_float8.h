@@ -0,0 +1,320 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+/*
+  Internal 8-wide float vector used by the native_utils kernels.
+
+  Maps to AVX2/FMA on x86 (ML2 and most hosts), to pairs of NEON registers
+  on ARM hosts, and to plain arrays elsewhere.  Comparisons return lane masks
+  of the same type (all bits set or clear) for use with Select().
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define NATIVE_UTILS_SIMD_AVX2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NATIVE_UTILS_SIMD_NEON 1
+#endif
+
+namespace native_utils {
+
+#if defined(NATIVE_UTILS_SIMD_AVX2)
+
+struct Float8 {
+  __m256 v;
+
+  static constexpr int kWidth = 8;
+
+  Float8() = default;
+  Float8(__m256 value) : v(value) {}
+  Float8(float value) : v(_mm256_set1_ps(value)) {}
+
+  static Float8 Load(const float *p) { return _mm256_loadu_ps(p); }
+  void Store(float *p) const { _mm256_storeu_ps(p, v); }
+  // Index of the first lane plus 0..7.
+  static Float8 Iota(float first) {
+    return _mm256_add_ps(_mm256_set1_ps(first), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+  }
+  // Converts 8 uint16_t values.
+  static Float8 LoadU16(const uint16_t *p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))));
+  }
+  // Converts 8 uint8_t values.
+  static Float8 LoadU8(const uint8_t *p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+  }
+  // Loads 8 uint32_t values and keeps their bit patterns.
+  static Float8 LoadBits(const uint32_t *p) {
+    return _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+  }
+  // Loads 16 values as lanes p[0], p[2], ... and p[1], p[3], ...
+  static void LoadDeinterleaved(const float *p, Float8 *even, Float8 *odd) {
+    const __m256 a = _mm256_loadu_ps(p), b = _mm256_loadu_ps(p + 8);
+    // Shuffling leaves the lanes in 64-bit pairs ordered (0, 2, 1, 3).
+    even->v = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+    odd->v = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  // Bitmask with bit i set when the sign bit of lane i is set.
+  int MoveMask() const { return _mm256_movemask_ps(v); }
+};
+
+inline Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline Float8 operator&(Float8 a, Float8 b) { return _mm256_and_ps(a.v, b.v); }
+inline Float8 operator|(Float8 a, Float8 b) { return _mm256_or_ps(a.v, b.v); }
+inline Float8 operator<(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline Float8 operator<=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline Float8 operator>(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline Float8 operator>=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+// Lanes where the bitwise AND of the raw bits is zero.
+inline Float8 TestZero(Float8 a, Float8 b) {
+  const __m256i bits = _mm256_and_si256(_mm256_castps_si256(a.v), _mm256_castps_si256(b.v));
+  return _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, _mm256_setzero_si256()));
+}
+inline Float8 AndNot(Float8 mask, Float8 a) { return _mm256_andnot_ps(mask.v, a.v); }
+inline Float8 MulAdd(Float8 a, Float8 b, Float8 c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline Float8 Min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+inline Float8 Max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+inline Float8 Sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+inline Float8 Abs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline Float8 Floor(Float8 a) { return _mm256_floor_ps(a.v); }
+inline Float8 Select(Float8 mask, Float8 a, Float8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+#else
+
+struct Float8 {
+#if defined(NATIVE_UTILS_SIMD_NEON)
+  float32x4_t lo, hi;
+#else
+  float f[8];
+#endif
+
+  static constexpr int kWidth = 8;
+
+  Float8() = default;
+  Float8(float value) {
+#if defined(NATIVE_UTILS_SIMD_NEON)
+    lo = hi = vdupq_n_f32(value);
+#else
+    for (float &lane : f) lane = value;
+#endif
+  }
+
+  static Float8 Load(const float *p) {
+    Float8 r;
+#if defined(NATIVE_UTILS_SIMD_NEON)
+    r.lo = vld1q_f32(p);
+    r.hi = vld1q_f32(p + 4);
+#else
+    memcpy(r.f, p, sizeof(r.f));
+#endif
+    return r;
+  }
+  void Store(float *p) const {
+#if defined(NATIVE_UTILS_SIMD_NEON)
+    vst1q_f32(p, lo);
+    vst1q_f32(p + 4, hi);
+#else
+    memcpy(p, f, sizeof(f));
+#endif
+  }
+  static Float8 Iota(float first) {
+    float lanes[8];
+    for (int i = 0; i < 8; i++) lanes[i] = first + (float)i;
+    return Load(lanes);
+  }
+  static Float8 LoadU16(const uint16_t *p) {
+    float lanes[8];
+    for (int i = 0; i < 8; i++) lanes[i] = (float)p[i];
+    return Load(lanes);
+  }
+  static Float8 LoadU8(const uint8_t *p) {
+    float lanes[8];
+    for (int i = 0; i < 8; i++) lanes[i] = (float)p[i];
+    return Load(lanes);
+  }
+  static Float8 LoadBits(const uint32_t *p) {
+    float lanes[8];
+    memcpy(lanes, p, sizeof(lanes));
+    return Load(lanes);
+  }
+  static void LoadDeinterleaved(const float *p, Float8 *even, Float8 *odd) {
+#if defined(NATIVE_UTILS_SIMD_NEON)
+    const float32x4x2_t lo = vld2q_f32(p), hi = vld2q_f32(p + 8);
+    even->lo = lo.val[0];
+    even->hi = hi.val[0];
+    odd->lo = lo.val[1];
+    odd->hi = hi.val[1];
+#else
+    for (int i = 0; i < 8; i++) {
+      even->f[i] = p[2 * i];
+      odd->f[i] = p[2 * i + 1];
+    }
+#endif
+  }
+  int MoveMask() const {
+    uint32_t bits[8];
+    Store(reinterpret_cast<float *>(bits));
+    int mask = 0;
+    for (int i = 0; i < 8; i++) mask |= (int)(bits[i] >> 31) << i;
+    return mask;
+  }
+};
+
+namespace simd_detail {
+
+#if defined(NATIVE_UTILS_SIMD_NEON)
+template <typename Op>
+inline Float8 Map(Float8 a, Float8 b, Op op) {
+  Float8 r;
+  r.lo = op(a.lo, b.lo);
+  r.hi = op(a.hi, b.hi);
+  return r;
+}
+inline float32x4_t Mask(uint32x4_t m) { return vreinterpretq_f32_u32(m); }
+inline uint32x4_t Bits(float32x4_t v) { return vreinterpretq_u32_f32(v); }
+#else
+template <typename Op>
+inline Float8 Map(Float8 a, Float8 b, Op op) {
+  Float8 r;
+  for (int i = 0; i < 8; i++) r.f[i] = op(a.f[i], b.f[i]);
+  return r;
+}
+inline float MaskOf(bool set) {
+  const uint32_t bits = set ? 0xFFFFFFFFu : 0u;
+  float r;
+  memcpy(&r, &bits, sizeof(r));
+  return r;
+}
+inline uint32_t BitsOf(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+inline float FromBits(uint32_t bits) {
+  float r;
+  memcpy(&r, &bits, sizeof(r));
+  return r;
+}
+#endif
+
+}  // namespace simd_detail
+
+#if defined(NATIVE_UTILS_SIMD_NEON)
+inline Float8 operator+(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return vaddq_f32(x, y); }); }
+inline Float8 operator-(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return vsubq_f32(x, y); }); }
+inline Float8 operator*(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return vmulq_f32(x, y); }); }
+inline Float8 operator/(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return vdivq_f32(x, y); }); }
+inline Float8 operator-(Float8 a) { return Float8(0.0f) - a; }
+inline Float8 operator&(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vandq_u32(simd_detail::Bits(x), simd_detail::Bits(y))); }); }
+inline Float8 operator|(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vorrq_u32(simd_detail::Bits(x), simd_detail::Bits(y))); }); }
+inline Float8 operator<(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vcltq_f32(x, y)); }); }
+inline Float8 operator<=(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vcleq_f32(x, y)); }); }
+inline Float8 operator>(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vcgtq_f32(x, y)); }); }
+inline Float8 operator>=(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vcgeq_f32(x, y)); }); }
+inline Float8 TestZero(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return simd_detail::Mask(vceqq_u32(vandq_u32(simd_detail::Bits(x), simd_detail::Bits(y)), vdupq_n_u32(0))); }); }
+inline Float8 AndNot(Float8 mask, Float8 a) { return simd_detail::Map(mask, a, [](float32x4_t m, float32x4_t x) { return simd_detail::Mask(vbicq_u32(simd_detail::Bits(x), simd_detail::Bits(m))); }); }
+inline Float8 MulAdd(Float8 a, Float8 b, Float8 c) {
+  Float8 r;
+  r.lo = vfmaq_f32(c.lo, a.lo, b.lo);
+  r.hi = vfmaq_f32(c.hi, a.hi, b.hi);
+  return r;
+}
+inline Float8 Min(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return vminq_f32(x, y); }); }
+inline Float8 Max(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float32x4_t x, float32x4_t y) { return vmaxq_f32(x, y); }); }
+inline Float8 Sqrt(Float8 a) { return simd_detail::Map(a, a, [](float32x4_t x, float32x4_t) { return vsqrtq_f32(x); }); }
+inline Float8 Abs(Float8 a) { return simd_detail::Map(a, a, [](float32x4_t x, float32x4_t) { return vabsq_f32(x); }); }
+inline Float8 Floor(Float8 a) { return simd_detail::Map(a, a, [](float32x4_t x, float32x4_t) { return vrndmq_f32(x); }); }
+inline Float8 Select(Float8 mask, Float8 a, Float8 b) {
+  Float8 r;
+  r.lo = vbslq_f32(simd_detail::Bits(mask.lo), a.lo, b.lo);
+  r.hi = vbslq_f32(simd_detail::Bits(mask.hi), a.hi, b.hi);
+  return r;
+}
+#else
+inline Float8 operator+(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return x + y; }); }
+inline Float8 operator-(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return x - y; }); }
+inline Float8 operator*(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return x * y; }); }
+inline Float8 operator/(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return x / y; }); }
+inline Float8 operator-(Float8 a) { return simd_detail::Map(a, a, [](float x, float) { return -x; }); }
+inline Float8 operator&(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::FromBits(simd_detail::BitsOf(x) & simd_detail::BitsOf(y)); }); }
+inline Float8 operator|(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::FromBits(simd_detail::BitsOf(x) | simd_detail::BitsOf(y)); }); }
+inline Float8 operator<(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::MaskOf(x < y); }); }
+inline Float8 operator<=(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::MaskOf(x <= y); }); }
+inline Float8 operator>(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::MaskOf(x > y); }); }
+inline Float8 operator>=(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::MaskOf(x >= y); }); }
+inline Float8 TestZero(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return simd_detail::MaskOf((simd_detail::BitsOf(x) & simd_detail::BitsOf(y)) == 0); }); }
+inline Float8 AndNot(Float8 mask, Float8 a) { return simd_detail::Map(mask, a, [](float m, float x) { return simd_detail::FromBits(simd_detail::BitsOf(x) & ~simd_detail::BitsOf(m)); }); }
+inline Float8 MulAdd(Float8 a, Float8 b, Float8 c) { return a * b + c; }
+inline Float8 Min(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+inline Float8 Max(Float8 a, Float8 b) { return simd_detail::Map(a, b, [](float x, float y) { return y > x ? y : x; }); }
+inline Float8 Sqrt(Float8 a) { return simd_detail::Map(a, a, [](float x, float) { return std::sqrt(x); }); }
+inline Float8 Abs(Float8 a) { return simd_detail::Map(a, a, [](float x, float) { return std::fabs(x); }); }
+inline Float8 Floor(Float8 a) { return simd_detail::Map(a, a, [](float x, float) { return std::floor(x); }); }
+inline Float8 Select(Float8 mask, Float8 a, Float8 b) {
+  Float8 r;
+  for (int i = 0; i < 8; i++) r.f[i] = simd_detail::BitsOf(mask.f[i]) ? a.f[i] : b.f[i];
+  return r;
+}
+#endif
+
+#endif
+
+/*
+  Polynomial approximations shared by the kernels, accurate to about 1e-6
+  over the documented input ranges.
+*/
+
+// sin(x) for |x| <= pi/2.
+inline Float8 SinSmall(Float8 x) {
+  const Float8 x2 = x * x;
+  Float8 p = MulAdd(x2, Float8(2.7557319e-6f), Float8(-1.9841270e-4f));
+  p = MulAdd(p, x2, Float8(8.3333333e-3f));
+  p = MulAdd(p, x2, Float8(-1.6666667e-1f));
+  return MulAdd(p * x2, x, x);
+}
+
+// cos(x) for |x| <= pi/2.
+inline Float8 CosSmall(Float8 x) {
+  const Float8 x2 = x * x;
+  Float8 p = MulAdd(x2, Float8(2.4801587e-5f), Float8(-1.3888889e-3f));
+  p = MulAdd(p, x2, Float8(4.1666667e-2f));
+  p = MulAdd(p, x2, Float8(-0.5f));
+  return MulAdd(p, x2, Float8(1.0f));
+}
+
+// acos(x) for 0 <= x <= 1 (Abramowitz & Stegun 4.4.46).
+inline Float8 AcosPositive(Float8 x) {
+  Float8 p = MulAdd(x, Float8(-0.0012624911f), Float8(0.0066700901f));
+  p = MulAdd(p, x, Float8(-0.0170881256f));
+  p = MulAdd(p, x, Float8(0.0308918810f));
+  p = MulAdd(p, x, Float8(-0.0501743046f));
+  p = MulAdd(p, x, Float8(0.0889789874f));
+  p = MulAdd(p, x, Float8(-0.2145988016f));
+  p = MulAdd(p, x, Float8(1.5707963050f));
+  return p * Sqrt(Max(Float8(1.0f) - x, Float8(0.0f)));
+}
+
+}  // namespace native_utils
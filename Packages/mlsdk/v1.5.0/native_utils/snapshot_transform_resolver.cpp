@@ -0,0 +1,147 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "snapshot_transform_resolver.h"
+
+namespace {
+
+inline uint64_t HashId(const MLCoordinateFrameUID &id) {
+  uint64_t h = id.data[0] * 0x9E3779B97F4A7C15ull ^ id.data[1];
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ull;
+  return h ^ (h >> 32);
+}
+
+inline bool SameId(const MLCoordinateFrameUID &a, const MLCoordinateFrameUID &b) {
+  return a.data[0] == b.data[0] && a.data[1] == b.data[1];
+}
+
+inline size_t NextPowerOfTwo(size_t value) {
+  size_t result = 16;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+SnapshotTransformResolver::SnapshotTransformResolver(size_t expected_ids) {
+  slots_.resize(NextPowerOfTwo(expected_ids * 2));
+  slot_mask_ = slots_.size() - 1;
+  for (std::vector<float> *column : {&px_, &py_, &pz_, &rx_, &ry_, &rz_, &rw_}) {
+    column->reserve(expected_ids);
+  }
+  results_.reserve(expected_ids);
+  ids_.reserve(expected_ids);
+}
+
+void SnapshotTransformResolver::BeginSnapshot(const MLSnapshot *snapshot) {
+  snapshot_ = snapshot;
+  if (++generation_ == 0) {
+    // Stamps wrapped around; clear them so no stale slot looks occupied.
+    for (Slot &slot : slots_) {
+      slot.stamp = 0;
+    }
+    generation_ = 1;
+  }
+  for (std::vector<float> *column : {&px_, &py_, &pz_, &rx_, &ry_, &rz_, &rw_}) {
+    column->clear();
+  }
+  results_.clear();
+  ids_.clear();
+  api_calls_ = 0;
+  memo_hits_ = 0;
+}
+
+void SnapshotTransformResolver::Grow() {
+  std::vector<Slot> old;
+  old.swap(slots_);
+  slots_.assign(old.size() * 2, Slot{});
+  slot_mask_ = slots_.size() - 1;
+  generation_ = 1;
+  for (size_t entry = 0; entry < ids_.size(); entry++) {
+    size_t index = HashId(ids_[entry]) & slot_mask_;
+    while (slots_[index].stamp == generation_) {
+      index = (index + 1) & slot_mask_;
+    }
+    slots_[index] = Slot{ids_[entry], generation_, (uint32_t)entry};
+  }
+}
+
+uint32_t SnapshotTransformResolver::Lookup(const MLCoordinateFrameUID &id) {
+  size_t index = HashId(id) & slot_mask_;
+  for (;;) {
+    Slot &slot = slots_[index];
+    if (slot.stamp != generation_) {
+      break;
+    }
+    if (SameId(slot.id, id)) {
+      memo_hits_++;
+      return slot.entry;
+    }
+    index = (index + 1) & slot_mask_;
+  }
+
+  // Keep the load factor at or below one half.
+  if ((ids_.size() + 1) * 2 > slots_.size()) {
+    Grow();
+    return Lookup(id);
+  }
+
+  MLTransform transform = {};
+  const MLResult result = MLSnapshotGetTransform(snapshot_, &id, &transform);
+  api_calls_++;
+  if (result != MLResult_Ok) {
+    transform = MLTransform{};
+    transform.rotation.w = 1.0f;
+  }
+
+  const uint32_t entry = (uint32_t)ids_.size();
+  ids_.push_back(id);
+  results_.push_back(result);
+  px_.push_back(transform.position.x);
+  py_.push_back(transform.position.y);
+  pz_.push_back(transform.position.z);
+  rx_.push_back(transform.rotation.x);
+  ry_.push_back(transform.rotation.y);
+  rz_.push_back(transform.rotation.z);
+  rw_.push_back(transform.rotation.w);
+  slots_[index] = Slot{id, generation_, entry};
+  return entry;
+}
+
+MLResult SnapshotTransformResolver::Resolve(const MLCoordinateFrameUID *ids, size_t count,
+                                            const MLTransformBatch &batch) {
+  if (!snapshot_ || (!ids && count)) {
+    return MLResult_InvalidParam;
+  }
+
+  MLResult first_failure = MLResult_Ok;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t entry = Lookup(ids[i]);
+    const MLResult result = results_[entry];
+    if (result != MLResult_Ok && first_failure == MLResult_Ok) {
+      first_failure = result;
+    }
+    if (batch.results) batch.results[i] = result;
+    if (batch.position_x) batch.position_x[i] = px_[entry];
+    if (batch.position_y) batch.position_y[i] = py_[entry];
+    if (batch.position_z) batch.position_z[i] = pz_[entry];
+    if (batch.rotation_x) batch.rotation_x[i] = rx_[entry];
+    if (batch.rotation_y) batch.rotation_y[i] = ry_[entry];
+    if (batch.rotation_z) batch.rotation_z[i] = rz_[entry];
+    if (batch.rotation_w) batch.rotation_w[i] = rw_[entry];
+  }
+  return first_failure;
+}
@@ -0,0 +1,122 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_coordinate_frame_uid.h"
+#include "ml_snapshot.h"
+#include "ml_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils Native Utilities
+  \brief Helpers built on top of the Magic Leap C API.
+  \{
+*/
+
+/*!
+  \brief Destination arrays for SnapshotTransformResolver::Resolve().
+
+  Each non-null array must hold at least as many entries as ids passed to
+  Resolve(). Entries for ids that could not be resolved are set to the
+  identity transform.
+*/
+typedef struct MLTransformBatch {
+  float *position_x;
+  float *position_y;
+  float *position_z;
+  float *rotation_x;
+  float *rotation_y;
+  float *rotation_z;
+  float *rotation_w;
+  /*! Optional per-id result of MLSnapshotGetTransform(). */
+  MLResult *results;
+} MLTransformBatch;
+
+/*!
+  \brief Resolves many coordinate frames against one snapshot.
+
+  Wraps MLSnapshotGetTransform() with a per-snapshot memo keyed by
+  MLCoordinateFrameUID, so every distinct id costs one C API call per
+  snapshot no matter how often or by how many subsystems it is asked for,
+  and writes the poses in structure-of-arrays layout.
+
+  \code
+    resolver.BeginSnapshot(snapshot);
+    resolver.Resolve(ids, count, batch);   // hands, markers, anchors...
+    resolver.Resolve(more_ids, n, other);  // repeated ids hit the memo
+  \endcode
+
+  Not thread safe.
+*/
+class SnapshotTransformResolver {
+public:
+  /*!
+    \param[in] expected_ids Number of distinct ids expected per snapshot; the
+               memo grows beyond it when needed.
+  */
+  explicit SnapshotTransformResolver(size_t expected_ids = 256);
+
+  /*!
+    \brief Starts resolving against a new snapshot and forgets every memoized
+           pose. Must be called whenever the snapshot changes, because a
+           released snapshot's address can be reused by a later one.
+  */
+  void BeginSnapshot(const MLSnapshot *snapshot);
+
+  /*!
+    \brief Resolves `count` ids against the current snapshot.
+
+    \retval MLResult_Ok Every id was resolved.
+    \retval MLResult_InvalidParam No snapshot was set, or ids is null.
+    \return Otherwise the first failure returned by MLSnapshotGetTransform();
+            per-id results are written to batch.results when provided.
+  */
+  MLResult Resolve(const MLCoordinateFrameUID *ids, size_t count, const MLTransformBatch &batch);
+
+  /*! Number of MLSnapshotGetTransform() calls made for the current snapshot. */
+  size_t api_calls() const { return api_calls_; }
+
+  /*! Number of ids served from the memo for the current snapshot. */
+  size_t memo_hits() const { return memo_hits_; }
+
+private:
+  struct Slot {
+    MLCoordinateFrameUID id;
+    // Slot is occupied for the current snapshot iff stamp == generation_.
+    uint32_t stamp;
+    uint32_t entry;
+  };
+
+  uint32_t Lookup(const MLCoordinateFrameUID &id);
+  void Grow();
+
+  const MLSnapshot *snapshot_ = nullptr;
+  uint32_t generation_ = 1;
+  std::vector<Slot> slots_;
+  size_t slot_mask_ = 0;
+
+  // Memoized poses of the current snapshot, in SoA layout.
+  std::vector<float> px_, py_, pz_, rx_, ry_, rz_, rw_;
+  std::vector<MLResult> results_;
+  std::vector<MLCoordinateFrameUID> ids_;
+
+  size_t api_calls_ = 0;
+  size_t memo_hits_ = 0;
+};
+
+/*! \} */
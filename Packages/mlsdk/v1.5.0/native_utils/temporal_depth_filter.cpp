@@ -0,0 +1,277 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "temporal_depth_filter.h"
+
+#include "depth_projection.h"
+#include "simd_float8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using native_utils::DistortedProjection;
+using native_utils::Float8;
+using native_utils::FieldOfViewRadius2;
+using native_utils::RotationMatrix;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+// Weight of a valid pixel at or below confidence_low.
+constexpr float kMinSampleWeight = 0.05f;
+
+}  // namespace
+
+TemporalDepthFilter::TemporalDepthFilter(uint32_t width, uint32_t height,
+                                         const TemporalDepthFilterSettings &settings)
+    : settings_(settings), width_(width), height_(height), unprojector_(2, settings.opengl_axes) {
+  const size_t count = static_cast<size_t>(width) * height;
+  depth_.resize(count);
+  weight_.resize(count);
+  current_.resize(count);
+  warped_depth_.resize(count);
+  warped_weight_.resize(count);
+}
+
+MLResult TemporalDepthFilter::Filter(const MLDepthCameraFrame &frame, float *out_depth) {
+  if (frame.depth_image == nullptr || frame.depth_image->width != width_ || frame.depth_image->height != height_ ||
+      frame.intrinsics.width != width_ || frame.intrinsics.height != height_ ||
+      (frame.confidence != nullptr && frame.confidence->bytes_per_unit != sizeof(float))) {
+    return MLResult_InvalidParam;
+  }
+  DepthMaskSettings mask = settings_.mask;
+  mask.invalid_depth = std::numeric_limits<float>::quiet_NaN();
+  const MLResult result = MaskDepth(frame, mask, current_.data(), nullptr, nullptr);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  Reproject(frame);
+  Blend(frame);
+  FillHoles();
+  pose_ = frame.camera_pose;
+  intrinsics_ = frame.intrinsics;
+  has_history_ = true;
+
+  if (out_depth != nullptr) {
+    const float invalid = settings_.mask.invalid_depth;
+    for (size_t i = 0; i < depth_.size(); i++) {
+      out_depth[i] = depth_[i] == depth_[i] ? depth_[i] : invalid;
+    }
+  }
+  return MLResult_Ok;
+}
+
+void TemporalDepthFilter::Reproject(const MLDepthCameraFrame &frame) {
+  std::fill(warped_depth_.begin(), warped_depth_.end(), std::numeric_limits<float>::infinity());
+  std::fill(warped_weight_.begin(), warped_weight_.end(), 0.0f);
+  if (!has_history_) {
+    return;
+  }
+  const MLDepthCameraIntrinsics &intrinsics = frame.intrinsics;
+  const size_t count = depth_.size();
+
+  const DistortedProjection projection(intrinsics, FieldOfViewRadius2(unprojector_.Rays(intrinsics), width_, height_),
+                                       0.5f);
+  const MLPointBatch rays = unprojector_.Rays(intrinsics_);
+
+  // Previous camera to current camera, R_cur^T R_prev and R_cur^T (t_prev - t_cur),
+  // with the pinhole axes folded into the rows.
+  float previous[3][3], current[3][3];
+  RotationMatrix(pose_.rotation, previous);
+  RotationMatrix(frame.camera_pose.rotation, current);
+  const float offset[3] = {pose_.position.x - frame.camera_pose.position.x,
+                           pose_.position.y - frame.camera_pose.position.y,
+                           pose_.position.z - frame.camera_pose.position.z};
+  const float sign = settings_.opengl_axes ? -1.0f : 1.0f;
+  Float8 r[3][3], t[3];
+  for (int row = 0; row < 3; row++) {
+    const float axis = row == 0 ? 1.0f : sign;
+    float translation = 0.0f;
+    for (int col = 0; col < 3; col++) {
+      float sum = 0.0f;
+      for (int k = 0; k < 3; k++) {
+        sum += current[k][row] * previous[k][col];
+      }
+      r[row][col] = Float8(axis * sum);
+      translation += current[col][row] * offset[col];
+    }
+    t[row] = Float8(axis * translation);
+  }
+  const Float8 zero(0.0f);
+  const Float8 max_u(static_cast<float>(width_ - 1)), max_v(static_cast<float>(height_ - 1));
+  alignas(32) float lanes[5][kLanes], us[kLanes], vs[kLanes], ds[kLanes];
+
+  for (size_t i = 0; i < count; i += kLanes) {
+    const size_t n = std::min<size_t>(kLanes, count - i);
+    const float *in[5] = {&rays.x[i], &rays.y[i], &rays.z[i], &depth_[i], &weight_[i]};
+    if (n < kLanes) {
+      // Pad the last vector with empty history.
+      for (int k = 0; k < 5; k++) {
+        std::fill(lanes[k], lanes[k] + kLanes, 0.0f);
+        memcpy(lanes[k], in[k], n * sizeof(float));
+        in[k] = lanes[k];
+      }
+    }
+    const Float8 d = Float8::Load(in[3]);
+    const Float8 px = Float8::Load(in[0]) * d, py = Float8::Load(in[1]) * d, pz = Float8::Load(in[2]) * d;
+    const Float8 x = MulAdd(px, r[0][0], MulAdd(py, r[0][1], MulAdd(pz, r[0][2], t[0])));
+    const Float8 y = MulAdd(px, r[1][0], MulAdd(py, r[1][1], MulAdd(pz, r[1][2], t[1])));
+    const Float8 z = MulAdd(px, r[2][0], MulAdd(py, r[2][1], MulAdd(pz, r[2][2], t[2])));
+    Float8 u, v;
+    const Float8 visible = projection.Project(x, y, z, &u, &v);
+    const int inside = ((d > zero) & (Float8::Load(in[4]) > zero) & visible & (u >= zero) & (u <= max_u) &
+                        (v >= zero) & (v <= max_v))
+                           .MoveMask();
+    if (inside == 0) {
+      continue;
+    }
+    u.Store(us);
+    v.Store(vs);
+    Sqrt(MulAdd(x, x, MulAdd(y, y, z * z))).Store(ds);
+    for (int lane = 0; lane < kLanes; lane++) {
+      if (((inside >> lane) & 1) == 0) {
+        continue;
+      }
+      const size_t target = static_cast<size_t>(vs[lane]) * width_ + static_cast<size_t>(us[lane]);
+      if (ds[lane] < warped_depth_[target]) {
+        warped_depth_[target] = ds[lane];
+        warped_weight_[target] = in[4][lane];
+      }
+    }
+  }
+}
+
+void TemporalDepthFilter::Blend(const MLDepthCameraFrame &frame) {
+  const bool weighted = frame.confidence != nullptr && settings_.confidence_high > settings_.confidence_low;
+  const Float8 low(settings_.confidence_low);
+  const Float8 inv_range(weighted ? 1.0f / (settings_.confidence_high - settings_.confidence_low) : 0.0f);
+  const Float8 min_sample(kMinSampleWeight), one(1.0f), zero(0.0f);
+  const Float8 tolerance(settings_.relative_tolerance), max_weight(settings_.max_weight);
+  const Float8 decay(settings_.hold_decay), min_weight(settings_.min_weight);
+  const Float8 infinity(std::numeric_limits<float>::infinity()), nan(std::numeric_limits<float>::quiet_NaN());
+  alignas(32) float lanes[4][kLanes], out_depth[kLanes], out_weight[kLanes];
+
+  for (uint32_t v = 0; v < height_; v++) {
+    const size_t row = static_cast<size_t>(v) * width_;
+    const float *confidence =
+        weighted ? reinterpret_cast<const float *>(static_cast<const uint8_t *>(frame.confidence->data) +
+                                                   static_cast<size_t>(v) * frame.confidence->stride)
+                 : nullptr;
+    for (uint32_t u = 0; u < width_; u += kLanes) {
+      const size_t n = std::min<size_t>(kLanes, width_ - u);
+      const float *in[4] = {&current_[row + u], &warped_depth_[row + u], &warped_weight_[row + u],
+                            weighted ? confidence + u : nullptr};
+      if (n < kLanes) {
+        for (int k = 0; k < 4; k++) {
+          std::fill(lanes[k], lanes[k] + kLanes, 0.0f);
+          if (in[k] != nullptr) {
+            memcpy(lanes[k], in[k], n * sizeof(float));
+            in[k] = lanes[k];
+          }
+        }
+      }
+      const Float8 c = Float8::Load(in[0]), h = Float8::Load(in[1]), history_weight = Float8::Load(in[2]);
+      const Float8 sample_weight =
+          weighted ? Min(Max((Float8::Load(in[3]) - low) * inv_range, min_sample), one) : one;
+      const Float8 has_current = c > zero;
+      const Float8 has_history = (h < infinity) & (history_weight > zero);
+      const Float8 agree = has_history & (Abs(c - h) <= tolerance * c);
+      const Float8 sum = sample_weight + history_weight;
+      const Float8 blended = MulAdd(c, sample_weight, h * history_weight) / sum;
+      const Float8 held_weight = history_weight * decay;
+      const Float8 held = has_history & (held_weight >= min_weight);
+
+      Float8 depth = Select(agree, blended, c);
+      Float8 weight = Select(agree, Min(sum, max_weight), sample_weight);
+      depth = Select(has_current, depth, Select(held, h, nan));
+      weight = Select(has_current, weight, Select(held, held_weight, zero));
+      if (n == kLanes) {
+        depth.Store(&depth_[row + u]);
+        weight.Store(&weight_[row + u]);
+      } else {
+        depth.Store(out_depth);
+        weight.Store(out_weight);
+        memcpy(&depth_[row + u], out_depth, n * sizeof(float));
+        memcpy(&weight_[row + u], out_weight, n * sizeof(float));
+      }
+    }
+  }
+}
+
+void TemporalDepthFilter::FillHoles() {
+  if (width_ < 3 || height_ < 3) {
+    return;
+  }
+  const float tolerance = settings_.relative_tolerance;
+  const float min_neighbours = static_cast<float>(settings_.fill_min_neighbours);
+  // Fills hole (u, v) with the mean of its valid neighbours when they agree; filled
+  // pixels get no weight so they never become history.
+  auto fill_pixel = [&](const float *source, float *target, size_t i) {
+    if (source[i] == source[i]) {
+      return;
+    }
+    float sum = 0.0f, low = std::numeric_limits<float>::infinity(), high = 0.0f, count = 0.0f;
+    for (int dv = -1; dv <= 1; dv++) {
+      for (int du = -1; du <= 1; du++) {
+        const float d = source[i + dv * static_cast<ptrdiff_t>(width_) + du];
+        if (d > 0.0f) {
+          sum += d;
+          low = std::min(low, d);
+          high = std::max(high, d);
+          count += 1.0f;
+        }
+      }
+    }
+    if (count >= min_neighbours && high - low <= tolerance * low) {
+      target[i] = sum / count;
+    }
+  };
+  const Float8 zero(0.0f), one(1.0f), needed(min_neighbours), spread(tolerance);
+  const Float8 infinity(std::numeric_limits<float>::infinity());
+  for (uint32_t iteration = 0; iteration < settings_.fill_iterations; iteration++) {
+    // Read the previous pass, write the next one.
+    memcpy(current_.data(), depth_.data(), depth_.size() * sizeof(float));
+    const float *source = depth_.data();
+    float *target = current_.data();
+    for (uint32_t v = 1; v + 1 < height_; v++) {
+      const size_t row = static_cast<size_t>(v) * width_;
+      uint32_t u = 1;
+      for (; u + kLanes < width_; u += kLanes) {
+        const size_t i = row + u;
+        const Float8 center = Float8::Load(source + i);
+        if ((center > zero).MoveMask() == 0xff) {
+          continue;
+        }
+        Float8 sum = zero, low = infinity, high = zero, count = zero;
+        for (int dv = -1; dv <= 1; dv++) {
+          for (int du = -1; du <= 1; du++) {
+            const Float8 d = Float8::Load(source + i + dv * static_cast<ptrdiff_t>(width_) + du);
+            const Float8 valid = d > zero;
+            sum = sum + Select(valid, d, zero);
+            low = Min(low, Select(valid, d, infinity));
+            high = Max(high, Select(valid, d, zero));
+            count = count + Select(valid, one, zero);
+          }
+        }
+        const Float8 fill = AndNot(center > zero, (count >= needed) & (high - low <= spread * low));
+        Select(fill, sum / count, center).Store(target + i);
+      }
+      for (; u + 1 < width_; u++) {
+        fill_pixel(source, target, row + u);
+      }
+    }
+    depth_.swap(current_);
+  }
+}
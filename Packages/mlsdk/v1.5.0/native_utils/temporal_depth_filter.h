@@ -0,0 +1,137 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include "depth_mask.h"
+#include "depth_unprojector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Parameters of a TemporalDepthFilter. */
+typedef struct TemporalDepthFilterSettings {
+  /*! Pixels of each frame to use; invalid_depth is written where the output has no depth. */
+  DepthMaskSettings mask;
+  /*!
+    \brief Confidences mapped linearly to sample weights 0 to 1. Set both to
+           the same value to weight every pixel 1.
+  */
+  float confidence_low;
+  float confidence_high;
+  /*! Cap on the accumulated weight, i.e. the number of frames averaged. */
+  float max_weight;
+  /*! History is dropped where a new depth differs from it by more than this fraction. */
+  float relative_tolerance;
+  /*! Factor applied to the weight of history that the current frame did not observe. */
+  float hold_decay;
+  /*! History below this weight is dropped. */
+  float min_weight;
+  /*! Hole filling passes; each closes holes one pixel further from valid depth. */
+  uint32_t fill_iterations;
+  /*! Valid pixels among the 8 neighbours needed to fill a hole pixel. */
+  uint32_t fill_min_neighbours;
+  /*! Whether camera poses follow the OpenGL camera convention, see DepthUnprojector. */
+  bool opengl_axes;
+} TemporalDepthFilterSettings;
+
+/*!
+  \brief Initializes TemporalDepthFilterSettings to average up to 8 frames,
+         hold dropouts for about two frames and fill single-pixel holes.
+*/
+inline void TemporalDepthFilterSettingsInit(TemporalDepthFilterSettings *inout_settings) {
+  if (inout_settings) {
+    DepthMaskSettingsInit(&inout_settings->mask);
+    inout_settings->confidence_low = 0.0f;
+    inout_settings->confidence_high = 0.0f;
+    inout_settings->max_weight = 8.0f;
+    inout_settings->relative_tolerance = 0.03f;
+    inout_settings->hold_decay = 0.5f;
+    inout_settings->min_weight = 0.2f;
+    inout_settings->fill_iterations = 1;
+    inout_settings->fill_min_neighbours = 5;
+    inout_settings->opengl_axes = false;
+  }
+}
+
+/*!
+  \brief Reduces noise and dropouts of a depth stream.
+
+  The filter keeps the previous filtered depth and its weight. For each
+  frame it reprojects that history into the new camera pose, using the
+  pose delta and the cached pixel rays, eight pixels at a time with a
+  z-buffer. It then blends history and new depth per pixel by weight, the
+  new depth weighted by its confidence. Where the two disagree beyond
+  relative_tolerance the new depth replaces the history, so motion and
+  disocclusions do not smear. Pixels the frame dropped keep decaying
+  history for a few frames, and small remaining holes are filled from
+  their neighbours when those agree.
+
+  All buffers are allocated for one image size at construction, except the
+  ray table built on the first frame; frames of another size are rejected.
+
+  Not thread safe.
+*/
+class TemporalDepthFilter {
+public:
+  TemporalDepthFilter(uint32_t width, uint32_t height, const TemporalDepthFilterSettings &settings);
+
+  /*!
+    \brief Filters `frame` and makes it the history for the next one.
+
+    \param[in] frame Frame with a float depth image and optional confidence
+               and flags buffers of the filter's size.
+    \param[out] out_depth Optional filtered radial depth, width * height floats.
+
+    \retval MLResult_Ok The frame was filtered.
+    \retval MLResult_InvalidParam The frame's size or buffers do not match.
+  */
+  MLResult Filter(const MLDepthCameraFrame &frame, float *out_depth);
+
+  /*! Drops the history; the next frame passes through unfiltered apart from hole filling. */
+  void Reset() { has_history_ = false; }
+
+private:
+  void Reproject(const MLDepthCameraFrame &frame);
+  void Blend(const MLDepthCameraFrame &frame);
+  void FillHoles();
+
+  TemporalDepthFilterSettings settings_;
+  uint32_t width_;
+  uint32_t height_;
+  DepthUnprojector unprojector_;
+
+  // History in the previous camera: depth (NaN where empty) and weight.
+  std::vector<float> depth_;
+  std::vector<float> weight_;
+  MLTransform pose_;
+  MLDepthCameraIntrinsics intrinsics_;
+  bool has_history_ = false;
+
+  // Per-frame scratch.
+  std::vector<float> current_;
+  std::vector<float> warped_depth_;
+  std::vector<float> warped_weight_;
+};
+
+/*! \} */
@@ -0,0 +1,79 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "depth_frame_ring.h"
+
+#include "test_check.h"
+
+#include <cstdio>
+
+namespace {
+
+// Data handed out by the stub camera and not yet released.
+int outstanding = 0;
+uint64_t frame_number = 0;
+
+}  // namespace
+
+// Stands in for perception.magicleap: every call returns new data.
+MLResult MLDepthCameraGetLatestDepthData(MLHandle, uint64_t, MLDepthCameraData *out_data) {
+  MLDepthCameraFrame *frame = new MLDepthCameraFrame();
+  frame->frame_number = ++frame_number;
+  out_data->frame_count = 1;
+  out_data->frames = frame;
+  outstanding++;
+  return MLResult_Ok;
+}
+
+MLResult MLDepthCameraReleaseDepthData(MLHandle, MLDepthCameraData *depth_camera_data) {
+  delete depth_camera_data->frames;
+  depth_camera_data->frames = nullptr;
+  outstanding--;
+  return MLResult_Ok;
+}
+
+int main() {
+  {
+    DepthFrameRing ring(1, 3);
+    DepthFrameView view;
+    CHECK(ring.Poll(100, &view) == MLResult_Ok);
+    CHECK(view && view.get()->frames->frame_number == 1);
+    CHECK(ring.Poll(100, nullptr) == MLResult_Ok);
+    // Replacing the view drops the last reference to the first slot.
+    CHECK(ring.Poll(100, &view) == MLResult_Ok);
+    CHECK(view.get()->frames->frame_number == 3);
+    CHECK(ring.Latest().sequence() == view.sequence());
+    for (int i = 0; i < 10; i++) {
+      CHECK(ring.Poll(100, &view) == MLResult_Ok);
+    }
+    CHECK(view.get()->frames->frame_number == 13);
+    CHECK(ring.in_use() <= 3);
+
+    // Every slot held by a view: Poll() times out instead of growing.
+    DepthFrameView held[2] = {view, ring.Latest()};
+    DepthFrameView first;
+    CHECK(ring.Poll(100, &first) == MLResult_Ok);
+    CHECK(ring.Poll(100, &held[1]) == MLResult_Ok);
+    CHECK(ring.Poll(10, nullptr) == MLResult_Timeout);
+
+    first.reset();
+    held[0].reset();
+    held[1].reset();
+    view.reset();
+    ring.ReleaseUnused();
+    CHECK(ring.in_use() == static_cast<size_t>(outstanding));
+  }
+  CHECK(outstanding == 0);
+  printf("depth_frame_ring_test passed\n");
+  return 0;
+}
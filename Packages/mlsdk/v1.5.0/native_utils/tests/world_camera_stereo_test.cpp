@@ -0,0 +1,132 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "world_camera_stereo.h"
+
+#include "depth_projection.h"
+#include "test_check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using native_utils::RotationMatrix;
+
+namespace {
+
+constexpr uint32_t kWidth = 640;
+constexpr uint32_t kHeight = 480;
+constexpr float kFocal = 250.0f;
+constexpr float kBaseline = 0.1f;
+// Distance of the textured plane facing both cameras.
+constexpr float kPlaneZ = 1.0f;
+
+float Hash(int x, int y) {
+  uint32_t h = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(y) * 668265263u;
+  h = (h ^ (h >> 13)) * 1274126177u;
+  return static_cast<float>(h ^ (h >> 16)) / 4294967296.0f;
+}
+
+// Smooth value noise with features about `cell` meters apart.
+float Noise(float x, float y, float cell) {
+  x /= cell;
+  y /= cell;
+  const float fx = std::floor(x), fy = std::floor(y);
+  const int ix = static_cast<int>(fx), iy = static_cast<int>(fy);
+  const float tx = (x - fx) * (x - fx) * (3.0f - 2.0f * (x - fx));
+  const float ty = (y - fy) * (y - fy) * (3.0f - 2.0f * (y - fy));
+  const float top = Hash(ix, iy) + (Hash(ix + 1, iy) - Hash(ix, iy)) * tx;
+  const float bottom = Hash(ix, iy + 1) + (Hash(ix + 1, iy + 1) - Hash(ix, iy + 1)) * tx;
+  return top + (bottom - top) * ty;
+}
+
+// Renders the plane from a pinhole camera at (x, 0, 0) looking down +z.
+void Render(float camera_x, MLWorldCameraIdentifier id, std::vector<uint8_t> *pixels, MLWorldCameraFrame *frame) {
+  pixels->resize(kWidth * kHeight);
+  for (uint32_t v = 0; v < kHeight; v++) {
+    for (uint32_t u = 0; u < kWidth; u++) {
+      const float x = camera_x + (u - 0.5f * (kWidth - 1)) / kFocal * kPlaneZ;
+      const float y = (v - 0.5f * (kHeight - 1)) / kFocal * kPlaneZ;
+      const float value = 0.6f * Noise(x, y, 0.05f) + 0.4f * Noise(x, y, 0.02f);
+      (*pixels)[v * kWidth + u] = static_cast<uint8_t>(value * 255.0f);
+    }
+  }
+  memset(frame, 0, sizeof(*frame));
+  frame->id = id;
+  frame->intrinsics.width = kWidth;
+  frame->intrinsics.height = kHeight;
+  frame->intrinsics.focal_length.x = frame->intrinsics.focal_length.y = kFocal;
+  frame->intrinsics.principal_point.x = 0.5f * (kWidth - 1);
+  frame->intrinsics.principal_point.y = 0.5f * (kHeight - 1);
+  frame->camera_pose.rotation.w = 1.0f;
+  frame->camera_pose.position.x = camera_x;
+  frame->frame_buffer.width = kWidth;
+  frame->frame_buffer.height = kHeight;
+  frame->frame_buffer.stride = kWidth;
+  frame->frame_buffer.bytes_per_pixel = 1;
+  frame->frame_buffer.size = kWidth * kHeight;
+  frame->frame_buffer.data = pixels->data();
+}
+
+float Median(std::vector<float> *values) {
+  std::nth_element(values->begin(), values->begin() + values->size() / 2, values->end());
+  return (*values)[values->size() / 2];
+}
+
+}  // namespace
+
+int main() {
+  std::vector<uint8_t> left_pixels, right_pixels;
+  MLWorldCameraFrame left, right;
+  Render(-0.5f * kBaseline, MLWorldCameraIdentifier_Left, &left_pixels, &left);
+  Render(0.5f * kBaseline, MLWorldCameraIdentifier_Right, &right_pixels, &right);
+
+  WorldCameraStereoSettings settings;
+  WorldCameraStereoSettingsInit(&settings);
+  settings.distortion_model = WorldCameraDistortionModel_RadialTangential;
+  WorldCameraStereo stereo(settings);
+  CHECK(stereo.Compute(left, right) == MLResult_Ok);
+  CHECK(std::fabs(stereo.baseline() - kBaseline) < 1e-4f);
+
+  // Depth must be the distance along each pixel's ray, which toward the
+  // corners is well beyond the plane's z.
+  const MLDepthCameraIntrinsics &intrinsics = stereo.intrinsics();
+  const MLTransform &pose = stereo.pose();
+  float rotation[3][3];
+  RotationMatrix(pose.rotation, rotation);
+  const float *depth = static_cast<const float *>(stereo.depth().data);
+  std::vector<float> center_errors, corner_errors;
+  for (uint32_t v = 0; v < stereo.height(); v++) {
+    for (uint32_t u = 0; u < stereo.width(); u++) {
+      const float measured = depth[v * stereo.width() + u];
+      if (!(measured > 0.0f)) {
+        continue;
+      }
+      const float ray[3] = {(u - intrinsics.principal_point.x) / intrinsics.focal_length.x,
+                            (v - intrinsics.principal_point.y) / intrinsics.focal_length.y, 1.0f};
+      const float length = std::sqrt(ray[0] * ray[0] + ray[1] * ray[1] + 1.0f);
+      const float ray_z = rotation[2][0] * ray[0] + rotation[2][1] * ray[1] + rotation[2][2];
+      const float expected = (kPlaneZ - pose.position.z) / ray_z * length;
+      (length > 1.2f ? corner_errors : center_errors).push_back(std::fabs(measured - expected) / expected);
+    }
+  }
+  const size_t pixels = static_cast<size_t>(stereo.width()) * stereo.height();
+  CHECK(center_errors.size() + corner_errors.size() > pixels / 2);
+  CHECK(corner_errors.size() > pixels / 10);
+  CHECK(Median(&center_errors) < 0.03f);
+  CHECK(Median(&corner_errors) < 0.03f);
+  printf("world_camera_stereo_test passed\n");
+  return 0;
+}
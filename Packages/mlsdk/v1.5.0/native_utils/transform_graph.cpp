@@ -0,0 +1,273 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "transform_graph.h"
+
+#include "simd_float8.h"
+
+#include <algorithm>
+
+using native_utils::Float8;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+
+const MLTransform kIdentity = {{{{0.0f, 0.0f, 0.0f, 1.0f}}}, {{{0.0f, 0.0f, 0.0f}}}};
+
+MLQuaternionf Multiply(const MLQuaternionf &a, const MLQuaternionf &b) {
+  MLQuaternionf r;
+  r.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  r.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  r.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  r.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return r;
+}
+
+MLVec3f Rotate(const MLQuaternionf &q, const MLVec3f &v) {
+  // v + w t + q.xyz x t, with t = 2 q.xyz x v
+  const float tx = 2.0f * (q.y * v.z - q.z * v.y);
+  const float ty = 2.0f * (q.z * v.x - q.x * v.z);
+  const float tz = 2.0f * (q.x * v.y - q.y * v.x);
+  MLVec3f r;
+  r.x = v.x + q.w * tx + (q.y * tz - q.z * ty);
+  r.y = v.y + q.w * ty + (q.z * tx - q.x * tz);
+  r.z = v.z + q.w * tz + (q.x * ty - q.y * tx);
+  return r;
+}
+
+// a * b: b expressed in a's parent.
+MLTransform Compose(const MLTransform &a, const MLTransform &b) {
+  MLTransform r;
+  r.rotation = Multiply(a.rotation, b.rotation);
+  const MLVec3f p = Rotate(a.rotation, b.position);
+  r.position.x = a.position.x + p.x;
+  r.position.y = a.position.y + p.y;
+  r.position.z = a.position.z + p.z;
+  return r;
+}
+
+}  // namespace
+
+TransformGraph::TransformGraph() {
+  const MLCoordinateFrameUID none = {{0, 0}};
+  Add(Kind::World, kWorld, none, kIdentity);
+  nodes_[kWorld].local_result = MLResult_Ok;
+  nodes_[kWorld].result = MLResult_Ok;
+}
+
+TransformGraph::Node TransformGraph::Add(Kind kind, Node parent, const MLCoordinateFrameUID &id,
+                                         const MLTransform &local) {
+  const Node node = static_cast<Node>(nodes_.size());
+  if (kind != Kind::World && parent >= nodes_.size()) {
+    kind = Kind::Invalid;
+    parent = kWorld;
+  }
+  Entry entry;
+  entry.kind = kind;
+  entry.parent = parent;
+  entry.id = id;
+  entry.local = local;
+  entry.world = kIdentity;
+  entry.local_result = MLResult_Ok;
+  entry.result = MLResult_Ok;
+  entry.local_stamp = 0;
+  entry.world_stamp = 0;
+  nodes_.push_back(entry);
+  if (kind != Kind::World) {
+    nodes_[parent].children.push_back(node);
+  }
+  return node;
+}
+
+TransformGraph::Node TransformGraph::AddFrame(const MLCoordinateFrameUID &id) {
+  return Add(Kind::Frame, kWorld, id, kIdentity);
+}
+
+TransformGraph::Node TransformGraph::AddFrameInBase(Node base, const MLCoordinateFrameUID &id) {
+  if (base >= nodes_.size() || (nodes_[base].kind != Kind::Frame && nodes_[base].kind != Kind::FrameInBase)) {
+    base = static_cast<Node>(nodes_.size() + 1);
+  }
+  return Add(Kind::FrameInBase, base, id, kIdentity);
+}
+
+TransformGraph::Node TransformGraph::AddOffset(Node parent, const MLTransform &offset) {
+  const MLCoordinateFrameUID none = {{0, 0}};
+  return Add(Kind::Offset, parent, none, offset);
+}
+
+MLResult TransformGraph::SetOffset(Node node, const MLTransform &offset) {
+  if (node >= nodes_.size() || nodes_[node].kind != Kind::Offset) {
+    return MLResult_InvalidParam;
+  }
+  nodes_[node].local = offset;
+  path_.assign(1, node);
+  while (!path_.empty()) {
+    Entry &entry = nodes_[path_.back()];
+    path_.pop_back();
+    if (entry.world_stamp == 0) {
+      // Descendants of a node that was never resolved were never resolved either.
+      continue;
+    }
+    entry.world_stamp = 0;
+    path_.insert(path_.end(), entry.children.begin(), entry.children.end());
+  }
+  return MLResult_Ok;
+}
+
+void TransformGraph::BeginSnapshot(const MLSnapshot *snapshot) {
+  snapshot_ = snapshot;
+  api_calls_ = 0;
+  if (++generation_ == 0) {
+    for (Entry &entry : nodes_) {
+      entry.local_stamp = 0;
+      entry.world_stamp = 0;
+    }
+    generation_ = 1;
+  }
+}
+
+MLResult TransformGraph::Resolve(Node node) {
+  if (node >= nodes_.size() || snapshot_ == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  path_.clear();
+  for (Node n = node; n != kWorld && nodes_[n].world_stamp != generation_; n = nodes_[n].parent) {
+    path_.push_back(n);
+  }
+  for (size_t i = path_.size(); i-- > 0;) {
+    Entry &entry = nodes_[path_[i]];
+    const Entry &parent = nodes_[entry.parent];
+    entry.world_stamp = generation_;
+    entry.result = parent.result;
+    if (entry.result != MLResult_Ok) {
+      continue;
+    }
+    if (entry.local_stamp != generation_) {
+      entry.local_stamp = generation_;
+      switch (entry.kind) {
+        case Kind::Frame:
+          api_calls_++;
+          entry.local_result = MLSnapshotGetTransform(snapshot_, &entry.id, &entry.local);
+          break;
+        case Kind::FrameInBase: {
+          MLPose pose = {};
+          api_calls_++;
+          entry.local_result = MLSnapshotGetPoseInBase(snapshot_, &parent.id, &entry.id, &pose);
+          entry.local = pose.transform;
+          break;
+        }
+        case Kind::Invalid:
+          entry.local_result = MLResult_InvalidParam;
+          break;
+        default:
+          entry.local_result = MLResult_Ok;
+          break;
+      }
+    }
+    entry.result = entry.local_result;
+    if (entry.result == MLResult_Ok) {
+      entry.world = entry.parent == kWorld ? entry.local : Compose(parent.world, entry.local);
+    }
+  }
+  return nodes_[node].result;
+}
+
+MLResult TransformGraph::GetWorldPose(Node node, MLTransform *out) {
+  if (out == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const MLResult result = Resolve(node);
+  *out = result == MLResult_Ok ? nodes_[node].world : kIdentity;
+  return result;
+}
+
+MLResult TransformGraph::GetRelativePose(Node node, Node base, MLTransform *out) {
+  if (out == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  const MLTransformBatch batch = {&out->position.x, &out->position.y, &out->position.z, &out->rotation.x,
+                                  &out->rotation.y, &out->rotation.z, &out->rotation.w, nullptr};
+  return GetRelativePoses(&node, 1, base, batch);
+}
+
+MLResult TransformGraph::GetRelativePoses(const Node *nodes, size_t count, Node base, const MLTransformBatch &batch) {
+  if (nodes == nullptr && count > 0) {
+    return MLResult_InvalidParam;
+  }
+  const MLResult base_result = Resolve(base);
+  MLResult overall = base_result;
+
+  // inverse(base) * world: rotate by conj(qb) and translate by -pb first.
+  const MLTransform &b = base_result == MLResult_Ok ? nodes_[base].world : kIdentity;
+  const Float8 bx(-b.rotation.x), by(-b.rotation.y), bz(-b.rotation.z), bw(b.rotation.w);
+  const Float8 two(2.0f);
+  float *const position[3] = {batch.position_x, batch.position_y, batch.position_z};
+  float *const rotation[4] = {batch.rotation_x, batch.rotation_y, batch.rotation_z, batch.rotation_w};
+  alignas(32) float lanes[7][kLanes];
+  MLResult results[kLanes];
+
+  for (size_t first = 0; first < count; first += kLanes) {
+    const size_t block = std::min<size_t>(kLanes, count - first);
+    for (size_t lane = 0; lane < static_cast<size_t>(kLanes); lane++) {
+      MLResult result = MLResult_InvalidParam;
+      const MLTransform *world = &kIdentity;
+      if (lane < block) {
+        result = base_result == MLResult_Ok ? Resolve(nodes[first + lane]) : base_result;
+        if (result == MLResult_Ok) {
+          world = &nodes_[nodes[first + lane]].world;
+        }
+      }
+      results[lane] = result;
+      lanes[0][lane] = world->position.x - b.position.x;
+      lanes[1][lane] = world->position.y - b.position.y;
+      lanes[2][lane] = world->position.z - b.position.z;
+      lanes[3][lane] = world->rotation.x;
+      lanes[4][lane] = world->rotation.y;
+      lanes[5][lane] = world->rotation.z;
+      lanes[6][lane] = world->rotation.w;
+    }
+
+    const Float8 vx = Float8::Load(lanes[0]), vy = Float8::Load(lanes[1]), vz = Float8::Load(lanes[2]);
+    const Float8 qx = Float8::Load(lanes[3]), qy = Float8::Load(lanes[4]), qz = Float8::Load(lanes[5]);
+    const Float8 qw = Float8::Load(lanes[6]);
+    const Float8 tx = two * (by * vz - bz * vy);
+    const Float8 ty = two * (bz * vx - bx * vz);
+    const Float8 tz = two * (bx * vy - by * vx);
+    (vx + bw * tx + (by * tz - bz * ty)).Store(lanes[0]);
+    (vy + bw * ty + (bz * tx - bx * tz)).Store(lanes[1]);
+    (vz + bw * tz + (bx * ty - by * tx)).Store(lanes[2]);
+    (bw * qx + bx * qw + by * qz - bz * qy).Store(lanes[3]);
+    (bw * qy - bx * qz + by * qw + bz * qx).Store(lanes[4]);
+    (bw * qz + bx * qy - by * qx + bz * qw).Store(lanes[5]);
+    (bw * qw - bx * qx - by * qy - bz * qz).Store(lanes[6]);
+
+    for (size_t lane = 0; lane < block; lane++) {
+      const size_t i = first + lane;
+      const bool ok = results[lane] == MLResult_Ok;
+      for (int c = 0; c < 3; c++) {
+        if (position[c] != nullptr) position[c][i] = ok ? lanes[c][lane] : 0.0f;
+      }
+      for (int c = 0; c < 4; c++) {
+        if (rotation[c] != nullptr) rotation[c][i] = ok ? lanes[3 + c][lane] : (c == 3 ? 1.0f : 0.0f);
+      }
+      if (batch.results != nullptr) {
+        batch.results[i] = results[lane];
+      }
+      if (!ok && overall == MLResult_Ok) {
+        overall = results[lane];
+      }
+    }
+  }
+  return overall;
+}
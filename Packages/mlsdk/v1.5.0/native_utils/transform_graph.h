@@ -0,0 +1,142 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_coordinate_frame_uid.h"
+#include "ml_snapshot.h"
+#include "ml_types.h"
+#include "snapshot_transform_resolver.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*!
+  \brief Tree of coordinate frames whose poses are resolved at most once per
+         snapshot.
+
+  Nodes are world-tracked frames (MLSnapshotGetTransform()), frames tracked
+  relative to another frame node (MLSnapshotGetPoseInBase()), or fixed
+  app-defined offsets such as a mesh block inside a space or a marker inside
+  an anchor. World poses are composed lazily down the tree and memoized until
+  the next snapshot; changing an offset only invalidates that node's
+  subtree, and never costs another C API call.
+
+  \code
+    TransformGraph graph;
+    TransformGraph::Node anchor = graph.AddFrame(anchor_id);
+    TransformGraph::Node marker = graph.AddOffset(anchor, marker_in_anchor);
+
+    graph.BeginSnapshot(snapshot);
+    graph.GetRelativePoses(markers, count, anchor, batch);  // SIMD
+  \endcode
+
+  Not thread safe.
+*/
+class TransformGraph {
+public:
+  typedef uint32_t Node;
+
+  /*! The world origin; parent of every frame added with AddFrame(). */
+  static constexpr Node kWorld = 0;
+
+  TransformGraph();
+
+  /*! Adds a frame whose world pose comes from MLSnapshotGetTransform(). */
+  Node AddFrame(const MLCoordinateFrameUID &id);
+
+  /*!
+    \brief Adds a frame whose pose relative to `base` comes from
+           MLSnapshotGetPoseInBase(). `base` must be a frame node.
+  */
+  Node AddFrameInBase(Node base, const MLCoordinateFrameUID &id);
+
+  /*! Adds a node at a fixed offset from `parent`. */
+  Node AddOffset(Node parent, const MLTransform &offset);
+
+  /*!
+    \brief Changes the offset of a node added with AddOffset() and
+           invalidates the cached poses of the node and its descendants.
+
+    \retval MLResult_Ok The offset was changed.
+    \retval MLResult_InvalidParam node is not an offset node.
+  */
+  MLResult SetOffset(Node node, const MLTransform &offset);
+
+  /*! Starts resolving against a new snapshot and forgets every cached pose. */
+  void BeginSnapshot(const MLSnapshot *snapshot);
+
+  /*!
+    \brief Returns the world pose of `node`.
+
+    \retval MLResult_Ok out holds the pose.
+    \retval MLResult_InvalidParam node is unknown, out is null, or no snapshot was set.
+    \return Otherwise the C API failure of the node or one of its ancestors.
+  */
+  MLResult GetWorldPose(Node node, MLTransform *out);
+
+  /*! Returns the pose of `node` expressed in the coordinates of `base`. */
+  MLResult GetRelativePose(Node node, Node base, MLTransform *out);
+
+  /*!
+    \brief Returns the poses of `count` nodes expressed in the coordinates
+           of `base`, composed eight at a time.
+
+    Per-node results are written to batch.results when provided; poses that
+    could not be resolved are set to identity.
+
+    \retval MLResult_Ok Every pose was resolved.
+    \return Otherwise the first failure.
+  */
+  MLResult GetRelativePoses(const Node *nodes, size_t count, Node base, const MLTransformBatch &batch);
+
+  /*! Number of C API calls made for the current snapshot. */
+  size_t api_calls() const { return api_calls_; }
+
+private:
+  // Invalid nodes were added with a bad parent and always fail to resolve.
+  enum class Kind : uint8_t { World, Frame, FrameInBase, Offset, Invalid };
+
+  struct Entry {
+    Kind kind;
+    Node parent;
+    MLCoordinateFrameUID id;
+    // Pose relative to the parent: fetched per snapshot for frames, fixed for offsets.
+    MLTransform local;
+    MLTransform world;
+    MLResult local_result;
+    MLResult result;
+    // local/world are current iff their stamps equal generation_.
+    uint32_t local_stamp;
+    uint32_t world_stamp;
+    std::vector<Node> children;
+  };
+
+  Node Add(Kind kind, Node parent, const MLCoordinateFrameUID &id, const MLTransform &local);
+  MLResult Resolve(Node node);
+
+  const MLSnapshot *snapshot_ = nullptr;
+  uint32_t generation_ = 1;
+  std::vector<Entry> nodes_;
+  std::vector<Node> path_;
+  size_t api_calls_ = 0;
+};
+
+/*! \} */
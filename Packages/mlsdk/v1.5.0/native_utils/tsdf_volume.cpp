@@ -0,0 +1,425 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "tsdf_volume.h"
+
+#include "depth_projection.h"
+#include "simd_float8.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using native_utils::DistortedProjection;
+using native_utils::Float8;
+using native_utils::FieldOfViewRadius2;
+using native_utils::RotationMatrix;
+using native_utils::WorkerPool;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+constexpr int kSide = TsdfVolume::kBlockVoxels;
+constexpr int kVoxels = kSide * kSide * kSide;
+// Voxels -1..kSide of a block and its neighbours, as read by the mesher.
+constexpr int kApron = kSide + 2;
+// Cells whose lowest corner is -1..kSide-1.
+constexpr int kCells = kSide + 1;
+constexpr int kKeyBits = 21;
+constexpr int32_t kKeyBias = 1 << (kKeyBits - 1);
+constexpr uint64_t kKeyMask = (uint64_t(1) << kKeyBits) - 1;
+
+static_assert(kSide == kLanes, "voxel rows are processed one vector at a time");
+
+uint64_t Key(int32_t x, int32_t y, int32_t z) {
+  return (uint64_t(uint32_t(x + kKeyBias)) & kKeyMask) << (2 * kKeyBits) |
+         (uint64_t(uint32_t(y + kKeyBias)) & kKeyMask) << kKeyBits | (uint64_t(uint32_t(z + kKeyBias)) & kKeyMask);
+}
+
+void Unkey(uint64_t key, int32_t *x, int32_t *y, int32_t *z) {
+  *x = int32_t((key >> (2 * kKeyBits)) & kKeyMask) - kKeyBias;
+  *y = int32_t((key >> kKeyBits) & kKeyMask) - kKeyBias;
+  *z = int32_t(key & kKeyMask) - kKeyBias;
+}
+
+}  // namespace
+
+struct TsdfVolume::Block {
+  int32_t x, y, z;
+  // Signed distance over the truncation, in [-1, 1], indexed (z * 8 + y) * 8 + x.
+  float sdf[kVoxels];
+  float weight[kVoxels];
+  // Last frame that visited the block.
+  uint64_t frame = 0;
+  bool changed = false;
+  bool dirty = false;
+};
+
+TsdfVolume::TsdfVolume(const TsdfVolumeSettings &settings)
+    : settings_(settings),
+      block_size_(settings.voxel_size * kSide),
+      pool_(new WorkerPool(settings.thread_count)),
+      unprojector_(4, settings.opengl_axes) {
+  settings_.mask.invalid_depth = std::numeric_limits<float>::quiet_NaN();
+  settings_.pixel_step = std::max<uint32_t>(settings_.pixel_step, 1);
+  keys_.resize(pool_->size());
+}
+
+TsdfVolume::~TsdfVolume() = default;
+
+TsdfVolume::Block *TsdfVolume::Find(int32_t x, int32_t y, int32_t z) const {
+  const auto it = blocks_.find(Key(x, y, z));
+  return it == blocks_.end() ? nullptr : it->second.get();
+}
+
+TsdfVolume::Block *TsdfVolume::Allocate(int32_t x, int32_t y, int32_t z) {
+  std::unique_ptr<Block> &slot = blocks_[Key(x, y, z)];
+  if (!slot) {
+    slot.reset(new Block());
+    slot->x = x;
+    slot->y = y;
+    slot->z = z;
+    std::fill(slot->sdf, slot->sdf + kVoxels, 1.0f);
+    std::fill(slot->weight, slot->weight + kVoxels, 0.0f);
+  }
+  return slot.get();
+}
+
+void TsdfVolume::MarkDirty(const Block &block) {
+  for (int32_t dz = -1; dz <= 1; dz++) {
+    for (int32_t dy = -1; dy <= 1; dy++) {
+      for (int32_t dx = -1; dx <= 1; dx++) {
+        Block *neighbour = Find(block.x + dx, block.y + dy, block.z + dz);
+        if (neighbour != nullptr && !neighbour->dirty) {
+          neighbour->dirty = true;
+          dirty_.push_back(neighbour);
+        }
+      }
+    }
+  }
+}
+
+MLResult TsdfVolume::Integrate(const MLDepthCameraData &data) {
+  if (data.frame_count > 0 && data.frames == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  for (uint8_t i = 0; i < data.frame_count; i++) {
+    const MLResult result = Integrate(data.frames[i]);
+    if (result != MLResult_Ok) {
+      return result;
+    }
+  }
+  return MLResult_Ok;
+}
+
+MLResult TsdfVolume::Integrate(const MLDepthCameraFrame &frame) {
+  const MLDepthCameraDepthImage *image = frame.depth_image;
+  if (image == nullptr || image->width != frame.intrinsics.width || image->height != frame.intrinsics.height) {
+    return MLResult_InvalidParam;
+  }
+  const uint32_t width = image->width, height = image->height;
+  depth_.resize(static_cast<size_t>(width) * height);
+  const MLResult result = MaskDepth(frame, settings_.mask, depth_.data(), nullptr, nullptr);
+  if (result != MLResult_Ok) {
+    return result;
+  }
+  const MLPointBatch rays = unprojector_.Rays(frame.intrinsics);
+  float rotation[3][3];
+  RotationMatrix(frame.camera_pose.rotation, rotation);
+  const float translation[3] = {frame.camera_pose.position.x, frame.camera_pose.position.y,
+                                frame.camera_pose.position.z};
+
+  const float max_r2 = FieldOfViewRadius2(rays, width, height);
+
+  // Collect the blocks within the truncation band of the sampled pixels.
+  frame_++;
+  const uint32_t step = settings_.pixel_step;
+  const float truncation = settings_.truncation;
+  const float inv_block = 1.0f / block_size_;
+  const float advance = 0.5f * block_size_;
+  for (std::vector<uint64_t> &keys : keys_) {
+    keys.clear();
+  }
+  pool_->ParallelFor((height + step - 1) / step, 4, [&](size_t begin, size_t end, unsigned worker) {
+    std::vector<uint64_t> &keys = keys_[worker];
+    for (size_t row = begin; row < end; row++) {
+      const size_t v = row * step;
+      for (size_t u = 0; u < width; u += step) {
+        const size_t i = v * width + u;
+        const float d = depth_[i];
+        if (!(d > 0.0f)) {
+          continue;
+        }
+        float dir[3];
+        for (int k = 0; k < 3; k++) {
+          dir[k] = rotation[k][0] * rays.x[i] + rotation[k][1] * rays.y[i] + rotation[k][2] * rays.z[i];
+        }
+        const float far = d + truncation;
+        uint64_t last = ~uint64_t(0);
+        for (float s = std::max(d - truncation, 0.0f);; s = std::min(s + advance, far)) {
+          const uint64_t key = Key(static_cast<int32_t>(std::floor((translation[0] + dir[0] * s) * inv_block)),
+                                   static_cast<int32_t>(std::floor((translation[1] + dir[1] * s) * inv_block)),
+                                   static_cast<int32_t>(std::floor((translation[2] + dir[2] * s) * inv_block)));
+          if (key != last) {
+            keys.push_back(key);
+            last = key;
+          }
+          if (s >= far) {
+            break;
+          }
+        }
+      }
+    }
+  });
+  pool_->ParallelFor(keys_.size(), 1, [&](size_t begin, size_t end, unsigned) {
+    for (size_t w = begin; w < end; w++) {
+      std::sort(keys_[w].begin(), keys_[w].end());
+      keys_[w].erase(std::unique(keys_[w].begin(), keys_[w].end()), keys_[w].end());
+    }
+  });
+  visible_.clear();
+  for (const std::vector<uint64_t> &keys : keys_) {
+    for (uint64_t key : keys) {
+      int32_t x, y, z;
+      Unkey(key, &x, &y, &z);
+      Block *block = Allocate(x, y, z);
+      if (block->frame != frame_) {
+        block->frame = frame_;
+        visible_.push_back(block);
+      }
+    }
+  }
+
+  pool_->ParallelFor(visible_.size(), 8, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      IntegrateBlock(*visible_[i], depth_.data(), width, height, frame.intrinsics, rotation, translation, max_r2);
+    }
+  });
+  for (Block *block : visible_) {
+    if (block->changed) {
+      block->changed = false;
+      MarkDirty(*block);
+    }
+  }
+  return MLResult_Ok;
+}
+
+void TsdfVolume::IntegrateBlock(Block &block, const float *depth, uint32_t width, uint32_t height,
+                                const MLDepthCameraIntrinsics &intrinsics, const float (&rotation)[3][3],
+                                const float (&translation)[3], float max_r2) {
+  const float voxel = settings_.voxel_size;
+  const float truncation = settings_.truncation;
+  const Float8 inv_truncation(1.0f / truncation);
+  const Float8 max_weight(settings_.max_weight);
+  const float sign = settings_.opengl_axes ? -1.0f : 1.0f;
+  const DistortedProjection projection(intrinsics, max_r2, 0.5f);
+  const Float8 one(1.0f), zero(0.0f);
+  const Float8 max_u(static_cast<float>(width - 1)), max_v(static_cast<float>(height - 1));
+
+  // World x of each lane relative to the camera.
+  const Float8 dx = (Float8::Iota(0.5f) * Float8(voxel)) + Float8(block.x * block_size_ - translation[0]);
+  alignas(32) float us[kLanes], vs[kLanes], gathered[kLanes];
+  bool changed = false;
+  for (int vz = 0; vz < kSide; vz++) {
+    const float dz = block.z * block_size_ + (vz + 0.5f) * voxel - translation[2];
+    for (int vy = 0; vy < kSide; vy++) {
+      const float dy = block.y * block_size_ + (vy + 0.5f) * voxel - translation[1];
+      // Camera coordinates, R^T (p - t), in the pinhole convention.
+      const Float8 x = MulAdd(dx, Float8(rotation[0][0]), Float8(rotation[1][0] * dy + rotation[2][0] * dz));
+      const Float8 y = MulAdd(dx, Float8(sign * rotation[0][1]), Float8(sign * (rotation[1][1] * dy + rotation[2][1] * dz)));
+      const Float8 z = MulAdd(dx, Float8(sign * rotation[0][2]), Float8(sign * (rotation[1][2] * dy + rotation[2][2] * dz)));
+      Float8 u, v;
+      const Float8 visible = projection.Project(x, y, z, &u, &v);
+      const int inside = (visible & (u >= zero) & (u <= max_u) & (v >= zero) & (v <= max_v)).MoveMask();
+      if (inside == 0) {
+        continue;
+      }
+      u.Store(us);
+      v.Store(vs);
+      for (int lane = 0; lane < kLanes; lane++) {
+        gathered[lane] = (inside >> lane) & 1
+                             ? depth[static_cast<size_t>(vs[lane]) * width + static_cast<size_t>(us[lane])]
+                             : std::numeric_limits<float>::quiet_NaN();
+      }
+      const Float8 measured = Float8::Load(gathered);
+      const Float8 sdf = measured - Sqrt(MulAdd(x, x, MulAdd(y, y, z * z)));
+      const Float8 update = (measured > zero) & (sdf >= Float8(-truncation));
+      if (update.MoveMask() == 0) {
+        continue;
+      }
+      const int i = (vz * kSide + vy) * kSide;
+      const Float8 old_sdf = Float8::Load(block.sdf + i), old_weight = Float8::Load(block.weight + i);
+      const Float8 weight = old_weight + one;
+      const Float8 fused = MulAdd(old_sdf, old_weight, Min(sdf * inv_truncation, one)) / weight;
+      Select(update, fused, old_sdf).Store(block.sdf + i);
+      Select(update, Min(weight, max_weight), old_weight).Store(block.weight + i);
+      changed = true;
+    }
+  }
+  block.changed = changed;
+}
+
+void TsdfVolume::ExtractMesh(std::vector<TsdfBlockMesh> *out_meshes) {
+  if (out_meshes == nullptr) {
+    return;
+  }
+  out_meshes->resize(dirty_.size());
+  pool_->ParallelFor(dirty_.size(), 1, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      MeshBlock(*dirty_[i], &(*out_meshes)[i]);
+    }
+  });
+  for (Block *block : dirty_) {
+    block->dirty = false;
+  }
+  dirty_.clear();
+}
+
+void TsdfVolume::MeshBlock(const Block &block, TsdfBlockMesh *out) const {
+  out->x = block.x;
+  out->y = block.y;
+  out->z = block.z;
+  out->vertices.clear();
+  out->normals.clear();
+  out->indices.clear();
+
+  // Copy the block with a one voxel apron from its neighbours.
+  float sdf[kApron * kApron * kApron];
+  float weight[kApron * kApron * kApron];
+  const Block *neighbours[27];
+  for (int n = 0; n < 27; n++) {
+    neighbours[n] = n == 13 ? &block : Find(block.x + n % 3 - 1, block.y + n / 3 % 3 - 1, block.z + n / 9 - 1);
+  }
+  int a = 0;
+  for (int lz = -1; lz <= kSide; lz++) {
+    for (int ly = -1; ly <= kSide; ly++) {
+      for (int lx = -1; lx <= kSide; lx++, a++) {
+        const int bx = lx < 0 ? 0 : lx < kSide ? 1 : 2, by = ly < 0 ? 0 : ly < kSide ? 1 : 2;
+        const int bz = lz < 0 ? 0 : lz < kSide ? 1 : 2;
+        const Block *source = neighbours[bz * 9 + by * 3 + bx];
+        if (source == nullptr) {
+          sdf[a] = 1.0f;
+          weight[a] = 0.0f;
+          continue;
+        }
+        const int i = (((lz + kSide) % kSide) * kSide + (ly + kSide) % kSide) * kSide + (lx + kSide) % kSide;
+        sdf[a] = source->sdf[i];
+        weight[a] = source->weight[i];
+      }
+    }
+  }
+  auto apron = [](int x, int y, int z) { return ((z + 1) * kApron + y + 1) * kApron + x + 1; };
+
+  // Surface nets: one vertex per cell with a sign change, at the mean of its edge crossings.
+  int32_t cells[kCells * kCells * kCells];
+  const float voxel = settings_.voxel_size;
+  const float origin[3] = {block.x * block_size_, block.y * block_size_, block.z * block_size_};
+  int c = 0;
+  for (int cz = -1; cz < kSide; cz++) {
+    for (int cy = -1; cy < kSide; cy++) {
+      for (int cx = -1; cx < kSide; cx++, c++) {
+        cells[c] = -1;
+        float corner[8];
+        int inside = 0;
+        bool observed = true;
+        for (int k = 0; k < 8; k++) {
+          const int i = apron(cx + (k & 1), cy + (k >> 1 & 1), cz + (k >> 2));
+          corner[k] = sdf[i];
+          observed = observed && weight[i] > 0.0f;
+          inside |= (corner[k] < 0.0f) << k;
+        }
+        if (!observed || inside == 0 || inside == 0xff) {
+          continue;
+        }
+        float sum[3] = {0, 0, 0};
+        int crossings = 0;
+        for (int k = 0; k < 8; k++) {
+          for (int axis = 0; axis < 3; axis++) {
+            const int other = k | (1 << axis);
+            if (other == k || ((inside >> k) & 1) == ((inside >> other) & 1)) {
+              continue;
+            }
+            const float t = corner[k] / (corner[k] - corner[other]);
+            sum[0] += (k & 1) + (axis == 0 ? t : 0.0f);
+            sum[1] += (k >> 1 & 1) + (axis == 1 ? t : 0.0f);
+            sum[2] += (k >> 2) + (axis == 2 ? t : 0.0f);
+            crossings++;
+          }
+        }
+        const float gradient[3] = {
+            corner[1] + corner[3] + corner[5] + corner[7] - corner[0] - corner[2] - corner[4] - corner[6],
+            corner[2] + corner[3] + corner[6] + corner[7] - corner[0] - corner[1] - corner[4] - corner[5],
+            corner[4] + corner[5] + corner[6] + corner[7] - corner[0] - corner[1] - corner[2] - corner[3]};
+        const float length = std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+        const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        const float cell[3] = {float(cx), float(cy), float(cz)};
+        MLVec3f vertex, normal;
+        for (int k = 0; k < 3; k++) {
+          vertex.values[k] = origin[k] + (cell[k] + 0.5f + sum[k] / crossings) * voxel;
+          normal.values[k] = gradient[k] * scale;
+        }
+        cells[c] = static_cast<int32_t>(out->vertices.size());
+        out->vertices.push_back(vertex);
+        out->normals.push_back(normal);
+      }
+    }
+  }
+
+  // One quad per crossing edge starting in this block, joining the four cells around it.
+  auto cell = [&](const int (&p)[3]) { return cells[((p[2] + 1) * kCells + p[1] + 1) * kCells + p[0] + 1]; };
+  for (int vz = 0; vz < kSide; vz++) {
+    for (int vy = 0; vy < kSide; vy++) {
+      for (int vx = 0; vx < kSide; vx++) {
+        const int i = apron(vx, vy, vz);
+        if (!(weight[i] > 0.0f)) {
+          continue;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+          const int j = i + (axis == 0 ? 1 : axis == 1 ? kApron : kApron * kApron);
+          if (!(weight[j] > 0.0f) || (sdf[i] < 0.0f) == (sdf[j] < 0.0f)) {
+            continue;
+          }
+          const int b = (axis + 1) % 3, d = (axis + 2) % 3;
+          int p[3] = {vx, vy, vz};
+          const int c00 = cell(p);
+          p[b]--;
+          const int c10 = cell(p);
+          p[d]--;
+          const int c11 = cell(p);
+          p[b]++;
+          const int c01 = cell(p);
+          if (c00 < 0 || c10 < 0 || c11 < 0 || c01 < 0) {
+            continue;
+          }
+          // The loop c00, c10, c11, c01 turns counter-clockwise around +axis.
+          const uint32_t quad[2][3] = {{uint32_t(c00), uint32_t(c10), uint32_t(c11)},
+                                       {uint32_t(c00), uint32_t(c11), uint32_t(c01)}};
+          const bool outward = sdf[i] < 0.0f;
+          for (const auto &triangle : quad) {
+            out->indices.push_back(triangle[0]);
+            out->indices.push_back(outward ? triangle[1] : triangle[2]);
+            out->indices.push_back(outward ? triangle[2] : triangle[1]);
+          }
+        }
+      }
+    }
+  }
+}
+
+void TsdfVolume::Clear() {
+  blocks_.clear();
+  dirty_.clear();
+  visible_.clear();
+}
@@ -0,0 +1,171 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+
+#include "depth_mask.h"
+#include "depth_unprojector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace native_utils {
+class WorkerPool;
+}
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Parameters of a TsdfVolume. */
+typedef struct TsdfVolumeSettings {
+  /*! Edge length of a voxel in meters. */
+  float voxel_size;
+  /*! Signed distances are clamped to +/- this many meters. */
+  float truncation;
+  /*! Cap on the accumulated weight; lower values adapt faster to change. */
+  float max_weight;
+  /*! Depth pixels to integrate; invalid_depth is ignored. */
+  DepthMaskSettings mask;
+  /*! Only every pixel_step-th pixel and row allocates blocks. */
+  uint32_t pixel_step;
+  /*! Threads used for integration and meshing; 0 uses every core. */
+  uint32_t thread_count;
+  /*! Whether camera poses follow the OpenGL camera convention, see DepthUnprojector. */
+  bool opengl_axes;
+} TsdfVolumeSettings;
+
+/*!
+  \brief Initializes TsdfVolumeSettings for near-field reconstruction:
+         1 cm voxels, 4 cm truncation and depths up to 3 m.
+*/
+inline void TsdfVolumeSettingsInit(TsdfVolumeSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->voxel_size = 0.01f;
+    inout_settings->truncation = 0.04f;
+    inout_settings->max_weight = 64.0f;
+    DepthMaskSettingsInit(&inout_settings->mask);
+    inout_settings->mask.min_depth = 0.1f;
+    inout_settings->mask.max_depth = 3.0f;
+    inout_settings->pixel_step = 2;
+    inout_settings->thread_count = 0;
+    inout_settings->opengl_axes = false;
+  }
+}
+
+/*!
+  \brief Mesh of one block of a TsdfVolume.
+
+  Replaces any mesh previously returned for the same block; an empty mesh
+  means the block no longer holds a surface.
+*/
+struct TsdfBlockMesh {
+  /*! Block coordinates; the block spans [x, x + 1) * TsdfVolume::block_size() in each axis. */
+  int32_t x, y, z;
+  /*! World space vertices. */
+  std::vector<MLVec3f> vertices;
+  /*! Unit normals pointing out of the surface, one per vertex. */
+  std::vector<MLVec3f> normals;
+  /*! Counter-clockwise triangles seen from outside. */
+  std::vector<uint32_t> indices;
+};
+
+/*!
+  \brief Fuses depth frames into a truncated signed distance field and
+         meshes it incrementally.
+
+  Space is split into blocks of 8 x 8 x 8 voxels that are allocated on
+  demand in a hash map, around the surfaces the frames observe. Each frame
+  allocates the blocks within the truncation band of its depth pixels, then
+  projects every voxel of those blocks into the depth image and updates
+  its running weighted average; blocks are spread over the worker threads
+  and voxels are processed eight at a time.
+
+  Blocks whose voxels changed, and their neighbours, are marked dirty, and
+  ExtractMesh() re-meshes only those with surface nets, so its cost follows
+  the part of the scene that changed rather than the size of the volume.
+
+  Not thread safe.
+*/
+class TsdfVolume {
+public:
+  static constexpr int kBlockVoxels = 8;
+
+  explicit TsdfVolume(const TsdfVolumeSettings &settings);
+  ~TsdfVolume();
+
+  TsdfVolume(const TsdfVolume &) = delete;
+  TsdfVolume &operator=(const TsdfVolume &) = delete;
+
+  /*!
+    \brief Integrates the depth image of `frame` seen from its camera pose.
+
+    \retval MLResult_Ok The frame was integrated.
+    \retval MLResult_InvalidParam The frame has no float depth image, or
+            its confidence or flags buffers do not match it.
+  */
+  MLResult Integrate(const MLDepthCameraFrame &frame);
+
+  /*! Integrates every frame of `data`, returning the first failure. */
+  MLResult Integrate(const MLDepthCameraData &data);
+
+  /*!
+    \brief Re-meshes the dirty blocks and clears their dirty state.
+
+    \param[out] out_meshes Receives one mesh per dirty block; reused
+                entries keep their capacity.
+  */
+  void ExtractMesh(std::vector<TsdfBlockMesh> *out_meshes);
+
+  /*! Drops every block; the next ExtractMesh() returns nothing. */
+  void Clear();
+
+  float block_size() const { return block_size_; }
+  size_t block_count() const { return blocks_.size(); }
+  size_t dirty_count() const { return dirty_.size(); }
+
+private:
+  struct Block;
+
+  Block *Find(int32_t x, int32_t y, int32_t z) const;
+  Block *Allocate(int32_t x, int32_t y, int32_t z);
+  void MarkDirty(const Block &block);
+  void IntegrateBlock(Block &block, const float *depth, uint32_t width, uint32_t height,
+                      const MLDepthCameraIntrinsics &intrinsics, const float (&rotation)[3][3],
+                      const float (&translation)[3], float max_r2);
+  void MeshBlock(const Block &block, TsdfBlockMesh *out) const;
+
+  TsdfVolumeSettings settings_;
+  float block_size_;
+  std::unique_ptr<native_utils::WorkerPool> pool_;
+  DepthUnprojector unprojector_;
+
+  std::unordered_map<uint64_t, std::unique_ptr<Block>> blocks_;
+  std::vector<Block *> dirty_;
+
+  // Per-frame scratch.
+  std::vector<float> depth_;
+  std::vector<std::vector<uint64_t>> keys_;
+  std::vector<Block *> visible_;
+  uint64_t frame_ = 0;
+};
+
+/*! \} */
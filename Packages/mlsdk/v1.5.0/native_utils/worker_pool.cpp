@@ -0,0 +1,92 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "worker_pool.h"
+
+#include <algorithm>
+
+namespace native_utils {
+
+WorkerPool::WorkerPool(unsigned thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  for (unsigned worker = 1; worker < thread_count; worker++) {
+    threads_.emplace_back(&WorkerPool::Run, this, worker);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::ParallelFor(size_t count, size_t grain, const Task &task) {
+  grain = std::max<size_t>(grain, 1);
+  if (threads_.empty() || count <= grain) {
+    if (count > 0) {
+      task(0, count, 0);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    grain_ = grain;
+    next_.store(0, std::memory_order_relaxed);
+    active_ = static_cast<unsigned>(threads_.size());
+    generation_++;
+  }
+  wake_.notify_all();
+  Work(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return active_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::Run(unsigned worker) {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    lock.unlock();
+    Work(worker);
+    lock.lock();
+    if (--active_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::Work(unsigned worker) {
+  for (;;) {
+    const size_t begin = next_.fetch_add(grain_, std::memory_order_relaxed);
+    if (begin >= count_) {
+      return;
+    }
+    (*task_)(begin, std::min(begin + grain_, count_), worker);
+  }
+}
+
+}  // namespace native_utils
@@ -0,0 +1,69 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+/*
+  Internal fork-join pool used by the native_utils kernels.
+
+  ParallelFor() splits [0, count) into grains that the pool threads and the
+  calling thread pull from a shared counter, and returns once every grain
+  has run.  Each call passes a worker index below size() so kernels can keep
+  per-thread scratch without locking.  Calls must not overlap.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace native_utils {
+
+class WorkerPool {
+public:
+  using Task = std::function<void(size_t begin, size_t end, unsigned worker)>;
+
+  // thread_count includes the calling thread; 0 uses every hardware thread.
+  explicit WorkerPool(unsigned thread_count = 0);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(threads_.size()) + 1; }
+
+  void ParallelFor(size_t count, size_t grain, const Task &task);
+
+private:
+  void Run(unsigned worker);
+  void Work(unsigned worker);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  uint64_t generation_ = 0;
+  unsigned active_ = 0;
+  bool stop_ = false;
+
+  const Task *task_ = nullptr;
+  size_t count_ = 0;
+  size_t grain_ = 1;
+  std::atomic<size_t> next_{0};
+};
+
+}  // namespace native_utils
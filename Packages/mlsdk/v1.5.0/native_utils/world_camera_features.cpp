@@ -0,0 +1,427 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "world_camera_features.h"
+
+#include "simd_float8.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using native_utils::Float8;
+using native_utils::WorkerPool;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+constexpr int kPatchRadius = 15;
+// Patch radius, plus rounding of the rotated pattern and the smoothing taps.
+constexpr uint32_t kBorder = kPatchRadius + 3;
+constexpr int kPairs = 256;
+constexpr int kSteps = 32;
+constexpr uint32_t kSmoothBand = 32;
+constexpr float kPi = 3.14159265358979f;
+
+// Bresenham circle of radius 3, clockwise from the top.
+constexpr int kCircle[16][2] = {{0, -3}, {1, -3}, {2, -2}, {3, -1}, {3, 0},  {3, 1},  {2, 2},  {1, 3},
+                                {0, 3},  {-1, 3}, {-2, 2}, {-3, 1}, {-3, 0}, {-3, -1}, {-2, -2}, {-1, -3}};
+
+// Lanes of `masks` whose circle holds 9 contiguous set pixels.
+int Arc(const int (&masks)[16]) {
+  int pairs[16], quads[16];
+  for (int k = 0; k < 16; k++) {
+    pairs[k] = masks[k] & masks[(k + 1) & 15];
+  }
+  for (int k = 0; k < 16; k++) {
+    quads[k] = pairs[k] & pairs[(k + 2) & 15];
+  }
+  int arc = 0;
+  for (int k = 0; k < 16; k++) {
+    arc |= quads[k] & quads[(k + 4) & 15] & masks[(k + 8) & 15];
+  }
+  return arc;
+}
+
+// Test pairs of BRIEF's isotropic Gaussian layout (sigma = patch size / 5)
+// clipped to the patch disc. The generator is fixed so descriptors stay
+// comparable across builds and runs.
+void BasePattern(int (&out)[kPairs * 4]) {
+  uint32_t state = 0x9E3779B9u;
+  auto uniform = [&state] {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<float>(state >> 8) * (1.0f / 16777216.0f) - 0.5f;
+  };
+  // A sum of four uniforms has variance 1/3.
+  const float scale = (2 * kPatchRadius + 1) / 5.0f * std::sqrt(3.0f);
+  for (int i = 0; i < kPairs * 2; i++) {
+    int x, y;
+    do {
+      x = static_cast<int>(std::lround((uniform() + uniform() + uniform() + uniform()) * scale));
+      y = static_cast<int>(std::lround((uniform() + uniform() + uniform() + uniform()) * scale));
+    } while (x * x + y * y > kPatchRadius * kPatchRadius);
+    out[2 * i] = x;
+    out[2 * i + 1] = y;
+  }
+}
+
+bool Stronger(const WorldCameraFeature &a, const WorldCameraFeature &b) {
+  if (a.score != b.score) {
+    return a.score > b.score;
+  }
+  return a.position.y != b.position.y ? a.position.y < b.position.y : a.position.x < b.position.x;
+}
+
+}  // namespace
+
+WorldCameraFeatureExtractor::WorldCameraFeatureExtractor(const WorldCameraFeatureSettings &settings)
+    : settings_(settings), pool_(new WorkerPool(settings.thread_count)) {
+  if (settings_.tile_size < kLanes) {
+    settings_.tile_size = kLanes;
+  }
+  scratch_.resize(pool_->size());
+  int base[kPairs * 4];
+  BasePattern(base);
+  pattern_.resize(kSteps * kPairs * 4);
+  for (int step = 0; step < kSteps; step++) {
+    const double angle = 2.0 * kPi * step / kSteps;
+    const double c = std::cos(angle), s = std::sin(angle);
+    int8_t *rotated = &pattern_[step * kPairs * 4];
+    for (int i = 0; i < kPairs * 2; i++) {
+      const double x = base[2 * i], y = base[2 * i + 1];
+      rotated[2 * i] = static_cast<int8_t>(std::lround(c * x - s * y));
+      rotated[2 * i + 1] = static_cast<int8_t>(std::lround(s * x + c * y));
+    }
+  }
+}
+
+WorldCameraFeatureExtractor::~WorldCameraFeatureExtractor() = default;
+
+uint32_t WorldCameraFeatureExtractor::Distance(const WorldCameraDescriptor &a, const WorldCameraDescriptor &b) {
+  uint32_t count = 0;
+  for (size_t i = 0; i < sizeof(a.bits); i += sizeof(uint64_t)) {
+    uint64_t x, y;
+    memcpy(&x, a.bits + i, sizeof(x));
+    memcpy(&y, b.bits + i, sizeof(y));
+    uint64_t v = x ^ y;
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    count += static_cast<uint32_t>((v * 0x0101010101010101ull) >> 56);
+  }
+  return count;
+}
+
+MLResult WorldCameraFeatureExtractor::Extract(const MLWorldCameraFrame &frame,
+                                              std::vector<WorldCameraFeature> *out_features,
+                                              std::vector<WorldCameraDescriptor> *out_descriptors) {
+  return Extract(frame.frame_buffer, out_features, out_descriptors);
+}
+
+MLResult WorldCameraFeatureExtractor::Extract(const MLWorldCameraFrameBuffer &buffer,
+                                              std::vector<WorldCameraFeature> *out_features,
+                                              std::vector<WorldCameraDescriptor> *out_descriptors) {
+  const uint32_t width = buffer.width, height = buffer.height, depth = buffer.bytes_per_pixel;
+  if (out_features == nullptr || buffer.data == nullptr || (depth != 1 && depth != 2) ||
+      buffer.stride < static_cast<uint64_t>(width) * depth ||
+      (height > 0 && buffer.size < static_cast<uint64_t>(buffer.stride) * (height - 1) + uint64_t(width) * depth)) {
+    return MLResult_InvalidParam;
+  }
+  out_features->clear();
+  if (out_descriptors != nullptr) {
+    out_descriptors->clear();
+  }
+  if (width <= 2 * kBorder || height <= 2 * kBorder) {
+    return MLResult_Ok;
+  }
+
+  if (depth == 1) {
+    pixels_ = buffer.data;
+    stride_ = buffer.stride;
+  } else {
+    const uint32_t bits = std::min(std::max(settings_.significant_bits, 8u), 16u);
+    const uint32_t shift = bits - 8;
+    converted_.resize(static_cast<size_t>(width) * height);
+    pool_->ParallelFor(height, 16, [&](size_t begin, size_t end, unsigned) {
+      for (size_t v = begin; v < end; v++) {
+        const uint8_t *row = buffer.data + v * buffer.stride;
+        uint8_t *out = &converted_[v * width];
+        for (uint32_t u = 0; u < width; u++) {
+          uint16_t value;
+          memcpy(&value, row + 2 * u, sizeof(value));
+          out[u] = static_cast<uint8_t>(std::min(value >> shift, 255));
+        }
+      }
+    });
+    pixels_ = converted_.data();
+    stride_ = width;
+  }
+
+  if (width != width_ || height != height_) {
+    width_ = width;
+    height_ = height;
+    scores_.assign(static_cast<size_t>(width) * height, 0.0f);
+    smooth_.assign(static_cast<size_t>(width) * height, 0);
+    offsets_.resize(pattern_.size() / 2);
+    for (size_t i = 0; i < offsets_.size(); i++) {
+      offsets_[i] = pattern_[2 * i + 1] * static_cast<int32_t>(width) + pattern_[2 * i];
+    }
+    const uint32_t size = settings_.tile_size;
+    tiles_.clear();
+    for (uint32_t y = 0; y < height; y += size) {
+      for (uint32_t x = 0; x < width; x += size) {
+        Tile tile;
+        tile.x0 = std::max(x, kBorder);
+        tile.y0 = std::max(y, kBorder);
+        tile.x1 = std::min(x + size, width - kBorder);
+        tile.y1 = std::min(y + size, height - kBorder);
+        if (tile.x0 < tile.x1 && tile.y0 < tile.y1) {
+          tiles_.push_back(std::move(tile));
+        }
+      }
+    }
+    for (std::vector<float> &scratch : scratch_) {
+      scratch.assign(static_cast<size_t>(kSmoothBand + 4) * width + kLanes, 0.0f);
+    }
+  }
+
+  pool_->ParallelFor(tiles_.size(), 1, [this](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      Detect(tiles_[i]);
+    }
+  });
+  // Suppression reads the scores of neighbouring tiles, so it waits for every tile.
+  const size_t max_features = settings_.max_features;
+  const size_t quota = max_features > 0 ? (2 * max_features + tiles_.size() - 1) / tiles_.size() : SIZE_MAX;
+  pool_->ParallelFor(tiles_.size(), 1, [this, quota](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      Suppress(tiles_[i], quota);
+    }
+  });
+
+  selected_.clear();
+  for (const Tile &tile : tiles_) {
+    for (const Candidate &candidate : tile.candidates) {
+      scores_[static_cast<size_t>(candidate.y) * width + candidate.x] = 0.0f;
+    }
+    selected_.insert(selected_.end(), tile.kept.begin(), tile.kept.end());
+  }
+  out_features->resize(selected_.size());
+  for (size_t i = 0; i < selected_.size(); i++) {
+    WorldCameraFeature &feature = (*out_features)[i];
+    feature.position.x = static_cast<float>(selected_[i].x);
+    feature.position.y = static_cast<float>(selected_[i].y);
+    feature.score = selected_[i].score;
+    feature.angle = 0.0f;
+  }
+  if (max_features > 0 && out_features->size() > max_features) {
+    std::nth_element(out_features->begin(), out_features->begin() + max_features, out_features->end(), Stronger);
+    out_features->resize(max_features);
+  }
+  std::sort(out_features->begin(), out_features->end(), Stronger);
+
+  if (out_descriptors != nullptr) {
+    out_descriptors->resize(out_features->size());
+    pool_->ParallelFor((height + kSmoothBand - 1) / kSmoothBand, 1, [this](size_t begin, size_t end, unsigned worker) {
+      for (size_t band = begin; band < end; band++) {
+        const uint32_t row = static_cast<uint32_t>(band) * kSmoothBand;
+        Smooth(row, std::min(row + kSmoothBand, height_), scratch_[worker]);
+      }
+    });
+  }
+  if (settings_.oriented || out_descriptors != nullptr) {
+    pool_->ParallelFor(out_features->size(), 32, [&](size_t begin, size_t end, unsigned) {
+      for (size_t i = begin; i < end; i++) {
+        Describe(&(*out_features)[i], out_descriptors != nullptr ? &(*out_descriptors)[i] : nullptr);
+      }
+    });
+  }
+  return MLResult_Ok;
+}
+
+void WorldCameraFeatureExtractor::Detect(Tile &tile) {
+  tile.candidates.clear();
+  const ptrdiff_t stride = static_cast<ptrdiff_t>(stride_);
+  ptrdiff_t circle[16];
+  for (int k = 0; k < 16; k++) {
+    circle[k] = kCircle[k][1] * stride + kCircle[k][0];
+  }
+  const Float8 threshold(static_cast<float>(settings_.fast_threshold));
+  const Float8 zero(0.0f);
+  alignas(32) float scores[kLanes];
+  for (uint32_t y = tile.y0; y < tile.y1; y++) {
+    const uint8_t *row = pixels_ + y * stride_;
+    float *score_row = &scores_[static_cast<size_t>(y) * width_];
+    for (uint32_t x = tile.x0; x < tile.x1; x += kLanes) {
+      const uint8_t *p = row + x;
+      const Float8 center = Float8::LoadU8(p);
+      const Float8 hi = center + threshold, lo = center - threshold;
+      Float8 ring[16];
+      int bright[16], dark[16];
+      auto test = [&](int k) {
+        ring[k] = Float8::LoadU8(p + circle[k]);
+        bright[k] = (ring[k] > hi).MoveMask();
+        dark[k] = (ring[k] < lo).MoveMask();
+      };
+      // Any arc of nine covers two neighbouring compass points.
+      test(0);
+      test(4);
+      test(8);
+      test(12);
+      const int lanes = tile.x1 - x >= static_cast<uint32_t>(kLanes) ? 0xFF : (1 << (tile.x1 - x)) - 1;
+      const int compass = (bright[0] & bright[4]) | (bright[4] & bright[8]) | (bright[8] & bright[12]) |
+                          (bright[12] & bright[0]) | (dark[0] & dark[4]) | (dark[4] & dark[8]) |
+                          (dark[8] & dark[12]) | (dark[12] & dark[0]);
+      if ((compass & lanes) == 0) {
+        continue;
+      }
+      for (int k = 0; k < 16; k++) {
+        if ((k & 3) != 0) {
+          test(k);
+        }
+      }
+      const int corners = (Arc(bright) | Arc(dark)) & lanes;
+      if (corners == 0) {
+        continue;
+      }
+      Float8 above = zero, below = zero;
+      for (int k = 0; k < 16; k++) {
+        above = above + Max(ring[k] - hi, zero);
+        below = below + Max(lo - ring[k], zero);
+      }
+      Max(above, below).Store(scores);
+      for (int lane = 0; lane < kLanes; lane++) {
+        if ((corners >> lane) & 1) {
+          score_row[x + lane] = scores[lane];
+          tile.candidates.push_back({x + lane, y, scores[lane]});
+        }
+      }
+    }
+  }
+}
+
+void WorldCameraFeatureExtractor::Suppress(Tile &tile, size_t quota) const {
+  tile.kept.clear();
+  const ptrdiff_t width = width_;
+  for (const Candidate &candidate : tile.candidates) {
+    const float *s = &scores_[static_cast<size_t>(candidate.y) * width_ + candidate.x];
+    const float score = candidate.score;
+    // Ties go to the first corner in raster order.
+    if (s[-width - 1] < score && s[-width] < score && s[-width + 1] < score && s[-1] < score && s[1] <= score &&
+        s[width - 1] <= score && s[width] <= score && s[width + 1] <= score) {
+      tile.kept.push_back(candidate);
+    }
+  }
+  if (tile.kept.size() > quota) {
+    std::nth_element(tile.kept.begin(), tile.kept.begin() + quota, tile.kept.end(),
+                     [](const Candidate &a, const Candidate &b) {
+                       return a.score != b.score ? a.score > b.score : (a.y != b.y ? a.y < b.y : a.x < b.x);
+                     });
+    tile.kept.resize(quota);
+  }
+}
+
+void WorldCameraFeatureExtractor::Smooth(uint32_t row_begin, uint32_t row_end, std::vector<float> &scratch) {
+  // Binomial [1 4 6 4 1] / 16 filter in each direction. Only rows and
+  // columns 2 away from the edges are filled; patches never reach further.
+  row_begin = std::max(row_begin, 2u);
+  row_end = std::min(row_end, height_ - 2);
+  if (row_begin >= row_end) {
+    return;
+  }
+  const uint32_t width = width_;
+  const uint32_t last = width - 2;
+  const Float8 four(4.0f), six(6.0f);
+  float *lanes = &scratch[static_cast<size_t>(kSmoothBand + 4) * width];
+  for (uint32_t v = row_begin - 2; v < row_end + 2; v++) {
+    const uint8_t *row = pixels_ + v * stride_;
+    float *out = &scratch[static_cast<size_t>(v - (row_begin - 2)) * width];
+    uint32_t u = 2;
+    for (; u + kLanes <= last; u += kLanes) {
+      const uint8_t *p = row + u;
+      const Float8 sum = Float8::LoadU8(p - 2) + Float8::LoadU8(p + 2) +
+                         MulAdd(four, Float8::LoadU8(p - 1) + Float8::LoadU8(p + 1), six * Float8::LoadU8(p));
+      sum.Store(out + u);
+    }
+    for (; u < last; u++) {
+      const uint8_t *p = row + u;
+      out[u] = static_cast<float>(p[-2] + p[2] + 4 * (p[-1] + p[1]) + 6 * p[0]);
+    }
+  }
+  const Float8 scale(1.0f / 256.0f), half(0.5f);
+  for (uint32_t v = row_begin; v < row_end; v++) {
+    const float *r0 = &scratch[static_cast<size_t>(v - row_begin) * width];
+    const float *r1 = r0 + width, *r2 = r1 + width, *r3 = r2 + width, *r4 = r3 + width;
+    uint8_t *out = &smooth_[static_cast<size_t>(v) * width];
+    for (uint32_t u = 2; u < last; u += kLanes) {
+      const Float8 sum = Float8::Load(r0 + u) + Float8::Load(r4 + u) +
+                         MulAdd(four, Float8::Load(r1 + u) + Float8::Load(r3 + u), six * Float8::Load(r2 + u));
+      MulAdd(sum, scale, half).Store(lanes);
+      const uint32_t count = std::min<uint32_t>(kLanes, last - u);
+      for (uint32_t lane = 0; lane < count; lane++) {
+        out[u + lane] = static_cast<uint8_t>(lanes[lane]);
+      }
+    }
+  }
+}
+
+void WorldCameraFeatureExtractor::Describe(WorldCameraFeature *feature, WorldCameraDescriptor *out_descriptor) const {
+  const uint32_t x = static_cast<uint32_t>(feature->position.x);
+  const uint32_t y = static_cast<uint32_t>(feature->position.y);
+  int step = 0;
+  if (settings_.oriented) {
+    // Intensity centroid over the patch disc, eight pixels of a row at a time.
+    const uint8_t *center = pixels_ + y * stride_ + x;
+    Float8 mx(0.0f), my(0.0f);
+    for (int dy = -kPatchRadius; dy <= kPatchRadius; dy++) {
+      const int half = static_cast<int>(std::sqrt(static_cast<float>(kPatchRadius * kPatchRadius - dy * dy)));
+      const uint8_t *row = center + dy * static_cast<ptrdiff_t>(stride_) - half;
+      const Float8 limit(static_cast<float>(half)), offset(static_cast<float>(dy));
+      Float8 sum(0.0f);
+      for (int i = 0; i <= 2 * half; i += kLanes) {
+        const Float8 dx = Float8::Iota(static_cast<float>(i - half));
+        const Float8 value = Float8::LoadU8(row + i) & (dx <= limit);
+        mx = MulAdd(value, dx, mx);
+        sum = sum + value;
+      }
+      my = MulAdd(sum, offset, my);
+    }
+    alignas(32) float sx[kLanes], sy[kLanes];
+    mx.Store(sx);
+    my.Store(sy);
+    float m10 = 0.0f, m01 = 0.0f;
+    for (int lane = 0; lane < kLanes; lane++) {
+      m10 += sx[lane];
+      m01 += sy[lane];
+    }
+    feature->angle = std::atan2(m01, m10);
+    step = static_cast<int>(std::lround(feature->angle * (kSteps / (2.0f * kPi))));
+    step = (step % kSteps + kSteps) % kSteps;
+  }
+  if (out_descriptor == nullptr) {
+    return;
+  }
+  const uint8_t *s = &smooth_[static_cast<size_t>(y) * width_ + x];
+  const int32_t *pairs = &offsets_[static_cast<size_t>(step) * kPairs * 2];
+  for (int byte = 0; byte < kPairs / 8; byte++) {
+    uint32_t bits = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      const int32_t *pair = pairs + 2 * (byte * 8 + bit);
+      bits |= static_cast<uint32_t>(s[pair[0]] < s[pair[1]]) << bit;
+    }
+    out_descriptor->bits[byte] = static_cast<uint8_t>(bits);
+  }
+}
@@ -0,0 +1,168 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_types.h"
+#include "ml_world_camera.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace native_utils {
+class WorkerPool;
+}
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief Parameters of a WorldCameraFeatureExtractor. */
+typedef struct WorldCameraFeatureSettings {
+  /*! Intensity difference, in 8-bit levels, the FAST segment test requires. */
+  uint32_t fast_threshold;
+  /*! Features kept per frame, strongest first; 0 keeps every corner. */
+  uint32_t max_features;
+  /*! Edge length in pixels of the tiles the frame is split into. */
+  uint32_t tile_size;
+  /*! Significant bits of 2-byte pixels, e.g. 10; they are shifted down to 8 bits. */
+  uint32_t significant_bits;
+  /*! Whether descriptors are steered by the keypoint orientation (ORB) or upright. */
+  bool oriented;
+  /*! Threads used per frame; 0 uses every core. */
+  uint32_t thread_count;
+} WorldCameraFeatureSettings;
+
+/*! \brief Initializes WorldCameraFeatureSettings for up to 1000 oriented features per frame. */
+inline void WorldCameraFeatureSettingsInit(WorldCameraFeatureSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->fast_threshold = 20;
+    inout_settings->max_features = 1000;
+    inout_settings->tile_size = 64;
+    inout_settings->significant_bits = 16;
+    inout_settings->oriented = true;
+    inout_settings->thread_count = 0;
+  }
+}
+
+/*! \brief A corner found by WorldCameraFeatureExtractor. */
+typedef struct WorldCameraFeature {
+  /*! Pixel position in the frame buffer. */
+  MLVec2f position;
+  /*! Summed contrast beyond the threshold around the FAST circle. */
+  float score;
+  /*! Orientation in radians from the intensity centroid, 0 along +x; 0 when not oriented. */
+  float angle;
+} WorldCameraFeature;
+
+/*! \brief 256-bit binary descriptor of a WorldCameraFeature. */
+typedef struct WorldCameraDescriptor {
+  uint8_t bits[32];
+} WorldCameraDescriptor;
+
+/*!
+  \brief Detects FAST corners in world camera frames and describes them with
+         rotated BRIEF, in the manner of ORB.
+
+  Frames are read in place through their stride when bytes_per_pixel is 1;
+  2-byte frames are first shifted down to 8 bits. Corners pass the FAST-9
+  segment test on the 16 pixel circle of radius 3, are scored by their
+  contrast beyond fast_threshold and thinned by 3 x 3 non-maximum
+  suppression. The segment test and score run eight pixels at a time, with
+  the arc of nine checked for all eight lanes at once on per-circle-pixel
+  lane masks.
+
+  The frame is split into tile_size tiles that are detected in parallel.
+  No tile keeps more than twice its even share of max_features, so
+  features spread over the frame, and the strongest max_features overall
+  are returned. Each feature's orientation is the direction of its
+  intensity centroid over a radius 15 disc, and its descriptor compares 256
+  fixed pairs of pixels of a binomially smoothed copy of the frame, rotated
+  to the orientation in steps of 360 / 32 degrees.
+
+  Corners closer than 18 pixels to the frame edges are not reported, so
+  every patch lies inside the frame. Not thread safe.
+*/
+class WorldCameraFeatureExtractor {
+public:
+  explicit WorldCameraFeatureExtractor(const WorldCameraFeatureSettings &settings);
+  ~WorldCameraFeatureExtractor();
+
+  WorldCameraFeatureExtractor(const WorldCameraFeatureExtractor &) = delete;
+  WorldCameraFeatureExtractor &operator=(const WorldCameraFeatureExtractor &) = delete;
+
+  /*!
+    \brief Detects and describes the features of one frame buffer.
+
+    \param[in] buffer Grayscale frame with 1 or 2 bytes per pixel.
+    \param[out] out_features Features found, strongest first.
+    \param[out] out_descriptors Optional descriptors, one per feature.
+
+    \retval MLResult_Ok The outputs were written.
+    \retval MLResult_InvalidParam The buffer has no data, an unsupported
+            bytes_per_pixel, or a stride or size too small for its
+            dimensions, or out_features is null.
+  */
+  MLResult Extract(const MLWorldCameraFrameBuffer &buffer, std::vector<WorldCameraFeature> *out_features,
+                   std::vector<WorldCameraDescriptor> *out_descriptors);
+
+  /*! Extracts the features of the frame buffer of `frame`. */
+  MLResult Extract(const MLWorldCameraFrame &frame, std::vector<WorldCameraFeature> *out_features,
+                   std::vector<WorldCameraDescriptor> *out_descriptors);
+
+  /*! Number of differing bits between two descriptors. */
+  static uint32_t Distance(const WorldCameraDescriptor &a, const WorldCameraDescriptor &b);
+
+private:
+  struct Candidate {
+    uint32_t x, y;
+    float score;
+  };
+  struct Tile {
+    uint32_t x0, y0, x1, y1;
+    std::vector<Candidate> candidates;
+    std::vector<Candidate> kept;
+  };
+
+  void Detect(Tile &tile);
+  void Suppress(Tile &tile, size_t quota) const;
+  void Smooth(uint32_t row_begin, uint32_t row_end, std::vector<float> &scratch);
+  void Describe(WorldCameraFeature *feature, WorldCameraDescriptor *out_descriptor) const;
+
+  WorldCameraFeatureSettings settings_;
+  std::unique_ptr<native_utils::WorkerPool> pool_;
+
+  // Test pairs as (x0, y0, x1, y1) per rotation step, and as offsets into
+  // smooth_ for the current width.
+  std::vector<int8_t> pattern_;
+  std::vector<int32_t> offsets_;
+
+  // Current frame: 8-bit pixels, either the buffer itself or converted.
+  const uint8_t *pixels_ = nullptr;
+  size_t stride_ = 0;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<uint8_t> converted_;
+  std::vector<uint8_t> smooth_;
+  std::vector<float> scores_;
+
+  std::vector<Tile> tiles_;
+  std::vector<std::vector<float>> scratch_;
+  std::vector<Candidate> selected_;
+};
+
+/*! \} */
@@ -0,0 +1,327 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "world_camera_grabber.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+struct WorldCameraTupleView::Slot {
+  std::atomic<uint32_t> references{0};
+  WorldCameraGrabber *grabber = nullptr;
+  // Holds SDK data not yet released; guarded by the grabber's mutex.
+  bool acquired = false;
+  MLWorldCameraData *data = nullptr;
+};
+
+namespace {
+
+int CameraIndex(MLWorldCameraIdentifier id) {
+  switch (id) {
+    case MLWorldCameraIdentifier_Left: return 0;
+    case MLWorldCameraIdentifier_Right: return 1;
+    case MLWorldCameraIdentifier_Center: return 2;
+    default: return -1;
+  }
+}
+
+}  // namespace
+
+WorldCameraTupleView::WorldCameraTupleView(const WorldCameraTupleView &other)
+    : timestamp_(other.timestamp_), frame_type_(other.frame_type_), sequence_(other.sequence_) {
+  for (int i = 0; i < kCameras; i++) {
+    slots_[i] = other.slots_[i];
+    frames_[i] = other.frames_[i];
+    if (slots_[i] != nullptr) {
+      slots_[i]->references.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+WorldCameraTupleView::WorldCameraTupleView(WorldCameraTupleView &&other) noexcept
+    : timestamp_(other.timestamp_), frame_type_(other.frame_type_), sequence_(other.sequence_) {
+  for (int i = 0; i < kCameras; i++) {
+    slots_[i] = other.slots_[i];
+    frames_[i] = other.frames_[i];
+    other.slots_[i] = nullptr;
+    other.frames_[i] = nullptr;
+  }
+  other.sequence_ = 0;
+}
+
+WorldCameraTupleView &WorldCameraTupleView::operator=(WorldCameraTupleView other) noexcept {
+  std::swap(slots_, other.slots_);
+  std::swap(frames_, other.frames_);
+  std::swap(timestamp_, other.timestamp_);
+  std::swap(frame_type_, other.frame_type_);
+  std::swap(sequence_, other.sequence_);
+  return *this;
+}
+
+WorldCameraTupleView::~WorldCameraTupleView() {
+  reset();
+}
+
+const MLWorldCameraFrame *WorldCameraTupleView::Frame(MLWorldCameraIdentifier id) const {
+  const int index = CameraIndex(id);
+  return index >= 0 ? frames_[index] : nullptr;
+}
+
+uint32_t WorldCameraTupleView::cameras() const {
+  uint32_t cameras = 0;
+  for (int i = 0; i < kCameras; i++) {
+    cameras |= frames_[i] != nullptr ? 1u << i : 0u;
+  }
+  return cameras;
+}
+
+void WorldCameraTupleView::reset() {
+  for (int i = 0; i < kCameras; i++) {
+    Slot *slot = slots_[i];
+    slots_[i] = nullptr;
+    frames_[i] = nullptr;
+    if (slot == nullptr) {
+      continue;
+    }
+    uint32_t references = slot->references.load(std::memory_order_relaxed);
+    bool dropped = false;
+    while (references > 1 && !dropped) {
+      dropped = slot->references.compare_exchange_weak(references, references - 1, std::memory_order_acq_rel);
+    }
+    // The last reference is dropped under the grabber's lock, so a grabber
+    // being destroyed cannot observe the free slot before this call is done with it.
+    if (!dropped) {
+      slot->grabber->OnSlotFree(slot);
+    }
+  }
+  sequence_ = 0;
+}
+
+WorldCameraGrabber::WorldCameraGrabber(MLHandle camera, const WorldCameraGrabberSettings &settings)
+    : camera_(camera), settings_(settings) {
+  settings_.capacity = std::max<uint32_t>(settings_.capacity, 1);
+  slots_.reset(new Slot[settings_.capacity]);
+  for (uint32_t i = 0; i < settings_.capacity; i++) {
+    slots_[i].grabber = this;
+  }
+}
+
+WorldCameraGrabber::~WorldCameraGrabber() {
+  WorldCameraTupleView latest;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest = std::move(latest_);
+    for (WorldCameraTupleView &tuple : pending_) {
+      Drop(&tuple);
+    }
+    pending_.clear();
+  }
+  latest.reset();
+  std::unique_lock<std::mutex> lock(mutex_);
+  slot_free_.wait(lock, [this] {
+    ReleaseUnusedLocked();
+    for (uint32_t i = 0; i < settings_.capacity; i++) {
+      if (slots_[i].acquired) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void WorldCameraGrabber::OnSlotFree(Slot *slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  slot->references.fetch_sub(1, std::memory_order_acq_rel);
+  slot_free_.notify_all();
+}
+
+void WorldCameraGrabber::ReleaseUnusedLocked() {
+  for (uint32_t i = 0; i < settings_.capacity; i++) {
+    Slot &slot = slots_[i];
+    if (slot.acquired && slot.references.load(std::memory_order_acquire) == 0) {
+      MLWorldCameraReleaseCameraData(camera_, slot.data);
+      slot.data = nullptr;
+      slot.acquired = false;
+      stats_.released++;
+    }
+  }
+}
+
+void WorldCameraGrabber::ReleaseUnused() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseUnusedLocked();
+}
+
+void WorldCameraGrabber::File(Slot *slot, const MLWorldCameraFrame &frame) {
+  const int index = CameraIndex(frame.id);
+  if (index < 0 || (settings_.cameras & frame.id) == 0) {
+    return;
+  }
+  newest_timestamp_ = std::max(newest_timestamp_, frame.timestamp);
+  WorldCameraTupleView *tuple = nullptr;
+  for (WorldCameraTupleView &candidate : pending_) {
+    const MLTime skew = frame.timestamp - candidate.timestamp_;
+    if (candidate.frame_type_ == frame.frame_type && candidate.frames_[index] == nullptr &&
+        std::max(skew, -skew) <= settings_.max_skew_ns) {
+      tuple = &candidate;
+      break;
+    }
+  }
+  if (tuple == nullptr) {
+    WorldCameraTupleView created;
+    created.timestamp_ = frame.timestamp;
+    created.frame_type_ = frame.frame_type;
+    auto position = std::upper_bound(pending_.begin(), pending_.end(), frame.timestamp,
+                                     [](MLTime t, const WorldCameraTupleView &v) { return t < v.timestamp_; });
+    tuple = &*pending_.insert(position, std::move(created));
+  }
+  tuple->timestamp_ = std::min(tuple->timestamp_, frame.timestamp);
+  tuple->slots_[index] = slot;
+  tuple->frames_[index] = &frame;
+  slot->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WorldCameraGrabber::Drop(WorldCameraTupleView *tuple) {
+  // Called with the lock held, so the references can be dropped directly;
+  // slots reaching zero are released by the next ReleaseUnusedLocked().
+  for (int i = 0; i < WorldCameraTupleView::kCameras; i++) {
+    if (tuple->slots_[i] != nullptr) {
+      tuple->slots_[i]->references.fetch_sub(1, std::memory_order_acq_rel);
+      tuple->slots_[i] = nullptr;
+      tuple->frames_[i] = nullptr;
+      stats_.dropped_frames++;
+    }
+  }
+  slot_free_.notify_all();
+}
+
+void WorldCameraGrabber::Publish(WorldCameraTupleView *tuple, bool partial, std::vector<WorldCameraTupleView> *retired,
+                                 WorldCameraTupleView *out_view) {
+  tuple->sequence_ = ++sequence_;
+  stats_.tuples++;
+  stats_.partial_tuples += partial ? 1 : 0;
+  // The replaced latest tuple may hold the last references to its slots;
+  // it is dropped by the caller once the lock is released.
+  retired->push_back(std::move(latest_));
+  latest_ = std::move(*tuple);
+  if (out_view != nullptr) {
+    retired->push_back(std::move(*out_view));
+    *out_view = latest_;
+  }
+}
+
+void WorldCameraGrabber::Resolve(bool flush_oldest, std::vector<WorldCameraTupleView> *retired,
+                                 WorldCameraTupleView *out_view) {
+  const uint32_t wanted = settings_.cameras & MLWorldCameraIdentifier_All;
+  size_t last_complete = 0;
+  bool any_complete = false;
+  for (size_t i = 0; i < pending_.size(); i++) {
+    if ((pending_[i].cameras() & wanted) == wanted) {
+      last_complete = i;
+      any_complete = true;
+    }
+  }
+  size_t resolved = 0;
+  for (; resolved < pending_.size(); resolved++) {
+    WorldCameraTupleView &tuple = pending_[resolved];
+    const bool complete = (tuple.cameras() & wanted) == wanted;
+    const bool overtaken = any_complete && resolved < last_complete;
+    const bool expired = newest_timestamp_ - tuple.timestamp_ > settings_.max_wait_ns;
+    if (!complete && !overtaken && !expired && !(flush_oldest && resolved == 0)) {
+      break;
+    }
+    if (complete) {
+      Publish(&tuple, false, retired, out_view);
+    } else if (settings_.straggler_policy == WorldCameraStragglerPolicy_Partial) {
+      Publish(&tuple, true, retired, out_view);
+    } else {
+      Drop(&tuple);
+    }
+  }
+  pending_.erase(pending_.begin(), pending_.begin() + resolved);
+}
+
+MLResult WorldCameraGrabber::Poll(uint64_t timeout_ms, WorldCameraTupleView *out_view) {
+  // Declared before the lock so that replaced views are dropped after it is released.
+  std::vector<WorldCameraTupleView> retired;
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t published = stats_.tuples;
+  Slot *slot = nullptr;
+  auto find_free = [&] {
+    ReleaseUnusedLocked();
+    for (uint32_t i = 0; i < settings_.capacity && slot == nullptr; i++) {
+      if (!slots_[i].acquired) {
+        slot = &slots_[i];
+      }
+    }
+    return slot != nullptr;
+  };
+  // Pending tuples cannot complete without new data, so resolve them
+  // before waiting on consumers.
+  while (!find_free() && !pending_.empty()) {
+    Resolve(true, &retired, out_view);
+  }
+  if (slot == nullptr) {
+    stats_.waits++;
+    lock.unlock();
+    retired.clear();
+    lock.lock();
+    if (!slot_free_.wait_for(lock, std::chrono::milliseconds(timeout_ms), find_free)) {
+      stats_.stalls++;
+      return stats_.tuples != published ? MLResult_Ok : MLResult_Timeout;
+    }
+  }
+  // Reserve the slot while the camera fills it without the lock held.
+  slot->acquired = true;
+  lock.unlock();
+
+  MLWorldCameraData *data = nullptr;
+  const MLResult result = MLWorldCameraGetLatestWorldCameraData(camera_, timeout_ms, &data);
+
+  lock.lock();
+  if (result != MLResult_Ok || data == nullptr) {
+    slot->acquired = false;
+    const MLResult failure = result != MLResult_Ok ? result : MLResult_UnspecifiedFailure;
+    return stats_.tuples != published ? MLResult_Ok : failure;
+  }
+  stats_.acquired++;
+  slot->data = data;
+  slot->references.store(0, std::memory_order_relaxed);
+  for (uint8_t i = 0; i < data->frame_count && data->frames != nullptr; i++) {
+    File(slot, data->frames[i]);
+  }
+  Resolve(false, &retired, out_view);
+  // Data without a wanted frame is released right away.
+  ReleaseUnusedLocked();
+  return stats_.tuples != published ? MLResult_Ok : MLResult_Pending;
+}
+
+WorldCameraTupleView WorldCameraGrabber::Latest() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latest_;
+}
+
+size_t WorldCameraGrabber::in_use() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t used = 0;
+  for (uint32_t i = 0; i < settings_.capacity; i++) {
+    used += slots_[i].acquired ? 1 : 0;
+  }
+  return used;
+}
+
+WorldCameraGrabberStats WorldCameraGrabber::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
@@ -0,0 +1,226 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_types.h"
+#include "ml_world_camera.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief What a WorldCameraGrabber does with a tuple whose cameras did not all deliver. */
+typedef enum WorldCameraStragglerPolicy {
+  /*! Release the frames; only complete tuples are published. */
+  WorldCameraStragglerPolicy_Drop = 0,
+  /*! Publish the tuple with the frames that arrived. */
+  WorldCameraStragglerPolicy_Partial = 1,
+  WorldCameraStragglerPolicy_Ensure32Bits = 0x7FFFFFFF
+} WorldCameraStragglerPolicy;
+
+/*! \brief Parameters of a WorldCameraGrabber. */
+typedef struct WorldCameraGrabberSettings {
+  /*! MLWorldCameraIdentifier bits a complete tuple holds; frames of other cameras are ignored. */
+  uint32_t cameras;
+  /*! Largest timestamp difference between frames of one tuple. */
+  MLTime max_skew_ns;
+  /*!
+    \brief How far frames may run ahead of an incomplete tuple, in frame
+           timestamps, before it is handled by straggler_policy.
+  */
+  MLTime max_wait_ns;
+  WorldCameraStragglerPolicy straggler_policy;
+  /*! Number of MLWorldCameraData objects that may be held at once. */
+  uint32_t capacity;
+} WorldCameraGrabberSettings;
+
+/*!
+  \brief Initializes WorldCameraGrabberSettings for complete left, right and
+         center tuples within 1 ms, waiting up to 50 ms for stragglers.
+*/
+inline void WorldCameraGrabberSettingsInit(WorldCameraGrabberSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->cameras = MLWorldCameraIdentifier_All;
+    inout_settings->max_skew_ns = 1000000;
+    inout_settings->max_wait_ns = 50000000;
+    inout_settings->straggler_policy = WorldCameraStragglerPolicy_Drop;
+    inout_settings->capacity = 6;
+  }
+}
+
+/*! \brief Counters of a WorldCameraGrabber. */
+typedef struct WorldCameraGrabberStats {
+  /*! MLWorldCameraData objects obtained from the cameras. */
+  uint64_t acquired;
+  /*! MLWorldCameraData objects handed back with MLWorldCameraReleaseCameraData(). */
+  uint64_t released;
+  /*! Tuples published, including partial ones. */
+  uint64_t tuples;
+  /*! Incomplete tuples published under WorldCameraStragglerPolicy_Partial. */
+  uint64_t partial_tuples;
+  /*! Frames released without being published under WorldCameraStragglerPolicy_Drop. */
+  uint64_t dropped_frames;
+  /*! Poll() calls that had to wait for a consumer to free a slot. */
+  uint64_t waits;
+  /*! Poll() calls that timed out because every slot stayed in use. */
+  uint64_t stalls;
+} WorldCameraGrabberStats;
+
+class WorldCameraGrabber;
+
+/*!
+  \brief Reference-counted view of one synchronized tuple of world camera frames.
+
+  The frames point into the MLWorldCameraData objects returned by the SDK,
+  which stay valid until the last view referring to them is dropped.
+  Views may be copied and dropped on any thread.
+*/
+class WorldCameraTupleView {
+public:
+  WorldCameraTupleView() = default;
+  WorldCameraTupleView(const WorldCameraTupleView &other);
+  WorldCameraTupleView(WorldCameraTupleView &&other) noexcept;
+  WorldCameraTupleView &operator=(WorldCameraTupleView other) noexcept;
+  ~WorldCameraTupleView();
+
+  /*! The frame of camera `id`, or null when the tuple has none. */
+  const MLWorldCameraFrame *Frame(MLWorldCameraIdentifier id) const;
+
+  /*! MLWorldCameraIdentifier bits of the cameras in the tuple. */
+  uint32_t cameras() const;
+
+  /*! Timestamp of the earliest frame in the tuple. */
+  MLTime timestamp() const { return timestamp_; }
+
+  /*! Exposure every frame of the tuple was captured with. */
+  MLWorldCameraFrameType frame_type() const { return frame_type_; }
+
+  /*! Publication sequence number of the tuple, starting at 1. */
+  uint64_t sequence() const { return sequence_; }
+
+  explicit operator bool() const { return sequence_ != 0; }
+
+  /*! Drops this view's references. */
+  void reset();
+
+private:
+  friend class WorldCameraGrabber;
+  struct Slot;
+  static constexpr int kCameras = 3;
+
+  // One reference per frame, to the slot holding the frame.
+  Slot *slots_[kCameras] = {};
+  const MLWorldCameraFrame *frames_[kCameras] = {};
+  MLTime timestamp_ = 0;
+  MLWorldCameraFrameType frame_type_ = MLWorldCameraFrameType_Unknown;
+  uint64_t sequence_ = 0;
+};
+
+/*!
+  \brief Groups world camera frames into synchronized tuples and shares them without copies.
+
+  MLWorldCameraGetLatestWorldCameraData() returns whatever frames are ready,
+  so one call may hold frames of several exposures and the partner of a
+  frame may only come with the next call. Poll() fetches the next data into
+  a fixed set of slots and files every frame into a pending tuple with the
+  same frame type and a timestamp within max_skew_ns, never pairing low and
+  normal exposures. As soon as a tuple holds every camera in `cameras` it is
+  published, oldest first; incomplete tuples older than a published one, or
+  than max_wait_ns behind the newest frame, are handled by
+  straggler_policy.
+
+  Consumers hold WorldCameraTupleView references instead of copying the
+  buffers. An MLWorldCameraData object is handed back with
+  MLWorldCameraReleaseCameraData() once none of its frames is pending or
+  referenced; because the world camera API is not thread safe, these
+  releases are deferred to the polling thread (the next Poll() or
+  ReleaseUnused()). When every slot is held, Poll() first resolves the
+  oldest pending tuple by policy, then waits up to its timeout for a view to
+  be dropped, so slow consumers throttle the producer.
+
+  Poll() and ReleaseUnused() must be called from one thread; Latest() and
+  views may be used from any thread. Destroying the grabber waits for every
+  view to be dropped.
+*/
+class WorldCameraGrabber {
+public:
+  /*! \param[in] camera Handle from MLWorldCameraConnect(); must outlive the grabber. */
+  WorldCameraGrabber(MLHandle camera, const WorldCameraGrabberSettings &settings);
+  ~WorldCameraGrabber();
+
+  WorldCameraGrabber(const WorldCameraGrabber &) = delete;
+  WorldCameraGrabber &operator=(const WorldCameraGrabber &) = delete;
+
+  /*!
+    \brief Fetches the next camera data and publishes the tuples it completes.
+
+    \param[in] timeout_ms Longest time to wait, first for a free slot and
+               then for new data.
+    \param[out] out_view Optional view of the newest tuple published.
+
+    \retval MLResult_Ok At least one tuple was published.
+    \retval MLResult_Pending The frames were filed, but no tuple is complete yet.
+    \retval MLResult_Timeout No slot was freed, or no new data arrived, in time.
+    \return Otherwise the failure returned by MLWorldCameraGetLatestWorldCameraData().
+  */
+  MLResult Poll(uint64_t timeout_ms, WorldCameraTupleView *out_view = nullptr);
+
+  /*! View of the most recently published tuple, or an empty view. */
+  WorldCameraTupleView Latest() const;
+
+  /*! Releases the data no pending tuple or view refers to any more. */
+  void ReleaseUnused();
+
+  /*! Number of slots currently holding camera data. */
+  size_t in_use() const;
+
+  WorldCameraGrabberStats stats() const;
+
+private:
+  friend class WorldCameraTupleView;
+  using Slot = WorldCameraTupleView::Slot;
+
+  void ReleaseUnusedLocked();
+  void OnSlotFree(Slot *slot);
+  void File(Slot *slot, const MLWorldCameraFrame &frame);
+  void Resolve(bool flush_oldest, std::vector<WorldCameraTupleView> *retired, WorldCameraTupleView *out_view);
+  void Publish(WorldCameraTupleView *tuple, bool partial, std::vector<WorldCameraTupleView> *retired,
+               WorldCameraTupleView *out_view);
+  void Drop(WorldCameraTupleView *tuple);
+
+  MLHandle camera_;
+  WorldCameraGrabberSettings settings_;
+  std::unique_ptr<Slot[]> slots_;
+  mutable std::mutex mutex_;
+  std::condition_variable slot_free_;
+  // Tuples still collecting frames, oldest first; they hold slot
+  // references like views but are not published yet.
+  std::vector<WorldCameraTupleView> pending_;
+  MLTime newest_timestamp_ = 0;
+  WorldCameraTupleView latest_;
+  uint64_t sequence_ = 0;
+  WorldCameraGrabberStats stats_ = {};
+};
+
+/*! \} */
@@ -0,0 +1,553 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#include "world_camera_stereo.h"
+
+#include "depth_projection.h"
+#include "simd_float8.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using native_utils::Float8;
+using native_utils::RotationMatrix;
+using native_utils::WorkerPool;
+
+namespace {
+
+constexpr int kLanes = Float8::kWidth;
+constexpr uint32_t kMaxDisparities = 256;
+constexpr uint32_t kMatchBand = 64;
+
+MLQuaternionf QuaternionFromMatrix(const float (&m)[3][3]) {
+  MLQuaternionf q;
+  const float trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0.0f) {
+    const float s = 2.0f * std::sqrt(1.0f + trace);
+    q.w = 0.25f * s;
+    q.x = (m[2][1] - m[1][2]) / s;
+    q.y = (m[0][2] - m[2][0]) / s;
+    q.z = (m[1][0] - m[0][1]) / s;
+  } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+    const float s = 2.0f * std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]);
+    q.w = (m[2][1] - m[1][2]) / s;
+    q.x = 0.25f * s;
+    q.y = (m[0][1] + m[1][0]) / s;
+    q.z = (m[0][2] + m[2][0]) / s;
+  } else if (m[1][1] > m[2][2]) {
+    const float s = 2.0f * std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]);
+    q.w = (m[0][2] - m[2][0]) / s;
+    q.x = (m[0][1] + m[1][0]) / s;
+    q.y = 0.25f * s;
+    q.z = (m[1][2] + m[2][1]) / s;
+  } else {
+    const float s = 2.0f * std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]);
+    q.w = (m[1][0] - m[0][1]) / s;
+    q.x = (m[0][2] + m[2][0]) / s;
+    q.y = (m[1][2] + m[2][1]) / s;
+    q.z = 0.25f * s;
+  }
+  return q;
+}
+
+// Camera to world rotation with the pinhole axes: x right, y down, z forward.
+void CameraRotation(const MLTransform &pose, bool opengl_axes, float (&m)[3][3]) {
+  RotationMatrix(pose.rotation, m);
+  if (opengl_axes) {
+    for (int i = 0; i < 3; i++) {
+      m[i][1] = -m[i][1];
+      m[i][2] = -m[i][2];
+    }
+  }
+}
+
+bool SameIntrinsics(const MLWorldCameraIntrinsics &a, const MLWorldCameraIntrinsics &b) {
+  if (a.width != b.width || a.height != b.height || a.focal_length.x != b.focal_length.x ||
+      a.focal_length.y != b.focal_length.y || a.principal_point.x != b.principal_point.x ||
+      a.principal_point.y != b.principal_point.y) {
+    return false;
+  }
+  return memcmp(a.radial_distortion, b.radial_distortion, sizeof(a.radial_distortion)) == 0 &&
+         memcmp(a.tangential_distortion, b.tangential_distortion, sizeof(a.tangential_distortion)) == 0;
+}
+
+// Maps a normalized pinhole coordinate to a distorted one.
+void Distort(WorldCameraDistortionModel model, const MLWorldCameraIntrinsics &intrinsics, double x, double y,
+             double *xd, double *yd) {
+  const double *k = intrinsics.radial_distortion;
+  const double p1 = intrinsics.tangential_distortion[0], p2 = intrinsics.tangential_distortion[1];
+  if (model == WorldCameraDistortionModel_Fisheye) {
+    const double r = std::sqrt(x * x + y * y);
+    const double theta = std::atan(r), t2 = theta * theta;
+    const double theta_d = theta * (1.0 + t2 * (k[0] + t2 * (k[1] + t2 * (k[2] + t2 * k[3]))));
+    const double s = r > 1e-12 ? theta_d / r : 1.0;
+    x *= s;
+    y *= s;
+  }
+  const double r2 = x * x + y * y;
+  const double radial =
+      model == WorldCameraDistortionModel_Fisheye ? 1.0 : 1.0 + r2 * (k[0] + r2 * (k[1] + r2 * (k[2] + r2 * k[3])));
+  *xd = x * radial + 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x);
+  *yd = y * radial + p1 * (r2 + 2.0 * y * y) + 2.0 * p2 * x * y;
+}
+
+bool ValidBuffer(const MLWorldCameraFrame &frame) {
+  const MLWorldCameraFrameBuffer &buffer = frame.frame_buffer;
+  const uint32_t depth = buffer.bytes_per_pixel;
+  return buffer.data != nullptr && (depth == 1 || depth == 2) && buffer.width == frame.intrinsics.width &&
+         buffer.height == frame.intrinsics.height && buffer.width >= 2 && buffer.height >= 2 &&
+         buffer.stride >= static_cast<uint64_t>(buffer.width) * depth &&
+         buffer.size >= static_cast<uint64_t>(buffer.stride) * (buffer.height - 1) + uint64_t(buffer.width) * depth;
+}
+
+}  // namespace
+
+WorldCameraStereo::WorldCameraStereo(const WorldCameraStereoSettings &settings)
+    : settings_(settings), pool_(new WorkerPool(settings.thread_count)) {
+  if (settings_.scale == 0) {
+    settings_.scale = 1;
+  }
+  disparities_ = (std::min(std::max(settings_.max_disparity, 1u), kMaxDisparities) + kLanes - 1) / kLanes * kLanes;
+  columns_.resize(pool_->size());
+  costs_.resize(pool_->size());
+}
+
+WorldCameraStereo::~WorldCameraStereo() = default;
+
+MLResult WorldCameraStereo::Compute(const MLWorldCameraData &data) {
+  const MLWorldCameraFrame *left = nullptr;
+  const MLWorldCameraFrame *right = nullptr;
+  for (uint8_t i = 0; i < data.frame_count && data.frames != nullptr; i++) {
+    const MLWorldCameraFrame &frame = data.frames[i];
+    if (frame.id == MLWorldCameraIdentifier_Left && left == nullptr) {
+      left = &frame;
+    } else if (frame.id == MLWorldCameraIdentifier_Right && right == nullptr) {
+      right = &frame;
+    }
+  }
+  if (left == nullptr || right == nullptr) {
+    return MLResult_InvalidParam;
+  }
+  return Compute(*left, *right);
+}
+
+MLResult WorldCameraStereo::Compute(const MLWorldCameraFrame &left, const MLWorldCameraFrame &right) {
+  if (!ValidBuffer(left) || !ValidBuffer(right) || left.intrinsics.width != right.intrinsics.width ||
+      left.intrinsics.height != right.intrinsics.height || left.intrinsics.width / settings_.scale < 2 ||
+      left.intrinsics.height / settings_.scale < 2) {
+    return MLResult_InvalidParam;
+  }
+  // Relative pose: right camera to left camera, and the right camera's center in the left camera.
+  float left_rotation[3][3], right_rotation[3][3];
+  CameraRotation(left.camera_pose, settings_.opengl_axes, left_rotation);
+  CameraRotation(right.camera_pose, settings_.opengl_axes, right_rotation);
+  const float offset[3] = {right.camera_pose.position.x - left.camera_pose.position.x,
+                           right.camera_pose.position.y - left.camera_pose.position.y,
+                           right.camera_pose.position.z - left.camera_pose.position.z};
+  float rotation[3][3], translation[3];
+  for (int i = 0; i < 3; i++) {
+    translation[i] =
+        left_rotation[0][i] * offset[0] + left_rotation[1][i] * offset[1] + left_rotation[2][i] * offset[2];
+    for (int j = 0; j < 3; j++) {
+      rotation[i][j] = left_rotation[0][i] * right_rotation[0][j] + left_rotation[1][i] * right_rotation[1][j] +
+                       left_rotation[2][i] * right_rotation[2][j];
+    }
+  }
+  if (translation[0] <= 0.0f) {
+    return MLResult_InvalidParam;
+  }
+  if (!MapsMatch(left.intrinsics, right.intrinsics, rotation, translation)) {
+    BuildMaps(left.intrinsics, right.intrinsics, rotation, translation);
+  }
+
+  // Frames are read in place when they are 8-bit and full size, and are
+  // otherwise shrunk into 8-bit copies first.
+  const MLWorldCameraFrameBuffer *buffers[2] = {&left.frame_buffer, &right.frame_buffer};
+  const uint8_t *sources[2];
+  size_t strides[2];
+  const uint32_t scale = settings_.scale;
+  const uint32_t source_width = left.intrinsics.width / scale, source_height = left.intrinsics.height / scale;
+  for (int camera = 0; camera < 2; camera++) {
+    if (scale == 1 && buffers[camera]->bytes_per_pixel == 1) {
+      sources[camera] = buffers[camera]->data;
+      strides[camera] = buffers[camera]->stride;
+    } else {
+      sources[camera] = sources_[camera].data();
+      strides[camera] = source_width;
+    }
+  }
+  pool_->ParallelFor(2 * static_cast<size_t>(source_height), 16, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      const int camera = i < source_height ? 0 : 1;
+      if (sources[camera] != buffers[camera]->data) {
+        Shrink(*buffers[camera], camera, static_cast<uint32_t>(i % source_height));
+      }
+    }
+  });
+  const uint32_t height = height_;
+  pool_->ParallelFor(2 * static_cast<size_t>(height), 16, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      const int camera = i < height ? 0 : 1;
+      Remap(sources[camera], strides[camera], camera, static_cast<uint32_t>(i % height));
+    }
+  });
+  pool_->ParallelFor(2 * static_cast<size_t>(height), 16, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      Prefilter(i < height ? 0 : 1, static_cast<uint32_t>(i % height));
+    }
+  });
+  pool_->ParallelFor((height + kMatchBand - 1) / kMatchBand, 1, [&](size_t begin, size_t end, unsigned worker) {
+    for (size_t band = begin; band < end; band++) {
+      const uint32_t row = static_cast<uint32_t>(band) * kMatchBand;
+      Match(row, std::min(row + kMatchBand, height), worker);
+    }
+  });
+
+  // The rectified left camera: the left camera turned by the transpose of its rectifying rotation.
+  float m[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      m[i][j] = left_rotation[i][0] * rectify_[0][j][0] + left_rotation[i][1] * rectify_[0][j][1] +
+                left_rotation[i][2] * rectify_[0][j][2];
+    }
+  }
+  if (settings_.opengl_axes) {
+    for (int i = 0; i < 3; i++) {
+      m[i][1] = -m[i][1];
+      m[i][2] = -m[i][2];
+    }
+  }
+  pose_.rotation = QuaternionFromMatrix(m);
+  pose_.position = left.camera_pose.position;
+  return MLResult_Ok;
+}
+
+bool WorldCameraStereo::MapsMatch(const MLWorldCameraIntrinsics &left, const MLWorldCameraIntrinsics &right,
+                                  const float (&rotation)[3][3], const float (&translation)[3]) const {
+  if (rectification_count_ == 0 || !SameIntrinsics(left, map_intrinsics_[0]) ||
+      !SameIntrinsics(right, map_intrinsics_[1])) {
+    return false;
+  }
+  // Angle of the rotation between the two relative rotations, from its trace.
+  float trace = 0.0f, distance2 = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      trace += map_rotation_[j][i] * rotation[j][i];
+    }
+    distance2 += (translation[i] - map_translation_[i]) * (translation[i] - map_translation_[i]);
+  }
+  const float angle = std::acos(std::min(std::max((trace - 1.0f) * 0.5f, -1.0f), 1.0f));
+  const float tolerance = settings_.translation_tolerance;
+  return angle <= settings_.rotation_tolerance && distance2 <= tolerance * tolerance;
+}
+
+void WorldCameraStereo::BuildMaps(const MLWorldCameraIntrinsics &left, const MLWorldCameraIntrinsics &right,
+                                  const float (&rotation)[3][3], const float (&translation)[3]) {
+  map_intrinsics_[0] = left;
+  map_intrinsics_[1] = right;
+  memcpy(map_rotation_, rotation, sizeof(map_rotation_));
+  memcpy(map_translation_, translation, sizeof(map_translation_));
+  rectification_count_++;
+
+  // Rectified axes in the left camera: x along the baseline, y down, z
+  // closest to the mean optical axis.
+  const double length = std::sqrt(double(translation[0]) * translation[0] + double(translation[1]) * translation[1] +
+                                  double(translation[2]) * translation[2]);
+  const double e1[3] = {translation[0] / length, translation[1] / length, translation[2] / length};
+  const double axis[3] = {rotation[0][2], rotation[1][2], 1.0 + rotation[2][2]};
+  double e2[3] = {axis[1] * e1[2] - axis[2] * e1[1], axis[2] * e1[0] - axis[0] * e1[2],
+                  axis[0] * e1[1] - axis[1] * e1[0]};
+  const double norm = std::sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]);
+  for (double &value : e2) {
+    value /= norm;
+  }
+  const double e3[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+  for (int j = 0; j < 3; j++) {
+    rectify_[0][0][j] = static_cast<float>(e1[j]);
+    rectify_[0][1][j] = static_cast<float>(e2[j]);
+    rectify_[0][2][j] = static_cast<float>(e3[j]);
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      rectify_[1][i][j] = rectify_[0][i][0] * rotation[0][j] + rectify_[0][i][1] * rotation[1][j] +
+                          rectify_[0][i][2] * rotation[2][j];
+    }
+  }
+  baseline_ = static_cast<float>(length);
+
+  const uint32_t scale = settings_.scale;
+  width_ = left.width / scale;
+  height_ = left.height / scale;
+  const double focal = std::min(std::min(left.focal_length.x, left.focal_length.y),
+                                std::min(right.focal_length.x, right.focal_length.y)) /
+                       static_cast<double>(scale);
+  const double cx = (width_ - 1) * 0.5, cy = (height_ - 1) * 0.5;
+  intrinsics_ = {};
+  intrinsics_.width = width_;
+  intrinsics_.height = height_;
+  intrinsics_.focal_length.x = intrinsics_.focal_length.y = static_cast<float>(focal);
+  intrinsics_.principal_point.x = static_cast<float>(cx);
+  intrinsics_.principal_point.y = static_cast<float>(cy);
+  intrinsics_.fov = static_cast<float>(2.0 * std::atan(width_ * 0.5 / focal) * 180.0 / 3.14159265358979);
+
+  const size_t count = static_cast<size_t>(width_) * height_;
+  const MLWorldCameraIntrinsics *sources[2] = {&left, &right};
+  for (int camera = 0; camera < 2; camera++) {
+    maps_[camera].resize(count);
+    const MLWorldCameraIntrinsics &source = *sources[camera];
+    const float(&r)[3][3] = rectify_[camera];
+    pool_->ParallelFor(height_, 16, [&](size_t begin, size_t end, unsigned) {
+      for (size_t v = begin; v < end; v++) {
+        MapEntry *map = &maps_[camera][v * width_];
+        for (uint32_t u = 0; u < width_; u++) {
+          map[u] = {};
+          // Ray of the rectified pixel in the source camera.
+          const double x = (u - cx) / focal, y = (v - cy) / focal;
+          const double rx = r[0][0] * x + r[1][0] * y + r[2][0];
+          const double ry = r[0][1] * x + r[1][1] * y + r[2][1];
+          const double rz = r[0][2] * x + r[1][2] * y + r[2][2];
+          if (rz <= 1e-6) {
+            continue;
+          }
+          double xd, yd;
+          Distort(settings_.distortion_model, source, rx / rz, ry / rz, &xd, &yd);
+          // Pixel of the source shrunk by scale.
+          const double su = (source.focal_length.x * xd + source.principal_point.x + 0.5) / scale - 0.5;
+          const double sv = (source.focal_length.y * yd + source.principal_point.y + 0.5) / scale - 0.5;
+          if (!(su >= 0.0 && sv >= 0.0 && su < source.width / scale - 1.0 && sv < source.height / scale - 1.0)) {
+            continue;
+          }
+          const double fu = std::floor(su), fv = std::floor(sv);
+          map[u].x = static_cast<uint16_t>(fu);
+          map[u].y = static_cast<uint16_t>(fv);
+          map[u].wx = static_cast<uint8_t>(std::min((su - fu) * 256.0, 255.0));
+          map[u].wy = static_cast<uint8_t>(std::min((sv - fv) * 256.0, 255.0));
+          map[u].valid = 1;
+        }
+      }
+    });
+  }
+
+  const float neutral = static_cast<float>(settings_.prefilter_cap);
+  for (int camera = 0; camera < 2; camera++) {
+    sources_[camera].resize(static_cast<size_t>(sources[camera]->width / scale) * (sources[camera]->height / scale));
+  }
+  rectified_[0].assign(count, 0);
+  rectified_[1].assign(count, 0);
+  left_pitch_ = width_ + kLanes;
+  left_.assign(left_pitch_ * height_, neutral);
+  right_pitch_ = disparities_ + width_ + kLanes;
+  right_.assign(right_pitch_ * height_, neutral);
+  for (size_t worker = 0; worker < columns_.size(); worker++) {
+    columns_[worker].assign(left_pitch_ * disparities_, 0.0f);
+    costs_[worker].assign(static_cast<size_t>(disparities_) * kLanes, 0.0f);
+  }
+  disparity_.assign(count, -1.0f);
+  depth_.assign(count, 0.0f);
+  depth_image_ = {};
+  depth_image_.width = width_;
+  depth_image_.height = height_;
+  depth_image_.stride = width_ * sizeof(float);
+  depth_image_.bytes_per_unit = sizeof(float);
+  depth_image_.size = static_cast<uint32_t>(count * sizeof(float));
+  depth_image_.data = depth_.data();
+}
+
+void WorldCameraStereo::Shrink(const MLWorldCameraFrameBuffer &buffer, int camera, uint32_t row) {
+  // Box average of scale x scale pixels, which keeps fine texture from
+  // aliasing in the rectified images.
+  const uint32_t scale = settings_.scale;
+  const uint32_t width = buffer.width / scale;
+  const uint32_t shift = buffer.bytes_per_pixel == 2 ? std::min(std::max(settings_.significant_bits, 8u), 16u) - 8 : 0;
+  const uint32_t area = scale * scale;
+  uint8_t *out = &sources_[camera][static_cast<size_t>(row) * width];
+  for (uint32_t u = 0; u < width; u++) {
+    uint32_t sum = 0;
+    for (uint32_t y = 0; y < scale; y++) {
+      const uint8_t *p = buffer.data + (static_cast<size_t>(row) * scale + y) * buffer.stride;
+      for (uint32_t x = u * scale; x < (u + 1) * scale; x++) {
+        if (buffer.bytes_per_pixel == 1) {
+          sum += p[x];
+        } else {
+          uint16_t value;
+          memcpy(&value, p + 2 * x, sizeof(value));
+          sum += std::min<uint32_t>(value >> shift, 255u);
+        }
+      }
+    }
+    out[u] = static_cast<uint8_t>((sum + area / 2) / area);
+  }
+}
+
+void WorldCameraStereo::Remap(const uint8_t *source, size_t stride, int camera, uint32_t row) {
+  const MapEntry *map = &maps_[camera][static_cast<size_t>(row) * width_];
+  uint8_t *out = &rectified_[camera][static_cast<size_t>(row) * width_];
+  for (uint32_t u = 0; u < width_; u++) {
+    const MapEntry &entry = map[u];
+    if (!entry.valid) {
+      out[u] = 0;
+      continue;
+    }
+    const uint8_t *p = source + entry.y * stride + entry.x;
+    const uint32_t top = p[0] * (256u - entry.wx) + p[1] * entry.wx;
+    const uint32_t bottom = p[stride] * (256u - entry.wx) + p[stride + 1] * entry.wx;
+    out[u] = static_cast<uint8_t>((top * (256u - entry.wy) + bottom * entry.wy + 32768u) >> 16);
+  }
+}
+
+void WorldCameraStereo::Prefilter(int camera, uint32_t row) {
+  // Horizontal Sobel clamped to +/- cap and offset by cap; pixels without a
+  // source or a full neighbourhood stay at the neutral cap.
+  const uint32_t width = width_;
+  const float cap = static_cast<float>(settings_.prefilter_cap);
+  float *out = camera == 0 ? &left_[row * left_pitch_] : &right_[row * right_pitch_ + disparities_];
+  if (row == 0 || row + 1 >= height_ || width < 3) {
+    std::fill_n(out, width, cap);
+    return;
+  }
+  const uint8_t *mid = &rectified_[camera][static_cast<size_t>(row) * width];
+  const uint8_t *up = mid - width, *down = mid + width;
+  const MapEntry *map = &maps_[camera][static_cast<size_t>(row) * width];
+  out[0] = out[width - 1] = cap;
+  const Float8 two(2.0f), lo(-cap), hi(cap), offset(cap);
+  alignas(32) float lanes[kLanes];
+  for (uint32_t u = 1; u + 1 < width; u += kLanes) {
+    const uint32_t count = std::min<uint32_t>(kLanes, width - 1 - u);
+    if (count == kLanes) {
+      const Float8 gx = Float8::LoadU8(up + u + 1) - Float8::LoadU8(up + u - 1) +
+                        MulAdd(two, Float8::LoadU8(mid + u + 1) - Float8::LoadU8(mid + u - 1),
+                               Float8::LoadU8(down + u + 1) - Float8::LoadU8(down + u - 1));
+      (Min(Max(gx, lo), hi) + offset).Store(lanes);
+    } else {
+      for (uint32_t lane = 0; lane < count; lane++) {
+        const uint32_t i = u + lane;
+        const float gx = static_cast<float>(up[i + 1] - up[i - 1] + 2 * (mid[i + 1] - mid[i - 1]) + down[i + 1] -
+                                            down[i - 1]);
+        lanes[lane] = std::min(std::max(gx, -cap), cap) + cap;
+      }
+    }
+    for (uint32_t lane = 0; lane < count; lane++) {
+      out[u + lane] = map[u + lane].valid ? lanes[lane] : cap;
+    }
+  }
+}
+
+void WorldCameraStereo::Match(uint32_t row_begin, uint32_t row_end, unsigned worker) {
+  const uint32_t width = width_, radius = settings_.block_radius;
+  const uint32_t disparities = disparities_;
+  const uint32_t first = std::max(row_begin, radius);
+  const uint32_t last = height_ > radius ? std::min(row_end, height_ - radius) : 0;
+  for (uint32_t v = row_begin; v < row_end; v++) {
+    std::fill_n(&disparity_[static_cast<size_t>(v) * width], width, -1.0f);
+    std::fill_n(&depth_[static_cast<size_t>(v) * width], width, 0.0f);
+  }
+  if (first >= last || width <= 2 * radius) {
+    return;
+  }
+
+  // Adds the absolute differences of row `add` to the column sums and
+  // subtracts those of row `remove`, if any. Lanes past the row end only
+  // read padding.
+  float *columns = columns_[worker].data();
+  const size_t pitch = left_pitch_;
+  auto slide = [&](uint32_t add, const uint32_t *remove) {
+    const float *left_add = &left_[add * pitch];
+    const float *right_add = &right_[add * right_pitch_ + disparities];
+    const float *left_remove = remove != nullptr ? &left_[*remove * pitch] : nullptr;
+    const float *right_remove = remove != nullptr ? &right_[*remove * right_pitch_ + disparities] : nullptr;
+    for (uint32_t d = 0; d < disparities; d++) {
+      float *column = columns + d * pitch;
+      for (uint32_t u = 0; u < width; u += kLanes) {
+        Float8 sum = Float8::Load(column + u) + Abs(Float8::Load(left_add + u) - Float8::Load(right_add + u - d));
+        if (left_remove != nullptr) {
+          sum = sum - Abs(Float8::Load(left_remove + u) - Float8::Load(right_remove + u - d));
+        }
+        sum.Store(column + u);
+      }
+    }
+  };
+  std::fill(columns_[worker].begin(), columns_[worker].end(), 0.0f);
+  for (uint32_t v = first - radius; v < first + radius; v++) {
+    slide(v, nullptr);
+  }
+
+  const Float8 infinity(std::numeric_limits<float>::infinity()), one(1.0f);
+  const Float8 uniqueness(1.0f + settings_.uniqueness_ratio);
+  // Disparity gives z; depth is the distance along the pixel's ray, as in
+  // depth camera frames.
+  const float depth_scale = intrinsics_.focal_length.x * baseline_;
+  const float inv_focal = 1.0f / intrinsics_.focal_length.x;
+  const float cx = intrinsics_.principal_point.x, cy = intrinsics_.principal_point.y;
+  float *costs = costs_[worker].data();
+  alignas(32) float best_lanes[kLanes], found_lanes[kLanes], unique_lanes[kLanes];
+  for (uint32_t v = first; v < last; v++) {
+    const uint32_t top = v - radius - 1;
+    slide(v + radius, v > first ? &top : nullptr);
+    float *disparity = &disparity_[static_cast<size_t>(v) * width];
+    float *depth = &depth_[static_cast<size_t>(v) * width];
+    const float yn = (static_cast<float>(v) - cy) * inv_focal;
+    const MapEntry *left_map = &maps_[0][static_cast<size_t>(v) * width];
+    const MapEntry *right_map = &maps_[1][static_cast<size_t>(v) * width];
+    for (uint32_t u0 = radius; u0 < width - radius; u0 += kLanes) {
+      // Disparity d needs its right window inside the image: d <= u - radius.
+      const Float8 reach = Float8::Iota(static_cast<float>(u0 - radius));
+      Float8 best = infinity, found = 0.0f;
+      for (uint32_t d = 0; d < disparities && d <= u0 + kLanes - 1 - radius; d++) {
+        const float *column = columns + d * pitch + u0 - radius;
+        Float8 cost = Float8::Load(column);
+        for (uint32_t k = 1; k <= 2 * radius; k++) {
+          cost = cost + Float8::Load(column + k);
+        }
+        const Float8 disparity8(static_cast<float>(d));
+        cost = Select(disparity8 <= reach, cost, infinity);
+        cost.Store(costs + d * kLanes);
+        const Float8 better = cost < best;
+        best = Select(better, cost, best);
+        found = Select(better, disparity8, found);
+      }
+      // Lowest cost away from the winner and its neighbours.
+      Float8 second = infinity;
+      for (uint32_t d = 0; d < disparities && d <= u0 + kLanes - 1 - radius; d++) {
+        const Float8 away = Abs(Float8(static_cast<float>(d)) - found) > one;
+        second = Min(second, Select(away, Float8::Load(costs + d * kLanes), infinity));
+      }
+      (second > best * uniqueness).Store(unique_lanes);
+      best.Store(best_lanes);
+      found.Store(found_lanes);
+      const uint32_t count = std::min<uint32_t>(kLanes, width - radius - u0);
+      for (uint32_t lane = 0; lane < count; lane++) {
+        const uint32_t u = u0 + lane;
+        const uint32_t d = static_cast<uint32_t>(found_lanes[lane]);
+        uint32_t unique;
+        memcpy(&unique, &unique_lanes[lane], sizeof(unique));
+        if (unique == 0 || !left_map[u].valid || !right_map[u - d].valid) {
+          continue;
+        }
+        float value = found_lanes[lane];
+        if (settings_.subpixel && d > 0 && d + 1 < disparities && d + 1 <= u - radius) {
+          const float before = costs[(d - 1) * kLanes + lane], after = costs[(d + 1) * kLanes + lane];
+          const float curvature = before + after - 2.0f * best_lanes[lane];
+          if (curvature > 0.0f) {
+            value += (before - after) / (2.0f * curvature);
+          }
+        }
+        disparity[u] = value;
+        const float xn = (static_cast<float>(u) - cx) * inv_focal;
+        depth[u] = value > 0.0f ? depth_scale / value * std::sqrt(1.0f + xn * xn + yn * yn) : 0.0f;
+      }
+    }
+  }
+}
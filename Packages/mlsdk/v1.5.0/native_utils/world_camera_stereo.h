@@ -0,0 +1,225 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+// Copyright (c) 2024 Magic Leap, Inc. All Rights Reserved.
+// Use of this file is governed by the Software License Agreement,
+// located here: https://www.magicleap.com/software-license-agreement-ml2
+// Terms and conditions applicable to third-party materials accompanying
+// this distribution may also be found in the top-level NOTICE file
+// appearing herein.
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+#pragma once
+
+#include "ml_api.h"
+#include "ml_depth_camera.h"
+#include "ml_types.h"
+#include "ml_world_camera.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace native_utils {
+class WorkerPool;
+}
+
+/*!
+  \addtogroup NativeUtils
+  \{
+*/
+
+/*! \brief How MLWorldCameraIntrinsics distortion coefficients are applied. */
+typedef enum WorldCameraDistortionModel {
+  /*!
+    \brief Equidistant fisheye: theta_d = theta (1 + k1 theta^2 + k2 theta^4 +
+           k3 theta^6 + k4 theta^8), followed by the p1, p2 tangential terms.
+  */
+  WorldCameraDistortionModel_Fisheye = 0,
+  /*! \brief Pinhole: r (1 + k1 r^2 + k2 r^4 + k3 r^6 + k4 r^8) and the p1, p2 tangential terms. */
+  WorldCameraDistortionModel_RadialTangential = 1,
+  WorldCameraDistortionModel_Ensure32Bits = 0x7FFFFFFF
+} WorldCameraDistortionModel;
+
+/*! \brief Parameters of a WorldCameraStereo. */
+typedef struct WorldCameraStereoSettings {
+  WorldCameraDistortionModel distortion_model;
+  /*! Rectified images are the camera size divided by this, e.g. 2 for half size. */
+  uint32_t scale;
+  /*! Disparities searched, in rectified pixels; rounded up to a multiple of 8. */
+  uint32_t max_disparity;
+  /*! Half size of the square matching window, e.g. 3 for 7 x 7 pixels. */
+  uint32_t block_radius;
+  /*! Horizontal Sobel responses are clamped to +/- this before matching. */
+  uint32_t prefilter_cap;
+  /*! The best cost must beat every other disparity but its neighbours by this fraction. */
+  float uniqueness_ratio;
+  /*! Whether disparities are refined to subpixels with a parabola through the costs. */
+  bool subpixel;
+  /*! Significant bits of 2-byte pixels, e.g. 10; they are shifted down to 8 bits. */
+  uint32_t significant_bits;
+  /*! Change of the relative camera rotation, in radians, that rebuilds the rectification maps. */
+  float rotation_tolerance;
+  /*! Change of the baseline, in meters, that rebuilds the rectification maps. */
+  float translation_tolerance;
+  /*! Whether camera poses follow the OpenGL camera convention, see DepthUnprojector. */
+  bool opengl_axes;
+  /*! Threads used per frame pair; 0 uses every core. */
+  uint32_t thread_count;
+} WorldCameraStereoSettings;
+
+/*!
+  \brief Initializes WorldCameraStereoSettings for half-size rectification,
+         64 disparities and 7 x 7 windows.
+*/
+inline void WorldCameraStereoSettingsInit(WorldCameraStereoSettings *inout_settings) {
+  if (inout_settings) {
+    inout_settings->distortion_model = WorldCameraDistortionModel_Fisheye;
+    inout_settings->scale = 2;
+    inout_settings->max_disparity = 64;
+    inout_settings->block_radius = 3;
+    inout_settings->prefilter_cap = 31;
+    inout_settings->uniqueness_ratio = 0.1f;
+    inout_settings->subpixel = true;
+    inout_settings->significant_bits = 16;
+    inout_settings->rotation_tolerance = 0.002f;
+    inout_settings->translation_tolerance = 0.001f;
+    inout_settings->opengl_axes = false;
+    inout_settings->thread_count = 0;
+  }
+}
+
+/*!
+  \brief Rectifies the left and right world cameras and computes dense
+         disparity and depth by block matching.
+
+  The rectifying rotations turn both cameras to a common orientation whose
+  x axis runs along the baseline and whose z axis averages the two optical
+  axes, and both rectified images share one pinhole camera with the
+  smallest source focal length divided by scale. Frames are box averaged
+  down by scale first. Source coordinates and bilinear weights of every
+  rectified pixel are kept in maps that are only rebuilt when the
+  intrinsics change or the relative pose of the frames moves beyond
+  rotation_tolerance or translation_tolerance, so with the rigid world
+  camera rig they are built once.
+
+  Matching runs on horizontal Sobel responses clamped to prefilter_cap,
+  which tolerates exposure differences between the cameras. Sums of
+  absolute differences are kept per column and disparity and updated as
+  the window slides down the rows; eight pixels at a time then add up
+  their windows, keep the lowest cost over the disparities and apply the
+  uniqueness test, so no step needs a horizontal reduction. Rows are split
+  into bands processed in parallel.
+
+  depth() is the distance in meters along each pixel's ray from the
+  rectified left camera, as in depth camera frames, with intrinsics() and
+  pose() describing that camera, so it can be passed to DepthUnprojector
+  and the other helpers. Not thread safe.
+*/
+class WorldCameraStereo {
+public:
+  explicit WorldCameraStereo(const WorldCameraStereoSettings &settings);
+  ~WorldCameraStereo();
+
+  WorldCameraStereo(const WorldCameraStereo &) = delete;
+  WorldCameraStereo &operator=(const WorldCameraStereo &) = delete;
+
+  /*!
+    \brief Computes disparity and depth for a synchronized frame pair.
+
+    \param[in] left Frame of MLWorldCameraIdentifier_Left.
+    \param[in] right Frame of MLWorldCameraIdentifier_Right.
+
+    \retval MLResult_Ok disparity() and depth() hold the result.
+    \retval MLResult_InvalidParam A frame buffer is invalid or does not
+            match its intrinsics, the frames differ in size or are smaller
+            than 2 x 2 pixels once scaled, or the right camera does not lie
+            on the +x side of the left one.
+  */
+  MLResult Compute(const MLWorldCameraFrame &left, const MLWorldCameraFrame &right);
+
+  /*! Computes from the left and right frames of `data`, returning MLResult_InvalidParam if either is missing. */
+  MLResult Compute(const MLWorldCameraData &data);
+
+  /*! Size of the rectified images and results. */
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+
+  /*! Disparity per rectified left pixel, -1 where no match was accepted. */
+  const float *disparity() const { return disparity_.data(); }
+  /*! Depth in meters per rectified left pixel, 0 where unknown. */
+  const MLDepthCameraDepthImage &depth() const { return depth_image_; }
+  /*! Distortion-free intrinsics of the rectified cameras. */
+  const MLDepthCameraIntrinsics &intrinsics() const { return intrinsics_; }
+  /*! Transform from the rectified left camera to the world. */
+  const MLTransform &pose() const { return pose_; }
+  /*! Distance between the camera centers in meters. */
+  float baseline() const { return baseline_; }
+
+  /*! Rectified 8-bit images of the last Compute(). */
+  const uint8_t *rectified_left() const { return rectified_[0].data(); }
+  const uint8_t *rectified_right() const { return rectified_[1].data(); }
+
+  /*! Number of times the rectification maps were built. */
+  uint32_t rectification_count() const { return rectification_count_; }
+
+private:
+  // Source pixel and 8-bit bilinear weights of one rectified pixel.
+  struct MapEntry {
+    uint16_t x, y;
+    uint8_t wx, wy;
+    uint8_t valid;
+  };
+
+  bool MapsMatch(const MLWorldCameraIntrinsics &left, const MLWorldCameraIntrinsics &right,
+                 const float (&rotation)[3][3], const float (&translation)[3]) const;
+  void BuildMaps(const MLWorldCameraIntrinsics &left, const MLWorldCameraIntrinsics &right,
+                 const float (&rotation)[3][3], const float (&translation)[3]);
+  void Shrink(const MLWorldCameraFrameBuffer &buffer, int camera, uint32_t row);
+  void Remap(const uint8_t *source, size_t stride, int camera, uint32_t row);
+  void Prefilter(int camera, uint32_t row);
+  void Match(uint32_t row_begin, uint32_t row_end, unsigned worker);
+
+  WorldCameraStereoSettings settings_;
+  std::unique_ptr<native_utils::WorkerPool> pool_;
+  uint32_t disparities_ = 0;
+
+  // Inputs the maps were built for.
+  MLWorldCameraIntrinsics map_intrinsics_[2] = {};
+  float map_rotation_[3][3] = {};
+  float map_translation_[3] = {};
+  uint32_t rectification_count_ = 0;
+
+  // Rotation from each source camera to the rectified cameras.
+  float rectify_[2][3][3] = {};
+  std::vector<MapEntry> maps_[2];
+  // Frames shrunk by scale or converted to 8 bits.
+  std::vector<uint8_t> sources_[2];
+
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<uint8_t> rectified_[2];
+  // Prefiltered rows padded with neutral values: the right rows by
+  // disparities_ in front, so pixel u - d is in bounds for every disparity.
+  std::vector<float> left_;
+  std::vector<float> right_;
+  size_t left_pitch_ = 0;
+  size_t right_pitch_ = 0;
+
+  // Per-worker window column sums, one row per disparity, and the costs of
+  // every disparity for eight pixels.
+  std::vector<std::vector<float>> columns_;
+  std::vector<std::vector<float>> costs_;
+
+  std::vector<float> disparity_;
+  std::vector<float> depth_;
+  MLDepthCameraDepthImage depth_image_ = {};
+  MLDepthCameraIntrinsics intrinsics_ = {};
+  MLTransform pose_ = {};
+  float baseline_ = 0.0f;
+};
+
+/*! \} */
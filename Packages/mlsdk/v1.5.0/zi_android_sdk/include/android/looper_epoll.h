@@ -0,0 +1,82 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Extensions to the ALooper API provided by the open epoll based looper
+ * implementation for Linux hosts (see zi_android_sdk/looper).
+ *
+ * These are not part of the closed ZI runtime; only use them when linking
+ * against the open looper.
+ */
+
+#pragma once
+
+#include "looper.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wakes the poll asynchronously.
+ *
+ * This method can be called on any thread.  It returns immediately, and the
+ * pending or next ALooper_pollOnce() of the looper returns ALOOPER_POLL_WAKE
+ * if nothing else was ready.
+ */
+ZI_API void ZI_CALL ALooper_wake(ALooper* looper);
+
+/**
+ * Creates a timerfd and adds it to the looper, the same way as
+ * ALooper_addFd() would.
+ *
+ * "initialNanos" is the delay before the first expiration and must be > 0.
+ * "intervalNanos" is the period of subsequent expirations, or 0 for a one
+ * shot timer.
+ *
+ * The looper consumes the expiration count of the timer before reporting it,
+ * so neither callbacks nor callers of ALooper_pollOnce() need to read it.
+ *
+ * Returns the timer file descriptor, or -1 if an error occurred.  The caller
+ * owns the descriptor and must close it after ALooper_removeFd().
+ */
+ZI_API int ZI_CALL ALooper_addTimerFd(ALooper* looper, int64_t initialNanos, int64_t intervalNanos, int ident,
+                                      ALooper_callbackFunc callback, void* data);
+
+#ifdef __cplusplus
+};
+#endif
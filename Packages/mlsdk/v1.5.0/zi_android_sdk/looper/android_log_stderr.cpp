@@ -0,0 +1,90 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Minimal stderr backend for the Android log API, so that apps linking the
+ * open looper on headless Linux hosts do not need the ZI runtime for logging.
+ */
+
+#include "android/log.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+char PriorityChar(int prio) {
+  switch (prio) {
+    case ANDROID_LOG_VERBOSE: return 'V';
+    case ANDROID_LOG_DEBUG: return 'D';
+    case ANDROID_LOG_INFO: return 'I';
+    case ANDROID_LOG_WARN: return 'W';
+    case ANDROID_LOG_ERROR: return 'E';
+    case ANDROID_LOG_FATAL: return 'F';
+    default: return '?';
+  }
+}
+
+}  // namespace
+
+int __android_log_write(int prio, const char* tag, const char* text) {
+  return fprintf(stderr, "%c/%s: %s\n", PriorityChar(prio), tag ? tag : "", text ? text : "");
+}
+
+int __android_log_vprint(int prio, const char* tag, const char* fmt, va_list ap) {
+  char buffer[1024];
+  vsnprintf(buffer, sizeof(buffer), fmt, ap);
+  return __android_log_write(prio, tag, buffer);
+}
+
+int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  const int result = __android_log_vprint(prio, tag, fmt, ap);
+  va_end(ap);
+  return result;
+}
+
+void __android_log_assert(const char* cond, const char* tag, const char* fmt, ...) {
+  if (fmt) {
+    va_list ap;
+    va_start(ap, fmt);
+    __android_log_vprint(ANDROID_LOG_FATAL, tag, fmt, ap);
+    va_end(ap);
+  } else {
+    __android_log_print(ANDROID_LOG_FATAL, tag, "Assertion failed: %s", cond ? cond : "(unknown)");
+  }
+  abort();
+}
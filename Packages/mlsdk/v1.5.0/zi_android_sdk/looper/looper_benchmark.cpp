@@ -0,0 +1,191 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Microbenchmarks for the open epoll looper.
+ *
+ * For 1, 16 and 256 registered eventfds this measures:
+ *   - wakeup latency: time from another thread signalling one of the fds
+ *     to ALooper_pollOnce() returning its identifier on the looper thread.
+ *   - throughput: callbacks dispatched per second by ALooper_pollAll()
+ *     while every registered fd is signalled on each iteration.
+ *
+ * Usage: zi_looper_benchmark [iterations]
+ *
+ * iterations must be a positive number and defaults to 20000.
+ */
+
+#include "android/looper.h"
+#include "android/looper_epoll.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Identifiers of callback-less fds; the glue reserves the ones below 3.
+constexpr int kFirstIdent = 3;
+
+void Signal(int fd) {
+  const uint64_t inc = 1;
+  if (write(fd, &inc, sizeof(inc)) != sizeof(inc)) {
+    abort();
+  }
+}
+
+void Drain(int fd) {
+  uint64_t counter;
+  if (read(fd, &counter, sizeof(counter)) != sizeof(counter)) {
+    abort();
+  }
+}
+
+int DrainCallback(int fd, int events, void* data) {
+  (void)events;
+  Drain(fd);
+  ++*static_cast<uint64_t*>(data);
+  return 1;
+}
+
+std::vector<int> CreateFds(int count) {
+  std::vector<int> fds;
+  for (int i = 0; i < count; i++) {
+    fds.push_back(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  }
+  return fds;
+}
+
+void CloseFds(ALooper* looper, const std::vector<int>& fds) {
+  for (int fd : fds) {
+    ALooper_removeFd(looper, fd);
+    close(fd);
+  }
+}
+
+void BenchWakeupLatency(ALooper* looper, int fdCount, int iterations) {
+  std::vector<int> fds = CreateFds(fdCount);
+  for (int i = 0; i < fdCount; i++) {
+    ALooper_addFd(looper, fds[i], kFirstIdent + i, ALOOPER_EVENT_INPUT, nullptr, nullptr);
+  }
+
+  std::atomic<int64_t> sentAt(0);
+  std::atomic<int> turn(0);
+  std::thread producer([&]() {
+    for (int i = 0; i < iterations; i++) {
+      while (turn.load(std::memory_order_acquire) != i) {
+        std::this_thread::yield();
+      }
+      sentAt.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+      Signal(fds[i % fdCount]);
+    }
+  });
+
+  std::vector<double> latenciesUs;
+  latenciesUs.reserve(iterations);
+  for (int i = 0; i < iterations; i++) {
+    int fd = -1;
+    const int ident = ALooper_pollOnce(-1, &fd, nullptr, nullptr);
+    const int64_t now = Clock::now().time_since_epoch().count();
+    if (ident != kFirstIdent + i % fdCount) {
+      fprintf(stderr, "unexpected ident %d\n", ident);
+      abort();
+    }
+    Drain(fd);
+    latenciesUs.push_back(std::chrono::duration<double, std::micro>(
+        Clock::duration(now - sentAt.load(std::memory_order_acquire))).count());
+    turn.store(i + 1, std::memory_order_release);
+  }
+  producer.join();
+  CloseFds(looper, fds);
+
+  std::sort(latenciesUs.begin(), latenciesUs.end());
+  auto percentile = [&](double p) { return latenciesUs[(size_t)(p * (latenciesUs.size() - 1))]; };
+  printf("wakeup latency  fds=%-4d  p50=%8.2fus  p90=%8.2fus  p99=%8.2fus  max=%8.2fus\n", fdCount,
+         percentile(0.5), percentile(0.9), percentile(0.99), latenciesUs.back());
+}
+
+void BenchThroughput(ALooper* looper, int fdCount, int iterations) {
+  std::vector<int> fds = CreateFds(fdCount);
+  uint64_t dispatched = 0;
+  for (int fd : fds) {
+    ALooper_addFd(looper, fd, 0, ALOOPER_EVENT_INPUT, DrainCallback, &dispatched);
+  }
+
+  const Clock::time_point start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    for (int fd : fds) {
+      Signal(fd);
+    }
+    const uint64_t target = (uint64_t)(i + 1) * fdCount;
+    while (dispatched < target) {
+      ALooper_pollAll(0, nullptr, nullptr, nullptr);
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  CloseFds(looper, fds);
+
+  printf("throughput      fds=%-4d  %12.0f callbacks/s  %8.1fns/callback\n", fdCount, dispatched / seconds,
+         seconds * 1e9 / dispatched);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  if (iterations <= 0) {
+    fprintf(stderr, "usage: %s [iterations > 0]\n", argv[0]);
+    return 1;
+  }
+  ALooper* looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+
+  for (int fdCount : {1, 16, 256}) {
+    BenchWakeupLatency(looper, fdCount, iterations);
+  }
+  for (int fdCount : {1, 16, 256}) {
+    BenchThroughput(looper, fdCount, std::max(1, iterations / fdCount));
+  }
+  return 0;
+}
@@ -0,0 +1,347 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Open implementation of the ALooper API for Linux hosts, built on epoll.
+ *
+ * Wakeups use an eventfd and timers use timerfd sources, see
+ * android/looper_epoll.h.  The dispatch rules follow the Android Looper:
+ * callback-less fds are reported one at a time through the return value of
+ * ALooper_pollOnce(), callbacks are invoked before returning, and a callback
+ * returning 0 unregisters its fd.
+ */
+
+#include "android/looper.h"
+#include "android/looper_epoll.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Maximum number of ready fds collected per epoll_wait() call.
+constexpr int kEpollMaxEvents = 64;
+
+struct Request {
+  int fd;
+  int ident;
+  int events;
+  bool isTimer;
+  ALooper_callbackFunc callback;
+  void* data;
+};
+
+struct Response {
+  int events;
+  Request request;
+};
+
+uint32_t ToEpollEvents(int events) {
+  uint32_t epollEvents = 0;
+  if (events & ALOOPER_EVENT_INPUT) epollEvents |= EPOLLIN;
+  if (events & ALOOPER_EVENT_OUTPUT) epollEvents |= EPOLLOUT;
+  return epollEvents;
+}
+
+int FromEpollEvents(uint32_t epollEvents) {
+  int events = 0;
+  if (epollEvents & EPOLLIN) events |= ALOOPER_EVENT_INPUT;
+  if (epollEvents & EPOLLOUT) events |= ALOOPER_EVENT_OUTPUT;
+  if (epollEvents & EPOLLERR) events |= ALOOPER_EVENT_ERROR;
+  if (epollEvents & EPOLLHUP) events |= ALOOPER_EVENT_HANGUP;
+  return events;
+}
+
+int64_t NowNanos() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}  // namespace
+
+struct ALooper {
+  explicit ALooper(bool allowNonCallbacks)
+      : allowNonCallbacks_(allowNonCallbacks),
+        epollFd_(epoll_create1(EPOLL_CLOEXEC)),
+        wakeFd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    epoll_event item = {};
+    item.events = EPOLLIN;
+    item.data.fd = wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &item);
+  }
+
+  ~ALooper() {
+    close(wakeFd_);
+    close(epollFd_);
+  }
+
+  ALooper(const ALooper&) = delete;
+  ALooper& operator=(const ALooper&) = delete;
+
+  void Wake() {
+    uint64_t inc = 1;
+    ssize_t n;
+    do {
+      n = write(wakeFd_, &inc, sizeof(inc));
+    } while (n < 0 && errno == EINTR);
+  }
+
+  int AddFd(int fd, int ident, int events, bool isTimer, ALooper_callbackFunc callback, void* data) {
+    if (fd < 0) {
+      return -1;
+    }
+    if (callback) {
+      ident = ALOOPER_POLL_CALLBACK;
+    } else if (!allowNonCallbacks_ || ident < 0) {
+      return -1;
+    }
+
+    epoll_event item = {};
+    item.events = ToEpollEvents(events);
+    item.data.fd = fd;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = requests_.find(fd);
+    const int op = it == requests_.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(epollFd_, op, fd, &item) < 0) {
+      return -1;
+    }
+    requests_[fd] = Request{fd, ident, events, isTimer, callback, data};
+    return 1;
+  }
+
+  int RemoveFd(int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = requests_.find(fd);
+    if (it == requests_.end()) {
+      return 0;
+    }
+    requests_.erase(it);
+    // The fd may already have been closed by the caller, in which case the
+    // kernel has dropped it from the epoll set on its own.
+    if (epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != EBADF && errno != ENOENT) {
+      return -1;
+    }
+    return 1;
+  }
+
+  int PollOnce(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
+    int result = 0;
+    for (;;) {
+      while (responseIndex_ < responses_.size()) {
+        const Response& response = responses_[responseIndex_++];
+        if (response.request.ident >= 0) {
+          if (outFd) *outFd = response.request.fd;
+          if (outEvents) *outEvents = response.events;
+          if (outData) *outData = response.request.data;
+          return response.request.ident;
+        }
+      }
+
+      if (result != 0) {
+        if (outFd) *outFd = 0;
+        if (outEvents) *outEvents = 0;
+        if (outData) *outData = nullptr;
+        return result;
+      }
+
+      result = PollInner(timeoutMillis);
+    }
+  }
+
+ private:
+  int PollInner(int timeoutMillis) {
+    responses_.clear();
+    responseIndex_ = 0;
+
+    epoll_event eventItems[kEpollMaxEvents];
+    const int eventCount = epoll_wait(epollFd_, eventItems, kEpollMaxEvents, timeoutMillis);
+    if (eventCount < 0) {
+      return errno == EINTR ? ALOOPER_POLL_WAKE : ALOOPER_POLL_ERROR;
+    }
+    if (eventCount == 0) {
+      return ALOOPER_POLL_TIMEOUT;
+    }
+
+    int result = ALOOPER_POLL_WAKE;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int i = 0; i < eventCount; i++) {
+        const int fd = eventItems[i].data.fd;
+        if (fd == wakeFd_) {
+          uint64_t counter;
+          while (read(wakeFd_, &counter, sizeof(counter)) > 0) {
+          }
+          continue;
+        }
+        auto it = requests_.find(fd);
+        if (it == requests_.end()) {
+          continue;
+        }
+        if (it->second.isTimer) {
+          uint64_t expirations;
+          while (read(fd, &expirations, sizeof(expirations)) > 0) {
+          }
+        }
+        responses_.push_back(Response{FromEpollEvents(eventItems[i].events), it->second});
+      }
+    }
+
+    // Invoke callbacks without holding the lock so they can add and remove
+    // fds themselves.
+    for (Response& response : responses_) {
+      if (response.request.ident == ALOOPER_POLL_CALLBACK) {
+        const Request& request = response.request;
+        if (request.callback(request.fd, response.events, request.data) == 0) {
+          RemoveFd(request.fd);
+        }
+        result = ALOOPER_POLL_CALLBACK;
+      }
+    }
+    return result;
+  }
+
+  const bool allowNonCallbacks_;
+  const int epollFd_;
+  const int wakeFd_;
+
+  // Guards requests_, which may be changed from any thread.
+  std::mutex mutex_;
+  std::unordered_map<int, Request> requests_;
+
+  // Only touched by the thread that owns the looper.
+  std::vector<Response> responses_;
+  size_t responseIndex_ = 0;
+};
+
+namespace {
+
+thread_local std::unique_ptr<ALooper> tLooper;
+
+}  // namespace
+
+ALooper* ALooper_forThread() {
+  return tLooper.get();
+}
+
+ALooper* ALooper_prepare(int opts) {
+  if (!tLooper) {
+    tLooper.reset(new ALooper((opts & ALOOPER_PREPARE_ALLOW_NON_CALLBACKS) != 0));
+  }
+  return tLooper.get();
+}
+
+int ALooper_pollOnce(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
+  ALooper* looper = ALooper_forThread();
+  if (!looper) {
+    return ALOOPER_POLL_ERROR;
+  }
+  return looper->PollOnce(timeoutMillis, outFd, outEvents, outData);
+}
+
+int ALooper_pollAll(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
+  ALooper* looper = ALooper_forThread();
+  if (!looper) {
+    return ALOOPER_POLL_ERROR;
+  }
+  if (timeoutMillis <= 0) {
+    int result;
+    do {
+      result = looper->PollOnce(timeoutMillis, outFd, outEvents, outData);
+    } while (result == ALOOPER_POLL_CALLBACK);
+    return result;
+  }
+
+  const int64_t deadline = NowNanos() + (int64_t)timeoutMillis * 1000000LL;
+  for (;;) {
+    const int result = looper->PollOnce(timeoutMillis, outFd, outEvents, outData);
+    if (result != ALOOPER_POLL_CALLBACK) {
+      return result;
+    }
+    const int64_t remaining = deadline - NowNanos();
+    if (remaining <= 0) {
+      return ALOOPER_POLL_TIMEOUT;
+    }
+    timeoutMillis = (int)((remaining + 999999) / 1000000);
+  }
+}
+
+int ALooper_addFd(ALooper* looper, int fd, int ident, int events, ALooper_callbackFunc callback, void* data) {
+  return looper ? looper->AddFd(fd, ident, events, false, callback, data) : -1;
+}
+
+int ALooper_removeFd(ALooper* looper, int fd) {
+  return looper ? looper->RemoveFd(fd) : -1;
+}
+
+void ALooper_wake(ALooper* looper) {
+  if (looper) {
+    looper->Wake();
+  }
+}
+
+int ALooper_addTimerFd(ALooper* looper, int64_t initialNanos, int64_t intervalNanos, int ident,
+                       ALooper_callbackFunc callback, void* data) {
+  if (!looper || initialNanos <= 0 || intervalNanos < 0) {
+    return -1;
+  }
+  const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (fd < 0) {
+    return -1;
+  }
+  itimerspec spec = {};
+  spec.it_value.tv_sec = initialNanos / 1000000000LL;
+  spec.it_value.tv_nsec = initialNanos % 1000000000LL;
+  spec.it_interval.tv_sec = intervalNanos / 1000000000LL;
+  spec.it_interval.tv_nsec = intervalNanos % 1000000000LL;
+  if (timerfd_settime(fd, 0, &spec, nullptr) < 0 ||
+      looper->AddFd(fd, ident, ALOOPER_EVENT_INPUT, true, callback, data) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
@@ -0,0 +1,122 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * LooperEventReaderWriter backed by an eventfd, for use with the open epoll
+ * looper.  The handle is a real file descriptor in semaphore mode whose
+ * counter mirrors the number of queued events, so the looper reports it as
+ * readable for as long as events are pending.
+ */
+
+#include "android/looper_event_reader_writer.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+std::unordered_map<int, LooperEventReaderWriter *> LooperEventReaderWriter::handleToPointerMap_;
+
+namespace {
+
+// Guards LooperEventReaderWriter::handleToPointerMap_.
+std::mutex gHandleMapMutex;
+
+}  // namespace
+
+class LooperEventReaderWriter::LooperEventReaderWriterImpl {
+public:
+  LooperEventReaderWriterImpl() : fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE)) {}
+  ~LooperEventReaderWriterImpl() { close(fd_); }
+
+  int fd_;
+  mutable std::mutex mutex_;
+  std::deque<int> events_;
+};
+
+LooperEventReaderWriter::LooperEventReaderWriter() : impl_(new LooperEventReaderWriterImpl()) {
+  std::lock_guard<std::mutex> lock(gHandleMapMutex);
+  handleToPointerMap_[impl_->fd_] = this;
+}
+
+LooperEventReaderWriter::~LooperEventReaderWriter() {
+  std::lock_guard<std::mutex> lock(gHandleMapMutex);
+  handleToPointerMap_.erase(impl_->fd_);
+}
+
+int LooperEventReaderWriter::GetHandle() const {
+  return impl_->fd_;
+}
+
+LooperEventReaderWriter* LooperEventReaderWriter::GetPointer(int handle) {
+  std::lock_guard<std::mutex> lock(gHandleMapMutex);
+  auto it = handleToPointerMap_.find(handle);
+  return it == handleToPointerMap_.end() ? nullptr : it->second;
+}
+
+bool LooperEventReaderWriter::HasEvent() const {
+  std::lock_guard<std::mutex> lock(impl_->mutex_);
+  return !impl_->events_.empty();
+}
+
+int LooperEventReaderWriter::ReadEvent() {
+  std::lock_guard<std::mutex> lock(impl_->mutex_);
+  if (impl_->events_.empty()) {
+    return -1;
+  }
+  const int event = impl_->events_.front();
+  impl_->events_.pop_front();
+
+  uint64_t counter;
+  ssize_t n;
+  do {
+    n = read(impl_->fd_, &counter, sizeof(counter));
+  } while (n < 0 && errno == EINTR);
+  return event;
+}
+
+void LooperEventReaderWriter::WriteEvent(int event) {
+  std::lock_guard<std::mutex> lock(impl_->mutex_);
+  impl_->events_.push_back(event);
+
+  const uint64_t inc = 1;
+  ssize_t n;
+  do {
+    n = write(impl_->fd_, &inc, sizeof(inc));
+  } while (n < 0 && errno == EINTR);
+}
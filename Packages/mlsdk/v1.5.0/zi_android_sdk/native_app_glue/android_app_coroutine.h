@@ -0,0 +1,563 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * C++20 coroutine front-end for the native app glue.
+ *
+ * An AndroidAppExecutor binds coroutines to the looper of an android_app:
+ * coroutines always resume on the app thread, from inside ALooper_pollOnce()
+ * or ALooper_pollAll(), and can await
+ *
+ *   - readiness of a file descriptor (WaitFd), registered through
+ *     ALooper_addFd() instead of being checked every frame,
+ *   - APP_CMD_* events as they come out of process_cmd() (WaitAppCmd),
+ *   - request/poll style ML handles that return MLResult_Pending (Poll),
+ *     e.g. MLMeshingGetMeshResult() or
+ *     MLPlanesQueryGetResultsWithBoundaries(),
+ *   - blocking ML calls such as MLSpatialAnchorQueryCreate() (Call).
+ *
+ * Polls and calls run on a poll thread owned by the executor.  Pending polls
+ * are retried with an exponential backoff, so results are picked up shortly
+ * after they become available instead of at a fixed point in the frame, and
+ * without polling every handle every frame.
+ *
+ * \code
+ *   AndroidAppTask<> Run(AndroidAppExecutor& executor, MLHandle meshing,
+ *                        MLMeshingMeshRequest mesh_request) {
+ *     co_await executor.WaitAppCmd(APP_CMD_RESUME);
+ *     MLHandle request = ML_INVALID_HANDLE;
+ *     MLMeshingMesh mesh = {};
+ *     if (co_await AndroidAppGetMesh(executor, meshing, &mesh_request, &request, &mesh) == MLResult_Ok) {
+ *       ...
+ *       MLMeshingFreeResource(meshing, &request);
+ *     }
+ *   }
+ *
+ *   void android_main(android_app* app) {
+ *     AndroidAppExecutor executor(app);
+ *     executor.Spawn(Run(executor, meshing, mesh_request));
+ *     while (!app->destroyRequested) {
+ *       ...ALooper_pollAll() as usual...
+ *     }
+ *   }
+ * \endcode
+ */
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "android_app_coroutine.h requires C++20 coroutine support"
+#endif
+
+#include "android_native_app_glue.h"
+
+#include "android/looper_event_reader_writer.h"
+
+#include "ml_api.h"
+#include "ml_meshing2.h"
+#include "ml_planes.h"
+#include "ml_spatial_anchor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+template <typename T = void>
+class AndroidAppTask;
+
+namespace android_app_coroutine_detail {
+
+struct PromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      PromiseBase& promise = handle.promise();
+      if (promise.continuation) {
+        return promise.continuation;
+      }
+      if (promise.detached) {
+        if (promise.exception) {
+          std::terminate();
+        }
+        handle.destroy();
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+  bool detached = false;
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  AndroidAppTask<T> get_return_object() noexcept;
+
+  template <typename U>
+  void return_value(U&& value) {
+    result.emplace(std::forward<U>(value));
+  }
+
+  T Result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*result);
+  }
+
+  std::optional<T> result;
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  AndroidAppTask<void> get_return_object() noexcept;
+
+  void return_void() const noexcept {}
+
+  void Result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+}  // namespace android_app_coroutine_detail
+
+/**
+ * A lazily started coroutine producing a T.  Starts running when it is
+ * awaited, or when handed to AndroidAppExecutor::Spawn().
+ */
+template <typename T>
+class [[nodiscard]] AndroidAppTask {
+public:
+  using promise_type = android_app_coroutine_detail::Promise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  explicit AndroidAppTask(Handle handle) noexcept : handle_(handle) {}
+  AndroidAppTask(AndroidAppTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+  AndroidAppTask& operator=(AndroidAppTask&& other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  AndroidAppTask(const AndroidAppTask&) = delete;
+  AndroidAppTask& operator=(const AndroidAppTask&) = delete;
+
+  ~AndroidAppTask() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+
+  T await_resume() { return handle_.promise().Result(); }
+
+  // Gives up ownership of the coroutine, which then destroys itself when it
+  // completes.  Used by AndroidAppExecutor::Spawn().
+  Handle Release() noexcept {
+    if (handle_) {
+      handle_.promise().detached = true;
+    }
+    return std::exchange(handle_, nullptr);
+  }
+
+private:
+  Handle handle_;
+};
+
+namespace android_app_coroutine_detail {
+
+template <typename T>
+inline AndroidAppTask<T> Promise<T>::get_return_object() noexcept {
+  return AndroidAppTask<T>(AndroidAppTask<T>::Handle::from_promise(*this));
+}
+
+inline AndroidAppTask<void> Promise<void>::get_return_object() noexcept {
+  return AndroidAppTask<void>(AndroidAppTask<void>::Handle::from_promise(*this));
+}
+
+}  // namespace android_app_coroutine_detail
+
+/**
+ * Resumes coroutines on the thread of an android_app's looper.
+ *
+ * Must be created and destroyed on the app thread after the looper has
+ * been prepared (i.e. from android_main()), and outlive every coroutine
+ * suspended on it.  Installs itself as the android_app::cmdObserver.
+ */
+class AndroidAppExecutor {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Backoff between two polls of a handle that returned MLResult_Pending.
+  static constexpr std::chrono::microseconds kMinPollInterval{250};
+  static constexpr std::chrono::microseconds kMaxPollInterval{8000};
+
+  explicit AndroidAppExecutor(android_app* app) : app_(app) {
+    ALooper_addFd(app_->looper, wake_.GetHandle(), ALOOPER_POLL_CALLBACK, ALOOPER_EVENT_INPUT, &OnWake, this);
+    app_->cmdObserver = &OnAppCmd;
+    app_->cmdObserverData = this;
+    pollThread_ = std::thread([this] { PollLoop(); });
+  }
+
+  ~AndroidAppExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(pollMutex_);
+      stopping_ = true;
+    }
+    pollCv_.notify_one();
+    pollThread_.join();
+    app_->cmdObserver = nullptr;
+    app_->cmdObserverData = nullptr;
+    ALooper_removeFd(app_->looper, wake_.GetHandle());
+  }
+
+  AndroidAppExecutor(const AndroidAppExecutor&) = delete;
+  AndroidAppExecutor& operator=(const AndroidAppExecutor&) = delete;
+
+  android_app* app() const { return app_; }
+
+  /**
+   * Starts a task on the calling thread and lets it run to completion on its
+   * own.  An exception escaping a spawned task terminates the app.
+   */
+  void Spawn(AndroidAppTask<void> task) {
+    if (auto handle = task.Release()) {
+      handle.resume();
+    }
+  }
+
+  /**
+   * Schedules a coroutine to be resumed on the app thread during the next
+   * looper poll.  May be called from any thread.
+   */
+  void Post(std::coroutine_handle<> handle) {
+    {
+      std::lock_guard<std::mutex> lock(readyMutex_);
+      ready_.push_back(handle);
+    }
+    if (!wakePending_.exchange(true)) {
+      wake_.WriteEvent(1);
+    }
+  }
+
+  struct FdAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      if (ALooper_addFd(executor_->app_->looper, fd_, ALOOPER_POLL_CALLBACK, events_, &OnFd, this) < 0) {
+        revents_ = ALOOPER_EVENT_ERROR;
+        return false;
+      }
+      return true;
+    }
+
+    int await_resume() const noexcept { return revents_; }
+
+    static int OnFd(int fd, int events, void* data) {
+      (void)fd;
+      auto* self = static_cast<FdAwaiter*>(data);
+      self->revents_ = events;
+      // Resume through the ready queue rather than from here: the looper
+      // unregisters the fd after this returns 0, which would drop a
+      // registration made by the resumed coroutine.
+      self->executor_->Post(self->handle_);
+      return 0;
+    }
+
+    AndroidAppExecutor* executor_;
+    int fd_;
+    int events_;
+    int revents_ = 0;
+    std::coroutine_handle<> handle_{};
+  };
+
+  /**
+   * Suspends until "fd" reports any of the ALOOPER_EVENT_* "events", and
+   * returns the events that fired.  The fd is only registered with the
+   * looper while a coroutine waits on it.
+   */
+  FdAwaiter WaitFd(int fd, int events = ALOOPER_EVENT_INPUT) { return FdAwaiter{this, fd, events}; }
+
+  struct AppCmdAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      executor_->cmdWaiters_.push_back(this);
+    }
+
+    int32_t await_resume() const noexcept { return received_; }
+
+    AndroidAppExecutor* executor_;
+    int32_t cmd_;
+    int32_t received_ = -1;
+    std::coroutine_handle<> handle_{};
+  };
+
+  /**
+   * Suspends until process_cmd() has processed "cmd", or any command if
+   * "cmd" is negative, and returns the command.  The coroutine resumes after
+   * onAppCmd and android_app_post_exec_cmd() have run for it.
+   */
+  AppCmdAwaiter WaitAppCmd(int32_t cmd = -1) { return AppCmdAwaiter{this, cmd}; }
+
+  struct PollAwaiter {
+    bool await_ready() {
+      // Try once inline; most handles only need to be polled again when the
+      // first attempt is still pending.
+      if (!once_) {
+        result_ = fn_();
+        return result_ != MLResult_Pending;
+      }
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      executor_->QueuePoll(this);
+    }
+
+    MLResult await_resume() const noexcept { return result_; }
+
+    AndroidAppExecutor* executor_;
+    std::function<MLResult()> fn_;
+    bool once_;
+    MLResult result_ = MLResult_Pending;
+    std::coroutine_handle<> handle_{};
+    Clock::time_point due_{};
+    Clock::duration interval_ = kMinPollInterval;
+  };
+
+  /**
+   * Calls "fn" until it returns something other than MLResult_Pending and
+   * returns that result.  Retries run on the poll thread.
+   */
+  PollAwaiter Poll(std::function<MLResult()> fn) { return PollAwaiter{this, std::move(fn), false}; }
+
+  /**
+   * Runs the potentially blocking "fn" once on the poll thread and returns
+   * its result.
+   */
+  PollAwaiter Call(std::function<MLResult()> fn) { return PollAwaiter{this, std::move(fn), true}; }
+
+private:
+  static int OnWake(int fd, int events, void* data) {
+    (void)fd;
+    (void)events;
+    auto* self = static_cast<AndroidAppExecutor*>(data);
+    while (self->wake_.HasEvent()) {
+      self->wake_.ReadEvent();
+    }
+    self->wakePending_.store(false);
+
+    std::vector<std::coroutine_handle<>> ready;
+    {
+      std::lock_guard<std::mutex> lock(self->readyMutex_);
+      ready.swap(self->ready_);
+    }
+    for (std::coroutine_handle<> handle : ready) {
+      handle.resume();
+    }
+    return 1;
+  }
+
+  static void OnAppCmd(android_app* app, int32_t cmd, void* data) {
+    (void)app;
+    auto* self = static_cast<AndroidAppExecutor*>(data);
+    std::vector<AppCmdAwaiter*> matched;
+    auto& waiters = self->cmdWaiters_;
+    for (auto it = waiters.begin(); it != waiters.end();) {
+      if ((*it)->cmd_ < 0 || (*it)->cmd_ == cmd) {
+        (*it)->received_ = cmd;
+        matched.push_back(*it);
+        it = waiters.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (AppCmdAwaiter* waiter : matched) {
+      waiter->handle_.resume();
+    }
+  }
+
+  void QueuePoll(PollAwaiter* poll) {
+    poll->due_ = Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(pollMutex_);
+      polls_.push_back(poll);
+    }
+    pollCv_.notify_one();
+  }
+
+  void PollLoop() {
+    std::unique_lock<std::mutex> lock(pollMutex_);
+    while (!stopping_) {
+      if (polls_.empty()) {
+        pollCv_.wait(lock);
+        continue;
+      }
+
+      Clock::time_point next = Clock::time_point::max();
+      std::vector<PollAwaiter*> due;
+      const Clock::time_point now = Clock::now();
+      for (auto it = polls_.begin(); it != polls_.end();) {
+        if ((*it)->due_ <= now) {
+          due.push_back(*it);
+          it = polls_.erase(it);
+        } else {
+          next = std::min(next, (*it)->due_);
+          ++it;
+        }
+      }
+
+      if (due.empty()) {
+        pollCv_.wait_until(lock, next);
+        continue;
+      }
+
+      lock.unlock();
+      std::vector<PollAwaiter*> pending;
+      for (PollAwaiter* poll : due) {
+        poll->result_ = poll->fn_();
+        if (poll->once_ || poll->result_ != MLResult_Pending) {
+          Post(poll->handle_);
+        } else {
+          poll->due_ = Clock::now() + poll->interval_;
+          poll->interval_ = std::min<Clock::duration>(poll->interval_ * 2, kMaxPollInterval);
+          pending.push_back(poll);
+        }
+      }
+      lock.lock();
+      polls_.insert(polls_.end(), pending.begin(), pending.end());
+    }
+  }
+
+  android_app* app_;
+
+  LooperEventReaderWriter wake_;
+  std::atomic<bool> wakePending_{false};
+  std::mutex readyMutex_;
+  std::vector<std::coroutine_handle<>> ready_;
+
+  // Only touched on the app thread.
+  std::vector<AppCmdAwaiter*> cmdWaiters_;
+
+  std::mutex pollMutex_;
+  std::condition_variable pollCv_;
+  std::vector<PollAwaiter*> polls_;
+  bool stopping_ = false;
+  std::thread pollThread_;
+};
+
+/**
+ * Requests a mesh with MLMeshingRequestMesh() and awaits
+ * MLMeshingGetMeshResult().  On MLResult_Ok the caller owns *out_request and
+ * must release it with MLMeshingFreeResource().
+ */
+inline AndroidAppTask<MLResult> AndroidAppGetMesh(AndroidAppExecutor& executor, MLHandle client,
+                                                  const MLMeshingMeshRequest* request, MLHandle* out_request,
+                                                  MLMeshingMesh* out_mesh) {
+  MLResult result = MLMeshingRequestMesh(client, request, out_request);
+  if (result != MLResult_Ok) {
+    co_return result;
+  }
+  const MLHandle request_handle = *out_request;
+  co_return co_await executor.Poll(
+      [client, request_handle, out_mesh] { return MLMeshingGetMeshResult(client, request_handle, out_mesh); });
+}
+
+/**
+ * Starts a plane query with MLPlanesQueryBegin() and awaits
+ * MLPlanesQueryGetResultsWithBoundaries().  On MLResult_Ok the caller must
+ * release *out_boundaries with MLPlanesReleaseBoundariesList() if it was
+ * requested.
+ */
+inline AndroidAppTask<MLResult> AndroidAppQueryPlanes(AndroidAppExecutor& executor, MLHandle planes_tracker,
+                                                      const MLPlanesQuery* query, MLPlane* out_results,
+                                                      uint32_t* out_num_results,
+                                                      MLPlaneBoundariesList* out_boundaries) {
+  MLHandle query_handle = ML_INVALID_HANDLE;
+  MLResult result = MLPlanesQueryBegin(planes_tracker, query, &query_handle);
+  if (result != MLResult_Ok) {
+    co_return result;
+  }
+  co_return co_await executor.Poll([=] {
+    return MLPlanesQueryGetResultsWithBoundaries(planes_tracker, query_handle, out_results, out_num_results,
+                                                 out_boundaries);
+  });
+}
+
+/**
+ * Runs MLSpatialAnchorQueryCreate() off the app thread.  On MLResult_Ok the
+ * caller must release *out_query_handle with MLSpatialAnchorQueryDestroy().
+ */
+inline AndroidAppTask<MLResult> AndroidAppQuerySpatialAnchors(AndroidAppExecutor& executor, MLHandle tracker,
+                                                              const MLSpatialAnchorQueryFilter* query_filter,
+                                                              MLHandle* out_query_handle,
+                                                              uint32_t* out_results_count) {
+  co_return co_await executor.Call([=] {
+    return MLSpatialAnchorQueryCreate(tracker, query_filter, out_query_handle, out_results_count);
+  });
+}
@@ -0,0 +1,80 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Hooks between android_native_app_glue.cpp and the other translation units
+ * of the glue.  Not part of the public glue API.
+ */
+
+#pragma once
+
+#include "android_native_app_glue.h"
+
+// android_app_scheduler.cpp
+
+// Stops the task scheduler, if running, after all queued tasks have run.
+void android_app_stop_scheduler(struct android_app* app);
+
+// android_app_saved_state.cpp
+
+// Maps the saved state region left by a previous instance, if any.
+void android_app_saved_state_open(struct android_app* app);
+
+// Marks the mapped region as being rewritten, before APP_CMD_SAVE_STATE is
+// handed to the app.
+void android_app_saved_state_begin(struct android_app* app);
+
+// Flushes the mapped region and marks it consistent again, after the app has
+// handled APP_CMD_SAVE_STATE.
+void android_app_saved_state_commit(struct android_app* app);
+
+// Unmaps the region without discarding it.
+void android_app_saved_state_close(struct android_app* app);
+
+// android_app_trace.cpp
+
+// Monotonic timestamp in nanoseconds used by the lifecycle trace.
+int64_t android_app_trace_now();
+
+// Allocates the lifecycle trace, starting at the OnAppLaunchZIv2() timestamp,
+// if $ANDROID_APP_TRACE_FILE is set.  Tracing is disabled otherwise.
+void android_app_trace_create(struct android_app* app, int64_t launchNanos);
+
+// Records the phases of one command handled by process_cmd().
+void android_app_trace_cmd(struct android_app* app, int8_t cmd, int64_t begin, int64_t preExecEnd, int64_t appEnd,
+                           int64_t end);
+
+// Writes the trace to $ANDROID_APP_TRACE_FILE if set, then frees it.
+void android_app_trace_destroy(struct android_app* app);
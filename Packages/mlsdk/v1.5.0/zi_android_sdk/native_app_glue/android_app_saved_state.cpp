@@ -0,0 +1,411 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Memory-mapped saved state region of an android_app.
+ *
+ * The region lives in <applicationWritableDir>/android_app_saved_state.bin
+ * and is mapped MAP_SHARED, so the app writes its state directly into the
+ * page cache and the next instance maps the same pages back.  The file
+ * starts with a header holding a table of versioned sections, followed by
+ * the section data.
+ *
+ * The whole address range up to kMaxRegionSize is reserved when the region
+ * is mapped and the file is only grown underneath it, so growing the file
+ * never moves the mapping.  A section that outgrows its capacity is moved
+ * within the region, though, so a pointer handed to the app stays valid only
+ * until its section grows or the region is cleared.
+ */
+
+#include "android_native_app_glue.h"
+#include "android_app_internal.h"
+
+#include "android/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "threaded_app", __VA_ARGS__))
+
+namespace {
+
+const uint32_t kMagic = 0x53414c4d;  // "MLAS"
+const uint32_t kFormatVersion = 1;
+const uint32_t kMaxSections = 64;
+const uint64_t kSectionAlignment = 64;
+const uint64_t kMaxRegionSize = 1ull << 30;
+const char kFileName[] = "android_app_saved_state.bin";
+
+struct SectionEntry {
+  uint32_t id;
+  uint32_t version;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t capacity;
+};
+
+struct RegionHeader {
+  uint32_t magic;
+  uint32_t formatVersion;
+  // Non-zero while APP_CMD_SAVE_STATE is being handled; a region left in
+  // that state was not saved completely and is discarded.
+  uint32_t writing;
+  uint32_t sectionCount;
+  uint64_t used;
+  SectionEntry sections[kMaxSections];
+};
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Returns the lowest aligned offset at which "size" bytes fit without
+// overlapping a section other than "skip", which is either a hole left by a
+// section that moved or the end of the sections in use.
+uint64_t FindFreeOffset(const RegionHeader* header, const SectionEntry* skip, uint64_t size) {
+  const SectionEntry* sections[kMaxSections];
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < header->sectionCount; i++) {
+    if (&header->sections[i] != skip) {
+      sections[count++] = &header->sections[i];
+    }
+  }
+  std::sort(sections, sections + count,
+            [](const SectionEntry* a, const SectionEntry* b) { return a->offset < b->offset; });
+
+  uint64_t offset = AlignUp(sizeof(RegionHeader), kSectionAlignment);
+  for (uint32_t i = 0; i < count; i++) {
+    if (offset + size <= sections[i]->offset) {
+      break;
+    }
+    offset = std::max(offset, AlignUp(sections[i]->offset + sections[i]->capacity, kSectionAlignment));
+  }
+  return offset;
+}
+
+// Returns whether every section of "header" lies after the header, within
+// the first "fileSize" bytes and clear of the other sections, so a region
+// written by another build or truncated on disk is never handed to the app.
+bool SectionsValid(const RegionHeader* header, uint64_t fileSize) {
+  const SectionEntry* sections[kMaxSections];
+  for (uint32_t i = 0; i < header->sectionCount; i++) {
+    const SectionEntry& section = header->sections[i];
+    if (section.offset < sizeof(RegionHeader) || section.capacity > fileSize ||
+        section.offset > fileSize - section.capacity || section.size > section.capacity) {
+      return false;
+    }
+    sections[i] = &section;
+  }
+  std::sort(sections, sections + header->sectionCount,
+            [](const SectionEntry* a, const SectionEntry* b) { return a->offset < b->offset; });
+  for (uint32_t i = 1; i < header->sectionCount; i++) {
+    if (sections[i - 1]->offset + sections[i - 1]->capacity > sections[i]->offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+struct android_app_saved_state {
+  int fd;
+  uint8_t* base;
+  uint64_t fileSize;
+  // Set when the region was mapped from a complete save of a previous
+  // instance, or once this instance has reserved a section.
+  bool valid;
+
+  RegionHeader* header() const { return reinterpret_cast<RegionHeader*>(base); }
+};
+
+#if !defined(_WIN32)
+
+namespace {
+
+std::string RegionPath(const android_app* app) {
+  std::string path = app->applicationWritableDir ? app->applicationWritableDir : ".";
+  if (!path.empty() && path.back() != '/') {
+    path += '/';
+  }
+  return path + kFileName;
+}
+
+bool GrowFile(android_app_saved_state* state, uint64_t size) {
+  if (size <= state->fileSize) {
+    return true;
+  }
+  if (size > kMaxRegionSize) {
+    LOGE("Saved state region would exceed %llu bytes", (unsigned long long)kMaxRegionSize);
+    return false;
+  }
+  const uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+  size = AlignUp(size, pageSize);
+  if (ftruncate(state->fd, (off_t)size) != 0) {
+    LOGE("Failed to grow saved state region to %llu bytes", (unsigned long long)size);
+    return false;
+  }
+  state->fileSize = size;
+  return true;
+}
+
+android_app_saved_state* MapRegion(android_app* app, bool create) {
+  const std::string path = RegionPath(app);
+  const int fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+  if (fd < 0) {
+    if (create) {
+      LOGE("Failed to open %s", path.c_str());
+    }
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  void* base = mmap(nullptr, kMaxRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    LOGE("Failed to map %s", path.c_str());
+    close(fd);
+    return nullptr;
+  }
+
+  android_app_saved_state* state = new android_app_saved_state{};
+  state->fd = fd;
+  state->base = static_cast<uint8_t*>(base);
+  state->fileSize = (uint64_t)st.st_size;
+
+  RegionHeader* header = state->header();
+  const bool complete = state->fileSize >= sizeof(RegionHeader) && header->magic == kMagic &&
+                        header->formatVersion == kFormatVersion && !header->writing &&
+                        header->sectionCount <= kMaxSections && header->used <= state->fileSize &&
+                        SectionsValid(header, state->fileSize);
+  if (complete) {
+    state->valid = true;
+  } else if (!GrowFile(state, sizeof(RegionHeader))) {
+    munmap(base, kMaxRegionSize);
+    close(fd);
+    delete state;
+    return nullptr;
+  } else {
+    memset(header, 0, sizeof(RegionHeader));
+    header->magic = kMagic;
+    header->formatVersion = kFormatVersion;
+    header->used = AlignUp(sizeof(RegionHeader), kSectionAlignment);
+    // Not a complete save until the next APP_CMD_SAVE_STATE is handled.
+    header->writing = 1;
+  }
+  return state;
+}
+
+}  // namespace
+
+void android_app_saved_state_open(android_app* app) {
+  if (!app->mappedState) {
+    app->mappedState = MapRegion(app, false);
+  }
+}
+
+void android_app_saved_state_begin(android_app* app) {
+  if (android_app_saved_state* state = app->mappedState) {
+    state->header()->writing = 1;
+  }
+}
+
+void android_app_saved_state_commit(android_app* app) {
+  if (android_app_saved_state* state = app->mappedState) {
+    // Write back asynchronously: the pages stay in the page cache for the
+    // next instance either way, and large regions would stall the app
+    // thread with MS_SYNC.
+    msync(state->base, state->fileSize, MS_ASYNC);
+    std::atomic_thread_fence(std::memory_order_release);
+    state->header()->writing = 0;
+  }
+}
+
+void android_app_saved_state_close(android_app* app) {
+  if (android_app_saved_state* state = app->mappedState) {
+    munmap(state->base, kMaxRegionSize);
+    close(state->fd);
+    delete state;
+    app->mappedState = nullptr;
+  }
+}
+
+void* android_app_saved_state_reserve(android_app* android_app, uint32_t sectionId, uint32_t version,
+                                      size_t size) {
+  if (!android_app->mappedState) {
+    android_app->mappedState = MapRegion(android_app, true);
+    if (!android_app->mappedState) {
+      return nullptr;
+    }
+  }
+  android_app_saved_state* state = android_app->mappedState;
+  RegionHeader* header = state->header();
+  state->valid = true;
+
+  for (uint32_t i = 0; i < header->sectionCount; i++) {
+    SectionEntry& section = header->sections[i];
+    if (section.id == sectionId && section.capacity >= size) {
+      section.version = version;
+      section.size = size;
+      return state->base + section.offset;
+    }
+  }
+
+  // Either a new section or one that outgrew its slot.  A grown section is
+  // extended in place when the space after it is free, or else moved with its
+  // contents into the first hole that fits, so the region only grows by what
+  // does not fit in the space left by earlier moves.
+  SectionEntry* section = nullptr;
+  for (uint32_t i = 0; i < header->sectionCount; i++) {
+    if (header->sections[i].id == sectionId) {
+      section = &header->sections[i];
+    }
+  }
+  if (!section && header->sectionCount == kMaxSections) {
+    LOGE("Saved state region is limited to %u sections", kMaxSections);
+    return nullptr;
+  }
+
+  // A grown section gets twice its previous capacity, so growing it step by
+  // step only moves it a logarithmic number of times.
+  const uint64_t capacity = section ? std::max<uint64_t>(size, section->capacity * 2) : size;
+  const uint64_t offset = FindFreeOffset(header, section, capacity);
+  if (!GrowFile(state, offset + capacity)) {
+    return nullptr;
+  }
+  if (!section) {
+    section = &header->sections[header->sectionCount++];
+    section->id = sectionId;
+  } else if (section->offset != offset) {
+    memmove(state->base + offset, state->base + section->offset, (size_t)section->size);
+  }
+  section->version = version;
+  section->offset = offset;
+  section->size = size;
+  section->capacity = capacity;
+
+  header->used = 0;
+  for (uint32_t i = 0; i < header->sectionCount; i++) {
+    header->used = std::max(header->used, header->sections[i].offset + header->sections[i].capacity);
+  }
+  return state->base + offset;
+}
+
+void* android_app_saved_state_get(android_app* android_app, uint32_t sectionId, uint32_t* outVersion,
+                                  size_t* outSize) {
+  android_app_saved_state* state = android_app->mappedState;
+  if (!state || !state->valid) {
+    return nullptr;
+  }
+  RegionHeader* header = state->header();
+  for (uint32_t i = 0; i < header->sectionCount; i++) {
+    const SectionEntry& section = header->sections[i];
+    if (section.id == sectionId) {
+      if (section.offset + section.size > state->fileSize) {
+        return nullptr;
+      }
+      if (outVersion) *outVersion = section.version;
+      if (outSize) *outSize = (size_t)section.size;
+      return state->base + section.offset;
+    }
+  }
+  return nullptr;
+}
+
+void android_app_saved_state_clear(android_app* android_app) {
+  if (android_app_saved_state* state = android_app->mappedState) {
+    RegionHeader* header = state->header();
+    header->sectionCount = 0;
+    header->used = AlignUp(sizeof(RegionHeader), kSectionAlignment);
+  }
+}
+
+#else  // _WIN32
+
+// The region relies on reserving address space ahead of the mapped file,
+// which MapViewOfFile cannot grow into; Windows hosts keep using savedState.
+
+void android_app_saved_state_open(android_app* app) {
+  (void)app;
+}
+
+void android_app_saved_state_begin(android_app* app) {
+  (void)app;
+}
+
+void android_app_saved_state_commit(android_app* app) {
+  (void)app;
+}
+
+void android_app_saved_state_close(android_app* app) {
+  (void)app;
+}
+
+void* android_app_saved_state_reserve(android_app* android_app, uint32_t sectionId, uint32_t version,
+                                      size_t size) {
+  (void)android_app;
+  (void)sectionId;
+  (void)version;
+  (void)size;
+  LOGE("Memory-mapped saved state is not supported on this host");
+  return nullptr;
+}
+
+void* android_app_saved_state_get(android_app* android_app, uint32_t sectionId, uint32_t* outVersion,
+                                  size_t* outSize) {
+  (void)android_app;
+  (void)sectionId;
+  (void)outVersion;
+  (void)outSize;
+  return nullptr;
+}
+
+void android_app_saved_state_clear(android_app* android_app) {
+  (void)android_app;
+}
+
+#endif  // _WIN32
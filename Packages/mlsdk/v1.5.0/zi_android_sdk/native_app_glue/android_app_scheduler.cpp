@@ -0,0 +1,343 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Task scheduler behind android_app_start_scheduler().
+ *
+ * The worker lane is a pool of threads that each own a task deque: a worker
+ * pops its own most recently queued task first and steals the oldest task
+ * of another worker when its deque runs dry.  Every dedicated lane (render,
+ * perception, I/O) is a single thread draining a FIFO queue.
+ */
+
+#include "android_native_app_glue.h"
+#include "android_app_internal.h"
+
+#include "android/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "threaded_app", __VA_ARGS__))
+
+struct android_app_task {
+  void (*fn)(void* data);
+  void* data;
+  std::atomic<int> done;
+  // One reference for the scheduler and one for the android_app_wait() caller.
+  std::atomic<int> refs;
+};
+
+namespace {
+
+struct TaskQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<android_app_task*> tasks;
+};
+
+void ReleaseTask(android_app_task* task) {
+  if (task->refs.fetch_sub(1) == 1) {
+    delete task;
+  }
+}
+
+void SetThreadName(const char* name) {
+#if defined(__linux__)
+  pthread_setname_np(pthread_self(), name);
+#else
+  (void)name;
+#endif
+}
+
+}  // namespace
+
+struct android_app_scheduler {
+  std::vector<std::unique_ptr<TaskQueue>> workerQueues;
+  TaskQueue laneQueues[ANDROID_APP_LANE_COUNT];
+  std::vector<std::thread> threads;
+
+  // Number of queued worker lane tasks; idle workers sleep on idleCv while
+  // it is zero.
+  std::atomic<int> pendingWork;
+  std::mutex idleMutex;
+  std::condition_variable idleCv;
+
+  // Signalled whenever a task completes, for android_app_wait(), and when
+  // worker lane tasks are queued while threads are waiting, so they help.
+  std::mutex doneMutex;
+  std::condition_variable doneCv;
+  // Number of threads blocked on doneCv.
+  std::atomic<int> waiters;
+
+  std::atomic<unsigned> nextQueue;
+  std::atomic<bool> stopping;
+};
+
+namespace {
+
+// Index of the worker queue owned by the calling thread, or -1.
+thread_local int tWorkerIndex = -1;
+
+void RunTask(android_app_scheduler* scheduler, android_app_task* task) {
+  task->fn(task->data);
+  task->done.store(1, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(scheduler->doneMutex);
+  }
+  scheduler->doneCv.notify_all();
+  ReleaseTask(task);
+}
+
+android_app_task* TakeWork(android_app_scheduler* scheduler) {
+  const int count = (int)scheduler->workerQueues.size();
+  const int self = tWorkerIndex;
+  if (self >= 0) {
+    TaskQueue& own = *scheduler->workerQueues[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      android_app_task* task = own.tasks.back();
+      own.tasks.pop_back();
+      scheduler->pendingWork.fetch_sub(1);
+      return task;
+    }
+  }
+  const int start = self >= 0 ? self + 1 : 0;
+  for (int i = 0; i < count; i++) {
+    TaskQueue& victim = *scheduler->workerQueues[(start + i) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      android_app_task* task = victim.tasks.front();
+      victim.tasks.pop_front();
+      scheduler->pendingWork.fetch_sub(1);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void WorkerLoop(android_app_scheduler* scheduler, int index) {
+  tWorkerIndex = index;
+  SetThreadName("app-worker");
+  for (;;) {
+    if (android_app_task* task = TakeWork(scheduler)) {
+      RunTask(scheduler, task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(scheduler->idleMutex);
+    scheduler->idleCv.wait(lock, [scheduler] {
+      return scheduler->pendingWork.load() > 0 || scheduler->stopping.load();
+    });
+    if (scheduler->stopping.load() && scheduler->pendingWork.load() == 0) {
+      return;
+    }
+  }
+}
+
+void LaneLoop(android_app_scheduler* scheduler, int lane, const char* name) {
+  SetThreadName(name);
+  TaskQueue& queue = scheduler->laneQueues[lane];
+  for (;;) {
+    android_app_task* task;
+    {
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      queue.cv.wait(lock, [&] { return !queue.tasks.empty() || scheduler->stopping.load(); });
+      if (queue.tasks.empty()) {
+        return;
+      }
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+    }
+    RunTask(scheduler, task);
+  }
+}
+
+bool Enqueue(android_app_scheduler* scheduler, int lane, android_app_task* task) {
+  if (lane < 0 || lane >= ANDROID_APP_LANE_COUNT) {
+    LOGE("Invalid scheduler lane %d", lane);
+    return false;
+  }
+  if (lane != ANDROID_APP_LANE_WORKER) {
+    TaskQueue& queue = scheduler->laneQueues[lane];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(task);
+    }
+    queue.cv.notify_one();
+    return true;
+  }
+
+  // Workers keep their own tasks local; other threads spread them round-robin.
+  const int count = (int)scheduler->workerQueues.size();
+  const int index = tWorkerIndex >= 0 ? tWorkerIndex : (int)(scheduler->nextQueue.fetch_add(1) % count);
+  {
+    TaskQueue& queue = *scheduler->workerQueues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  scheduler->pendingWork.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(scheduler->idleMutex);
+  }
+  scheduler->idleCv.notify_one();
+  // A waiter either sees pendingWork before blocking or is counted here.
+  if (scheduler->waiters.load() > 0) {
+    {
+      std::lock_guard<std::mutex> lock(scheduler->doneMutex);
+    }
+    scheduler->doneCv.notify_all();
+  }
+  return true;
+}
+
+android_app_task* NewTask(void (*fn)(void* data), void* data, int refs) {
+  android_app_task* task = new android_app_task;
+  task->fn = fn;
+  task->data = data;
+  task->done.store(0);
+  task->refs.store(refs);
+  return task;
+}
+
+}  // namespace
+
+int android_app_start_scheduler(android_app* android_app, int numWorkers) {
+  if (android_app->scheduler) {
+    return 1;
+  }
+  if (numWorkers <= 0) {
+    // The thread calling android_app_wait() helps with worker tasks, so leave
+    // one core for it.
+    const int cores = (int)std::thread::hardware_concurrency();
+    numWorkers = std::max(1, cores - 1);
+  }
+
+  android_app_scheduler* scheduler = new android_app_scheduler;
+  scheduler->pendingWork.store(0);
+  scheduler->waiters.store(0);
+  scheduler->nextQueue.store(0);
+  scheduler->stopping.store(false);
+  for (int i = 0; i < numWorkers; i++) {
+    scheduler->workerQueues.emplace_back(new TaskQueue);
+  }
+  for (int i = 0; i < numWorkers; i++) {
+    scheduler->threads.emplace_back(WorkerLoop, scheduler, i);
+  }
+  scheduler->threads.emplace_back(LaneLoop, scheduler, (int)ANDROID_APP_LANE_RENDER, "app-render");
+  scheduler->threads.emplace_back(LaneLoop, scheduler, (int)ANDROID_APP_LANE_PERCEPTION, "app-perception");
+  scheduler->threads.emplace_back(LaneLoop, scheduler, (int)ANDROID_APP_LANE_IO, "app-io");
+
+  android_app->scheduler = scheduler;
+  return 1;
+}
+
+void android_app_stop_scheduler(android_app* android_app) {
+  android_app_scheduler* scheduler = android_app->scheduler;
+  if (!scheduler) {
+    return;
+  }
+  scheduler->stopping.store(true);
+  {
+    std::lock_guard<std::mutex> lock(scheduler->idleMutex);
+  }
+  scheduler->idleCv.notify_all();
+  for (TaskQueue& queue : scheduler->laneQueues) {
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+    }
+    queue.cv.notify_all();
+  }
+  for (std::thread& thread : scheduler->threads) {
+    thread.join();
+  }
+  delete scheduler;
+  android_app->scheduler = nullptr;
+}
+
+android_app_task* android_app_submit(android_app* android_app, int lane, void (*fn)(void* data), void* data) {
+  android_app_scheduler* scheduler = android_app->scheduler;
+  if (!scheduler) {
+    return nullptr;
+  }
+  android_app_task* task = NewTask(fn, data, 2);
+  if (!Enqueue(scheduler, lane, task)) {
+    delete task;
+    return nullptr;
+  }
+  return task;
+}
+
+int android_app_post(android_app* android_app, int lane, void (*fn)(void* data), void* data) {
+  android_app_scheduler* scheduler = android_app->scheduler;
+  if (!scheduler) {
+    return 0;
+  }
+  android_app_task* task = NewTask(fn, data, 1);
+  if (!Enqueue(scheduler, lane, task)) {
+    delete task;
+    return 0;
+  }
+  return 1;
+}
+
+void android_app_wait(android_app* android_app, android_app_task* task) {
+  if (!task) {
+    return;
+  }
+  android_app_scheduler* scheduler = android_app->scheduler;
+  while (!task->done.load(std::memory_order_acquire)) {
+    if (android_app_task* other = TakeWork(scheduler)) {
+      RunTask(scheduler, other);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(scheduler->doneMutex);
+    scheduler->waiters.fetch_add(1);
+    scheduler->doneCv.wait(lock, [&] {
+      return task->done.load(std::memory_order_acquire) || scheduler->pendingWork.load() > 0;
+    });
+    scheduler->waiters.fetch_sub(1);
+  }
+  ReleaseTask(task);
+}
@@ -0,0 +1,341 @@
+// %BANNER_BEGIN%
+// ---------------------------------------------------------------------
+// %COPYRIGHT_BEGIN%
+//
+// Copyright (c) 202x Magic Leap, Inc. (COMPANY) All Rights Reserved.
+// Magic Leap, Inc. Confidential and Proprietary
+//
+// NOTICE: All information contained herein is, and remains the property
+// of COMPANY. The intellectual and technical concepts contained herein
+// are proprietary to COMPANY and may be covered by U.S. and Foreign
+// Patents, patents in process, and are protected by trade secret or
+// copyright law. Dissemination of this information or reproduction of
+// this material is strictly forbidden unless prior written permission is
+// obtained from COMPANY. Access to the source code contained herein is
+// hereby forbidden to anyone except current COMPANY employees, managers
+// or contractors who have executed Confidentiality and Non-disclosure
+// agreements explicitly covering such access.
+//
+// The copyright notice above does not evidence any actual or intended
+// publication or disclosure of this source code, which includes
+// information that is confidential and/or proprietary, and is a trade
+// secret, of COMPANY. ANY REPRODUCTION, MODIFICATION, DISTRIBUTION,
+// PUBLIC PERFORMANCE, OR PUBLIC DISPLAY OF OR THROUGH USE OF THIS
+// SOURCE CODE WITHOUT THE EXPRESS WRITTEN CONSENT OF COMPANY IS
+// STRICTLY PROHIBITED, AND IN VIOLATION OF APPLICABLE LAWS AND
+// INTERNATIONAL TREATIES. THE RECEIPT OR POSSESSION OF THIS SOURCE
+// CODE AND/OR RELATED INFORMATION DOES NOT CONVEY OR IMPLY ANY RIGHTS
+// TO REPRODUCE, DISCLOSE OR DISTRIBUTE ITS CONTENTS, OR TO MANUFACTURE,
+// USE, OR SELL ANYTHING THAT IT MAY DESCRIBE, IN WHOLE OR IN PART.
+//
+// %COPYRIGHT_END%
+// ---------------------------------------------------------------------
+// %BANNER_END%
+
+
+/**
+ * Lifecycle and startup latency tracing for the app glue.
+ *
+ * Records timestamps along the launch path and the pre-exec, onAppCmd and
+ * post-exec phases of every APP_CMD_* handled by process_cmd(), keeps a
+ * log-linear (HdrHistogram style) latency histogram per command, and
+ * exports them as Chrome trace JSON and HdrHistogram percentile text.
+ */
+
+#include "android_native_app_glue.h"
+#include "android_app_internal.h"
+
+#include "android/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "threaded_app", __VA_ARGS__))
+#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "threaded_app", __VA_ARGS__))
+
+namespace {
+
+const uint32_t kMaxEvents = 4096;
+const int kCmdCount = APP_CMD_DESTROY + 1;
+
+// Histogram layout: values below 2 * kSubBuckets nanoseconds get one bucket
+// each, every power of two above that is split into kSubBuckets linear
+// buckets, for a relative error below 1 / kSubBuckets.  Values are clamped
+// at 2^kMaxMagnitude nanoseconds (about 18 minutes).
+const int kSubBucketBits = 6;
+const uint64_t kSubBuckets = 1u << kSubBucketBits;
+const int kMaxMagnitude = 40;
+const int kBucketCount = (int)(2 * kSubBuckets + (kMaxMagnitude - kSubBucketBits - 1) * kSubBuckets);
+
+const char* const kCmdNames[kCmdCount] = {
+    "APP_CMD_INPUT_CHANGED",
+    "APP_CMD_INIT_WINDOW",
+    "APP_CMD_TERM_WINDOW",
+    "APP_CMD_WINDOW_RESIZED",
+    "APP_CMD_WINDOW_REDRAW_NEEDED",
+    "APP_CMD_CONTENT_RECT_CHANGED",
+    "APP_CMD_GAINED_FOCUS",
+    "APP_CMD_LOST_FOCUS",
+    "APP_CMD_CONFIG_CHANGED",
+    "APP_CMD_LOW_MEMORY",
+    "APP_CMD_START",
+    "APP_CMD_RESUME",
+    "APP_CMD_SAVE_STATE",
+    "APP_CMD_PAUSE",
+    "APP_CMD_STOP",
+    "APP_CMD_DESTROY",
+};
+
+struct TraceEvent {
+  // Set last, once the rest of the event has been written.
+  std::atomic<int> ready;
+  // Static name of a mark, or NULL for a command.
+  const char* name;
+  int cmd;
+  int tid;
+  int64_t begin;
+  int64_t preExecEnd;
+  int64_t appEnd;
+  int64_t end;
+};
+
+struct Histogram {
+  uint64_t count;
+  uint64_t maxValue;
+  uint32_t buckets[kBucketCount];
+};
+
+int BucketIndex(uint64_t value) {
+  if (value >= (1ull << kMaxMagnitude)) {
+    value = (1ull << kMaxMagnitude) - 1;
+  }
+  if (value < 2 * kSubBuckets) {
+    return (int)value;
+  }
+  int magnitude = 63;
+  while (!(value >> magnitude)) {
+    magnitude--;
+  }
+  const int shift = magnitude - kSubBucketBits;
+  return (int)(2 * kSubBuckets + (shift - 1) * kSubBuckets + ((value >> shift) - kSubBuckets));
+}
+
+// Highest value that falls into the given bucket.
+uint64_t BucketValue(int index) {
+  if ((uint64_t)index < 2 * kSubBuckets) {
+    return (uint64_t)index;
+  }
+  const int shift = (int)((index - 2 * kSubBuckets) / kSubBuckets) + 1;
+  const uint64_t sub = (index - 2 * kSubBuckets) % kSubBuckets + kSubBuckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+int CurrentThreadId() {
+  static std::atomic<int> nextId(1);
+  thread_local int id = nextId.fetch_add(1);
+  return id;
+}
+
+}  // namespace
+
+struct android_app_trace {
+  int64_t launch;
+  std::atomic<uint32_t> eventCount;
+  std::atomic<uint32_t> dropped;
+  std::atomic<int> firstFrameSeen;
+  TraceEvent events[kMaxEvents];
+  // Only updated on the app thread.
+  Histogram histograms[kCmdCount];
+};
+
+namespace {
+
+TraceEvent* AppendEvent(android_app_trace* trace) {
+  const uint32_t index = trace->eventCount.fetch_add(1);
+  if (index >= kMaxEvents) {
+    trace->eventCount.store(kMaxEvents);
+    trace->dropped.fetch_add(1);
+    return nullptr;
+  }
+  return &trace->events[index];
+}
+
+double ToMicros(const android_app_trace* trace, int64_t nanos) {
+  return (double)(nanos - trace->launch) / 1000.0;
+}
+
+}  // namespace
+
+int64_t android_app_trace_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void android_app_trace_create(android_app* app, int64_t launchNanos) {
+  // The event buffer takes a few hundred KB, so it is only allocated when the
+  // trace is going to be written.
+  if (!getenv("ANDROID_APP_TRACE_FILE")) {
+    return;
+  }
+  android_app_trace* trace = new android_app_trace();
+  trace->launch = launchNanos;
+  app->trace = trace;
+
+  TraceEvent* event = AppendEvent(trace);
+  event->name = "OnAppLaunchZIv2";
+  event->cmd = -1;
+  event->tid = CurrentThreadId();
+  event->begin = event->preExecEnd = event->appEnd = event->end = launchNanos;
+  event->ready.store(1, std::memory_order_release);
+}
+
+void android_app_trace_cmd(android_app* app, int8_t cmd, int64_t begin, int64_t preExecEnd, int64_t appEnd,
+                           int64_t end) {
+  android_app_trace* trace = app->trace;
+  if (!trace) {
+    return;
+  }
+  if (cmd >= 0 && cmd < kCmdCount) {
+    Histogram& histogram = trace->histograms[cmd];
+    const uint64_t value = (uint64_t)(end - begin);
+    histogram.buckets[BucketIndex(value)]++;
+    histogram.count++;
+    if (value > histogram.maxValue) {
+      histogram.maxValue = value;
+    }
+  }
+  if (TraceEvent* event = AppendEvent(trace)) {
+    event->name = nullptr;
+    event->cmd = cmd;
+    event->tid = CurrentThreadId();
+    event->begin = begin;
+    event->preExecEnd = preExecEnd;
+    event->appEnd = appEnd;
+    event->end = end;
+    event->ready.store(1, std::memory_order_release);
+  }
+}
+
+void android_app_trace_mark(android_app* android_app, const char* name) {
+  android_app_trace* trace = android_app->trace;
+  if (!trace) {
+    return;
+  }
+  if (TraceEvent* event = AppendEvent(trace)) {
+    const int64_t now = android_app_trace_now();
+    event->name = name;
+    event->cmd = -1;
+    event->tid = CurrentThreadId();
+    event->begin = event->preExecEnd = event->appEnd = event->end = now;
+    event->ready.store(1, std::memory_order_release);
+  }
+}
+
+void android_app_trace_first_frame(android_app* android_app) {
+  android_app_trace* trace = android_app->trace;
+  if (trace && !trace->firstFrameSeen.load(std::memory_order_relaxed) && !trace->firstFrameSeen.exchange(1)) {
+    android_app_trace_mark(android_app, "MLGraphicsBeginFrameEx");
+    LOGI("First frame %.3f ms after launch", (double)(android_app_trace_now() - trace->launch) / 1e6);
+  }
+}
+
+int android_app_trace_write_chrome_json(android_app* android_app, const char* path) {
+  android_app_trace* trace = android_app->trace;
+  FILE* file = trace ? fopen(path, "w") : nullptr;
+  if (!file) {
+    return 0;
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"android_app\"}}");
+  const uint32_t count = trace->eventCount.load();
+  int64_t firstFrame = -1;
+  for (uint32_t i = 0; i < count; i++) {
+    const TraceEvent& event = trace->events[i];
+    if (!event.ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    if (event.name) {
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", event.name,
+              event.tid, ToMicros(trace, event.begin));
+      if (firstFrame < 0 && std::string(event.name) == "MLGraphicsBeginFrameEx") {
+        firstFrame = event.begin;
+      }
+      continue;
+    }
+    const char* name = event.cmd >= 0 && event.cmd < kCmdCount ? kCmdNames[event.cmd] : "APP_CMD_UNKNOWN";
+    fprintf(file,
+            ",\n{\"name\":\"%s\",\"cat\":\"app_cmd\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"pre_exec_us\":%.3f,\"on_app_cmd_us\":%.3f,\"post_exec_us\":%.3f}}",
+            name, event.tid, ToMicros(trace, event.begin), (event.end - event.begin) / 1000.0,
+            (event.preExecEnd - event.begin) / 1000.0, (event.appEnd - event.preExecEnd) / 1000.0,
+            (event.end - event.appEnd) / 1000.0);
+  }
+  if (firstFrame >= 0) {
+    fprintf(file, ",\n{\"name\":\"startup\",\"cat\":\"launch\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":0,\"dur\":%.3f}",
+            ToMicros(trace, firstFrame));
+  }
+  fprintf(file, "\n],\"otherData\":{\"droppedEvents\":%u}}\n", trace->dropped.load());
+  return fclose(file) == 0;
+}
+
+int android_app_trace_write_histograms(android_app* android_app, const char* path) {
+  android_app_trace* trace = android_app->trace;
+  FILE* file = trace ? fopen(path, "w") : nullptr;
+  if (!file) {
+    return 0;
+  }
+
+  // One block per command, in the percentile distribution format printed by
+  // HdrHistogram's outputPercentileDistribution(), with values in
+  // microseconds.
+  for (int cmd = 0; cmd < kCmdCount; cmd++) {
+    const Histogram& histogram = trace->histograms[cmd];
+    if (!histogram.count) {
+      continue;
+    }
+    fprintf(file, "# %s\n", kCmdNames[cmd]);
+    fprintf(file, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    uint64_t total = 0;
+    double mean = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+      if (!histogram.buckets[i]) {
+        continue;
+      }
+      total += histogram.buckets[i];
+      const double percentile = (double)total / histogram.count;
+      const double value = (double)std::min<uint64_t>(BucketValue(i), histogram.maxValue) / 1000.0;
+      mean += value * histogram.buckets[i];
+      if (total < histogram.count) {
+        fprintf(file, "%12.3f %14.12f %10llu %14.2f\n", value, percentile, (unsigned long long)total,
+                1.0 / (1.0 - percentile));
+      } else {
+        fprintf(file, "%12.3f %14.12f %10llu\n", value, percentile, (unsigned long long)total);
+      }
+    }
+    fprintf(file, "#[Mean    = %12.3f, Max     = %12.3f]\n", mean / histogram.count, histogram.maxValue / 1000.0);
+    fprintf(file, "#[Total count    = %12llu]\n\n", (unsigned long long)histogram.count);
+  }
+  return fclose(file) == 0;
+}
+
+void android_app_trace_destroy(android_app* app) {
+  if (!app->trace) {
+    return;
+  }
+  if (const char* path = getenv("ANDROID_APP_TRACE_FILE")) {
+    const std::string histogramPath = std::string(path) + ".hgrm";
+    if (android_app_trace_write_chrome_json(app, path) &&
+        android_app_trace_write_histograms(app, histogramPath.c_str())) {
+      LOGI("Wrote lifecycle trace to %s", path);
+    } else {
+      LOGE("Failed to write lifecycle trace to %s", path);
+    }
+  }
+  delete app->trace;
+  app->trace = nullptr;
+}
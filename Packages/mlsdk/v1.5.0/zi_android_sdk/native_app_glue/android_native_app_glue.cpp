@@ -20,10 +20,13 @@
  */
 
 #include "android_native_app_glue.h"
+#include "android_app_internal.h"
 
 #include "android/log.h"
 #include "android/looper_event_reader_writer.h"
 
+#include <atomic>
+
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "threaded_app", __VA_ARGS__))
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "threaded_app", __VA_ARGS__))
 
@@ -87,6 +90,7 @@ void android_app_post_exec_cmd(struct android_app* app, int8_t cmd) {
 
     case APP_CMD_SAVE_STATE:
       LOGV("APP_CMD_SAVE_STATE\n");
+      android_app_saved_state_commit(app);
       app->stateSaved = 1;
       break;
 
@@ -96,65 +100,147 @@ void android_app_post_exec_cmd(struct android_app* app, int8_t cmd) {
   }
 }
 
-int8_t android_app_read_cmd(android_app* android_app) {
-  int8_t cmd;
-  if (auto* reader = LooperEventReaderWriter::GetPointer(android_app->msgread)) {
-    if (reader->HasEvent()) {
-      cmd = reader->ReadEvent();
-      switch (cmd) {
-        case APP_CMD_SAVE_STATE:
-          free_saved_state(android_app);
-          break;
-      }
-      return cmd;
-    } else {
-      LOGE("No data on command pipe!");
+// Commands process_cmd() moves from the command handle per batch.  Must be
+// a power of two.
+static const uint32_t kCmdRingCapacity = 64;
+
+// Single-producer / single-consumer ring of commands read from the command
+// handle.  android_app_drain_cmds() is the producer and
+// android_app_next_cmd() the consumer, so the dispatch loop takes commands
+// without a lock or a call into the reader.  The indices are free running.
+struct android_app_cmd_ring {
+  // Next command to dispatch.  Only written by the consumer.
+  std::atomic<uint32_t> head{0};
+  // Next free slot.  Only written by the producer.
+  std::atomic<uint32_t> tail{0};
+  int8_t cmds[kCmdRingCapacity];
+};
+
+// Moves the commands pending on the command handle onto the ring.  Commands
+// that do not fit stay on the handle, which keeps it readable, so they are
+// drained on the next looper wakeup.
+static void android_app_drain_cmds(android_app* app) {
+  android_app_cmd_ring* ring = app->cmdRing;
+  LooperEventReaderWriter* reader = app->cmdReader;
+  uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+  const uint32_t head = ring->head.load(std::memory_order_acquire);
+  while (reader->HasEvent()) {
+    if (tail - head == kCmdRingCapacity) {
+      LOGV("Command ring full, leaving the remaining commands for the next wakeup");
+      break;
     }
-  } else {
-    LOGE("No pointer to event reader!");
+    ring->cmds[tail & (kCmdRingCapacity - 1)] = (int8_t)reader->ReadEvent();
+    ++tail;
+  }
+  ring->tail.store(tail, std::memory_order_release);
+}
+
+int android_app_write_cmd(android_app* android_app, int8_t cmd) {
+  // The command handle is the one ordered queue for commands from the
+  // runtime and the app, and wakes the looper.
+  android_app->cmdReader->WriteEvent(cmd);
+  return 1;
+}
+
+// Returns the next command on the ring, or -1 if it is empty.
+static int8_t android_app_next_cmd(android_app* app) {
+  android_app_cmd_ring* ring = app->cmdRing;
+  const uint32_t head = ring->head.load(std::memory_order_relaxed);
+  if (head == ring->tail.load(std::memory_order_acquire)) {
+    return -1;
+  }
+  const int8_t cmd = ring->cmds[head & (kCmdRingCapacity - 1)];
+  ring->head.store(head + 1, std::memory_order_release);
+  switch (cmd) {
+    case APP_CMD_SAVE_STATE:
+      free_saved_state(app);
+      android_app_saved_state_begin(app);
+      break;
   }
-  return -1;
+  return cmd;
+}
+
+int8_t android_app_read_cmd(android_app* android_app) {
+  int8_t cmd = android_app_next_cmd(android_app);
+  if (cmd < 0) {
+    android_app_drain_cmds(android_app);
+    cmd = android_app_next_cmd(android_app);
+  }
+  if (cmd < 0) {
+    LOGE("No data on command pipe!");
+  }
+  return cmd;
 }
 
 static void process_cmd(android_app* app, android_poll_source* source) {
   // Unused params; kept to match the original function signature from the Android implementation
   (void)source;
 
-  int8_t cmd = android_app_read_cmd(app);
-  android_app_pre_exec_cmd(app, cmd);
-  if (app->onAppCmd) {
-    app->onAppCmd(app, cmd);
+  // Take every command that is pending for this wakeup in one batch instead
+  // of returning to the looper after each one.
+  android_app_drain_cmds(app);
+  int8_t cmd;
+  while ((cmd = android_app_next_cmd(app)) >= 0) {
+    const int64_t begin = android_app_trace_now();
+    android_app_pre_exec_cmd(app, cmd);
+    const int64_t preExecEnd = android_app_trace_now();
+    if (app->onAppCmd) {
+      app->onAppCmd(app, cmd);
+    }
+    const int64_t appEnd = android_app_trace_now();
+    android_app_post_exec_cmd(app, cmd);
+    android_app_trace_cmd(app, cmd, begin, preExecEnd, appEnd, android_app_trace_now());
+    if (app->cmdObserver) {
+      app->cmdObserver(app, cmd, app->cmdObserverData);
+    }
   }
-  android_app_post_exec_cmd(app, cmd);
 }
 
 static void android_app_destroy(android_app* app) {
   LOGV("android_app_destroy!");
+  android_app_trace_mark(app, "android_app_destroy");
+  android_app_stop_scheduler(app);
   free_saved_state(app);
+  android_app_saved_state_close(app);
+  android_app_trace_destroy(app);
+  delete app->cmdRing;
+  app->cmdRing = nullptr;
   app->destroyed = 1;
 }
 
 static void* android_app_entry(android_app* app) {
+  android_app_trace_mark(app, "android_app_entry");
+
   app->cmdPollSource.id = LOOPER_ID_MAIN;
   app->cmdPollSource.app = app;
   app->cmdPollSource.process = process_cmd;
 
-  LooperEventReaderWriter eventReader;
   ALooper* looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
   ALooper_addFd(looper, app->msgread, LOOPER_ID_MAIN, ALOOPER_EVENT_INPUT, nullptr,
                 &app->cmdPollSource);
   app->looper = looper;
 
+  android_app_saved_state_open(app);
+
   app->running = 1;
 
+#ifdef ANDROID_APP_SCHEDULER_WORKERS
+  if (!android_app_start_scheduler(app, ANDROID_APP_SCHEDULER_WORKERS)) {
+    LOGE("Failed to start the task scheduler");
+  }
+#endif
+
+  android_app_trace_mark(app, "android_main");
   android_main(app);
 
   android_app_destroy(app);
   return nullptr;
 }
 
-static android_app* android_app_create(int argc, const char** argv, const char* appInstallDir, const char* appWritableDir, const char* externalFilesDir) {
+static android_app* android_app_create(int64_t launchTime, int argc, const char** argv, const char* appInstallDir, const char* appWritableDir, const char* externalFilesDir) {
   android_app* app = new android_app{};
+  android_app_trace_create(app, launchTime);
+  android_app_trace_mark(app, "android_app_create");
 
   app->argc = argc;
   app->argv = argv;
@@ -168,6 +254,8 @@ static android_app* android_app_create(int argc, const char** argv, const char*
 
   LooperEventReaderWriter readerWriter;
   app->msgread = readerWriter.GetHandle();
+  app->cmdReader = &readerWriter;
+  app->cmdRing = new android_app_cmd_ring();
 
   android_app_entry(app);
 
@@ -175,7 +263,8 @@ static android_app* android_app_create(int argc, const char** argv, const char*
 }
 
 void OnAppLaunchZIv2(int argc, const char** argv, const char* appInstallDir, const char* appWritableDir, const char* externalFilesDir) {
-  android_app_create(argc, argv, appInstallDir, appWritableDir, externalFilesDir);
+  const int64_t launchTime = android_app_trace_now();
+  android_app_create(launchTime, argc, argv, appInstallDir, appWritableDir, externalFilesDir);
 }
 
 #ifdef _MSC_VER
@@ -28,6 +28,8 @@
 #include <cstdlib>
 #include <cstdint>
 
+class LooperEventReaderWriter;
+
 // UNSUPPORTED types
 struct AInputEvent;
 typedef struct AInputEvent AInputEvent;
@@ -90,6 +92,11 @@ extern "C" {
  */
 
 struct android_app;
+struct android_app_cmd_ring;
+struct android_app_saved_state;
+struct android_app_scheduler;
+struct android_app_task;
+struct android_app_trace;
 
 /**
  * Data associated with an ALooper fd that will be returned as the "outData"
@@ -142,6 +149,10 @@ struct android_app {
   // destroyed and waiting for the app thread to complete.
   int destroyRequested;
 
+  // The task scheduler started with android_app_start_scheduler(), or NULL
+  // if the app runs single threaded.  See android_app_submit().
+  struct android_app_scheduler* scheduler;
+
   // -------------------------------------------------
   // UNSUPPORTED methods and variables
 
@@ -162,6 +173,13 @@ struct android_app {
   void* savedState;
   size_t savedStateSize;
 
+  // Memory-mapped saved state region with versioned sections, persisted in
+  // applicationWritableDir.  Unlike savedState it is never copied: see
+  // android_app_saved_state_reserve() and android_app_saved_state_get().
+  // NULL until the first section is reserved, unless a previous instance
+  // left one behind.
+  struct android_app_saved_state* mappedState;
+
   // When non-NULL, this is the window surface that the app can draw in.
   ANativeWindow* window;
 
@@ -170,8 +188,27 @@ struct android_app {
 
   int msgread;
 
+  // Reader behind msgread, set when the handle is created and before any
+  // command can be written, so the command path needs no handle lookup.
+  LooperEventReaderWriter* cmdReader;
+
+  // Commands read from msgread and not yet dispatched.  process_cmd() moves
+  // every command pending on msgread onto it once per looper wakeup and then
+  // dispatches them in one batch, so bursts of lifecycle events (e.g. PAUSE,
+  // STOP, SAVE_STATE, TERM_WINDOW) are handled in one poll iteration.
+  struct android_app_cmd_ring* cmdRing;
+
   struct android_poll_source cmdPollSource;
 
+  // Called by process_cmd() after each APP_CMD_* has been fully processed,
+  // for glue extensions such as the coroutine front-end in
+  // android_app_coroutine.h.  Independent of onAppCmd.
+  void (*cmdObserver)(struct android_app* app, int32_t cmd, void* data);
+  void* cmdObserverData;
+
+  // Lifecycle and startup latency trace, see android_app_trace_mark().
+  struct android_app_trace* trace;
+
   int running;
   int stateSaved;
   int destroyed;
@@ -290,7 +327,8 @@ enum {
    * for itself, to restore from later if needed.  If you have saved state,
    * allocate it with malloc and place it in android_app.savedState with
    * the size in android_app.savedStateSize.  The will be freed for you
-   * later.
+   * later.  Large state can instead be written in place into the
+   * memory-mapped region with android_app_saved_state_reserve().
    */
   APP_CMD_SAVE_STATE,
 
@@ -313,10 +351,20 @@ enum {
 
 /**
  * Call when ALooper_pollAll() returns LOOPER_ID_MAIN, reading the next
- * app command message.
+ * app command message.  Commands are returned in the order they were
+ * written, whether by the runtime or with android_app_write_cmd().
  */
 int8_t android_app_read_cmd(struct android_app* android_app);
 
+/**
+ * Queue an app command behind the ones the runtime has written and wake up
+ * the looper of the android_app.  May be called from any thread while the
+ * app thread is polling.
+ *
+ * Returns 1 once the command is queued.
+ */
+int android_app_write_cmd(struct android_app* android_app, int8_t cmd);
+
 /**
  * Call with the command returned by android_app_read_cmd() to do the
  * initial pre-processing of the given command.  You can perform your own
@@ -331,6 +379,142 @@ void android_app_pre_exec_cmd(struct android_app* android_app, int8_t cmd);
  */
 void android_app_post_exec_cmd(struct android_app* android_app, int8_t cmd);
 
+/**
+ * Returns a pointer to "size" writable bytes of the memory-mapped saved state
+ * region for section "sectionId", tagged with "version", or NULL on error.
+ *
+ * Call while handling APP_CMD_SAVE_STATE and write the state in place.  If
+ * the section already exists, the memory returned holds its previous
+ * contents, so data kept in the region across frames does not need to be
+ * written again.  A section that has to grow may move, and its space is
+ * reused by later sections, so a pointer stays valid until the section is
+ * reserved again with a larger size, the region is cleared, or the
+ * android_app is destroyed.  The region is flushed after the command has
+ * been handled.
+ *
+ * Only available on POSIX hosts; returns NULL on Windows.
+ */
+void* android_app_saved_state_reserve(struct android_app* android_app, uint32_t sectionId, uint32_t version,
+                                      size_t size);
+
+/**
+ * Returns the memory of saved state section "sectionId" and fills in its
+ * version and size, or returns NULL if there is no such section or the last
+ * APP_CMD_SAVE_STATE did not complete.  The memory is mapped straight from
+ * the backing file; nothing is copied or deserialized.
+ */
+void* android_app_saved_state_get(struct android_app* android_app, uint32_t sectionId, uint32_t* outVersion,
+                                  size_t* outSize);
+
+/**
+ * Drops every section of the saved state region.
+ */
+void android_app_saved_state_clear(struct android_app* android_app);
+
+/**
+ * Records a named instant in the lifecycle trace of the android_app.  The
+ * glue already marks OnAppLaunchZIv2, android_app_create,
+ * android_app_entry, android_main and android_app_destroy, and times every
+ * APP_CMD_* handled by process_cmd() (pre-exec, onAppCmd and post-exec).
+ * "name" must remain valid for the lifetime of the app, e.g. a literal.
+ * May be called from any thread.
+ */
+void android_app_trace_mark(struct android_app* android_app, const char* name);
+
+/**
+ * Call right before each MLGraphicsBeginFrameEx(); only the first call is
+ * recorded, closing the startup span of the trace.
+ */
+void android_app_trace_first_frame(struct android_app* android_app);
+
+/**
+ * Writes the lifecycle trace in Chrome trace event JSON format, loadable in
+ * chrome://tracing or Perfetto.  Returns 1 on success.
+ *
+ * Tracing is enabled by setting the ANDROID_APP_TRACE_FILE environment
+ * variable before launch; otherwise nothing is recorded and this returns 0.
+ * The glue writes the trace there, and the histograms next to it with a
+ * ".hgrm" suffix, when android_main() returns.
+ */
+int android_app_trace_write_chrome_json(struct android_app* android_app, const char* path);
+
+/**
+ * Writes per APP_CMD_* latency histograms in HdrHistogram percentile
+ * distribution format, with values in microseconds.  Returns 1 on success.
+ */
+int android_app_trace_write_histograms(struct android_app* android_app, const char* path);
+
+/**
+ * Execution lanes of the android_app task scheduler.
+ */
+enum {
+  /**
+   * General purpose CPU work.  Tasks run on a pool of work-stealing worker
+   * threads, and threads blocked in android_app_wait() help run them.
+   */
+  ANDROID_APP_LANE_WORKER,
+
+  /**
+   * A dedicated thread for rendering.  Tasks run one at a time in
+   * submission order, so graphics state bound on this thread stays valid
+   * across tasks.
+   */
+  ANDROID_APP_LANE_RENDER,
+
+  /**
+   * A dedicated thread for polling perception data (snapshots, tracking,
+   * meshing and camera results).  Tasks run in submission order.
+   */
+  ANDROID_APP_LANE_PERCEPTION,
+
+  /**
+   * A dedicated thread for blocking I/O, so that file and network access
+   * never stalls the worker pool.  Tasks run in submission order.
+   */
+  ANDROID_APP_LANE_IO,
+
+  ANDROID_APP_LANE_COUNT,
+};
+
+/**
+ * Starts the task scheduler of the android_app with "numWorkers" threads in
+ * the worker lane, plus one thread for each dedicated lane.  If numWorkers
+ * is <= 0 the worker count is derived from the number of CPU cores.
+ *
+ * Call from android_main().  Defining ANDROID_APP_SCHEDULER_WORKERS when
+ * building the glue (the ML_ZI_APP_SCHEDULER_WORKERS CMake cache variable)
+ * starts the scheduler with that many workers before
+ * android_main() is invoked.  The scheduler is stopped, after finishing all
+ * queued tasks, when android_main() returns.
+ *
+ * Returns 1 if the scheduler is running, or 0 if it could not be started.
+ */
+int android_app_start_scheduler(struct android_app* android_app, int numWorkers);
+
+/**
+ * Queues "fn(data)" on the given ANDROID_APP_LANE_* lane and returns a handle
+ * that must be passed to android_app_wait() exactly once.  Returns NULL if
+ * the scheduler is not running.
+ */
+struct android_app_task* android_app_submit(struct android_app* android_app, int lane, void (*fn)(void* data),
+                                            void* data);
+
+/**
+ * Like android_app_submit(), for tasks that are never waited on.
+ *
+ * Returns 1 if the task was queued, or 0 if the scheduler is not running.
+ */
+int android_app_post(struct android_app* android_app, int lane, void (*fn)(void* data), void* data);
+
+/**
+ * Blocks until the task has run and releases its handle.  While waiting,
+ * the calling thread runs queued worker lane tasks.
+ *
+ * Waiting on a task of a dedicated lane from the thread of that same lane
+ * deadlocks.
+ */
+void android_app_wait(struct android_app* android_app, struct android_app_task* task);
+
 /**
  * This is the entry point to running the app on host.
  *